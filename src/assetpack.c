@@ -0,0 +1,67 @@
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_timer.h>
+
+#include <string.h>
+
+#include "allocator.h"
+#include "jobs.h"
+#include "vfs.h"
+
+/*
+  Offline packer for assets. Every argument after the output is a
+  name=path pair; name is what the game asks the vfs for, relative to the
+  pack's mount, and path is the loose file to pack under it. Chunks are
+  compressed on one worker per spare core.
+*/
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    SDL_Log("Usage: %s <out.hbpack> <name>=<path>...", argv[0]);
+    return 1;
+  }
+
+  StandardAllocator std_alloc = {0};
+  create_standard_allocator(&std_alloc, "Asset Pack");
+
+  // Split each pair in place; argv outlives the pack
+  uint32_t file_count = (uint32_t)(argc - 2);
+  const char **names =
+      hb_alloc_nm_tp(std_alloc.alloc, file_count, const char *);
+  const char **paths =
+      hb_alloc_nm_tp(std_alloc.alloc, file_count, const char *);
+  if (!names || !paths) {
+    return 1;
+  }
+  for (uint32_t i = 0; i < file_count; ++i) {
+    char *pair = argv[i + 2];
+    char *split = strchr(pair, '=');
+    if (!split) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Expected name=path, got %s", pair);
+      return 1;
+    }
+    *split = '\0';
+    names[i] = pair;
+    paths[i] = split + 1;
+  }
+
+  JobSystem jobs = {0};
+  if (create_job_system(std_alloc.alloc, UINT32_MAX, &jobs) != 0) {
+    return 1;
+  }
+
+  uint64_t start = SDL_GetPerformanceCounter();
+  int32_t err = vfs_write_pack(std_alloc.alloc, &jobs, argv[1], file_count,
+                               names, paths);
+  uint64_t ticks = SDL_GetPerformanceCounter() - start;
+  if (err == 0) {
+    SDL_Log("Packed in %.3f ms with %u workers",
+            (double)ticks * 1000.0 / SDL_GetPerformanceFrequency(),
+            jobs.worker_count);
+  }
+
+  destroy_job_system(&jobs);
+  hb_free(std_alloc.alloc, names);
+  hb_free(std_alloc.alloc, paths);
+  destroy_standard_allocator(std_alloc);
+  return err == 0 ? 0 : 1;
+}
@@ -11,7 +11,9 @@
 
 #include "vk_mem_alloc.h"
 
+#include "config.h"
 #include "cpuresources.h"
+#include "derivedcache.h"
 #include "hosek.h"
 #include "pipelines.h"
 #include "shadercommon.h"
@@ -21,13 +23,40 @@
 
 #ifdef __ANDROID__
 #define ASSET_PREFIX
+#define ASSET_PACK "assets.hbpack"
 #elif __SWITCH__
 #define ASSET_PREFIX "romfs:/"
+#define ASSET_PACK "romfs:/assets.hbpack"
 #else
 #define ASSET_PREFIX "./assets/"
+#define ASSET_PACK "./assets.hbpack"
 #endif
 
 #define MAX_EXT_COUNT 16
+#define MAX_BINDLESS_TEXTURES 4096
+
+// Imported meshes and mipped textures past this are evicted at startup,
+// least recently used first
+#define DERIVED_CACHE_MAX_SIZE (1024ull * 1024 * 1024)
+
+// Pixels of screen space error a mesh level of detail may introduce
+#define DEFAULT_LOD_PIXEL_ERROR 1.0f
+// A coarser level must be this far under the threshold before we switch to
+// it so entities sitting on the boundary don't pop back and forth
+#define LOD_HYSTERESIS 0.75f
+
+_Static_assert(MESH_MAX_LODS <= (1 << DRAW_KEY_LOD_BITS),
+               "Every mesh level of detail must fit in the draw key");
+
+// Occupies slot 0 of the material table for entities without a material
+static const GLTFMaterialData default_gltf_material = {
+    .base_color_factor = {1.0f, 1.0f, 1.0f, 1.0f},
+    .metallic_factor = 0.0f,
+    .roughness_factor = 0.5f,
+    .albedo_idx = GLTF_TEXTURE_NONE,
+    .normal_idx = GLTF_TEXTURE_NONE,
+    .roughness_idx = GLTF_TEXTURE_NONE,
+};
 
 static void vma_alloc_fn(VmaAllocator allocator, uint32_t memoryType,
                          VkDeviceMemory memory, VkDeviceSize size,
@@ -55,7 +84,9 @@ static VkDevice create_device(VkPhysicalDevice gpu,
                               uint32_t present_queue_family_index,
                               uint32_t ext_count,
                               const VkAllocationCallbacks *vk_alloc,
-                              const char *const *ext_names) {
+                              const char *const *ext_names,
+                              const VkPhysicalDeviceFeatures *enabled_features,
+                              void *device_features) {
   TracyCZoneN(ctx, "create_device", true);
 
   float queue_priorities[1] = {0.0};
@@ -70,6 +101,7 @@ static VkDevice create_device(VkPhysicalDevice gpu,
   VkPhysicalDeviceRayTracingPipelineFeaturesKHR rt_pipe_feature = {
       .sType =
           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
+      .pNext = device_features,
       .rayTracingPipeline = VK_TRUE,
   };
 
@@ -80,6 +112,7 @@ static VkDevice create_device(VkPhysicalDevice gpu,
   create_info.pQueueCreateInfos = queues;
   create_info.enabledExtensionCount = ext_count;
   create_info.ppEnabledExtensionNames = ext_names;
+  create_info.pEnabledFeatures = enabled_features;
 
   if (present_queue_family_index != graphics_queue_family_index) {
     queues[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -181,86 +214,649 @@ pick_surface_format(VkSurfaceFormatKHR *surface_formats,
   return surface_formats[0];
 }
 
+// Indexed by GLTF_INDEX_TYPE_*
+static const VkIndexType gltf_index_types[GLTF_INDEX_TYPE_COUNT] = {
+    VK_INDEX_TYPE_UINT16,
+    VK_INDEX_TYPE_UINT32,
+};
+
+// Material slot 0 is the default material
+static void submesh_material(const Scene *s, const Submesh *submesh,
+                             uint32_t *material, uint32_t *perm) {
+  *material = 0;
+  *perm = GLTF_PERM_NONE;
+  if (submesh->material != SUBMESH_NO_MATERIAL) {
+    *material = submesh->material + 1;
+    *perm = s->materials[submesh->material].perm_flags;
+  }
+}
+
+// World space bounding sphere of an entity's mesh
+static float4 entity_bounds(const Scene *s, uint32_t entity,
+                            const float4x4 *m) {
+  const PooledMesh *mesh = &s->meshes[s->static_meshes[entity]];
+  float4 center = f3tof4(f4tof3(mesh->bounds), 1.0f);
+  float3 world = {dotf4(m->row0, center), dotf4(m->row1, center),
+                  dotf4(m->row2, center)};
+
+  float3 scale = s->transforms[entity].t.scale;
+  float max_scale = 0.0f;
+  for (uint32_t i = 0; i < 3; ++i) {
+    float axis = scale[i] < 0.0f ? -scale[i] : scale[i];
+    max_scale = axis > max_scale ? axis : max_scale;
+  }
+  return f3tof4(world, mesh->bounds[3] * max_scale);
+}
+
+// Picks the coarsest level whose projected error stays under the threshold.
+// pixel_scale converts object space error into pixels at the entity's
+// distance.
+static uint32_t select_mesh_lod(const PooledMesh *mesh, float pixel_scale,
+                                float threshold, uint32_t current) {
+  uint32_t lod = 0;
+  for (uint32_t i = 1; i < mesh->lod_count; ++i) {
+    float limit = i > current ? threshold * LOD_HYSTERESIS : threshold;
+    if (mesh->lod_errors[i] * pixel_scale > limit) {
+      break;
+    }
+    lod = i;
+  }
+  return lod;
+}
+
+static void demo_rasterize_occluders(const Scene *s, const float4x4 *vp,
+                                     const float4 *planes, Demo *d) {
+  TracyCZoneN(ctx, "demo_rasterize_occluders", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  OcclusionBuffer *occlusion = &d->occlusion;
+  occlusion_begin(occlusion, vp);
+  for (uint32_t i = 0; i < s->entity_count; ++i) {
+    const uint64_t occluder_components =
+        COMPONENT_TYPE_STATIC_MESH | COMPONENT_TYPE_OCCLUDER;
+    if ((s->components[i] & occluder_components) != occluder_components ||
+        !s->resident_meshes[s->static_meshes[i]]) {
+      continue;
+    }
+
+    float4x4 m = {.row0 = {0}};
+    transform_to_matrix(&m, &s->transforms[i].t);
+
+    float4 bounds = entity_bounds(s, i, &m);
+    if (!frustum_test_sphere(planes, f4tof3(bounds), bounds[3])) {
+      continue;
+    }
+
+    occlusion_add_occluder(occlusion, &m,
+                           &s->occluder_meshes[s->static_meshes[i]]);
+  }
+  occlusion_rasterize(occlusion);
+
+  TracyCZoneEnd(ctx);
+}
+
+static void demo_scene_stream_progress(void *user_data, uint32_t done_count,
+                                       uint32_t total_count) {
+  Demo *d = (Demo *)user_data;
+  d->scene_stream_done = done_count;
+  d->scene_stream_total = total_count;
+}
+
 static void demo_render_scene(Scene *s, VkCommandBuffer cmd,
+                              const GPUPipeline *pipeline,
                               VkPipelineLayout layout, VkDescriptorSet view_set,
-                              VkDescriptorSet object_set,
-                              VkDescriptorSet material_set, const float4x4 *vp,
-                              Demo *d) {
+                              const float4x4 *vp, Demo *d) {
   TracyCZoneN(ctx, "demo_render_scene", true);
   TracyCZoneColor(ctx, TracyCategoryColorRendering);
-  for (uint32_t i = 0; i < s->entity_count; ++i) {
-    uint64_t components = s->components[i];
-    SceneTransform *scene_transform = &s->transforms[i];
-    uint32_t static_mesh_idx = s->static_meshes[i];
 
-    if (components & COMPONENT_TYPE_STATIC_MESH) {
-      Transform *t = &scene_transform->t;
+  DrawStats *stats = &d->draw_stats;
+  *stats = (DrawStats){0};
+
+  // Build a packet for every submesh of every visible drawable entity
+  DrawList draw_list = {0};
+  create_drawlist(d->tmp_alloc, d->gltf_object_capacity, &draw_list);
+  {
+    TracyCZoneN(build_ctx, "Build Draw List", true);
+    TracyCZoneColor(build_ctx, TracyCategoryColorRendering);
+    uint64_t cull_start = SDL_GetPerformanceCounter();
 
-      // Hack to fuck with the scale of the object
-      // t->scale = (float3){0.01f, -0.01f, 0.01f};
-      // t->scale = (float3){100.0f, -100.0f, 100.0f};
-      t->scale = (float3){1.0f, -1.0f, 1.0f};
+    float4 planes[6] = {{0}};
+    frustum_planes(vp, planes);
 
-      CommonObjectData object_data = {0};
+    bool cpu_occlusion = d->cpu_occlusion;
+    if (cpu_occlusion) {
+      demo_rasterize_occluders(s, vp, planes, d);
+    }
 
-      transform_to_matrix(&object_data.m, t);
-      mulmf44(vp, &object_data.m, &object_data.mvp);
+    // The view matrix is orthonormal so the length of the projection's y
+    // row is the focal length
+    assert(s->entity_count <= d->entity_lod_capacity);
+    float lod_scale =
+        magf3(f4tof3(vp->row1)) * (float)d->swap_info.height * 0.5f;
 
-      // HACK: Update object's constant buffer here
-      {
-        TracyCZoneN(update_object_ctx, "Update Object Const Buffer", true);
-        TracyCZoneColor(update_object_ctx, TracyCategoryColorRendering);
+    for (uint32_t i = 0; i < s->entity_count; ++i) {
+      uint64_t components = s->components[i];
+      if ((components & COMPONENT_TYPE_STATIC_MESH) == 0) {
+        continue;
+      }
+      // Placeholders have no triangles to draw yet
+      if (!s->resident_meshes[s->static_meshes[i]]) {
+        stats->non_resident++;
+        continue;
+      }
 
-        VmaAllocator vma_alloc = d->vma_alloc;
-        VmaAllocation object_host_alloc = d->object_const_buffer.host.alloc;
+      const Transform *t = &s->transforms[i].t;
 
-        uint8_t *data = NULL;
-        VkResult err =
-            vmaMapMemory(vma_alloc, object_host_alloc, (void **)&data);
-        if (err != VK_SUCCESS) {
-          assert(0);
-          return;
+      float4x4 m = {.row0 = {0}};
+      transform_to_matrix(&m, t);
+
+      float4 bounds = entity_bounds(s, i, &m);
+      float3 center = f4tof3(bounds);
+      float radius = bounds[3];
+      if (!frustum_test_sphere(planes, center, radius)) {
+        stats->frustum_culled++;
+        continue;
+      }
+      // Occlusion is only tested for what survived the cheaper frustum test
+      if (cpu_occlusion) {
+        float3 extent = {radius, radius, radius};
+        if (!occlusion_test_aabb(&d->occlusion, center - extent,
+                                 center + extent)) {
+          stats->occlusion_culled++;
+          continue;
         }
-        memcpy(data, &object_data, sizeof(CommonObjectData));
-        vmaUnmapMemory(vma_alloc, object_host_alloc);
+      }
+
+      // View depth of the object's origin is the w of its clip position
+      float4x4 mvp = {.row0 = {0}};
+      mulmf44(vp, &m, &mvp);
+      float depth = mvp.row3[3];
+
+      uint32_t mesh = s->static_meshes[i];
+      const PooledMesh *pooled = &s->meshes[mesh];
 
-        demo_upload_const_buffer(d, &d->object_const_buffer);
+      // Error is measured against the nearest point of the bounding sphere.
+      // Once the camera is inside it only full detail is safe.
+      uint32_t lod = 0;
+      {
+        float distance = dotf4(vp->row3, f3tof4(center, 1.0f)) - radius;
+        if (distance > 0.0f && pooled->bounds[3] > 0.0f) {
+          float world_scale = radius / pooled->bounds[3];
+          float pixel_scale = lod_scale * world_scale / distance;
+          lod = select_mesh_lod(pooled, pixel_scale, d->lod_pixel_error,
+                                d->entity_lods[i]);
+        }
+        d->entity_lods[i] = (uint8_t)lod;
+      }
 
-        TracyCZoneEnd(update_object_ctx);
+      for (uint32_t ii = 0; ii < pooled->submesh_count; ++ii) {
+        uint32_t material = 0;
+        uint32_t perm = GLTF_PERM_NONE;
+        submesh_material(s, &pooled->submeshes[ii], &material, &perm);
+
+        DrawPacket *packet = drawlist_push(&draw_list);
+        *packet = (DrawPacket){
+            .key = draw_key(perm, material, mesh, lod, depth),
+            .entity = i,
+            .perm = perm,
+            .material = material,
+            .mesh = mesh,
+            .submesh = ii,
+            .lod = lod,
+        };
       }
+    }
 
-      cmd_begin_label(cmd, "demo_render_scene", (float4){0.5, 0.1, 0.1, 1.0});
+    uint64_t cull_ticks = SDL_GetPerformanceCounter() - cull_start;
+    stats->cull_ms = (float)((double)cull_ticks * 1000.0 /
+                             (double)SDL_GetPerformanceFrequency());
+    TracyCZoneEnd(build_ctx);
+  }
 
-      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
-                              1, &material_set, 0, NULL);
+  sort_drawlist(&draw_list, d->tmp_alloc);
+  stats->packet_count = draw_list.packet_count;
+
+  cmd_begin_label(cmd, "demo_render_scene", (float4){0.5, 0.1, 0.1, 1.0});
+
+  // The view set doesn't change for the duration of the pass. Set 0 stays
+  // bound across pipeline changes since every permutation shares one layout.
+  // All scene geometry lives in the mesh pool so vertices are only bound
+  // once too. Indices only need rebinding when the index type changes.
+  VkIndexType last_index_type = VK_INDEX_TYPE_UINT16;
+  if (draw_list.packet_count > 0) {
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
+                            &view_set, 0, NULL);
+    stats->descriptor_binds++;
+
+    last_index_type = s->meshes[draw_list.packets[0].mesh].index_type;
+    meshpool_bind(&d->mesh_pool, cmd, last_index_type);
+    stats->index_binds++;
+    stats->vertex_binds++;
+  }
+
+  // Object records are written in sorted order so that every run of packets
+  // sharing a permutation, material, submesh and level of detail has
+  // contiguous records and can be drawn as a single instanced draw
+  uint32_t packet_count = draw_list.packet_count;
+  assert(packet_count <= d->gltf_object_capacity);
+  VmaAllocation object_alloc = d->gltf_object_buffers[d->frame_idx].alloc;
+  GLTFObjectData *objects = NULL;
+  if (packet_count > 0) {
+    VkResult err =
+        vmaMapMemory(d->vma_alloc, object_alloc, (void **)&objects);
+    assert(err == VK_SUCCESS);
+    (void)err;
+  }
+
+  const VkDescriptorSet *material_sets =
+      &d->gltf_material_sets[d->frame_idx * d->gltf_material_set_count];
+
+  // Only record the state that differs from the previous draw
+  uint32_t last_perm = UINT32_MAX;
+  VkDescriptorSet last_material_set = VK_NULL_HANDLE;
+  uint32_t run_start = 0;
+  for (uint32_t i = 0; i < packet_count; ++i) {
+    const DrawPacket *packet = &draw_list.packets[i];
+
+    objects[i] = (GLTFObjectData){
+        .dequant = s->meshes[packet->mesh].dequant,
+        .material = packet->material,
+    };
+    transform_to_matrix(&objects[i].m, &s->transforms[packet->entity].t);
+
+    // Keep growing the run while the next packet could share the draw
+    if (i + 1 < packet_count) {
+      const DrawPacket *next = &draw_list.packets[i + 1];
+      if (next->perm == packet->perm && next->material == packet->material &&
+          next->mesh == packet->mesh && next->submesh == packet->submesh &&
+          next->lod == packet->lod) {
+        continue;
+      }
+    }
 
+    if (packet->perm != last_perm) {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline->pipelines[packet->perm]);
+      stats->pipeline_binds++;
+      last_perm = packet->perm;
+    }
+
+    // With bindless there is only one material set to bind. Otherwise every
+    // material has a set with its own textures.
+    VkDescriptorSet material_set = material_sets[0];
+    if (!d->bindless) {
+      material_set = material_sets[packet->material];
+    }
+    if (material_set != last_material_set) {
       vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1,
-                              1, &object_set, 0, NULL);
+                              1, &material_set, 0, NULL);
+      stats->descriptor_binds++;
+      last_material_set = material_set;
+    }
+
+    const PooledMesh *mesh = &s->meshes[packet->mesh];
+    if (mesh->index_type != last_index_type) {
+      meshpool_bind_indices(&d->mesh_pool, cmd, mesh->index_type);
+      stats->index_binds++;
+      last_index_type = mesh->index_type;
+    }
+
+    // firstInstance points the run at its first object record
+    const MeshLod *lod = &mesh->submeshes[packet->submesh].lods[packet->lod];
+    uint32_t instance_count = i + 1 - run_start;
+    vkCmdDrawIndexed(cmd, lod->index_count, instance_count,
+                     meshpool_first_index(mesh) + lod->first_index,
+                     (int32_t)mesh->vertices.offset, run_start);
+    stats->draw_count++;
+    stats->triangle_count += lod->index_count / 3 * instance_count;
+    run_start = i + 1;
+  }
+
+  if (objects) {
+    // The memory may not be coherent
+    vmaFlushAllocation(d->vma_alloc, object_alloc, 0, VK_WHOLE_SIZE);
+    vmaUnmapMemory(d->vma_alloc, object_alloc);
+  }
+
+  cmd_end_label(cmd);
+
+  TracyCZoneEnd(ctx);
+}
+
+// Clustered draws index the frame's compacted cluster indices, everything
+// else indexes the pool directly
+static void demo_bind_draw_bucket(VkCommandBuffer cmd, uint32_t bucket,
+                                  Demo *d) {
+  if (bucket == GLTF_DRAW_BUCKET_CLUSTERS) {
+    VkBuffer buffer = d->gltf_cluster_index_buffers[d->frame_idx].buffer;
+    vkCmdBindIndexBuffer(cmd, buffer, 0, VK_INDEX_TYPE_UINT32);
+  } else {
+    meshpool_bind_indices(&d->mesh_pool, cmd, gltf_index_types[bucket]);
+  }
+}
+
+// Must be recorded outside of a render pass
+static void demo_cull_scene(VkCommandBuffer cmd, const float4x4 *vp,
+                            uint32_t phase, Demo *d) {
+  TracyCZoneN(ctx, "demo_cull_scene", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  uint32_t frame_idx = d->frame_idx;
+  VkBuffer count_buffer = d->gltf_draw_count_buffers[frame_idx].buffer;
+  VkBuffer stats_buffer = d->gltf_cull_stats_buffers[frame_idx].buffer;
+
+  cmd_begin_label(cmd, "demo_cull_scene", (float4){0.1, 0.5, 0.1, 1.0});
+
+  // The late phase reuses the draw and cluster index buffers the depth
+  // pre-pass just read
+  if (phase == GLTF_CULL_PHASE_LATE) {
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, NULL, 0, NULL, 0, NULL);
+  } else {
+    // Stats accumulate over every phase of the frame
+    vkCmdFillBuffer(cmd, stats_buffer, 0, VK_WHOLE_SIZE, 0);
+    d->gltf_cull_stats_pending[frame_idx] = true;
+
+    // Nothing was visible before the first frame
+    if (d->gltf_visibility_reset) {
+      vkCmdFillBuffer(cmd, d->gltf_visibility_buffer.buffer, 0, VK_WHOLE_SIZE,
+                      0);
+      d->gltf_visibility_reset = false;
+    }
+  }
+
+  // Every permutation's draw count starts at zero
+  vkCmdFillBuffer(cmd, count_buffer, 0, VK_WHOLE_SIZE, 0);
+  {
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, NULL, 0, NULL);
+  }
+
+  GLTFCullConstants consts = {
+      .instance_count = d->gltf_instance_count,
+      .cluster_count = d->gltf_cluster_count,
+      .phase = phase,
+      .hiz_width = d->hiz_width,
+      .hiz_height = d->hiz_height,
+      .hiz_mip_count = d->hiz_mip_count,
+  };
+  frustum_planes(vp, consts.frustum_planes);
+
+  VkPipelineLayout layout = d->gltf_cull_pipe_layout;
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    d->gltf_cull_pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1,
+                          &d->gltf_cull_descriptor_sets[frame_idx], 0, NULL);
+  vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(GLTFCullConstants), (const void *)&consts);
+
+  uint32_t group_count =
+      (d->gltf_instance_count + GLTF_CULL_GROUP_SIZE - 1) /
+      GLTF_CULL_GROUP_SIZE;
+  if (group_count > 0) {
+    vkCmdDispatch(cmd, group_count, 1, 1);
+  }
+
+  // Clusters append to the draws their instances just wrote
+  if (d->gltf_cluster_count > 0) {
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      d->gltf_cluster_cull_pipeline);
+    vkCmdDispatch(cmd,
+                  (d->gltf_cluster_count + GLTF_CLUSTER_CULL_GROUP_SIZE - 1) /
+                      GLTF_CLUSTER_CULL_GROUP_SIZE,
+                  1, 1);
+  }
+
+  // Draws and counts are consumed as indirect arguments by the next pass and
+  // cluster indices as its index buffer. Visibility is read by the next
+  // frame's cull and stats by the host.
+  {
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                            VK_ACCESS_INDEX_READ_BIT |
+                            VK_ACCESS_SHADER_READ_BIT |
+                            VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, NULL, 0, NULL);
+  }
+
+  cmd_end_label(cmd);
+
+  TracyCZoneEnd(ctx);
+}
+
+// Lays down depth for everything the early cull phase emitted
+static void demo_depth_prepass(VkCommandBuffer cmd, Demo *d) {
+  TracyCZoneN(ctx, "demo_depth_prepass", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  uint32_t frame_idx = d->frame_idx;
+  uint32_t instance_count = d->gltf_instance_count;
+  const float width = d->swap_info.width;
+  const float height = d->swap_info.height;
+
+  cmd_begin_label(cmd, "demo_depth_prepass", (float4){0.1, 0.1, 0.5, 1.0});
+
+  {
+    VkClearValue clear_value = {
+        .depthStencil = {.depth = 0.0f, .stencil = 0.0f}};
+
+    VkRenderPassBeginInfo pass_info = {0};
+    pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    pass_info.renderPass = d->depth_prepass;
+    pass_info.framebuffer = d->depth_prepass_framebuffers[frame_idx];
+    pass_info.renderArea = (VkRect2D){{0, 0}, {width, height}};
+    pass_info.clearValueCount = 1;
+    pass_info.pClearValues = &clear_value;
+
+    vkCmdBeginRenderPass(cmd, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  VkViewport viewport = {0, height, width, -height, 0, 1};
+  VkRect2D scissor = {{0, 0}, {width, height}};
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+  if (instance_count > 0) {
+    VkPipelineLayout layout = d->gltf_pipe_layout;
+    VkBuffer draw_buffer = d->gltf_draw_buffers[frame_idx].buffer;
+    VkBuffer count_buffer = d->gltf_draw_count_buffers[frame_idx].buffer;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      d->gltf_depth_pipeline->pipelines[0]);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
+                            &d->gltf_view_descriptor_sets[frame_idx], 0,
+                            NULL);
+    meshpool_bind(&d->mesh_pool, cmd, gltf_index_types[0]);
+
+    // Permutations only matter for shading so one pipeline draws them all.
+    // Walking buckets in the outer loop keeps index rebinds to one per
+    // bucket.
+    uint32_t perm_count = d->gltf_indirect_pipeline->pipeline_count;
+    for (uint32_t type = 0; type < GLTF_DRAW_BUCKET_COUNT; ++type) {
+      if (type > 0) {
+        demo_bind_draw_bucket(cmd, type, d);
+      }
+      for (uint32_t perm = 0; perm < perm_count; ++perm) {
+        uint32_t bucket = perm * GLTF_DRAW_BUCKET_COUNT + type;
+        VkDeviceSize draw_offset =
+            (VkDeviceSize)bucket * instance_count * sizeof(GLTFDrawCommand);
+        VkDeviceSize count_offset = bucket * sizeof(uint32_t);
+        d->draw_indirect_count(cmd, draw_buffer, draw_offset, count_buffer,
+                               count_offset, instance_count,
+                               sizeof(GLTFDrawCommand));
+      }
+    }
+  }
 
-      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2,
-                              1, &view_set, 0, NULL);
+  vkCmdEndRenderPass(cmd);
 
-      const GPUMesh *mesh = &s->meshes[static_mesh_idx];
-      uint32_t idx_count = mesh->idx_count;
-      uint32_t vtx_count = mesh->vtx_count;
-      VkBuffer buffer = mesh->gpu.buffer;
+  cmd_end_label(cmd);
 
-      vkCmdBindIndexBuffer(cmd, buffer, 0, VK_INDEX_TYPE_UINT16);
-      VkDeviceSize offset = mesh->idx_size;
+  TracyCZoneEnd(ctx);
+}
+
+// Reduces the pre-pass depth into the Hi-Z pyramid one level at a time
+static void demo_build_hiz(VkCommandBuffer cmd, Demo *d) {
+  TracyCZoneN(ctx, "demo_build_hiz", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  uint32_t frame_idx = d->frame_idx;
+  uint32_t mip_count = d->hiz_mip_count;
+
+  cmd_begin_label(cmd, "demo_build_hiz", (float4){0.1, 0.5, 0.5, 1.0});
+
+  // Every level is rewritten so last frame's contents can be discarded
+  VkImageMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = d->hiz_image.image;
+  barrier.subresourceRange = (VkImageSubresourceRange){
+      VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_count, 0, 1,
+  };
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                       NULL, 1, &barrier);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, d->hiz_pipeline);
+
+  uint32_t src_width = d->swap_info.width;
+  uint32_t src_height = d->swap_info.height;
+  for (uint32_t i = 0; i < mip_count; ++i) {
+    uint32_t dst_width = SDL_max(d->hiz_width >> i, 1);
+    uint32_t dst_height = SDL_max(d->hiz_height >> i, 1);
+
+    HiZConstants consts = {
+        .src_width = src_width,
+        .src_height = src_height,
+        .dst_width = dst_width,
+        .dst_height = dst_height,
+    };
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            d->hiz_pipe_layout, 0, 1,
+                            &d->hiz_descriptor_sets[frame_idx][i], 0, NULL);
+    vkCmdPushConstants(cmd, d->hiz_pipe_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(HiZConstants), (const void *)&consts);
+    vkCmdDispatch(cmd, (dst_width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                  (dst_height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+
+    // The next level and the late cull read what was just written
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.subresourceRange.baseMipLevel = i;
+    barrier.subresourceRange.levelCount = 1;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    src_width = dst_width;
+    src_height = dst_height;
+  }
 
-      vkCmdBindVertexBuffers(cmd, 0, 1, &buffer, &offset);
-      offset += vtx_count * sizeof(float) * 3;
+  cmd_end_label(cmd);
+
+  TracyCZoneEnd(ctx);
+}
+
+// Draws whatever the cull pass left in this frame's draw buffer. The number
+// of surviving draws is only known on the GPU so stats count max draws.
+static void demo_render_scene_indirect(VkCommandBuffer cmd,
+                                       VkDescriptorSet view_set, Demo *d) {
+  TracyCZoneN(ctx, "demo_render_scene_indirect", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
 
-      vkCmdBindVertexBuffers(cmd, 1, 1, &buffer, &offset);
-      offset += vtx_count * sizeof(float) * 3;
+  DrawStats *stats = &d->draw_stats;
+  *stats = (DrawStats){0};
 
-      vkCmdBindVertexBuffers(cmd, 2, 1, &buffer, &offset);
+  uint32_t instance_count = d->gltf_instance_count;
+  if (instance_count == 0) {
+    TracyCZoneEnd(ctx);
+    return;
+  }
 
-      vkCmdDrawIndexed(cmd, idx_count, 1, 0, 0, 0);
+  uint32_t frame_idx = d->frame_idx;
+  VkPipelineLayout layout = d->gltf_pipe_layout;
+  const GPUPipeline *pipeline = d->gltf_indirect_pipeline;
+  VkBuffer draw_buffer = d->gltf_draw_buffers[frame_idx].buffer;
+  VkBuffer count_buffer = d->gltf_draw_count_buffers[frame_idx].buffer;
+
+  cmd_begin_label(cmd, "demo_render_scene_indirect",
+                  (float4){0.5, 0.1, 0.1, 1.0});
+
+  // Instances index the material table so only the bindless set is needed
+  VkDescriptorSet sets[2] = {
+      view_set, d->gltf_material_sets[frame_idx * d->gltf_material_set_count]};
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 2,
+                          sets, 0, NULL);
+  stats->descriptor_binds++;
+
+  meshpool_bind(&d->mesh_pool, cmd, gltf_index_types[0]);
+  stats->index_binds++;
+  stats->vertex_binds++;
+
+  // One indirect count draw per permutation and bucket; empty ones cost a
+  // count read. Pipelines are the more expensive bind so they change least.
+  uint32_t last_type = 0;
+  for (uint32_t perm = 0; perm < pipeline->pipeline_count; ++perm) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline->pipelines[perm]);
+    stats->pipeline_binds++;
+
+    for (uint32_t i = 0; i < GLTF_DRAW_BUCKET_COUNT; ++i) {
+      // Alternate the order so consecutive permutations share a binding
+      uint32_t type = perm % 2 == 0 ? i : GLTF_DRAW_BUCKET_COUNT - 1 - i;
+      if (type != last_type) {
+        last_type = type;
+        demo_bind_draw_bucket(cmd, type, d);
+        stats->index_binds++;
+      }
 
-      cmd_end_label(cmd);
+      uint32_t bucket = perm * GLTF_DRAW_BUCKET_COUNT + type;
+      VkDeviceSize draw_offset =
+          (VkDeviceSize)bucket * instance_count * sizeof(GLTFDrawCommand);
+      VkDeviceSize count_offset = bucket * sizeof(uint32_t);
+      d->draw_indirect_count(cmd, draw_buffer, draw_offset, count_buffer,
+                             count_offset, instance_count,
+                             sizeof(GLTFDrawCommand));
+      stats->draw_count++;
     }
   }
+  stats->packet_count = instance_count;
+
+  cmd_end_label(cmd);
+
   TracyCZoneEnd(ctx);
 }
 
@@ -557,6 +1153,10 @@ static bool demo_init_image_views(Demo *d) {
     create_info.samples = VK_SAMPLE_COUNT_1_BIT;
     create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // The Hi-Z pyramid is built from the depth pre-pass
+    if (d->gpu_driven) {
+      create_info.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
 
     VmaAllocationCreateInfo alloc_info = {0};
     alloc_info.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
@@ -602,6 +1202,106 @@ static bool demo_init_image_views(Demo *d) {
         return false;
       }
     }
+
+    // Views for sampling can only have one aspect
+    if (d->gpu_driven) {
+      create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+      for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+        if (d->depth_sample_views[i]) {
+          vkDestroyImageView(d->device, d->depth_sample_views[i],
+                             d->vk_alloc);
+        }
+        create_info.subresourceRange.baseArrayLayer = i;
+        err = vkCreateImageView(d->device, &create_info, d->vk_alloc,
+                                &d->depth_sample_views[i]);
+        if (err != VK_SUCCESS) {
+          assert(false);
+          return false;
+        }
+      }
+    }
+  }
+
+  // Create Hi-Z Pyramid
+  // Starting from the power of two below the swapchain size means every
+  // level is exactly half of the previous one
+  if (d->gpu_driven) {
+    if (d->hiz_image.image != VK_NULL_HANDLE) {
+      vkDestroyImageView(d->device, d->hiz_view, d->vk_alloc);
+      for (uint32_t i = 0; i < d->hiz_mip_count; ++i) {
+        vkDestroyImageView(d->device, d->hiz_mip_views[i], d->vk_alloc);
+      }
+      destroy_gpuimage(d->vma_alloc, &d->hiz_image);
+    }
+
+    uint32_t width = 1;
+    while (width * 2 <= d->swap_info.width) {
+      width *= 2;
+    }
+    uint32_t height = 1;
+    while (height * 2 <= d->swap_info.height) {
+      height *= 2;
+    }
+    uint32_t mip_count = 1;
+    while ((SDL_max(width, height) >> mip_count) > 0) {
+      mip_count++;
+    }
+    mip_count = SDL_min(mip_count, HIZ_MAX_MIP_COUNT);
+
+    d->hiz_width = width;
+    d->hiz_height = height;
+    d->hiz_mip_count = mip_count;
+
+    VkImageCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = VK_FORMAT_R32_SFLOAT;
+    create_info.extent = (VkExtent3D){width, height, 1};
+    create_info.mipLevels = mip_count;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage =
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    VmaAllocationCreateInfo alloc_info = {0};
+    alloc_info.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.pUserData = (void *)("Hi-Z Pyramid Memory");
+    err = create_gpuimage(d->vma_alloc, &create_info, &alloc_info,
+                          &d->hiz_image);
+    if (err != VK_SUCCESS) {
+      assert(false);
+      return false;
+    }
+    set_vk_name(d->device, (uint64_t)d->hiz_image.image, VK_OBJECT_TYPE_IMAGE,
+                "hiz pyramid");
+
+    VkImageViewCreateInfo view_info = {0};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = d->hiz_image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = VK_FORMAT_R32_SFLOAT;
+    view_info.subresourceRange = (VkImageSubresourceRange){
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_count, 0, 1,
+    };
+    err = vkCreateImageView(d->device, &view_info, d->vk_alloc, &d->hiz_view);
+    if (err != VK_SUCCESS) {
+      assert(false);
+      return false;
+    }
+
+    // Each level is written through its own view
+    view_info.subresourceRange.levelCount = 1;
+    for (uint32_t i = 0; i < mip_count; ++i) {
+      view_info.subresourceRange.baseMipLevel = i;
+      err = vkCreateImageView(d->device, &view_info, d->vk_alloc,
+                              &d->hiz_mip_views[i]);
+      if (err != VK_SUCCESS) {
+        assert(false);
+        return false;
+      }
+    }
   }
 
   return true;
@@ -624,6 +1324,12 @@ static bool demo_init_framebuffers(Demo *d) {
                              d->vk_alloc);
       }
     }
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      if (d->depth_prepass_framebuffers[i]) {
+        vkDestroyFramebuffer(d->device, d->depth_prepass_framebuffers[i],
+                             d->vk_alloc);
+      }
+    }
   }
 
   VkFramebufferCreateInfo create_info = {0};
@@ -667,9 +1373,565 @@ static bool demo_init_framebuffers(Demo *d) {
     }
   }
 
+  // Create depth pre-pass framebuffers
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    VkImageView attachments[1] = {
+        d->depth_buffer_views[i],
+    };
+
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = attachments;
+    create_info.renderPass = d->depth_prepass;
+    err = vkCreateFramebuffer(d->device, &create_info, d->vk_alloc,
+                              &d->depth_prepass_framebuffers[i]);
+    if (err != VK_SUCCESS) {
+      assert(false);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Points the Hi-Z build and cull sets at the current depth buffers and
+// pyramid. Must be called again whenever those are recreated.
+static void demo_write_hiz_descriptors(Demo *d) {
+  uint32_t mip_count = d->hiz_mip_count;
+
+  VkDescriptorImageInfo hiz_info = {
+      .imageView = d->hiz_view,
+      .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+  };
+
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = d->gltf_cull_descriptor_sets[i],
+        .dstBinding = 5,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &hiz_info,
+    };
+    vkUpdateDescriptorSets(d->device, 1, &write, 0, NULL);
+
+    for (uint32_t ii = 0; ii < mip_count; ++ii) {
+      // Level 0 is reduced straight from this frame's depth buffer
+      VkDescriptorImageInfo src_info = {
+          .imageView = d->depth_sample_views[i],
+          .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      };
+      if (ii > 0) {
+        src_info = (VkDescriptorImageInfo){
+            .imageView = d->hiz_mip_views[ii - 1],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+      }
+      VkDescriptorImageInfo dst_info = {
+          .imageView = d->hiz_mip_views[ii],
+          .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+      };
+
+      VkDescriptorSet hiz_set = d->hiz_descriptor_sets[i][ii];
+      VkWriteDescriptorSet writes[2] = {
+          {
+              .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+              .dstSet = hiz_set,
+              .dstBinding = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+              .pImageInfo = &src_info,
+          },
+          {
+              .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+              .dstSet = hiz_set,
+              .dstBinding = 1,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+              .pImageInfo = &dst_info,
+          },
+      };
+      vkUpdateDescriptorSets(d->device, 2, writes, 0, NULL);
+    }
+  }
+}
+
+// Rewrites and queues an upload of the main scene's material table. Textures
+// that aren't resident, or have no levels uploaded yet, resolve to
+// GLTF_TEXTURE_NONE so their materials fall back to their factors until the
+// texture streams in. The rest are clamped to their finest uploaded level,
+// counted from the first level their image holds.
+static void demo_write_material_table(Demo *d) {
+  const Scene *s = d->main_scene;
+
+  GLTFMaterialData *data = NULL;
+  VkResult err = vmaMapMemory(d->vma_alloc, d->gltf_material_table.host.alloc,
+                              (void **)&data);
+  assert(err == VK_SUCCESS);
+  (void)err;
+
+  data[0] = default_gltf_material;
+  for (uint32_t i = 0; i < s->material_count; ++i) {
+    GLTFMaterialData material = s->materials[i].data;
+    uint32_t *texture_ids[3] = {
+        &material.albedo_idx,
+        &material.normal_idx,
+        &material.roughness_idx,
+    };
+    float *min_lods[3] = {
+        &material.albedo_min_lod,
+        &material.normal_min_lod,
+        &material.roughness_min_lod,
+    };
+    for (uint32_t ii = 0; ii < 3; ++ii) {
+      uint32_t id = *texture_ids[ii];
+      if (id == GLTF_TEXTURE_NONE) {
+        continue;
+      }
+      uint32_t base_level = s->texture_base_levels[id];
+      if ((d->bindless && id >= d->bindless_texture_count) ||
+          !s->resident_textures[id] ||
+          base_level >= s->textures[id].mip_levels) {
+        *texture_ids[ii] = GLTF_TEXTURE_NONE;
+      } else {
+        *min_lods[ii] =
+            (float)(base_level - s->textures[id].image_base_level);
+      }
+    }
+    data[i + 1] = material;
+  }
+  vmaUnmapMemory(d->vma_alloc, d->gltf_material_table.host.alloc);
+
+  demo_upload_const_buffer(d, &d->gltf_material_table);
+}
+
+// Points a frame's material sets at the main scene's resident textures. The
+// frame's previous submission must have finished.
+static void demo_write_material_sets(Demo *d, uint32_t frame) {
+  const Scene *s = d->main_scene;
+  uint32_t set_count = d->gltf_material_set_count;
+  const VkDescriptorSet *sets = &d->gltf_material_sets[frame * set_count];
+
+  VkDescriptorBufferInfo table_info = {d->gltf_material_table.gpu.buffer, 0,
+                                       d->gltf_material_table.size};
+
+  // Slots without a resident texture still need a valid image. The
+  // material table never points a shader at them.
+  if (d->bindless) {
+    uint32_t texture_count = d->bindless_texture_count;
+    VkDescriptorImageInfo *image_infos = hb_alloc_nm_tp(
+        d->tmp_alloc, SDL_max(texture_count, 1), VkDescriptorImageInfo);
+    for (uint32_t i = 0; i < texture_count; ++i) {
+      VkImageView view = d->imgui_atlas.view;
+      if (s->resident_textures[i]) {
+        view = s->textures[i].view;
+      }
+      image_infos[i] = (VkDescriptorImageInfo){
+          NULL, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+
+    VkWriteDescriptorSet writes[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = sets[0],
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &table_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = sets[0],
+            .dstBinding = 2,
+            .descriptorCount = texture_count,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .pImageInfo = image_infos,
+        },
+    };
+    // Partially bound so an empty texture array is fine
+    vkUpdateDescriptorSets(d->device, texture_count > 0 ? 2 : 1, writes, 0,
+                           NULL);
+  } else {
+    for (uint32_t i = 0; i < set_count; ++i) {
+      const GLTFMaterialData *material =
+          i == 0 ? &default_gltf_material : &s->materials[i - 1].data;
+      uint32_t texture_ids[3] = {
+          material->albedo_idx,
+          material->normal_idx,
+          material->roughness_idx,
+      };
+
+      VkDescriptorImageInfo image_infos[3] = {{0}};
+      for (uint32_t ii = 0; ii < 3; ++ii) {
+        VkImageView view = d->imgui_atlas.view;
+        if (texture_ids[ii] != GLTF_TEXTURE_NONE &&
+            s->resident_textures[texture_ids[ii]]) {
+          view = s->textures[texture_ids[ii]].view;
+        }
+        image_infos[ii] = (VkDescriptorImageInfo){
+            NULL, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      }
+
+      VkWriteDescriptorSet writes[2] = {
+          {
+              .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+              .dstSet = sets[i],
+              .dstBinding = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+              .pBufferInfo = &table_info,
+          },
+          {
+              .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+              .dstSet = sets[i],
+              .dstBinding = 2,
+              .descriptorCount = 3,
+              .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+              .pImageInfo = image_infos,
+          },
+      };
+      vkUpdateDescriptorSets(d->device, 2, writes, 0, NULL);
+    }
+  }
+  d->gltf_material_sets_dirty[frame] = false;
+}
+
+// Frees the texture images a frame swapped out. Every frame that could have
+// sampled them must have finished.
+static void demo_destroy_retired_textures(Demo *d, uint32_t frame) {
+  for (uint32_t i = 0; i < d->retired_texture_counts[frame]; ++i) {
+    const RetiredTextureImage *retired = &d->retired_textures[frame][i];
+    vkDestroyImageView(d->device, retired->view, d->vk_alloc);
+    destroy_gpuimage(d->vma_alloc, &retired->image);
+  }
+  d->retired_texture_counts[frame] = 0;
+}
+
+// Builds the GPU driven instance and cluster tables for the resident part
+// of the main scene along with every buffer sized by them. Instances are
+// static so they are only written here. Each frame gets its own draw and
+// count buffers since the cull pass rewrites them every frame. The cull sets
+// must already be allocated and no frame may be in flight.
+static bool demo_create_gpu_scene(Demo *d) {
+  VkDevice device = d->device;
+  VmaAllocator vma_alloc = d->vma_alloc;
+  const VkAllocationCallbacks *vk_alloc = d->vk_alloc;
+  VkResult err = VK_SUCCESS;
+
+  const Scene *s = d->main_scene;
+
+  // Every resident submesh is its own instance since it may need its own
+  // pipeline. Submeshes with more than one cluster are culled per cluster
+  // and get room for their full index count in the cluster index buffer.
+  uint32_t instance_count = 0;
+  uint32_t cluster_count = 0;
+  uint32_t cluster_index_count = 0;
+  for (uint32_t i = 0; i < s->entity_count; ++i) {
+    if ((s->components[i] & COMPONENT_TYPE_STATIC_MESH) == 0 ||
+        !s->resident_meshes[s->static_meshes[i]]) {
+      continue;
+    }
+    const PooledMesh *mesh = &s->meshes[s->static_meshes[i]];
+    instance_count += mesh->submesh_count;
+    for (uint32_t ii = 0; ii < mesh->submesh_count; ++ii) {
+      const Submesh *submesh = &mesh->submeshes[ii];
+      if (submesh->cluster_count > 1) {
+        cluster_count += submesh->cluster_count;
+        cluster_index_count += submesh->lods[0].index_count;
+      }
+    }
+  }
+  d->gltf_instance_count = instance_count;
+  d->gltf_cluster_count = cluster_count;
+
+  // Zero sized buffers aren't allowed
+  uint32_t max_instances = SDL_max(instance_count, 1);
+  uint32_t max_clusters = SDL_max(cluster_count, 1);
+  uint32_t max_cluster_indices = SDL_max(cluster_index_count, 1);
+  d->gltf_instance_buffer =
+      create_gpustoragebuffer(device, vma_alloc, vk_alloc,
+                              max_instances * sizeof(GLTFInstanceData));
+  d->gltf_cluster_buffer =
+      create_gpustoragebuffer(device, vma_alloc, vk_alloc,
+                              max_clusters * sizeof(GLTFClusterData));
+
+  GLTFInstanceData *data = NULL;
+  err = vmaMapMemory(vma_alloc, d->gltf_instance_buffer.host.alloc,
+                     (void **)&data);
+  if (err != VK_SUCCESS) {
+    assert(0);
+    return false;
+  }
+  GLTFClusterData *cluster_data = NULL;
+  err = vmaMapMemory(vma_alloc, d->gltf_cluster_buffer.host.alloc,
+                     (void **)&cluster_data);
+  if (err != VK_SUCCESS) {
+    assert(0);
+    return false;
+  }
+  uint32_t instance_idx = 0;
+  uint32_t cluster_idx = 0;
+  uint32_t cluster_index_offset = 0;
+  for (uint32_t i = 0; i < s->entity_count; ++i) {
+    if ((s->components[i] & COMPONENT_TYPE_STATIC_MESH) == 0 ||
+        !s->resident_meshes[s->static_meshes[i]]) {
+      continue;
+    }
+    const PooledMesh *mesh = &s->meshes[s->static_meshes[i]];
+    uint32_t index_type = mesh->index_type == VK_INDEX_TYPE_UINT32
+                              ? GLTF_INDEX_TYPE_UINT32
+                              : GLTF_INDEX_TYPE_UINT16;
+
+    // The GPU driven path always draws full detail
+    for (uint32_t ii = 0; ii < mesh->submesh_count; ++ii) {
+      const Submesh *submesh = &mesh->submeshes[ii];
+      GLTFInstanceData *instance = &data[instance_idx++];
+      *instance = (GLTFInstanceData){
+          .dequant = mesh->dequant,
+          .bounds = mesh->bounds,
+          .first_index =
+              meshpool_first_index(mesh) + submesh->lods[0].first_index,
+          .index_count = submesh->lods[0].index_count,
+          .vertex_offset = (int32_t)mesh->vertices.offset,
+          .index_type = index_type,
+      };
+      submesh_material(s, submesh, &instance->material, &instance->perm);
+      transform_to_matrix(&instance->m, &s->transforms[i].t);
+
+      // A lone cluster can't cull anything the instance test didn't
+      if (submesh->cluster_count <= 1) {
+        continue;
+      }
+      instance->cluster_count = submesh->cluster_count;
+      instance->cluster_index_offset = cluster_index_offset;
+      cluster_index_offset += submesh->lods[0].index_count;
+      for (uint32_t iii = 0; iii < submesh->cluster_count; ++iii) {
+        const MeshCluster *cluster =
+            &mesh->clusters[submesh->first_cluster + iii];
+        cluster_data[cluster_idx++] = (GLTFClusterData){
+            .bounds = cluster->bounds,
+            .cone = cluster->cone,
+            .instance = instance_idx - 1,
+            .first_index = meshpool_first_index(mesh) + cluster->first_index,
+            .index_count = cluster->index_count,
+            .index_type = index_type,
+        };
+      }
+    }
+  }
+  vmaUnmapMemory(vma_alloc, d->gltf_cluster_buffer.host.alloc);
+  vmaUnmapMemory(vma_alloc, d->gltf_instance_buffer.host.alloc);
+
+  demo_upload_const_buffer(d, &d->gltf_instance_buffer);
+  demo_upload_const_buffer(d, &d->gltf_cluster_buffer);
+
+  // Every permutation and draw bucket gets room for every instance
+  uint32_t bucket_count =
+      d->gltf_indirect_pipeline->pipeline_count * GLTF_DRAW_BUCKET_COUNT;
+  VkDeviceSize draw_size =
+      bucket_count * max_instances * sizeof(GLTFDrawCommand);
+  VkDeviceSize count_size = bucket_count * sizeof(uint32_t);
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    err = create_gpubuffer(vma_alloc, draw_size, VMA_MEMORY_USAGE_GPU_ONLY,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                           &d->gltf_draw_buffers[i]);
+    assert(err == VK_SUCCESS);
+    set_vk_name(device, (uint64_t)d->gltf_draw_buffers[i].buffer,
+                VK_OBJECT_TYPE_BUFFER, "gltf draw buffer");
+
+    err = create_gpubuffer(vma_alloc, count_size, VMA_MEMORY_USAGE_GPU_ONLY,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           &d->gltf_draw_count_buffers[i]);
+    assert(err == VK_SUCCESS);
+    set_vk_name(device, (uint64_t)d->gltf_draw_count_buffers[i].buffer,
+                VK_OBJECT_TYPE_BUFFER, "gltf draw count buffer");
+
+    err = create_gpubuffer(vma_alloc, sizeof(GLTFCullStats),
+                           VMA_MEMORY_USAGE_GPU_TO_CPU,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           &d->gltf_cull_stats_buffers[i]);
+    assert(err == VK_SUCCESS);
+    set_vk_name(device, (uint64_t)d->gltf_cull_stats_buffers[i].buffer,
+                VK_OBJECT_TYPE_BUFFER, "gltf cull stats buffer");
+
+    err = create_gpubuffer(vma_alloc, max_instances * sizeof(uint32_t),
+                           VMA_MEMORY_USAGE_GPU_ONLY,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           &d->gltf_instance_draw_buffers[i]);
+    assert(err == VK_SUCCESS);
+    set_vk_name(device, (uint64_t)d->gltf_instance_draw_buffers[i].buffer,
+                VK_OBJECT_TYPE_BUFFER, "gltf instance draw buffer");
+
+    err = create_gpubuffer(vma_alloc, max_cluster_indices * sizeof(uint32_t),
+                           VMA_MEMORY_USAGE_GPU_ONLY,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                           &d->gltf_cluster_index_buffers[i]);
+    assert(err == VK_SUCCESS);
+    set_vk_name(device, (uint64_t)d->gltf_cluster_index_buffers[i].buffer,
+                VK_OBJECT_TYPE_BUFFER, "gltf cluster index buffer");
+  }
+
+  // Visibility carries over between frames so there is only one
+  VkDeviceSize visibility_size = max_instances * sizeof(uint32_t);
+  err = create_gpubuffer(vma_alloc, visibility_size, VMA_MEMORY_USAGE_GPU_ONLY,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         &d->gltf_visibility_buffer);
+  assert(err == VK_SUCCESS);
+  set_vk_name(device, (uint64_t)d->gltf_visibility_buffer.buffer,
+              VK_OBJECT_TYPE_BUFFER, "gltf visibility buffer");
+  d->gltf_visibility_reset = true;
+
+  // Fresh stats buffers have nothing to read back
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    d->gltf_cull_stats_pending[i] = false;
+  }
+
+  VkDescriptorBufferInfo instance_info = {
+      d->gltf_instance_buffer.gpu.buffer, 0, d->gltf_instance_buffer.size};
+  VkDescriptorBufferInfo camera_info = {d->camera_const_buffer.gpu.buffer,
+                                        0, d->camera_const_buffer.size};
+  VkDescriptorBufferInfo visibility_info = {
+      d->gltf_visibility_buffer.buffer, 0, visibility_size};
+  VkDescriptorBufferInfo cluster_info = {d->gltf_cluster_buffer.gpu.buffer,
+                                         0, d->gltf_cluster_buffer.size};
+  // Just the index region of the pool; the pool never grows in place
+  const MeshPool *pool = &d->mesh_pool;
+  VkDescriptorBufferInfo pool_index_info = {
+      pool->gpu.buffer, pool->index_offset,
+      pool->stream_offsets[0] - pool->index_offset};
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    VkDescriptorBufferInfo draw_info = {d->gltf_draw_buffers[i].buffer, 0,
+                                        draw_size};
+    VkDescriptorBufferInfo count_info = {
+        d->gltf_draw_count_buffers[i].buffer, 0, count_size};
+    VkDescriptorBufferInfo stats_info = {
+        d->gltf_cull_stats_buffers[i].buffer, 0, sizeof(GLTFCullStats)};
+    VkDescriptorBufferInfo instance_draw_info = {
+        d->gltf_instance_draw_buffers[i].buffer, 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo cluster_index_info = {
+        d->gltf_cluster_index_buffers[i].buffer, 0, VK_WHOLE_SIZE};
+
+    // The Hi-Z binding depends on the swapchain size and is written
+    // separately
+    VkDescriptorSet cull_set = d->gltf_cull_descriptor_sets[i];
+    VkWriteDescriptorSet writes[11] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &instance_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &draw_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 2,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &count_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 3,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &camera_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 4,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &visibility_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 6,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &stats_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 7,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &instance_draw_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 8,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &cluster_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 9,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &pool_index_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = cull_set,
+            .dstBinding = 10,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &cluster_index_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = d->gltf_view_descriptor_sets[i],
+            .dstBinding = 2,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &instance_info,
+        },
+    };
+    vkUpdateDescriptorSets(device, 11, writes, 0, NULL);
+  }
+
   return true;
 }
 
+static void demo_destroy_gpu_scene(Demo *d) {
+  VkDevice device = d->device;
+  VmaAllocator vma_alloc = d->vma_alloc;
+  const VkAllocationCallbacks *vk_alloc = d->vk_alloc;
+
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    destroy_gpubuffer(vma_alloc, &d->gltf_draw_buffers[i]);
+    destroy_gpubuffer(vma_alloc, &d->gltf_draw_count_buffers[i]);
+    destroy_gpubuffer(vma_alloc, &d->gltf_cull_stats_buffers[i]);
+    destroy_gpubuffer(vma_alloc, &d->gltf_instance_draw_buffers[i]);
+    destroy_gpubuffer(vma_alloc, &d->gltf_cluster_index_buffers[i]);
+  }
+  destroy_gpubuffer(vma_alloc, &d->gltf_visibility_buffer);
+  destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->gltf_instance_buffer);
+  destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->gltf_cluster_buffer);
+}
+
 static bool demo_init_imgui(Demo *d, SDL_Window *window) {
   (void)window;
   ImGuiContext *ctx = igCreateContext(NULL);
@@ -899,9 +2161,133 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   }
   */
 
-  VkDevice device = create_device(gpu, graphics_queue_family_index,
-                                  present_queue_family_index, device_ext_count,
-                                  vk_alloc, device_ext_names);
+  // Descriptor indexing lets us go bindless for material textures and
+  // indirect count draws let culling and draw submission move to the GPU
+  bool bindless = false;
+  bool gpu_driven = false;
+  bool memory_budget = false;
+  VkPhysicalDeviceDescriptorIndexingFeatures indexing_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+  };
+  VkPhysicalDeviceFeatures2 device_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &indexing_features,
+  };
+  // Features2 may only be chained on 1.1 devices
+  bool chain_features = gpu_props.apiVersion >= VK_API_VERSION_1_1;
+  {
+    uint32_t ext_prop_count = 0;
+    err = vkEnumerateDeviceExtensionProperties(gpu, NULL, &ext_prop_count,
+                                               NULL);
+    assert(err == VK_SUCCESS);
+    VkExtensionProperties *ext_props =
+        hb_alloc_nm_tp(tmp_alloc, ext_prop_count, VkExtensionProperties);
+    err = vkEnumerateDeviceExtensionProperties(gpu, NULL, &ext_prop_count,
+                                               ext_props);
+    assert(err == VK_SUCCESS);
+
+    bool indexing_ext = false;
+    bool indirect_count_ext = false;
+    bool memory_budget_ext = false;
+    for (uint32_t i = 0; i < ext_prop_count; ++i) {
+      const char *ext_name = ext_props[i].extensionName;
+      if (SDL_strcmp(ext_name, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ==
+          0) {
+        indexing_ext = true;
+      } else if (SDL_strcmp(ext_name,
+                            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+        indirect_count_ext = true;
+      } else if (SDL_strcmp(ext_name,
+                            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+        memory_budget_ext = true;
+      }
+    }
+    hb_free(tmp_alloc, ext_props);
+
+    // The indexing extension relies on maintenance3 which is core in 1.1
+    if (chain_features) {
+      vkGetPhysicalDeviceFeatures2(gpu, &device_features);
+
+      const VkPhysicalDeviceFeatures *features = &device_features.features;
+      bindless = indexing_ext &&
+                 indexing_features.shaderSampledImageArrayNonUniformIndexing &&
+                 indexing_features.runtimeDescriptorArray &&
+                 indexing_features.descriptorBindingPartiallyBound &&
+                 indexing_features.descriptorBindingVariableDescriptorCount;
+      // The indirect path reads materials from the bindless tables
+      gpu_driven = bindless && indirect_count_ext &&
+                   features->multiDrawIndirect &&
+                   features->drawIndirectFirstInstance;
+      // Budgets are queried through the core 1.1 memory properties
+      memory_budget = memory_budget_ext;
+    }
+
+    // Only enable what we actually use
+    device_features.features = (VkPhysicalDeviceFeatures){0};
+    indexing_features = (VkPhysicalDeviceDescriptorIndexingFeatures){
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+    };
+
+    if (bindless) {
+      indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+      indexing_features.runtimeDescriptorArray = VK_TRUE;
+      indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+      indexing_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+
+      assert(device_ext_count + 1 < MAX_EXT_COUNT);
+      device_ext_names[device_ext_count++] =
+          VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+    } else {
+      SDL_Log("%s", "Descriptor indexing unsupported; using per-material "
+                    "descriptor sets");
+    }
+
+    if (gpu_driven) {
+      device_features.features.multiDrawIndirect = VK_TRUE;
+      device_features.features.drawIndirectFirstInstance = VK_TRUE;
+
+      assert(device_ext_count + 1 < MAX_EXT_COUNT);
+      device_ext_names[device_ext_count++] =
+          VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+    } else {
+      SDL_Log("%s", "Indirect count draws unsupported; culling on the CPU");
+    }
+
+    // Without it VMA estimates budgets from heap sizes alone
+    if (memory_budget) {
+      assert(device_ext_count + 1 < MAX_EXT_COUNT);
+      device_ext_names[device_ext_count++] =
+          VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+
+    // Compressed formats can only be sampled once their family's feature is
+    // enabled; transcoding then picks from whichever families made it
+    device_features.features.textureCompressionASTC_LDR =
+        gpu_features.textureCompressionASTC_LDR;
+    device_features.features.textureCompressionBC =
+        gpu_features.textureCompressionBC;
+    device_features.features.textureCompressionETC2 =
+        gpu_features.textureCompressionETC2;
+  }
+
+  // Features2 replaces pEnabledFeatures, so only one of the two is passed
+  VkDevice device = create_device(
+      gpu, graphics_queue_family_index, present_queue_family_index,
+      device_ext_count, vk_alloc, device_ext_names,
+      chain_features ? NULL : &device_features.features,
+      chain_features ? (void *)&device_features : NULL);
+
+  uint32_t texture_format_caps =
+      query_texture_format_caps(gpu, &device_features.features);
+
+  // Comes from an optional extension so volk doesn't load it for us
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count = NULL;
+  if (gpu_driven) {
+    draw_indirect_count =
+        (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            device, "vkCmdDrawIndexedIndirectCountKHR");
+    assert(draw_indirect_count);
+  }
 
   VkQueue graphics_queue = VK_NULL_HANDLE;
   vkGetDeviceQueue(device, graphics_queue_family_index, 0, &graphics_queue);
@@ -953,27 +2339,96 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
     create_info.vulkanApiVersion = VK_API_VERSION_1_0;
     create_info.pAllocationCallbacks = vk_alloc;
     create_info.pDeviceMemoryCallbacks = &vma_callbacks;
+    if (memory_budget) {
+      volk_functions.vkGetPhysicalDeviceMemoryProperties2KHR =
+          vkGetPhysicalDeviceMemoryProperties2;
+      create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     err = vmaCreateAllocator(&create_info, &vma_alloc);
     assert(err == VK_SUCCESS);
-  }
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  {
+    int32_t w = 0;
+    int32_t h = 0;
+    SDL_GetWindowSize(window, &w, &h);
+    width = (uint32_t)w;
+    height = (uint32_t)h;
+  }
+
+  // Create Swapchain
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+  SwapchainInfo swap_info = init_swapchain(window, device, gpu, surface,
+                                           &swapchain, vk_alloc, tmp_alloc);
+
+  // Create Render Pass
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  {
+    VkAttachmentDescription color_attachment = {0};
+    color_attachment.format = swap_info.format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription depth_attachment = {0};
+    depth_attachment.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription attachments[2] = {color_attachment,
+                                              depth_attachment};
+
+    VkAttachmentReference color_attachment_ref = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_attachment_ref = {
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkAttachmentReference attachment_refs[1] = {color_attachment_ref};
+
+    VkSubpassDescription subpass = {0};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = attachment_refs;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    VkSubpassDependency subpass_dep = {0};
+    subpass_dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpass_dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpass_dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 2;
+    create_info.pAttachments = attachments;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    create_info.pDependencies = &subpass_dep;
+    err = vkCreateRenderPass(device, &create_info, vk_alloc, &render_pass);
+    assert(err == VK_SUCCESS);
 
-  uint32_t width = 0;
-  uint32_t height = 0;
-  {
-    int32_t w = 0;
-    int32_t h = 0;
-    SDL_GetWindowSize(window, &w, &h);
-    width = (uint32_t)w;
-    height = (uint32_t)h;
+    set_vk_name(device, (uint64_t)render_pass, VK_OBJECT_TYPE_RENDER_PASS,
+                "main render pass");
   }
 
-  // Create Swapchain
-  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
-  SwapchainInfo swap_info = init_swapchain(window, device, gpu, surface,
-                                           &swapchain, vk_alloc, tmp_alloc);
-
-  // Create Render Pass
-  VkRenderPass render_pass = VK_NULL_HANDLE;
+  // Create Main Render Pass that loads the depth pre-pass
+  // Only load ops and layouts differ so it stays compatible with the main
+  // pass's pipelines and framebuffers
+  VkRenderPass main_load_pass = VK_NULL_HANDLE;
   {
     VkAttachmentDescription color_attachment = {0};
     color_attachment.format = swap_info.format;
@@ -988,11 +2443,12 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
     VkAttachmentDescription depth_attachment = {0};
     depth_attachment.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
     depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
     depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.initialLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
     depth_attachment.finalLayout =
         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -1004,20 +2460,22 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
     VkAttachmentReference depth_attachment_ref = {
         1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
-    VkAttachmentReference attachment_refs[1] = {color_attachment_ref};
-
     VkSubpassDescription subpass = {0};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = attachment_refs;
+    subpass.pColorAttachments = &color_attachment_ref;
     subpass.pDepthStencilAttachment = &depth_attachment_ref;
 
+    // The Hi-Z build reads depth before the main pass writes to it again
     VkSubpassDependency subpass_dep = {0};
+    subpass_dep.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dep.dstSubpass = 0;
     subpass_dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     subpass_dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
                                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     subpass_dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     VkRenderPassCreateInfo create_info = {0};
@@ -1026,12 +2484,74 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
     create_info.pAttachments = attachments;
     create_info.subpassCount = 1;
     create_info.pSubpasses = &subpass;
+    create_info.dependencyCount = 1;
     create_info.pDependencies = &subpass_dep;
-    err = vkCreateRenderPass(device, &create_info, vk_alloc, &render_pass);
+    err = vkCreateRenderPass(device, &create_info, vk_alloc, &main_load_pass);
     assert(err == VK_SUCCESS);
 
-    set_vk_name(device, (uint64_t)render_pass, VK_OBJECT_TYPE_RENDER_PASS,
-                "main render pass");
+    set_vk_name(device, (uint64_t)main_load_pass, VK_OBJECT_TYPE_RENDER_PASS,
+                "main load depth render pass");
+  }
+
+  // Create Depth Pre-Pass
+  // Leaves depth read-only so the Hi-Z build can sample it
+  VkRenderPass depth_prepass = VK_NULL_HANDLE;
+  {
+    VkAttachmentDescription depth_attachment = {0};
+    depth_attachment.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref = {
+        0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass = {0};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    VkSubpassDependency subpass_deps[2] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+        },
+    };
+
+    VkRenderPassCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &depth_attachment;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    create_info.dependencyCount = 2;
+    create_info.pDependencies = subpass_deps;
+    err = vkCreateRenderPass(device, &create_info, vk_alloc, &depth_prepass);
+    assert(err == VK_SUCCESS);
+
+    set_vk_name(device, (uint64_t)depth_prepass, VK_OBJECT_TYPE_RENDER_PASS,
+                "depth pre-pass");
   }
 
   // Create ImGui Render Pass
@@ -1150,53 +2670,45 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
                 "immutable sampler");
   }
 
-  // Create Common Object DescriptorSet Layout
-  VkDescriptorSetLayout gltf_object_set_layout = VK_NULL_HANDLE;
+  // Create Common Per-View DescriptorSet Layout
+  VkDescriptorSetLayout gltf_view_set_layout = VK_NULL_HANDLE;
   {
-    VkDescriptorSetLayoutBinding bindings[1] = {
+    VkDescriptorSetLayoutBinding bindings[4] = {
         {
             0,
             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
             1,
-            VK_SHADER_STAGE_VERTEX_BIT,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
             NULL,
         },
-    };
-
-    VkDescriptorSetLayoutCreateInfo create_info = {0};
-    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    create_info.bindingCount = 1;
-    create_info.pBindings = bindings;
-    err = vkCreateDescriptorSetLayout(device, &create_info, vk_alloc,
-                                      &gltf_object_set_layout);
-    assert(err == VK_SUCCESS);
-    set_vk_name(device, (uint64_t)gltf_object_set_layout,
-                VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "gltf object set layout");
-  }
-
-  // Create Common Per-View DescriptorSet Layout
-  VkDescriptorSetLayout gltf_view_set_layout = VK_NULL_HANDLE;
-  {
-    VkDescriptorSetLayoutBinding bindings[2] = {
         {
-            0,
+            1,
             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
             1,
             VK_SHADER_STAGE_FRAGMENT_BIT,
             NULL,
         },
+        // Instance data; only read by the indirect pipeline
         {
+            2,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             1,
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            NULL,
+        },
+        // Object data; only read by the CPU built draws
+        {
+            3,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             1,
-            VK_SHADER_STAGE_FRAGMENT_BIT,
+            VK_SHADER_STAGE_VERTEX_BIT,
             NULL,
         },
     };
 
     VkDescriptorSetLayoutCreateInfo create_info = {0};
     create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    create_info.bindingCount = 2;
+    create_info.bindingCount = 4;
     create_info.pBindings = bindings;
     err = vkCreateDescriptorSetLayout(device, &create_info, vk_alloc,
                                       &gltf_view_set_layout);
@@ -1206,24 +2718,58 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
                 VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "gltf view set layout");
   }
 
-  // Create GLTF Descriptor Set Layout
+  // Create GLTF Material Descriptor Set Layout
+  // When bindless, one set holds the material table and every scene texture in
+  // a partially bound array. Otherwise each material gets its own set with
+  // fixed texture slots.
   VkDescriptorSetLayout gltf_material_set_layout = VK_NULL_HANDLE;
+  uint32_t max_bindless_textures = 0;
   {
-    VkDescriptorSetLayoutBinding bindings[4] = {
-        {0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
-         NULL},
-        {1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
+    VkDescriptorSetLayoutBinding bindings[5] = {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
          NULL},
+        {1, VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
+         &sampler},
         {2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
          NULL},
-        {3, VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
-         &sampler},
+        {3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
+         NULL},
+        {4, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT,
+         NULL},
     };
 
     VkDescriptorSetLayoutCreateInfo create_info = {0};
     create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    create_info.bindingCount = 4;
+    create_info.bindingCount = 5;
     create_info.pBindings = bindings;
+
+    // The texture array must be the last binding to have a variable count
+    VkDescriptorBindingFlags binding_flags[3] = {
+        0,
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {
+        .sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 3,
+        .pBindingFlags = binding_flags,
+    };
+    if (bindless) {
+      max_bindless_textures = MAX_BINDLESS_TEXTURES;
+      max_bindless_textures =
+          SDL_min(max_bindless_textures,
+                  gpu_props.limits.maxPerStageDescriptorSampledImages);
+      max_bindless_textures =
+          SDL_min(max_bindless_textures,
+                  gpu_props.limits.maxDescriptorSetSampledImages);
+      bindings[2].descriptorCount = max_bindless_textures;
+
+      create_info.pNext = &flags_info;
+      create_info.bindingCount = 3;
+    }
+
     err = vkCreateDescriptorSetLayout(device, &create_info, vk_alloc,
                                       &gltf_material_set_layout);
     assert(err == VK_SUCCESS);
@@ -1234,12 +2780,14 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   }
 
   // Create GLTF Pipeline Layout
+  // Sets are ordered by how often they change; per-view data is bound once per
+  // pass and per-material data once per material run. Per-object data lives in
+  // the view set's buffers and is found through the instance index.
   VkPipelineLayout gltf_pipe_layout = VK_NULL_HANDLE;
   {
     VkDescriptorSetLayout layouts[] = {
-        gltf_material_set_layout,
-        gltf_object_set_layout,
         gltf_view_set_layout,
+        gltf_material_set_layout,
     };
     const uint32_t layout_count =
         sizeof(layouts) / sizeof(VkDescriptorSetLayout);
@@ -1260,9 +2808,158 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   GPUPipeline *gltf_pipeline = NULL;
   err = create_gltf_pipeline(device, vk_alloc, tmp_alloc, std_alloc,
                              pipeline_cache, render_pass, width, height,
-                             gltf_pipe_layout, &gltf_pipeline);
+                             gltf_pipe_layout, bindless, false,
+                             &gltf_pipeline);
   assert(err == VK_SUCCESS);
 
+  // Create GLTF Cull Descriptor Set Layout
+  // Instances in, draw commands and per-permutation draw counts out. The
+  // camera, visibility, Hi-Z pyramid and stats are for occlusion culling.
+  // The rest is shared with the cluster pass which reads pool indices and
+  // writes compacted ones.
+  VkDescriptorSetLayout gltf_cull_set_layout = VK_NULL_HANDLE;
+  {
+    VkDescriptorSetLayoutBinding bindings[11] = {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {5, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+    };
+
+    VkDescriptorSetLayoutCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = 11;
+    create_info.pBindings = bindings;
+    err = vkCreateDescriptorSetLayout(device, &create_info, vk_alloc,
+                                      &gltf_cull_set_layout);
+    assert(err == VK_SUCCESS);
+
+    set_vk_name(device, (uint64_t)gltf_cull_set_layout,
+                VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "gltf cull set layout");
+  }
+
+  // Create GLTF Cull Pipeline Layout
+  VkPipelineLayout gltf_cull_pipe_layout = VK_NULL_HANDLE;
+  {
+    VkPushConstantRange cull_const_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(GLTFCullConstants),
+    };
+
+    VkPipelineLayoutCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = 1;
+    create_info.pSetLayouts = &gltf_cull_set_layout;
+    create_info.pushConstantRangeCount = 1;
+    create_info.pPushConstantRanges = &cull_const_range;
+
+    err = vkCreatePipelineLayout(device, &create_info, vk_alloc,
+                                 &gltf_cull_pipe_layout);
+    assert(err == VK_SUCCESS);
+
+    set_vk_name(device, (uint64_t)gltf_cull_pipe_layout,
+                VK_OBJECT_TYPE_PIPELINE_LAYOUT, "gltf cull pipeline layout");
+  }
+
+  // Create Hi-Z Descriptor Set Layout
+  // Reads one level and writes the next
+  VkDescriptorSetLayout hiz_set_layout = VK_NULL_HANDLE;
+  {
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+         NULL},
+    };
+
+    VkDescriptorSetLayoutCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = 2;
+    create_info.pBindings = bindings;
+    err = vkCreateDescriptorSetLayout(device, &create_info, vk_alloc,
+                                      &hiz_set_layout);
+    assert(err == VK_SUCCESS);
+
+    set_vk_name(device, (uint64_t)hiz_set_layout,
+                VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "hiz set layout");
+  }
+
+  // Create Hi-Z Pipeline Layout
+  VkPipelineLayout hiz_pipe_layout = VK_NULL_HANDLE;
+  {
+    VkPushConstantRange hiz_const_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(HiZConstants),
+    };
+
+    VkPipelineLayoutCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = 1;
+    create_info.pSetLayouts = &hiz_set_layout;
+    create_info.pushConstantRangeCount = 1;
+    create_info.pPushConstantRanges = &hiz_const_range;
+
+    err = vkCreatePipelineLayout(device, &create_info, vk_alloc,
+                                 &hiz_pipe_layout);
+    assert(err == VK_SUCCESS);
+
+    set_vk_name(device, (uint64_t)hiz_pipe_layout,
+                VK_OBJECT_TYPE_PIPELINE_LAYOUT, "hiz pipeline layout");
+  }
+
+  // Create GPU driven GLTF Pipelines
+  VkPipeline gltf_cull_pipeline = VK_NULL_HANDLE;
+  VkPipeline gltf_cluster_cull_pipeline = VK_NULL_HANDLE;
+  GPUPipeline *gltf_indirect_pipeline = NULL;
+  GPUPipeline *gltf_depth_pipeline = NULL;
+  VkPipeline hiz_pipeline = VK_NULL_HANDLE;
+  if (gpu_driven) {
+    err = create_gltf_cull_pipeline(device, vk_alloc, pipeline_cache,
+                                    gltf_cull_pipe_layout, &gltf_cull_pipeline);
+    assert(err == VK_SUCCESS);
+
+    err = create_gltf_cluster_cull_pipeline(device, vk_alloc, pipeline_cache,
+                                            gltf_cull_pipe_layout,
+                                            &gltf_cluster_cull_pipeline);
+    assert(err == VK_SUCCESS);
+
+    err = create_gltf_pipeline(device, vk_alloc, tmp_alloc, std_alloc,
+                               pipeline_cache, render_pass, width, height,
+                               gltf_pipe_layout, bindless, true,
+                               &gltf_indirect_pipeline);
+    assert(err == VK_SUCCESS);
+
+    err = create_gltf_depth_pipeline(device, vk_alloc, tmp_alloc, std_alloc,
+                                     pipeline_cache, depth_prepass, width,
+                                     height, gltf_pipe_layout,
+                                     &gltf_depth_pipeline);
+    assert(err == VK_SUCCESS);
+
+    err = create_hiz_pipeline(device, vk_alloc, pipeline_cache,
+                              hiz_pipe_layout, &hiz_pipeline);
+    assert(err == VK_SUCCESS);
+  }
+
   // Create GLTF RT Pipeline Layout
   // Create GLTF Descriptor Set Layout
   VkDescriptorSetLayout gltf_rt_layout = VK_NULL_HANDLE;
@@ -1446,6 +3143,7 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
 
   // Create a pool for texture memory
   VmaPool texture_mem_pool = VK_NULL_HANDLE;
+  uint32_t texture_heap_idx = 0;
   {
     TracyCZoneN(vma_pool_e, "init vma texture pool", true);
     uint32_t mem_type_idx = 0xFFFFFFFF;
@@ -1458,6 +3156,7 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
       }
     }
     assert(mem_type_idx != 0xFFFFFFFF);
+    texture_heap_idx = gpu_mem_props.memoryTypes[mem_type_idx].heapIndex;
 
     // block size to fit a 4k R8G8B8A8 uncompressed texture
     uint64_t block_size = (uint64_t)(4096.0 * 4096.0 * 4.0);
@@ -1488,10 +3187,6 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   GPUConstBuffer hosek_const_buffer = create_gpustoragebuffer(
       device, vma_alloc, vk_alloc, sizeof(SkyHosekData));
 
-  // Create Uniform buffer for object data
-  GPUConstBuffer object_const_buffer = create_gpuconstbuffer(
-      device, vma_alloc, vk_alloc, sizeof(CommonObjectData));
-
   // Create Uniform buffer for camera data
   GPUConstBuffer camera_const_buffer = create_gpuconstbuffer(
       device, vma_alloc, vk_alloc, sizeof(CommonCameraData));
@@ -1500,6 +3195,39 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   GPUConstBuffer light_const_buffer = create_gpuconstbuffer(
       device, vma_alloc, vk_alloc, sizeof(CommonLightData));
 
+  // Create the mesh pool that all scene geometry is sub-allocated from
+  // Scenes hold a pointer to it so it is created in place
+  if (create_meshpool(vma_alloc, std_alloc, MESH_POOL_MAX_INDICES,
+                      MESH_POOL_MAX_VERTICES, &d->mesh_pool) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Failed to create mesh pool");
+    SDL_TriggerBreakpoint();
+    return false;
+  }
+  set_vk_name(device, (uint64_t)d->mesh_pool.gpu.buffer, VK_OBJECT_TYPE_BUFFER,
+              "scene mesh pool");
+
+  // Like the mesh pool, workers and the occlusion buffer point at d->jobs
+  if (create_job_system(std_alloc, UINT32_MAX, &d->jobs) != 0 ||
+      create_occlusion_buffer(std_alloc, &d->jobs, &d->occlusion) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                 "Failed to create CPU occlusion culling");
+    SDL_TriggerBreakpoint();
+    return false;
+  }
+
+  // Derived asset data is cached per user. Without a writable location we
+  // just import everything on every launch.
+  d->cache_dir = SDL_GetPrefPath(HB_ENGINE_NAME, HB_GAME_NAME);
+  if (!d->cache_dir) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "No asset cache: %s",
+                SDL_GetError());
+  }
+  trim_derived_cache(std_alloc, d->cache_dir, DERIVED_CACHE_MAX_SIZE);
+
+  // Assets come out of the pack when there is one and loose files otherwise
+  create_vfs(std_alloc, &d->vfs);
+  vfs_mount_pack(&d->vfs, ASSET_PREFIX, ASSET_PACK);
+
   // Composite main scene
   Scene *main_scene = NULL;
   {
@@ -1517,6 +3245,10 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
         .vma_alloc = vma_alloc,
         .up_pool = upload_mem_pool,
         .tex_pool = texture_mem_pool,
+        .mesh_pool = &d->mesh_pool,
+        .cache_dir = d->cache_dir,
+        .vfs = &d->vfs,
+        .texture_format_caps = texture_format_caps,
     };
     if (create_scene(ctx, main_scene) != 0) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Failed to load main scene");
@@ -1524,19 +3256,75 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
       return false;
     }
 
-    if (scene_append_gltf(main_scene, ASSET_PREFIX "scenes/Floor.glb") != 0) {
+    // Cooked scenes are appended whole since they need no decoding or
+    // importing. Any glb without an up to date cooked copy has its entities
+    // appended right after and its meshes and textures stream in over the
+    // first frames.
+    const char *cooked_files[] = {
+        ASSET_PREFIX "scenes/Floor.hbscene",
+        ASSET_PREFIX "scenes/duck.hbscene",
+    };
+    const char *scene_files[] = {
+        ASSET_PREFIX "scenes/Floor.glb",
+        ASSET_PREFIX "scenes/duck.glb",
+    };
+    const uint32_t scene_file_count =
+        sizeof(scene_files) / sizeof(scene_files[0]);
+    // The stream keeps this list so it can't live on the stack
+    static const char
+        *stream_files[sizeof(scene_files) / sizeof(scene_files[0])];
+    uint32_t stream_file_count = 0;
+    int32_t cooked_errs[sizeof(scene_files) / sizeof(scene_files[0])] = {0};
+    if (scene_append_cooked_files(main_scene, &d->jobs, scene_file_count,
+                                  cooked_files, cooked_errs) != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                   "Failed to append cooked files to main scene");
+      SDL_TriggerBreakpoint();
+      return false;
+    }
+    for (uint32_t i = 0; i < scene_file_count; ++i) {
+      // Missing or stale cooked files fall back to the glb
+      int32_t err = cooked_errs[i];
+      if (err == -1 || err == -2) {
+        stream_files[stream_file_count++] = scene_files[i];
+      } else if (err != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                     "Failed to append cooked file to main scene");
+        SDL_TriggerBreakpoint();
+        return false;
+      }
+    }
+    if (stream_file_count > 0 &&
+        scene_stream_gltfs(main_scene, &d->jobs, stream_file_count,
+                           stream_files, demo_scene_stream_progress, d, NULL,
+                           &d->scene_stream) != 0) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
-                   "Failed to append floor to main scene");
+                   "Failed to append files to main scene");
       SDL_TriggerBreakpoint();
       return false;
     }
 
-    if (scene_append_gltf(main_scene, ASSET_PREFIX "scenes/duck.glb") != 0) {
+    // Hack to fuck with the scale of the object
+    for (uint32_t i = 0; i < main_scene->entity_count; ++i) {
+      if (main_scene->components[i] & COMPONENT_TYPE_STATIC_MESH) {
+        Transform *t = &main_scene->transforms[i].t;
+        // t->scale = (float3){0.01f, -0.01f, 0.01f};
+        // t->scale = (float3){100.0f, -100.0f, 100.0f};
+        t->scale = (float3){1.0f, -1.0f, 1.0f};
+      }
+    }
+
+    // Every entity starts at full detail
+    uint32_t lod_capacity = SDL_max(main_scene->entity_count, 1);
+    d->entity_lods = hb_alloc_nm_tp(std_alloc, lod_capacity, uint8_t);
+    if (!d->entity_lods) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
-                   "Failed to append duck to main scene");
+                   "Failed to alloc entity levels of detail");
       SDL_TriggerBreakpoint();
       return false;
     }
+    memset(d->entity_lods, 0, lod_capacity * sizeof(uint8_t));
+    d->entity_lod_capacity = lod_capacity;
   }
 
   // Create resources for screenshots
@@ -1581,6 +3369,26 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   d->gpu = gpu;
   d->vma_alloc = vma_alloc;
   d->gpu_props = gpu_props;
+  d->bindless = bindless;
+  d->max_bindless_textures = max_bindless_textures;
+  // The texture array can't outgrow its layout. Textures past the end are
+  // left out of the material table so their materials use their factors.
+  d->bindless_texture_count =
+      SDL_min(main_scene->texture_count, max_bindless_textures);
+  if (bindless && d->bindless_texture_count < main_scene->texture_count) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                "Scene has %u textures but only %u can be bound",
+                main_scene->texture_count, d->bindless_texture_count);
+  }
+  d->gpu_driven = gpu_driven;
+  d->gpu_culling = gpu_driven;
+  d->occlusion_culling = gpu_driven;
+  d->cpu_occlusion = true;
+  d->lod_pixel_error = DEFAULT_LOD_PIXEL_ERROR;
+  d->texture_stream_budget = DEFAULT_TEXTURE_STREAM_BUDGET;
+  d->memory_budget = memory_budget;
+  d->texture_heap_idx = texture_heap_idx;
+  d->texture_memory_budget = DEFAULT_TEXTURE_MEMORY_BUDGET;
   d->gpu_mem_props = gpu_mem_props;
   d->queue_family_count = queue_family_count;
   d->queue_props = queue_props;
@@ -1597,6 +3405,8 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   d->swapchain = swapchain;
   d->render_pass = render_pass;
   d->imgui_pass = imgui_pass;
+  d->main_load_pass = main_load_pass;
+  d->depth_prepass = depth_prepass;
   d->pipeline_cache = pipeline_cache;
   d->sampler = sampler;
   d->skydome_layout = skydome_set_layout;
@@ -1605,14 +3415,22 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   d->skydome_pipeline = skydome_pipeline;
   d->sky_const_buffer = sky_const_buffer;
   d->hosek_const_buffer = hosek_const_buffer;
-  d->object_const_buffer = object_const_buffer;
   d->camera_const_buffer = camera_const_buffer;
   d->light_const_buffer = light_const_buffer;
   d->gltf_material_set_layout = gltf_material_set_layout;
-  d->gltf_object_set_layout = gltf_object_set_layout;
   d->gltf_view_set_layout = gltf_view_set_layout;
   d->gltf_pipe_layout = gltf_pipe_layout;
   d->gltf_pipeline = gltf_pipeline;
+  d->gltf_cull_set_layout = gltf_cull_set_layout;
+  d->gltf_cull_pipe_layout = gltf_cull_pipe_layout;
+  d->gltf_cull_pipeline = gltf_cull_pipeline;
+  d->gltf_cluster_cull_pipeline = gltf_cluster_cull_pipeline;
+  d->gltf_indirect_pipeline = gltf_indirect_pipeline;
+  d->gltf_depth_pipeline = gltf_depth_pipeline;
+  d->hiz_set_layout = hiz_set_layout;
+  d->hiz_pipe_layout = hiz_pipe_layout;
+  d->hiz_pipeline = hiz_pipeline;
+  d->draw_indirect_count = draw_indirect_count;
   d->gltf_rt_layout = gltf_rt_layout;
   d->gltf_rt_pipe_layout = gltf_rt_pipe_layout;
   // d->gltf_rt_pipeline = gltf_rt_pipeline;
@@ -1626,6 +3444,7 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   d->screenshot_image = screenshot_image;
   d->screenshot_fence = screenshot_fence;
   d->frame_idx = 0;
+  d->frame_count = 0;
 
   // Setup data for hosek buffer
   {
@@ -1730,14 +3549,15 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
   // Create Descriptor Set Pools
   {
     VkDescriptorPoolSize pool_sizes[] = {
-        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4}};
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 9},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12}};
     const uint32_t pool_sizes_count =
         sizeof(pool_sizes) / sizeof(VkDescriptorPoolSize);
 
     VkDescriptorPoolCreateInfo create_info = {0};
     create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    create_info.maxSets = 7;
+    create_info.maxSets = 6;
     create_info.poolSizeCount = pool_sizes_count;
     create_info.pPoolSizes = pool_sizes;
 
@@ -1771,22 +3591,6 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
       assert(err == VK_SUCCESS);
     }
 
-    alloc_info.pSetLayouts = &gltf_material_set_layout;
-    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
-      alloc_info.descriptorPool = d->descriptor_pools[i];
-      err = vkAllocateDescriptorSets(device, &alloc_info,
-                                     &d->gltf_material_descriptor_sets[i]);
-      assert(err == VK_SUCCESS);
-    }
-
-    alloc_info.pSetLayouts = &gltf_object_set_layout;
-    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
-      alloc_info.descriptorPool = d->descriptor_pools[i];
-      err = vkAllocateDescriptorSets(device, &alloc_info,
-                                     &d->gltf_object_descriptor_sets[i]);
-      assert(err == VK_SUCCESS);
-    }
-
     alloc_info.pSetLayouts = &gltf_view_set_layout;
     for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
       alloc_info.descriptorPool = d->descriptor_pools[i];
@@ -1813,63 +3617,28 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
 
   // Write textures to descriptor set
   {
-    VkDescriptorBufferInfo skydome_info = {sky_const_buffer.gpu.buffer, 0,
-                                           sky_const_buffer.size};
-    VkDescriptorImageInfo imgui_info = {
-        NULL, d->imgui_atlas.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-    VkDescriptorImageInfo material_info = {
-        NULL, d->main_scene->textures[0].view,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-    VkDescriptorBufferInfo object_info = {object_const_buffer.gpu.buffer, 0,
-                                          object_const_buffer.size};
-    VkDescriptorBufferInfo camera_info = {camera_const_buffer.gpu.buffer, 0,
-                                          camera_const_buffer.size};
-    VkDescriptorBufferInfo light_info = {light_const_buffer.gpu.buffer, 0,
-                                         light_const_buffer.size};
-    VkWriteDescriptorSet writes[8] = {
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstBinding = 1,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &skydome_info,
-        },
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstBinding = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-            .pImageInfo = &imgui_info,
-        },
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-            .pImageInfo = &material_info,
-        },
-        // Future permutations of the gltf pipeline may support these
-        // For now we have to write *something* even if we know they're not
-        // used (yet)
+    VkDescriptorBufferInfo skydome_info = {sky_const_buffer.gpu.buffer, 0,
+                                           sky_const_buffer.size};
+    VkDescriptorImageInfo imgui_info = {
+        NULL, d->imgui_atlas.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkDescriptorBufferInfo camera_info = {camera_const_buffer.gpu.buffer, 0,
+                                          camera_const_buffer.size};
+    VkDescriptorBufferInfo light_info = {light_const_buffer.gpu.buffer, 0,
+                                         light_const_buffer.size};
+    VkWriteDescriptorSet writes[4] = {
         {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
             .dstBinding = 1,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-            .pImageInfo = &material_info,
-        },
-        {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstBinding = 2,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-            .pImageInfo = &material_info,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &skydome_info,
         },
         {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
             .dstBinding = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &object_info,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .pImageInfo = &imgui_info,
         },
         {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -1887,8 +3656,6 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
         },
     };
     for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
-      VkDescriptorSet gltf_material_set = d->gltf_material_descriptor_sets[i];
-      VkDescriptorSet gltf_object_set = d->gltf_object_descriptor_sets[i];
       VkDescriptorSet gltf_view_set = d->gltf_view_descriptor_sets[i];
       VkDescriptorSet skydome_set = d->skydome_descriptor_sets[i];
       VkDescriptorSet imgui_set = d->imgui_descriptor_sets[i];
@@ -1896,17 +3663,180 @@ bool demo_init(SDL_Window *window, VkInstance instance, Allocator std_alloc,
       writes[0].dstSet = skydome_set;
       writes[1].dstSet = imgui_set;
 
-      writes[2].dstSet = gltf_material_set;
-      writes[3].dstSet = gltf_material_set;
-      writes[4].dstSet = gltf_material_set;
+      writes[2].dstSet = gltf_view_set;
+      writes[3].dstSet = gltf_view_set;
+
+      vkUpdateDescriptorSets(device, 4, writes, 0, NULL);
+    }
+  }
+
+  // Create the material table for the main scene
+  // Slot 0 is the default material and scene materials follow it
+  {
+    const Scene *s = d->main_scene;
+    uint32_t material_count = s->material_count + 1;
+    d->gltf_material_table = create_gpustoragebuffer(
+        device, vma_alloc, vk_alloc,
+        material_count * sizeof(GLTFMaterialData));
+    demo_write_material_table(d);
+  }
+
+  // Create per-frame object buffers for the main scene
+  // Every drawable submesh could be visible so each frame gets room for all
+  {
+    const Scene *s = d->main_scene;
+    uint32_t object_capacity = 0;
+    for (uint32_t i = 0; i < s->entity_count; ++i) {
+      if (s->components[i] & COMPONENT_TYPE_STATIC_MESH) {
+        object_capacity += s->meshes[s->static_meshes[i]].submesh_count;
+      }
+    }
+    // Zero sized buffers aren't allowed
+    object_capacity = SDL_max(object_capacity, 1);
+    d->gltf_object_capacity = object_capacity;
+
+    VkDeviceSize object_size = object_capacity * sizeof(GLTFObjectData);
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      err = create_gpubuffer(vma_alloc, object_size,
+                             VMA_MEMORY_USAGE_CPU_TO_GPU,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             &d->gltf_object_buffers[i]);
+      assert(err == VK_SUCCESS);
+      set_vk_name(device, (uint64_t)d->gltf_object_buffers[i].buffer,
+                  VK_OBJECT_TYPE_BUFFER, "gltf object buffer");
+
+      VkDescriptorBufferInfo object_info = {d->gltf_object_buffers[i].buffer,
+                                            0, object_size};
+      VkWriteDescriptorSet write = {
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = d->gltf_view_descriptor_sets[i],
+          .dstBinding = 3,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .pBufferInfo = &object_info,
+      };
+      vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    }
+  }
+
+  // Create Material Descriptor Sets
+  // Every frame gets its own sets so they can be rewritten as textures
+  // become resident without touching a set that is still in flight
+  {
+    const Scene *s = d->main_scene;
+    uint32_t set_count = bindless ? 1 : s->material_count + 1;
+    uint32_t total_set_count = set_count * FRAME_LATENCY;
+    uint32_t image_count =
+        bindless ? SDL_max(d->bindless_texture_count, 1) : set_count * 3;
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, total_set_count},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, total_set_count},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, image_count * FRAME_LATENCY},
+    };
+    const uint32_t pool_sizes_count =
+        sizeof(pool_sizes) / sizeof(VkDescriptorPoolSize);
+
+    VkDescriptorPoolCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    create_info.maxSets = total_set_count;
+    create_info.poolSizeCount = pool_sizes_count;
+    create_info.pPoolSizes = pool_sizes;
+    err = vkCreateDescriptorPool(device, &create_info, vk_alloc,
+                                 &d->material_descriptor_pool);
+    assert(err == VK_SUCCESS);
+
+    VkDescriptorSetLayout *layouts =
+        hb_alloc_nm_tp(tmp_alloc, total_set_count, VkDescriptorSetLayout);
+    for (uint32_t i = 0; i < total_set_count; ++i) {
+      layouts[i] = gltf_material_set_layout;
+    }
+
+    // Only used with bindless, where every frame has exactly one set
+    uint32_t texture_counts[FRAME_LATENCY] = {0};
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      texture_counts[i] = d->bindless_texture_count;
+    }
+    VkDescriptorSetVariableDescriptorCountAllocateInfo count_info = {
+        .sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+        .descriptorSetCount = FRAME_LATENCY,
+        .pDescriptorCounts = texture_counts,
+    };
+
+    VkDescriptorSetAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.pNext = bindless ? &count_info : NULL;
+    alloc_info.descriptorPool = d->material_descriptor_pool;
+    alloc_info.descriptorSetCount = total_set_count;
+    alloc_info.pSetLayouts = layouts;
+
+    d->gltf_material_set_count = set_count;
+    d->gltf_material_sets =
+        hb_alloc_nm_tp(std_alloc, total_set_count, VkDescriptorSet);
+    err = vkAllocateDescriptorSets(device, &alloc_info, d->gltf_material_sets);
+    assert(err == VK_SUCCESS);
+
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      demo_write_material_sets(d, i);
+    }
+  }
+
+  // Create GPU driven rendering resources for the main scene
+  // The cull sets are allocated once. Everything sized by the scene is made
+  // by demo_create_gpu_scene so it can be rebuilt when the scene changes.
+  if (gpu_driven) {
+    VkDescriptorSetAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &gltf_cull_set_layout;
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      alloc_info.descriptorPool = d->descriptor_pools[i];
+      err = vkAllocateDescriptorSets(device, &alloc_info,
+                                     &d->gltf_cull_descriptor_sets[i]);
+      assert(err == VK_SUCCESS);
+    }
+
+    if (!demo_create_gpu_scene(d)) {
+      return false;
+    }
 
-      writes[5].dstSet = gltf_object_set;
+    // Every frame gets a set for each level of the pyramid
+    {
+      const uint32_t set_count = FRAME_LATENCY * HIZ_MAX_MIP_COUNT;
+      VkDescriptorPoolSize pool_sizes[] = {
+          {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, set_count},
+          {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set_count}};
+      const uint32_t pool_sizes_count =
+          sizeof(pool_sizes) / sizeof(VkDescriptorPoolSize);
+
+      VkDescriptorPoolCreateInfo create_info = {0};
+      create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      create_info.maxSets = set_count;
+      create_info.poolSizeCount = pool_sizes_count;
+      create_info.pPoolSizes = pool_sizes;
+      err = vkCreateDescriptorPool(device, &create_info, vk_alloc,
+                                   &d->hiz_descriptor_pool);
+      assert(err == VK_SUCCESS);
 
-      writes[6].dstSet = gltf_view_set;
-      writes[7].dstSet = gltf_view_set;
+      VkDescriptorSetLayout layouts[HIZ_MAX_MIP_COUNT] = {0};
+      for (uint32_t i = 0; i < HIZ_MAX_MIP_COUNT; ++i) {
+        layouts[i] = hiz_set_layout;
+      }
 
-      vkUpdateDescriptorSets(device, 8, writes, 0, NULL);
+      VkDescriptorSetAllocateInfo alloc_info = {0};
+      alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      alloc_info.descriptorPool = d->hiz_descriptor_pool;
+      alloc_info.descriptorSetCount = HIZ_MAX_MIP_COUNT;
+      alloc_info.pSetLayouts = layouts;
+      for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+        err = vkAllocateDescriptorSets(device, &alloc_info,
+                                       d->hiz_descriptor_sets[i]);
+        assert(err == VK_SUCCESS);
+      }
     }
+
+    demo_write_hiz_descriptors(d);
   }
 
   // Write Hosek descriptor set seperately
@@ -1951,6 +3881,10 @@ void demo_destroy(Demo *d) {
 
   vkDeviceWaitIdle(device);
 
+  if (d->scene_stream) {
+    destroy_scene_stream(d->scene_stream);
+  }
+
   // Write out the pipeline cache
   {
     VkResult err = VK_SUCCESS;
@@ -1985,23 +3919,57 @@ void demo_destroy(Demo *d) {
     vkDestroyImageView(device, d->swapchain_image_views[i], vk_alloc);
     vkDestroyFramebuffer(device, d->main_pass_framebuffers[i], vk_alloc);
     vkDestroyFramebuffer(device, d->ui_pass_framebuffers[i], vk_alloc);
+    vkDestroyFramebuffer(device, d->depth_prepass_framebuffers[i], vk_alloc);
     vkDestroyCommandPool(device, d->command_pools[i], vk_alloc);
 
     destroy_gpumesh(vma_alloc, &d->imgui_gpu[i]);
   }
 
+  if (d->gpu_driven) {
+    demo_destroy_gpu_scene(d);
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      vkDestroyImageView(device, d->depth_sample_views[i], vk_alloc);
+    }
+
+    vkDestroyDescriptorPool(device, d->hiz_descriptor_pool, vk_alloc);
+    vkDestroyImageView(device, d->hiz_view, vk_alloc);
+    for (uint32_t i = 0; i < d->hiz_mip_count; ++i) {
+      vkDestroyImageView(device, d->hiz_mip_views[i], vk_alloc);
+    }
+    destroy_gpuimage(vma_alloc, &d->hiz_image);
+  }
+
+  vkDestroyDescriptorPool(device, d->material_descriptor_pool, vk_alloc);
+  hb_free(d->std_alloc, d->gltf_material_sets);
+
   destroy_gpuimage(vma_alloc, &d->depth_buffers);
 
   hb_free(d->std_alloc, d->imgui_mesh_data);
 
+  hb_free(d->std_alloc, d->entity_lods);
+  hb_free(d->std_alloc, d->texture_streams);
+  hb_free(d->std_alloc, d->texture_requested_levels);
+  hb_free(d->std_alloc, d->texture_last_seen);
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    demo_destroy_retired_textures(d, i);
+  }
   destroy_scene(d->main_scene);
   hb_free(d->std_alloc, d->main_scene);
+  SDL_free(d->cache_dir);
+  destroy_vfs(&d->vfs);
+  destroy_meshpool(&d->mesh_pool);
+
+  destroy_occlusion_buffer(&d->occlusion);
+  destroy_job_system(&d->jobs);
 
   destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->hosek_const_buffer);
   destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->sky_const_buffer);
-  destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->object_const_buffer);
   destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->camera_const_buffer);
   destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->light_const_buffer);
+  destroy_gpuconstbuffer(device, vma_alloc, vk_alloc, d->gltf_material_table);
+  for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+    destroy_gpubuffer(vma_alloc, &d->gltf_object_buffers[i]);
+  }
   destroy_gpumesh(vma_alloc, &d->skydome_gpu);
   destroy_texture(device, vma_alloc, vk_alloc, &d->imgui_atlas);
 
@@ -2024,11 +3992,25 @@ void demo_destroy(Demo *d) {
   // destroy_gpupipeline(device, vk_alloc, d->gltf_rt_pipeline);
 
   vkDestroyDescriptorSetLayout(device, d->gltf_material_set_layout, vk_alloc);
-  vkDestroyDescriptorSetLayout(device, d->gltf_object_set_layout, vk_alloc);
   vkDestroyDescriptorSetLayout(device, d->gltf_view_set_layout, vk_alloc);
   vkDestroyPipelineLayout(device, d->gltf_pipe_layout, vk_alloc);
   destroy_gpupipeline(device, d->std_alloc, vk_alloc, d->gltf_pipeline);
 
+  vkDestroyDescriptorSetLayout(device, d->gltf_cull_set_layout, vk_alloc);
+  vkDestroyPipelineLayout(device, d->gltf_cull_pipe_layout, vk_alloc);
+  vkDestroyPipeline(device, d->gltf_cull_pipeline, vk_alloc);
+  vkDestroyPipeline(device, d->gltf_cluster_cull_pipeline, vk_alloc);
+  if (d->gltf_indirect_pipeline) {
+    destroy_gpupipeline(device, d->std_alloc, vk_alloc,
+                        d->gltf_indirect_pipeline);
+    destroy_gpupipeline(device, d->std_alloc, vk_alloc,
+                        d->gltf_depth_pipeline);
+  }
+
+  vkDestroyDescriptorSetLayout(device, d->hiz_set_layout, vk_alloc);
+  vkDestroyPipelineLayout(device, d->hiz_pipe_layout, vk_alloc);
+  vkDestroyPipeline(device, d->hiz_pipeline, vk_alloc);
+
   vkDestroyDescriptorSetLayout(device, d->imgui_layout, vk_alloc);
   vkDestroyPipelineLayout(device, d->imgui_pipe_layout, vk_alloc);
   vkDestroyPipeline(device, d->imgui_pipeline, vk_alloc);
@@ -2036,6 +4018,8 @@ void demo_destroy(Demo *d) {
   vkDestroyPipelineCache(device, d->pipeline_cache, vk_alloc);
   vkDestroyRenderPass(device, d->render_pass, vk_alloc);
   vkDestroyRenderPass(device, d->imgui_pass, vk_alloc);
+  vkDestroyRenderPass(device, d->main_load_pass, vk_alloc);
+  vkDestroyRenderPass(device, d->depth_prepass, vk_alloc);
   vkDestroySwapchainKHR(device, d->swapchain, vk_alloc);
   vkDestroySurfaceKHR(d->instance, d->surface,
                       NULL); // Surface is created by SDL
@@ -2062,6 +4046,13 @@ void demo_upload_mesh(Demo *d, const GPUMesh *mesh) {
   d->mesh_upload_count++;
 }
 
+void demo_upload_pooled_mesh(Demo *d, const PooledMesh *mesh) {
+  uint32_t mesh_idx = d->pooled_mesh_upload_count;
+  assert(d->pooled_mesh_upload_count + 1 < POOLED_MESH_UPLOAD_QUEUE_SIZE);
+  d->pooled_mesh_upload_queue[mesh_idx] = *mesh;
+  d->pooled_mesh_upload_count++;
+}
+
 void demo_upload_texture(Demo *d, const GPUTexture *tex) {
   uint32_t tex_idx = d->texture_upload_count;
   assert(d->texture_upload_count + 1 < TEXTURE_UPLOAD_QUEUE_SIZE);
@@ -2069,13 +4060,447 @@ void demo_upload_texture(Demo *d, const GPUTexture *tex) {
   d->texture_upload_count++;
 }
 
+// Only single layer textures whose every level is in staging with a known
+// size can go up a few levels at a time
+static bool texture_streamable(const GPUTexture *tex) {
+  return !tex->gen_mips && tex->layer_count == 1 && tex->mip_levels > 1 &&
+         tex->region_count == tex->mip_levels && tex->region_sizes[0] > 0;
+}
+
+// The coarsest level larger than the tail extent is the first one left out
+static uint32_t texture_tail_level(const GPUTexture *tex) {
+  uint32_t level = tex->mip_levels - 1;
+  while (level > 0 &&
+         SDL_max(tex->width >> (level - 1), tex->height >> (level - 1)) <=
+             TEXTURE_STREAM_TAIL_EXTENT) {
+    level--;
+  }
+  return level;
+}
+
+// Bytes of host the chain from base_level on copies from, which is close
+// enough to what an image holding those levels takes up
+static uint64_t texture_chain_size(const GPUTexture *tex, uint32_t base_level) {
+  uint64_t size = 0;
+  for (uint32_t i = base_level; i < tex->mip_levels; ++i) {
+    size += tex->region_sizes[i];
+  }
+  return size;
+}
+
+// Adds a main scene texture to the ones still missing levels
+static bool demo_push_texture_stream(Demo *d, uint32_t texture) {
+  if (d->texture_stream_count == d->texture_stream_capacity) {
+    uint32_t capacity = SDL_max(d->texture_stream_capacity * 2, 64);
+    uint32_t *streams = hb_realloc_nm_tp(d->std_alloc, d->texture_streams,
+                                         capacity, uint32_t);
+    if (!streams) {
+      return false;
+    }
+    d->texture_streams = streams;
+    d->texture_stream_capacity = capacity;
+  }
+  d->texture_streams[d->texture_stream_count++] = texture;
+  return true;
+}
+
+// Queues one of the main scene's textures. Textures that can't stream are
+// uploaded whole and are usable as soon as that frame's uploads finish.
+static void demo_upload_scene_texture(Demo *d, uint32_t texture) {
+  Scene *s = d->main_scene;
+  const GPUTexture *tex = &s->textures[texture];
+
+  if (texture_streamable(tex) && demo_push_texture_stream(d, texture)) {
+    s->texture_base_levels[texture] = tex->mip_levels;
+    return;
+  }
+
+  demo_upload_texture(d, tex);
+  s->texture_base_levels[texture] = 0;
+}
+
+// Hands this frame its runs of streaming texture levels. Tails go first, as
+// many as the queue and the budget allow, then passes of one finer level per
+// texture until the budget is spent. Tails that don't fit wait for a later
+// frame. The material table is rewritten with the new clamps and uploaded in
+// the same frame as the levels.
+static void demo_update_texture_streams(Demo *d) {
+  if (d->texture_stream_count == 0) {
+    return;
+  }
+  TracyCZoneN(ctx, "demo_update_texture_streams", true);
+
+  Scene *s = d->main_scene;
+  uint64_t budget = d->texture_stream_budget;
+  uint64_t used = 0;
+  bool changed = false;
+  for (uint32_t pass = 0;; ++pass) {
+    bool progressed = false;
+    for (uint32_t i = 0; i < d->texture_stream_count; ++i) {
+      if (d->texture_level_upload_count == TEXTURE_LEVEL_UPLOAD_QUEUE_SIZE) {
+        break;
+      }
+      uint32_t texture = d->texture_streams[i];
+      const GPUTexture *tex = &s->textures[texture];
+      uint32_t base_level = s->texture_base_levels[texture];
+      bool first = base_level == tex->mip_levels;
+      if (base_level == tex->image_base_level || first != (pass == 0)) {
+        continue;
+      }
+
+      uint32_t first_level =
+          first ? SDL_max(texture_tail_level(tex), tex->image_base_level)
+                : base_level - 1;
+      uint64_t size = 0;
+      for (uint32_t l = first_level; l < base_level; ++l) {
+        size += tex->region_sizes[l];
+      }
+      // The first run always goes so one huge level can't stall streaming
+      if (used > 0 && used + size > budget) {
+        continue;
+      }
+
+      d->texture_level_upload_queue[d->texture_level_upload_count++] =
+          (TextureLevelUpload){
+              .texture = texture,
+              .first_level = first_level,
+              .level_count = base_level - first_level,
+              .first = first,
+          };
+      s->texture_base_levels[texture] = first_level;
+      used += size;
+      progressed = true;
+      changed = true;
+    }
+    if (!progressed && pass > 0) {
+      break;
+    }
+  }
+
+  // Drop whatever now has every level its image holds
+  uint32_t stream_count = 0;
+  for (uint32_t i = 0; i < d->texture_stream_count; ++i) {
+    uint32_t texture = d->texture_streams[i];
+    if (s->texture_base_levels[texture] >
+        s->textures[texture].image_base_level) {
+      d->texture_streams[stream_count++] = texture;
+    }
+  }
+  d->texture_stream_count = stream_count;
+
+  if (changed) {
+    demo_write_material_table(d);
+  }
+  TracyCZoneEnd(ctx);
+}
+
+// Moves a main scene texture to an image starting at base_level. Whatever
+// the new image shares with what was uploaded to the old one goes up as its
+// first run this frame and any finer levels stream in after.
+static bool demo_resize_scene_texture(Demo *d, uint32_t texture,
+                                      uint32_t base_level) {
+  Scene *s = d->main_scene;
+  GPUTexture *tex = &s->textures[texture];
+  uint32_t frame_idx = d->frame_idx;
+  if (d->retired_texture_counts[frame_idx] == TEXTURE_RESIZE_QUEUE_SIZE ||
+      d->texture_level_upload_count == TEXTURE_LEVEL_UPLOAD_QUEUE_SIZE) {
+    return false;
+  }
+
+  // Only textures with every level of their image uploaded are off the
+  // stream. Should the resize fail the extra entry is simply dropped.
+  uint32_t uploaded = s->texture_base_levels[texture];
+  if (uploaded == tex->image_base_level && base_level < uploaded &&
+      !demo_push_texture_stream(d, texture)) {
+    return false;
+  }
+
+  GPUImage old_image = {0};
+  VkImageView old_view = VK_NULL_HANDLE;
+  if (resize_texture_image(d->device, d->vma_alloc, d->vk_alloc,
+                           d->texture_mem_pool, base_level, tex, &old_image,
+                           &old_view) != 0) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                "Failed to resize texture %u to level %u", texture,
+                base_level);
+    return false;
+  }
+  d->retired_textures[frame_idx][d->retired_texture_counts[frame_idx]++] =
+      (RetiredTextureImage){old_image, old_view};
+
+  uint32_t first_level = SDL_max(base_level, uploaded);
+  d->texture_level_upload_queue[d->texture_level_upload_count++] =
+      (TextureLevelUpload){
+          .texture = texture,
+          .first_level = first_level,
+          .level_count = tex->mip_levels - first_level,
+          .first = true,
+      };
+  s->texture_base_levels[texture] = first_level;
+  return true;
+}
+
+typedef struct TextureCandidate {
+  uint64_t last_seen;
+  uint32_t texture;
+} TextureCandidate;
+
+static int texture_candidate_cmp(const void *a, const void *b) {
+  uint64_t lhs = ((const TextureCandidate *)a)->last_seen;
+  uint64_t rhs = ((const TextureCandidate *)b)->last_seen;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// Requests a level for every main scene texture from what is on screen and
+// moves textures towards their requests within the limit. Runs before the
+// level stream so the first runs of new images are queued ahead of it.
+static void demo_update_texture_residency(Demo *d, const float4x4 *vp) {
+  Scene *s = d->main_scene;
+  uint32_t texture_count = s->texture_count;
+  if (texture_count == 0) {
+    return;
+  }
+  TracyCZoneN(ctx, "demo_update_texture_residency", true);
+
+  if (texture_count > d->texture_residency_capacity) {
+    uint32_t capacity =
+        SDL_max(texture_count, d->texture_residency_capacity * 2);
+    uint32_t *levels = hb_realloc_nm_tp(
+        d->std_alloc, d->texture_requested_levels, capacity, uint32_t);
+    if (levels) {
+      d->texture_requested_levels = levels;
+    }
+    uint64_t *seen = hb_realloc_nm_tp(d->std_alloc, d->texture_last_seen,
+                                      capacity, uint64_t);
+    if (seen) {
+      d->texture_last_seen = seen;
+    }
+    if (!levels || !seen) {
+      TracyCZoneEnd(ctx);
+      return;
+    }
+    for (uint32_t i = d->texture_residency_capacity; i < capacity; ++i) {
+      seen[i] = 0;
+    }
+    d->texture_residency_capacity = capacity;
+  }
+  uint32_t *requested = d->texture_requested_levels;
+  uint64_t *last_seen = d->texture_last_seen;
+  uint64_t frame = ++d->texture_frame;
+
+  // Textures nothing on screen uses only need their tail
+  for (uint32_t i = 0; i < texture_count; ++i) {
+    const GPUTexture *tex = &s->textures[i];
+    requested[i] = texture_streamable(tex) ? texture_tail_level(tex) : 0;
+  }
+
+  // A texture is assumed to span its mesh once, so it wants the coarsest
+  // level still as wide as the mesh's bounding sphere is on screen. Tiled
+  // textures end up with more detail than they need rather than less.
+  {
+    TracyCZoneN(request_ctx, "Request Texture Levels", true);
+    float4 planes[6] = {{0}};
+    frustum_planes(vp, planes);
+    float focal =
+        magf3(f4tof3(vp->row1)) * (float)d->swap_info.height * 0.5f;
+
+    for (uint32_t i = 0; i < s->entity_count; ++i) {
+      if ((s->components[i] & COMPONENT_TYPE_STATIC_MESH) == 0 ||
+          !s->resident_meshes[s->static_meshes[i]]) {
+        continue;
+      }
+
+      float4x4 m = {.row0 = {0}};
+      transform_to_matrix(&m, &s->transforms[i].t);
+      float4 bounds = entity_bounds(s, i, &m);
+      float3 center = f4tof3(bounds);
+      float radius = bounds[3];
+      if (!frustum_test_sphere(planes, center, radius)) {
+        continue;
+      }
+
+      // Once the camera is inside the bounding sphere only full detail is
+      // safe
+      float distance = dotf4(vp->row3, f3tof4(center, 1.0f)) - radius;
+      float extent =
+          distance > 0.0f ? 2.0f * radius * focal / distance : FLT_MAX;
+
+      const PooledMesh *mesh = &s->meshes[s->static_meshes[i]];
+      for (uint32_t ii = 0; ii < mesh->submesh_count; ++ii) {
+        uint32_t material = mesh->submeshes[ii].material;
+        if (material == SUBMESH_NO_MATERIAL) {
+          continue;
+        }
+        const GPUMaterial *mat = &s->materials[material];
+        for (uint32_t iii = 0; iii < mat->texture_count; ++iii) {
+          uint32_t texture = mat->textures[iii];
+          const GPUTexture *tex = &s->textures[texture];
+          uint32_t level = 0;
+          while (level + 1 < tex->mip_levels &&
+                 (float)SDL_max(tex->width >> (level + 1),
+                                tex->height >> (level + 1)) >= extent) {
+            level++;
+          }
+          requested[texture] = SDL_min(requested[texture], level);
+          last_seen[texture] = frame;
+        }
+      }
+    }
+    TracyCZoneEnd(request_ctx);
+  }
+
+  // Only textures that have at least their tail uploaded are moved.
+  // Everything else streamable still counts against the limit as it is.
+  uint64_t resident = 0;
+  uint64_t wanted_sizes[TEXTURE_MAX_LOD_BIAS + 1] = {0};
+  for (uint32_t i = 0; i < texture_count; ++i) {
+    const GPUTexture *tex = &s->textures[i];
+    if (!s->resident_textures[i] || !texture_streamable(tex)) {
+      continue;
+    }
+    uint64_t size = texture_chain_size(tex, tex->image_base_level);
+    resident += size;
+    bool managed = s->texture_base_levels[i] < tex->mip_levels;
+    uint32_t tail = texture_tail_level(tex);
+    for (uint32_t bias = 0; bias <= TEXTURE_MAX_LOD_BIAS; ++bias) {
+      wanted_sizes[bias] +=
+          managed ? texture_chain_size(tex, SDL_min(requested[i] + bias, tail))
+                  : size;
+    }
+  }
+
+  // Room left in the device's budget for the texture heap, plus whatever
+  // the pool's blocks have free, is all textures may grow into
+  uint64_t limit = d->texture_memory_budget;
+  {
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetBudget(d->vma_alloc, budgets);
+    const VmaBudget *heap = &budgets[d->texture_heap_idx];
+    uint64_t room = 0;
+    if (heap->blockBytes > heap->allocationBytes) {
+      room += heap->blockBytes - heap->allocationBytes;
+    }
+    if (heap->budget > heap->usage) {
+      room += heap->budget - heap->usage;
+    }
+    limit = SDL_min(limit, resident + room);
+  }
+
+  uint32_t bias = 0;
+  while (bias < TEXTURE_MAX_LOD_BIAS && wanted_sizes[bias] > limit) {
+    bias++;
+  }
+
+  // Split what wants to move by which way it goes
+  TextureCandidate *shrinks =
+      hb_alloc_nm_tp(d->tmp_alloc, texture_count, TextureCandidate);
+  TextureCandidate *grows =
+      hb_alloc_nm_tp(d->tmp_alloc, texture_count, TextureCandidate);
+  uint32_t shrink_count = 0;
+  uint32_t grow_count = 0;
+  uint64_t grow_size = 0;
+  for (uint32_t i = 0; i < texture_count; ++i) {
+    const GPUTexture *tex = &s->textures[i];
+    if (!s->resident_textures[i] || !texture_streamable(tex) ||
+        s->texture_base_levels[i] == tex->mip_levels) {
+      continue;
+    }
+    uint32_t target = SDL_min(requested[i] + bias, texture_tail_level(tex));
+    requested[i] = target;
+    TextureCandidate candidate = {last_seen[i], i};
+    if (target > tex->image_base_level) {
+      shrinks[shrink_count++] = candidate;
+    } else if (target < tex->image_base_level) {
+      grows[grow_count++] = candidate;
+      grow_size += texture_chain_size(tex, target) -
+                   texture_chain_size(tex, tex->image_base_level);
+    }
+  }
+  SDL_qsort(shrinks, shrink_count, sizeof(TextureCandidate),
+            texture_candidate_cmp);
+  SDL_qsort(grows, grow_count, sizeof(TextureCandidate),
+            texture_candidate_cmp);
+
+  // Levels nobody asks for stay around until what is asked for doesn't fit.
+  // Every resize uploads its first run this frame so they share the
+  // stream's per frame budget.
+  uint64_t projected = resident;
+  uint64_t used = 0;
+  bool changed = false;
+  for (uint32_t i = 0; i < shrink_count && projected + grow_size > limit;
+       ++i) {
+    uint32_t texture = shrinks[i].texture;
+    const GPUTexture *tex = &s->textures[texture];
+    uint32_t target = requested[texture];
+    uint64_t before = texture_chain_size(tex, tex->image_base_level);
+    uint64_t upload = texture_chain_size(
+        tex, SDL_max(target, s->texture_base_levels[texture]));
+    if (used > 0 && used + upload > d->texture_stream_budget) {
+      break;
+    }
+    if (!demo_resize_scene_texture(d, texture, target)) {
+      continue;
+    }
+    projected -= before - texture_chain_size(tex, target);
+    used += upload;
+    changed = true;
+  }
+  for (uint32_t i = grow_count; i > 0; --i) {
+    uint32_t texture = grows[i - 1].texture;
+    const GPUTexture *tex = &s->textures[texture];
+    uint32_t target = requested[texture];
+    uint64_t before = texture_chain_size(tex, tex->image_base_level);
+    uint64_t after = texture_chain_size(tex, target);
+    if (projected + after - before > limit) {
+      continue;
+    }
+    uint64_t upload =
+        texture_chain_size(tex, s->texture_base_levels[texture]);
+    if (used > 0 && used + upload > d->texture_stream_budget) {
+      break;
+    }
+    if (!demo_resize_scene_texture(d, texture, target)) {
+      continue;
+    }
+    projected += after - before;
+    used += upload;
+    changed = true;
+  }
+  hb_free(d->tmp_alloc, grows);
+  hb_free(d->tmp_alloc, shrinks);
+
+  d->texture_memory_limit = limit;
+  d->texture_resident_bytes = projected;
+  d->texture_requested_bytes = wanted_sizes[0];
+  d->texture_lod_bias = bias;
+
+  // New views need every frame's material sets rewritten and clamps are
+  // relative to the first level an image holds
+  if (changed) {
+    demo_write_material_table(d);
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      d->gltf_material_sets_dirty[i] = true;
+    }
+  }
+  TracyCZoneEnd(ctx);
+}
+
 void demo_upload_scene(Demo *d, const Scene *s) {
   for (uint32_t i = 0; i < s->mesh_count; ++i) {
-    demo_upload_mesh(d, &s->meshes[i]);
+    if (s->resident_meshes[i]) {
+      demo_upload_pooled_mesh(d, &s->meshes[i]);
+    }
   }
 
   for (uint32_t i = 0; i < s->texture_count; ++i) {
-    demo_upload_texture(d, &s->textures[i]);
+    if (!s->resident_textures[i]) {
+      continue;
+    }
+    if (s == d->main_scene) {
+      demo_upload_scene_texture(d, i);
+    } else {
+      demo_upload_texture(d, &s->textures[i]);
+    }
   }
 }
 
@@ -2155,6 +4580,10 @@ void demo_resize(Demo *d) {
 
   demo_init_framebuffers(d);
 
+  if (d->gpu_driven) {
+    demo_write_hiz_descriptors(d);
+  }
+
   // Reset frame index so that the rendering routine knows that the
   // swapchain images need to be transitioned again
   d->frame_idx = 0;
@@ -2162,6 +4591,52 @@ void demo_resize(Demo *d) {
   TracyCZoneEnd(ctx);
 }
 
+// Commits whatever the main scene's stream finished and queues its uploads.
+// Once everything is resident the stream is released and the GPU driven
+// tables are rebuilt to cover the whole scene.
+static void demo_update_scene_stream(Demo *d) {
+  if (!d->scene_stream) {
+    return;
+  }
+  TracyCZoneN(ctx, "demo_update_scene_stream", true);
+
+  Scene *s = d->main_scene;
+  SceneStreamUpdate update = {0};
+  bool done = scene_stream_update(s, d->scene_stream, &update);
+
+  for (uint32_t i = 0; i < update.mesh_count; ++i) {
+    demo_upload_pooled_mesh(d, &s->meshes[update.meshes[i]]);
+  }
+  for (uint32_t i = 0; i < update.texture_count; ++i) {
+    demo_upload_scene_texture(d, update.textures[i]);
+  }
+
+  // The table is uploaded like any other constant buffer but material sets
+  // are only rewritten once their frame is no longer in flight
+  if (update.texture_count > 0) {
+    demo_write_material_table(d);
+    for (uint32_t i = 0; i < FRAME_LATENCY; ++i) {
+      d->gltf_material_sets_dirty[i] = true;
+    }
+  }
+
+  if (done) {
+    destroy_scene_stream(d->scene_stream);
+    d->scene_stream = NULL;
+
+    // Loading is over so one stall to resize the tables is acceptable
+    if (d->gpu_driven) {
+      vkDeviceWaitIdle(d->device);
+      demo_destroy_gpu_scene(d);
+      bool created = demo_create_gpu_scene(d);
+      assert(created);
+      (void)created;
+    }
+  }
+
+  TracyCZoneEnd(ctx);
+}
+
 void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
   TracyCZoneN(demo_render_frame_event, "demo_render_frame", true);
 
@@ -2189,6 +4664,34 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
     vkResetFences(device, 1, &fences[frame_idx]);
   }
 
+  // Anything swapped out this many frames ago is no longer sampled
+  demo_destroy_retired_textures(d, frame_idx);
+
+  // VMA only refetches the device's memory budget when the frame changes,
+  // which texture residency reads below
+  vmaSetCurrentFrameIndex(d->vma_alloc, ++d->frame_count);
+
+  // The last cull that used this frame's stats buffer has now finished
+  if (d->gltf_cull_stats_pending[frame_idx]) {
+    VmaAllocation stats_alloc = d->gltf_cull_stats_buffers[frame_idx].alloc;
+    GLTFCullStats *stats = NULL;
+    err = vmaMapMemory(d->vma_alloc, stats_alloc, (void **)&stats);
+    if (err == VK_SUCCESS) {
+      vmaInvalidateAllocation(d->vma_alloc, stats_alloc, 0, VK_WHOLE_SIZE);
+      d->cull_stats = *stats;
+      vmaUnmapMemory(d->vma_alloc, stats_alloc);
+    }
+    d->gltf_cull_stats_pending[frame_idx] = false;
+  }
+
+  // Uploads for whatever streamed in are recorded with this frame
+  demo_update_scene_stream(d);
+  demo_update_texture_residency(d, vp);
+  demo_update_texture_streams(d);
+  if (d->gltf_material_sets_dirty[frame_idx]) {
+    demo_write_material_sets(d, frame_idx);
+  }
+
   // Acquire Image
   {
     TracyCZoneN(ctx, "demo_render_frame acquire next image", true);
@@ -2249,7 +4752,8 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
 
       // Upload
       if (d->const_buffer_upload_count > 0 || d->mesh_upload_count > 0 ||
-          d->texture_upload_count > 0) {
+          d->pooled_mesh_upload_count > 0 || d->texture_upload_count > 0 ||
+          d->texture_level_upload_count > 0) {
         VkCommandBufferBeginInfo begin_info = {
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
         err = vkBeginCommandBuffer(upload_buffer, &begin_info);
@@ -2289,6 +4793,18 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
           cmd_end_label(upload_buffer);
         }
 
+        // Issue uploads into the scene mesh pool
+        if (d->pooled_mesh_upload_count > 0) {
+          cmd_begin_label(upload_buffer, "upload pooled meshes",
+                          (float4){0.1, 0.4, 0.1, 1.0});
+          for (uint32_t i = 0; i < d->pooled_mesh_upload_count; ++i) {
+            meshpool_record_upload(&d->mesh_pool, upload_buffer,
+                                   &d->pooled_mesh_upload_queue[i]);
+          }
+          d->pooled_mesh_upload_count = 0;
+          cmd_end_label(upload_buffer);
+        }
+
         // Issue texture uploads
         if (d->texture_upload_count > 0) {
           cmd_begin_label(upload_buffer, "upload textures",
@@ -2421,6 +4937,79 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
           cmd_end_label(upload_buffer);
         }
 
+        // Issue streaming texture levels. Levels below a texture's clamp are
+        // never sampled so they can be overwritten while earlier frames still
+        // sample the coarser ones. The first run takes the whole chain out of
+        // undefined to shader read so the view is always valid; every later
+        // run waits on that, or on sampling, before it moves its levels back
+        // to transfer. Images may start partway down the chain so regions are
+        // moved to match.
+        if (d->texture_level_upload_count > 0) {
+          cmd_begin_label(upload_buffer, "upload texture levels",
+                          (float4){0.1, 0.4, 0.1, 1.0});
+          const Scene *s = d->main_scene;
+          for (uint32_t i = 0; i < d->texture_level_upload_count; ++i) {
+            const TextureLevelUpload *upload =
+                &d->texture_level_upload_queue[i];
+            const GPUTexture *tex = &s->textures[upload->texture];
+            uint32_t image_base = tex->image_base_level;
+
+            VkBufferImageCopy regions[MAX_REGION_COUNT];
+            for (uint32_t ii = 0; ii < upload->level_count; ++ii) {
+              regions[ii] = tex->regions[upload->first_level + ii];
+              regions[ii].imageSubresource.mipLevel -= image_base;
+            }
+
+            VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            VkImageMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = tex->device.image,
+                .subresourceRange =
+                    {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = upload->first
+                                            ? 0
+                                            : upload->first_level - image_base,
+                        .levelCount = upload->first
+                                          ? tex->mip_levels - image_base
+                                          : upload->level_count,
+                        .layerCount = 1,
+                    },
+            };
+            if (!upload->first) {
+              src_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                          VK_PIPELINE_STAGE_TRANSFER_BIT;
+              barrier.srcAccessMask =
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+              barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+            vkCmdPipelineBarrier(upload_buffer, src_stage,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                                 NULL, 1, &barrier);
+
+            vkCmdCopyBufferToImage(upload_buffer, tex->host.buffer,
+                                   tex->device.image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   upload->level_count, regions);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            vkCmdPipelineBarrier(upload_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                                 NULL, 0, NULL, 1, &barrier);
+          }
+          d->texture_level_upload_count = 0;
+          cmd_end_label(upload_buffer);
+        }
+
         // Issue Const Data Updates
         {
           // TODO: If sky data has changed only...
@@ -2490,6 +5079,26 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
                              0, NULL, 0, NULL, 1, &barrier);
       }
 
+      // Cull the scene into this frame's indirect draw buffer
+      // With occlusion culling, whatever was visible last frame is drawn
+      // into a depth pre-pass whose Hi-Z pyramid then culls everything
+      // A scene that is still streaming is drawn from the CPU draw list
+      bool gpu_culling = d->gpu_culling && !d->scene_stream;
+      bool occlusion = gpu_culling && d->occlusion_culling;
+      if (gpu_culling) {
+        TracyCVkNamedZone(gpu_gfx_ctx, cull_scope, graphics_buffer,
+                          "Cull Scene", 2, true);
+        if (occlusion) {
+          demo_cull_scene(graphics_buffer, vp, GLTF_CULL_PHASE_EARLY, d);
+          demo_depth_prepass(graphics_buffer, d);
+          demo_build_hiz(graphics_buffer, d);
+          demo_cull_scene(graphics_buffer, vp, GLTF_CULL_PHASE_LATE, d);
+        } else {
+          demo_cull_scene(graphics_buffer, vp, GLTF_CULL_PHASE_FRUSTUM, d);
+        }
+        TracyCVkZoneEnd(cull_scope);
+      }
+
       // Render main geometry pass
       {
         VkFramebuffer framebuffer = d->main_pass_framebuffers[frame_idx];
@@ -2511,9 +5120,12 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
                 {.depthStencil = {.depth = 0.0f, .stencil = 0.0f}},
             };
 
+            // Keep the pre-pass depth so the main pass only shades
+            // visible surfaces
             VkRenderPassBeginInfo pass_info = {0};
             pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            pass_info.renderPass = d->render_pass;
+            pass_info.renderPass =
+                occlusion ? d->main_load_pass : d->render_pass;
             pass_info.framebuffer = framebuffer;
             pass_info.renderArea = (VkRect2D){{0, 0}, {width, height}};
             pass_info.clearValueCount = 2;
@@ -2536,22 +5148,20 @@ void demo_render_frame(Demo *d, const float4x4 *vp, const float4x4 *sky_vp) {
 
           // Draw Scene
           {
-            // HACK: Known desired permutations
-            uint32_t perm = GLTF_PERM_NONE;
             VkPipelineLayout pipe_layout = d->gltf_pipe_layout;
-            VkPipeline pipe = d->gltf_pipeline->pipelines[perm];
-
-            vkCmdBindPipeline(graphics_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              pipe);
 
             TracyCVkNamedZone(gpu_gfx_ctx, scene_scope, graphics_buffer,
                               "Draw Scene", 3, true);
 
-            demo_render_scene(d->main_scene, graphics_buffer, pipe_layout,
-                              d->gltf_view_descriptor_sets[frame_idx],
-                              d->gltf_object_descriptor_sets[frame_idx],
-                              d->gltf_material_descriptor_sets[frame_idx], vp,
-                              d);
+            if (gpu_culling) {
+              demo_render_scene_indirect(
+                  graphics_buffer, d->gltf_view_descriptor_sets[frame_idx], d);
+            } else {
+              demo_render_scene(d->main_scene, graphics_buffer,
+                                d->gltf_pipeline, pipe_layout,
+                                d->gltf_view_descriptor_sets[frame_idx], vp,
+                                d);
+            }
 
             TracyCVkZoneEnd(scene_scope);
           }
@@ -5,9 +5,15 @@
 #undef VK_NO_PROTOTYPES
 
 #include "allocator.h"
+#include "drawlist.h"
 #include "gpuresources.h"
+#include "jobs.h"
+#include "meshpool.h"
+#include "occlusion.h"
 #include "profiling.h"
 #include "scene.h"
+#include "shadercommon.h"
+#include "vfs.h"
 
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include <cimgui.h>
@@ -19,11 +25,40 @@
 #endif
 #define CONST_BUFFER_UPLOAD_QUEUE_SIZE 16
 #define MESH_UPLOAD_QUEUE_SIZE 16
+#define POOLED_MESH_UPLOAD_QUEUE_SIZE 128
 #define TEXTURE_UPLOAD_QUEUE_SIZE 16
+#define TEXTURE_LEVEL_UPLOAD_QUEUE_SIZE 64
+
+// Levels no larger than this on either side make up a texture's mip tail,
+// which streams in as one piece so the texture shows up right away
+#define TEXTURE_STREAM_TAIL_EXTENT 64
+#define DEFAULT_TEXTURE_STREAM_BUDGET (8 * 1024 * 1024)
+
+#define DEFAULT_TEXTURE_MEMORY_BUDGET (1024ull * 1024 * 1024)
+// Most main scene textures moved to a new image in one frame
+#define TEXTURE_RESIZE_QUEUE_SIZE 16
+// Furthest requests are pushed towards the tail when they don't all fit
+#define TEXTURE_MAX_LOD_BIAS 4
 
 typedef union SDL_Event SDL_Event;
 typedef struct SDL_Window SDL_Window;
 
+// A run of a scene texture's levels recorded with a frame's uploads. The
+// first run of a texture also moves every other level out of undefined.
+typedef struct TextureLevelUpload {
+  uint32_t texture;
+  uint32_t first_level;
+  uint32_t level_count;
+  bool first;
+} TextureLevelUpload;
+
+// What a texture held before it was moved to a new image. Destroyed once
+// every frame that could sample it is done.
+typedef struct RetiredTextureImage {
+  GPUImage image;
+  VkImageView view;
+} RetiredTextureImage;
+
 typedef struct SwapchainInfo {
   bool valid;
   uint32_t image_count;
@@ -66,6 +101,9 @@ typedef struct Demo {
 
   VkRenderPass render_pass;
   VkRenderPass imgui_pass;
+  // Depth only pass and a main pass variant that keeps its depth
+  VkRenderPass depth_prepass;
+  VkRenderPass main_load_pass;
 
   VkPipelineCache pipeline_cache;
 
@@ -78,16 +116,31 @@ typedef struct Demo {
   GPUConstBuffer sky_const_buffer;
   GPUConstBuffer hosek_const_buffer;
 
-  GPUConstBuffer object_const_buffer;
   GPUConstBuffer camera_const_buffer;
   GPUConstBuffer light_const_buffer;
 
   VkDescriptorSetLayout gltf_material_set_layout;
-  VkDescriptorSetLayout gltf_object_set_layout;
   VkDescriptorSetLayout gltf_view_set_layout;
   VkPipelineLayout gltf_pipe_layout;
   GPUPipeline *gltf_pipeline;
 
+  // GPU driven path; the cull pass fills per-permutation indirect draws
+  bool gpu_driven;
+  bool gpu_culling;
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count;
+  VkDescriptorSetLayout gltf_cull_set_layout;
+  VkPipelineLayout gltf_cull_pipe_layout;
+  VkPipeline gltf_cull_pipeline;
+  VkPipeline gltf_cluster_cull_pipeline;
+  GPUPipeline *gltf_indirect_pipeline;
+
+  // Two phase occlusion culling against a Hi-Z pyramid of the pre-pass depth
+  bool occlusion_culling;
+  GPUPipeline *gltf_depth_pipeline;
+  VkDescriptorSetLayout hiz_set_layout;
+  VkPipelineLayout hiz_pipe_layout;
+  VkPipeline hiz_pipeline;
+
   VkDescriptorSetLayout gltf_rt_layout;
   VkPipelineLayout gltf_rt_pipe_layout;
   GPUPipeline *gltf_rt_pipeline;
@@ -100,10 +153,20 @@ typedef struct Demo {
   VkImageView swapchain_image_views[FRAME_LATENCY];
   VkFramebuffer main_pass_framebuffers[FRAME_LATENCY];
   VkFramebuffer ui_pass_framebuffers[FRAME_LATENCY];
+  VkFramebuffer depth_prepass_framebuffers[FRAME_LATENCY];
 
   GPUImage depth_buffers; // Implemented as an image array; one image for each
                           // latency frame
   VkImageView depth_buffer_views[FRAME_LATENCY];
+  VkImageView depth_sample_views[FRAME_LATENCY]; // Depth aspect only
+
+  // Sized to the power of two below the swapchain; mip 0 is not full res
+  GPUImage hiz_image;
+  VkImageView hiz_view;
+  VkImageView hiz_mip_views[HIZ_MAX_MIP_COUNT];
+  uint32_t hiz_width;
+  uint32_t hiz_height;
+  uint32_t hiz_mip_count;
 
   VkCommandPool command_pools[FRAME_LATENCY];
   VkCommandBuffer upload_buffers[FRAME_LATENCY];
@@ -120,6 +183,7 @@ typedef struct Demo {
   VkSemaphore render_complete_sems[FRAME_LATENCY];
 
   uint32_t frame_idx;
+  uint32_t frame_count; // Handed to VMA so its budget refreshes every frame
   uint32_t swap_img_idx;
   VkFence fences[FRAME_LATENCY];
 
@@ -133,9 +197,32 @@ typedef struct Demo {
   GPUMesh imgui_gpu[FRAME_LATENCY];
   GPUTexture imgui_atlas;
 
+  MeshPool mesh_pool;
+  char *cache_dir;
+  Vfs vfs;
+
+  // Workers hold a pointer to the job system so it lives in place here
+  JobSystem jobs;
+
+  // Software occlusion culling for the CPU built draw list
+  bool cpu_occlusion;
+  OcclusionBuffer occlusion;
+
+  // Mesh level of detail for the CPU built draw list. Each entity remembers
+  // its last level so selection can apply hysteresis.
+  float lod_pixel_error;
+  uint32_t entity_lod_capacity;
+  uint8_t *entity_lods;
+
   Scene *duck_scene;
   Scene *floor_scene;
   Scene *main_scene;
+  // Set until every mesh and texture of the main scene is resident. The GPU
+  // driven tables are only built once it is done; until then the scene is
+  // drawn from the CPU draw list, which skips whatever isn't resident.
+  SceneStream *scene_stream;
+  uint32_t scene_stream_done;
+  uint32_t scene_stream_total;
 
   GPUImage screenshot_image;
   VkFence screenshot_fence;
@@ -143,20 +230,96 @@ typedef struct Demo {
   VkDescriptorPool descriptor_pools[FRAME_LATENCY];
   VkDescriptorSet skydome_descriptor_sets[FRAME_LATENCY];
   VkDescriptorSet hosek_descriptor_set;
-  VkDescriptorSet gltf_material_descriptor_sets[FRAME_LATENCY];
-  VkDescriptorSet gltf_object_descriptor_sets[FRAME_LATENCY];
   VkDescriptorSet gltf_view_descriptor_sets[FRAME_LATENCY];
   VkDescriptorSet imgui_descriptor_sets[FRAME_LATENCY];
 
+  // Each frame has its own material sets, gltf_material_set_count of them,
+  // which are rewritten after its fence once textures become resident
+  bool bindless;
+  uint32_t max_bindless_textures; // Most the set layout's texture array holds
+  uint32_t bindless_texture_count; // Slots in each frame's texture array
+  GPUConstBuffer gltf_material_table;
+  VkDescriptorPool material_descriptor_pool;
+  uint32_t gltf_material_set_count;
+  VkDescriptorSet *gltf_material_sets;
+  bool gltf_material_sets_dirty[FRAME_LATENCY];
+
+  // Host visible so the draw list can be written straight into the frame's
+  // buffer while recording
+  uint32_t gltf_object_capacity;
+  GPUBuffer gltf_object_buffers[FRAME_LATENCY];
+
+  uint32_t gltf_instance_count;
+  GPUConstBuffer gltf_instance_buffer;
+  GPUBuffer gltf_draw_buffers[FRAME_LATENCY];
+  GPUBuffer gltf_draw_count_buffers[FRAME_LATENCY];
+  VkDescriptorSet gltf_cull_descriptor_sets[FRAME_LATENCY];
+  GPUBuffer gltf_visibility_buffer; // Last frame's late cull result
+  bool gltf_visibility_reset;
+
+  // Clusters of dense submeshes are culled after their instance and the
+  // survivors' indices are compacted into the frame's cluster index buffer
+  uint32_t gltf_cluster_count;
+  GPUConstBuffer gltf_cluster_buffer;
+  GPUBuffer gltf_instance_draw_buffers[FRAME_LATENCY];
+  GPUBuffer gltf_cluster_index_buffers[FRAME_LATENCY];
+
+  // Stats are read back once the frame's fence has signaled
+  GPUBuffer gltf_cull_stats_buffers[FRAME_LATENCY];
+  bool gltf_cull_stats_pending[FRAME_LATENCY];
+  GLTFCullStats cull_stats;
+
+  VkDescriptorPool hiz_descriptor_pool;
+  VkDescriptorSet hiz_descriptor_sets[FRAME_LATENCY][HIZ_MAX_MIP_COUNT];
+
   uint32_t const_buffer_upload_count;
   GPUConstBuffer const_buffer_upload_queue[CONST_BUFFER_UPLOAD_QUEUE_SIZE];
 
   uint32_t mesh_upload_count;
   GPUMesh mesh_upload_queue[MESH_UPLOAD_QUEUE_SIZE];
 
+  uint32_t pooled_mesh_upload_count;
+  PooledMesh pooled_mesh_upload_queue[POOLED_MESH_UPLOAD_QUEUE_SIZE];
+
   uint32_t texture_upload_count;
   GPUTexture texture_upload_queue[TEXTURE_UPLOAD_QUEUE_SIZE];
 
+  // Main scene textures with their mips in staging stream in smallest level
+  // first and are sampled no finer than what has landed. Each frame uploads
+  // up to texture_stream_budget bytes of levels, and always at least one
+  // run, so the budget trades pop-in time for upload cost.
+  uint64_t texture_stream_budget;
+  uint32_t texture_stream_capacity;
+  uint32_t texture_stream_count;
+  uint32_t *texture_streams; // Scene texture indices still missing levels
+  uint32_t texture_level_upload_count;
+  TextureLevelUpload
+      texture_level_upload_queue[TEXTURE_LEVEL_UPLOAD_QUEUE_SIZE];
+
+  // Main scene textures are only kept as detailed as they were last seen.
+  // Visible entities request a level for each of their textures from their
+  // projected size. Over the limit, textures holding levels finer than they
+  // request give them up least recently seen first by moving to a smaller
+  // image; once requested again they move back and the levels stream in.
+  // The limit is the smaller of texture_memory_budget and what the device
+  // budget leaves, and requests are biased coarser until they fit it.
+  bool memory_budget; // Device budgets come from VK_EXT_memory_budget
+  uint32_t texture_heap_idx;
+  uint64_t texture_memory_budget;
+  uint64_t texture_memory_limit;
+  uint64_t texture_resident_bytes;
+  uint64_t texture_requested_bytes;
+  uint32_t texture_lod_bias;
+  uint64_t texture_frame;
+  uint32_t texture_residency_capacity;
+  uint32_t *texture_requested_levels;
+  uint64_t *texture_last_seen; // texture_frame each texture was last visible
+  uint32_t retired_texture_counts[FRAME_LATENCY];
+  RetiredTextureImage retired_textures[FRAME_LATENCY]
+                                      [TEXTURE_RESIZE_QUEUE_SIZE];
+
+  DrawStats draw_stats;
+
   ImGuiContext *ig_ctx;
   ImGuiIO *ig_io;
 } Demo;
@@ -168,6 +331,7 @@ void demo_destroy(Demo *d);
 
 void demo_upload_const_buffer(Demo *d, const GPUConstBuffer *buffer);
 void demo_upload_mesh(Demo *d, const GPUMesh *mesh);
+void demo_upload_pooled_mesh(Demo *d, const PooledMesh *mesh);
 void demo_upload_texture(Demo *d, const GPUTexture *tex);
 void demo_upload_scene(Demo *d, const Scene *s);
 
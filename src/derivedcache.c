@@ -0,0 +1,222 @@
+#include "derivedcache.h"
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_stdinc.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__SWITCH__)
+#define HB_DIRENT
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+#include "profiling.h"
+
+// Every cache file is named <kind>_<key>.cache which fits with room to spare
+#define DERIVED_CACHE_MAX_NAME 64
+
+static SDL_atomic_t cache_hits[DERIVED_CACHE_KIND_COUNT];
+static SDL_atomic_t cache_misses[DERIVED_CACHE_KIND_COUNT];
+
+void derived_cache_count(uint32_t kind, bool hit) {
+  SDL_AtomicIncRef(hit ? &cache_hits[kind] : &cache_misses[kind]);
+}
+
+DerivedCacheStats derived_cache_stats(void) {
+  DerivedCacheStats stats = {0};
+  for (uint32_t i = 0; i < DERIVED_CACHE_KIND_COUNT; ++i) {
+    stats.hits[i] = (uint32_t)SDL_AtomicGet(&cache_hits[i]);
+    stats.misses[i] = (uint32_t)SDL_AtomicGet(&cache_misses[i]);
+  }
+  return stats;
+}
+
+typedef struct CacheEntry {
+  char name[DERIVED_CACHE_MAX_NAME];
+  uint64_t size;
+  uint64_t last_used; // Only compared against other entries
+} CacheEntry;
+
+static bool cache_file_name(const char *name) {
+  size_t len = strlen(name);
+  return len < DERIVED_CACHE_MAX_NAME && len > 6 &&
+         strcmp(name + len - 6, ".cache") == 0;
+}
+
+static int cache_entry_cmp(const void *a, const void *b) {
+  uint64_t lhs = ((const CacheEntry *)a)->last_used;
+  uint64_t rhs = ((const CacheEntry *)b)->last_used;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+static bool push_cache_entry(Allocator alloc, CacheEntry **entries,
+                             uint32_t *count, uint32_t *capacity,
+                             CacheEntry entry) {
+  if (*count == *capacity) {
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 64;
+    CacheEntry *grown =
+        hb_realloc_nm_tp(alloc, *entries, new_capacity, CacheEntry);
+    if (!grown) {
+      return false;
+    }
+    *entries = grown;
+    *capacity = new_capacity;
+  }
+  (*entries)[(*count)++] = entry;
+  return true;
+}
+
+#if defined(_WIN32)
+
+void derived_cache_touch(const char *path) {
+  HANDLE file = CreateFileA(path, FILE_WRITE_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, 0, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  FILETIME now = {0};
+  GetSystemTimeAsFileTime(&now);
+  SetFileTime(file, NULL, NULL, &now);
+  CloseHandle(file);
+}
+
+static uint32_t list_cache_entries(Allocator alloc, const char *cache_dir,
+                                   CacheEntry **out_entries) {
+  char pattern[1024] = {0};
+  SDL_snprintf(pattern, sizeof(pattern), "%s*.cache", cache_dir);
+
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  WIN32_FIND_DATAA find = {0};
+  HANDLE handle = FindFirstFileA(pattern, &find);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+  do {
+    if ((find.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        !cache_file_name(find.cFileName)) {
+      continue;
+    }
+    CacheEntry entry = {
+        .size = ((uint64_t)find.nFileSizeHigh << 32) | find.nFileSizeLow,
+        .last_used = ((uint64_t)find.ftLastWriteTime.dwHighDateTime << 32) |
+                     find.ftLastWriteTime.dwLowDateTime,
+    };
+    SDL_strlcpy(entry.name, find.cFileName, sizeof(entry.name));
+    if (!push_cache_entry(alloc, out_entries, &count, &capacity, entry)) {
+      break;
+    }
+  } while (FindNextFileA(handle, &find));
+  FindClose(handle);
+  return count;
+}
+
+static void remove_cache_file(const char *path) {
+  DeleteFileA(path);
+}
+
+#elif defined(HB_DIRENT)
+
+void derived_cache_touch(const char *path) {
+  utime(path, NULL);
+}
+
+static uint32_t list_cache_entries(Allocator alloc, const char *cache_dir,
+                                   CacheEntry **out_entries) {
+  DIR *dir = opendir(cache_dir);
+  if (!dir) {
+    return 0;
+  }
+
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  struct dirent *ent = NULL;
+  while ((ent = readdir(dir)) != NULL) {
+    if (!cache_file_name(ent->d_name)) {
+      continue;
+    }
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", cache_dir, ent->d_name);
+    struct stat st = {0};
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    CacheEntry entry = {
+        .size = (uint64_t)st.st_size,
+        .last_used = (uint64_t)st.st_mtime,
+    };
+    SDL_strlcpy(entry.name, ent->d_name, sizeof(entry.name));
+    if (!push_cache_entry(alloc, out_entries, &count, &capacity, entry)) {
+      break;
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+static void remove_cache_file(const char *path) {
+  remove(path);
+}
+
+#else
+
+// No way to list the save directory here so the cache is never trimmed
+void derived_cache_touch(const char *path) {
+  (void)path;
+}
+
+static uint32_t list_cache_entries(Allocator alloc, const char *cache_dir,
+                                   CacheEntry **out_entries) {
+  (void)alloc;
+  (void)cache_dir;
+  (void)out_entries;
+  return 0;
+}
+
+static void remove_cache_file(const char *path) {
+  (void)path;
+}
+
+#endif
+
+uint64_t trim_derived_cache(Allocator alloc, const char *cache_dir,
+                            uint64_t max_size) {
+  if (!cache_dir) {
+    return 0;
+  }
+  TracyCZoneN(ctx, "trim_derived_cache", true);
+
+  CacheEntry *entries = NULL;
+  uint32_t count = list_cache_entries(alloc, cache_dir, &entries);
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    size += entries[i].size;
+  }
+
+  if (size > max_size) {
+    uint64_t start_size = size;
+    uint32_t removed = 0;
+    SDL_qsort(entries, count, sizeof(CacheEntry), cache_entry_cmp);
+    for (uint32_t i = 0; i < count && size > max_size; ++i) {
+      char path[1024] = {0};
+      SDL_snprintf(path, sizeof(path), "%s%s", cache_dir, entries[i].name);
+      remove_cache_file(path);
+      size -= entries[i].size;
+      removed++;
+    }
+    SDL_Log("Trimmed asset cache from %llu to %llu bytes (%u files)",
+            (unsigned long long)start_size, (unsigned long long)size,
+            removed);
+  }
+
+  hb_free(alloc, entries);
+  TracyCZoneEnd(ctx);
+  return size;
+}
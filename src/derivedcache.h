@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+// Kinds of derived data kept in the per user cache directory
+#define DERIVED_CACHE_MESH 0
+#define DERIVED_CACHE_TEXTURE 1
+#define DERIVED_CACHE_KIND_COUNT 2
+
+typedef struct DerivedCacheStats {
+  uint32_t hits[DERIVED_CACHE_KIND_COUNT];
+  uint32_t misses[DERIVED_CACHE_KIND_COUNT];
+} DerivedCacheStats;
+
+// Lookups are counted from any thread for as long as the process runs
+void derived_cache_count(uint32_t kind, bool hit);
+DerivedCacheStats derived_cache_stats(void);
+
+// Marks a cache file as just used so trimming keeps it around the longest
+void derived_cache_touch(const char *path);
+
+// Deletes the least recently used cache files until the ones left take up
+// no more than max_size bytes. Returns the size that is left.
+uint64_t trim_derived_cache(Allocator alloc, const char *cache_dir,
+                            uint64_t max_size);
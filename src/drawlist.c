@@ -0,0 +1,105 @@
+#include "drawlist.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "profiling.h"
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+static uint64_t mask_bits(uint32_t value, uint32_t bits) {
+  return (uint64_t)value & ((1ull << bits) - 1);
+}
+
+uint64_t draw_key(uint32_t perm, uint32_t material, uint32_t mesh,
+                  uint32_t lod, float depth) {
+  // Non-negative IEEE floats sort the same as their bit patterns so we can
+  // just keep the top bits of the float as a quantized depth
+  if (!(depth > 0.0f)) {
+    depth = 0.0f;
+  }
+  uint32_t depth_bits = 0;
+  memcpy(&depth_bits, &depth, sizeof(float));
+  depth_bits >>= (32 - DRAW_KEY_DEPTH_BITS);
+
+  return (mask_bits(perm, DRAW_KEY_PERM_BITS) << DRAW_KEY_PERM_SHIFT) |
+         (mask_bits(material, DRAW_KEY_MATERIAL_BITS)
+          << DRAW_KEY_MATERIAL_SHIFT) |
+         (mask_bits(mesh, DRAW_KEY_MESH_BITS) << DRAW_KEY_MESH_SHIFT) |
+         (mask_bits(lod, DRAW_KEY_LOD_BITS) << DRAW_KEY_LOD_SHIFT) |
+         (mask_bits(depth_bits, DRAW_KEY_DEPTH_BITS) << DRAW_KEY_DEPTH_SHIFT);
+}
+
+void create_drawlist(Allocator tmp_alloc, uint32_t max_packet_count,
+                     DrawList *out_list) {
+  *out_list = (DrawList){
+      .max_packet_count = max_packet_count,
+      .packets = hb_alloc_nm_tp(tmp_alloc, max_packet_count, DrawPacket),
+  };
+  assert(out_list->packets || max_packet_count == 0);
+}
+
+DrawPacket *drawlist_push(DrawList *list) {
+  assert(list->packet_count < list->max_packet_count);
+  return &list->packets[list->packet_count++];
+}
+
+void sort_drawlist(DrawList *list, Allocator tmp_alloc) {
+  TracyCZoneN(ctx, "sort_drawlist", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  uint32_t count = list->packet_count;
+  if (count < 2) {
+    TracyCZoneEnd(ctx);
+    return;
+  }
+
+  // Build every histogram in a single pass over the keys
+  uint32_t histograms[RADIX_PASSES][RADIX_SIZE] = {{0}};
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t key = list->packets[i].key;
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+      histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+    }
+  }
+
+  DrawPacket *src = list->packets;
+  DrawPacket *dst = hb_alloc_nm_tp(tmp_alloc, count, DrawPacket);
+  assert(dst);
+
+  for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+    uint32_t *histogram = histograms[pass];
+    uint32_t shift = pass * RADIX_BITS;
+
+    // Every key shares this digit so the pass would be a no-op copy
+    if (histogram[(src[0].key >> shift) & (RADIX_SIZE - 1)] == count) {
+      continue;
+    }
+
+    // Histogram to exclusive prefix sum
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < RADIX_SIZE; ++i) {
+      uint32_t c = histogram[i];
+      histogram[i] = offset;
+      offset += c;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t digit = (src[i].key >> shift) & (RADIX_SIZE - 1);
+      dst[histogram[digit]++] = src[i];
+    }
+
+    DrawPacket *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  // The sorted result may have ended up in the scratch buffer
+  if (src != list->packets) {
+    memcpy(list->packets, src, count * sizeof(DrawPacket));
+  }
+
+  TracyCZoneEnd(ctx);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "allocator.h"
+
+// Draw keys are sorted ascending so the most expensive state change lives in
+// the most significant bits. Depth is last so that within a run of identical
+// state we still draw roughly front to back.
+#define DRAW_KEY_PERM_BITS 8
+#define DRAW_KEY_MATERIAL_BITS 16
+#define DRAW_KEY_MESH_BITS 16
+#define DRAW_KEY_LOD_BITS 2
+#define DRAW_KEY_DEPTH_BITS 22
+
+#define DRAW_KEY_DEPTH_SHIFT 0
+#define DRAW_KEY_LOD_SHIFT (DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS)
+#define DRAW_KEY_MESH_SHIFT (DRAW_KEY_LOD_SHIFT + DRAW_KEY_LOD_BITS)
+#define DRAW_KEY_MATERIAL_SHIFT (DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS)
+#define DRAW_KEY_PERM_SHIFT (DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS)
+
+_Static_assert(DRAW_KEY_PERM_SHIFT + DRAW_KEY_PERM_BITS == 64,
+               "Draw key must use exactly 64 bits");
+
+typedef struct DrawPacket {
+  uint64_t key;
+  uint32_t entity;
+  uint32_t perm;
+  uint32_t material;
+  uint32_t mesh;
+  uint32_t submesh;
+  uint32_t lod;
+} DrawPacket;
+
+typedef struct DrawList {
+  uint32_t packet_count;
+  uint32_t max_packet_count;
+  DrawPacket *packets;
+} DrawList;
+
+// Per-frame counters for building the draw list and recording it
+typedef struct DrawStats {
+  uint32_t packet_count;
+  uint32_t draw_count;
+  uint32_t pipeline_binds;
+  uint32_t descriptor_binds;
+  uint32_t index_binds;
+  uint32_t vertex_binds;
+  uint32_t triangle_count;
+  uint32_t frustum_culled;
+  uint32_t occlusion_culled;
+  uint32_t non_resident; // Drawable entities whose mesh is still streaming
+  float cull_ms; // CPU time to cull and fill the list before sorting
+} DrawStats;
+
+uint64_t draw_key(uint32_t perm, uint32_t material, uint32_t mesh,
+                  uint32_t lod, float depth);
+
+// Packets are expected to live in and be sorted with a per-frame allocator
+void create_drawlist(Allocator tmp_alloc, uint32_t max_packet_count,
+                     DrawList *out_list);
+DrawPacket *drawlist_push(DrawList *list);
+void sort_drawlist(DrawList *list, Allocator tmp_alloc);
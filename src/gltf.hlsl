@@ -1,17 +1,50 @@
 #include "common.hlsli"
+#include "gltf.hlsli"
+
+// Per-view data - Bound once per pass
+ConstantBuffer<CommonCameraData> camera_data: register(b0, space0);
+ConstantBuffer<CommonLightData> light_data : register(b1, space0); // Fragment Stage Only
 
 // Per-material data - Fragment Stage Only (Maybe vertex stage too later?)
-Texture2D albedo_map : register(t0, space0); // Fragment Stage Only
-Texture2D normal_map : register(t1, space0); // Fragment Stage Only
-Texture2D roughness_map : register(t2, space0); // Fragment Stage Only
-sampler static_sampler : register(s3, space0); // Immutable sampler
+StructuredBuffer<GLTFMaterialData> material_data : register(t0, space1);
+sampler static_sampler : register(s1, space1); // Immutable sampler
 
-// Per-object data - Vertex Stage Only
-ConstantBuffer<CommonObjectData> object_data: register(b0, space1);
+// Mips finer than min_lod may still be uploading so the computed level is
+// clamped to it. Fully resident textures keep the regular filtered sample.
+float4 sample_material_map(Texture2D map, float2 uv, float min_lod)
+{
+    if(min_lod > 0)
+    {
+        float lod = map.CalculateLevelOfDetail(static_sampler, uv);
+        return map.SampleLevel(static_sampler, uv, max(lod, min_lod));
+    }
+    return map.Sample(static_sampler, uv);
+}
 
-// Per-view data - Fragment Stage Only
-ConstantBuffer<CommonCameraData> camera_data: register(b0, space2);
-ConstantBuffer<CommonLightData> light_data : register(b1, space2);
+#ifdef GLTF_BINDLESS
+// Every texture in the scene; indexed by the material record
+Texture2D gltf_textures[] : register(t2, space1);
+#define SAMPLE_MATERIAL_MAP(idx, map, uv, min_lod) \
+    sample_material_map(gltf_textures[NonUniformResourceIndex(idx)], uv, min_lod)
+#else
+// Fallback for devices without descriptor indexing; one set per material
+Texture2D albedo_map : register(t2, space1);
+Texture2D normal_map : register(t3, space1);
+Texture2D roughness_map : register(t4, space1);
+#define SAMPLE_MATERIAL_MAP(idx, map, uv, min_lod) \
+    sample_material_map(map, uv, min_lod)
+#endif
+
+#ifdef GLTF_INDIRECT
+// Per-object data - Vertex Stage Only
+// Indexed by the draw's firstInstance which the culling pass sets to the
+// instance's index. DXC maps SV_InstanceID to InstanceIndex which includes it.
+StructuredBuffer<GLTFInstanceData> instance_data : register(t2, space0);
+#else
+// Per-object data - Vertex Stage Only
+// Instanced draws set firstInstance to the start of their run of records
+StructuredBuffer<GLTFObjectData> object_data : register(t3, space0);
+#endif
 
 #define GLTF_PERM_NORMAL_MAP 0x00000001
 #define GLTF_PERM_PBR_METALLIC_ROUGHNESS 0x00000002
@@ -24,10 +57,11 @@ ConstantBuffer<CommonLightData> light_data : register(b1, space2);
 
 [[vk::constant_id(0)]] const uint PermutationFlags = 0;
 
+// See the mesh pool for how each stream is compressed
 struct VertexIn
 {
-    float3 local_pos : SV_POSITION;
-    float3 normal : NORMAL0;
+    float3 local_pos : SV_POSITION; // Unorm within the mesh's bounds
+    float2 normal : NORMAL0; // Octahedral
     float2 uv: TEXCOORD0;
 };
 
@@ -37,20 +71,46 @@ struct Interpolators
     float3 world_pos: POSITION0;
     float3 normal : NORMAL0;
     float2 uv: TEXCOORD0;
+    nointerpolation uint material : MATERIAL0;
 };
 
-Interpolators vert(VertexIn i)
+float3 decode_octahedral(float2 e)
 {
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    // Fold the lower hemisphere back out of the corners
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+Interpolators vert(VertexIn i, uint instance_id : SV_InstanceID)
+{
+#ifdef GLTF_INDIRECT
+    GLTFInstanceData instance = instance_data[instance_id];
+    float4x4 m = instance.m;
+    float4 dequant = instance.dequant;
+    uint material = instance.material;
+#else
+    GLTFObjectData object = object_data[instance_id];
+    float4x4 m = object.m;
+    float4 dequant = object.dequant;
+    uint material = object.material;
+#endif
+
     // Apply displacement map
-    float3 pos = i.local_pos;
+    float3 pos = dequant.xyz + i.local_pos * dequant.w;
+    float3 normal = decode_octahedral(i.normal);
 
-    float3x3 orientation = (float3x3)object_data.m;
+    float3x3 orientation = (float3x3)m;
+    float4 world_pos = mul(float4(pos, 1.0), m);
 
     Interpolators o;
-    o.clip_pos = mul(float4(pos, 1.0), object_data.mvp);
-    o.world_pos = mul(float4(pos, 1.0), object_data.m).xyz;
-    o.normal = mul(i.normal, orientation); // convert to world-space normal
+    o.clip_pos = mul(world_pos, camera_data.vp);
+    o.world_pos = world_pos.xyz;
+    o.normal = mul(normal, orientation); // convert to world-space normal
     o.uv = i.uv;
+    o.material = material;
     return o;
 }
 
@@ -94,17 +154,27 @@ float3 fresnelSchlick(float cosTheta, float3 F0)
 
 float4 frag(Interpolators i) : SV_TARGET
 {
+    GLTFMaterialData material = material_data[i.material];
+
     // Sample textures up-front
-    float3 albedo = albedo_map.Sample(static_sampler, i.uv).rgb;
+    float4 base_color = material.base_color_factor;
+    if(material.albedo_idx != GLTF_TEXTURE_NONE)
+    {
+        base_color *= SAMPLE_MATERIAL_MAP(material.albedo_idx, albedo_map, i.uv,
+                                          material.albedo_min_lod);
+    }
+    float3 albedo = base_color.rgb;
 
     float3 N = normalize(i.normal);
-    if(PermutationFlags & GLTF_PERM_NORMAL_MAP)
+    if((PermutationFlags & GLTF_PERM_NORMAL_MAP) &&
+       material.normal_idx != GLTF_TEXTURE_NONE)
     {
-        N = normal_map.Sample(static_sampler, i.uv).xyz;
+        N = SAMPLE_MATERIAL_MAP(material.normal_idx, normal_map, i.uv,
+                                material.normal_min_lod).xyz;
         N = normalize(N * 2 - 1); // Must unpack normal
     }
 
-    float roughness = 0.5;
+    float roughness = material.roughness_factor;
 
     float3 V = normalize(camera_data.view_pos - i.world_pos);
 
@@ -112,10 +182,16 @@ float4 frag(Interpolators i) : SV_TARGET
 
     if(PermutationFlags & GLTF_PERM_PBR_METALLIC_ROUGHNESS)
     {
-        float metallic = 0.5; // TODO: read metallic value from somewhere
+        float metallic = material.metallic_factor;
 
-        // TODO: If has roughness map
-        // roughness = roughness_map.Sample(static_sampler, i.uv).x;
+        // glTF packs roughness in green and metallic in blue
+        if(material.roughness_idx != GLTF_TEXTURE_NONE)
+        {
+            float4 mr = SAMPLE_MATERIAL_MAP(material.roughness_idx, roughness_map,
+                                           i.uv, material.roughness_min_lod);
+            roughness *= mr.g;
+            metallic *= mr.b;
+        }
 
         float3 F0 = float3(0.04, 0.04, 0.04);
         F0 = lerp(F0, albedo, metallic);
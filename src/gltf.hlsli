@@ -0,0 +1,115 @@
+#pragma once
+
+// Material texture slot that has nothing bound
+#define GLTF_TEXTURE_NONE 0xFFFFFFFF
+
+// One record per material in a scene's material table
+// Texture ids index the scene's texture array. Each texture's min lod is the
+// finest mip streamed in so far; sampling never goes below it.
+typedef struct GLTFMaterialData {
+  float4 base_color_factor;
+  float metallic_factor;
+  float roughness_factor;
+  uint32_t albedo_idx;
+  uint32_t normal_idx;
+  uint32_t roughness_idx;
+  float albedo_min_lod;
+  float normal_min_lod;
+  float roughness_min_lod;
+} GLTFMaterialData;
+
+// One record per instance of a CPU built draw, rewritten every frame
+// Instanced draws cover a contiguous run of records
+typedef struct GLTFObjectData {
+  float4x4 m;
+  float4 dequant; // Mesh position dequantization; offset in xyz, scale in w
+  uint32_t material;
+  uint32_t padding0;
+  uint32_t padding1;
+  uint32_t padding2;
+} GLTFObjectData;
+
+// Index buffers can't be rebound within an indirect draw so draws are
+// grouped by index type as well as by permutation
+#define GLTF_INDEX_TYPE_UINT16 0
+#define GLTF_INDEX_TYPE_UINT32 1
+#define GLTF_INDEX_TYPE_COUNT 2
+
+// Clustered instances draw from the compacted cluster index buffer instead of
+// the pool so they get a bucket of their own after the index type buckets
+#define GLTF_DRAW_BUCKET_CLUSTERS GLTF_INDEX_TYPE_COUNT
+#define GLTF_DRAW_BUCKET_COUNT (GLTF_INDEX_TYPE_COUNT + 1)
+
+// Marks an instance with no draw this phase
+#define GLTF_NO_DRAW 0xFFFFFFFF
+
+// One record per drawable submesh of an entity for GPU driven rendering
+// bounds is an object space bounding sphere; xyz center and w radius
+typedef struct GLTFInstanceData {
+  float4x4 m;
+  float4 dequant; // Mesh position dequantization; offset in xyz, scale in w
+  float4 bounds;
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+  uint32_t material;
+  uint32_t perm;
+  uint32_t index_type;           // GLTF_INDEX_TYPE_*
+  uint32_t cluster_count;        // Zero draws the whole index range
+  uint32_t cluster_index_offset; // Into the cluster index buffer
+} GLTFInstanceData;
+
+// One record per cluster of a clustered instance
+// bounds and cone are in object space; cone is the axis in xyz and the
+// cutoff in w
+typedef struct GLTFClusterData {
+  float4 bounds;
+  float4 cone;
+  uint32_t instance;
+  uint32_t first_index; // Into the mesh pool's indices
+  uint32_t index_count;
+  uint32_t index_type; // GLTF_INDEX_TYPE_*
+} GLTFClusterData;
+
+// Mirrors VkDrawIndexedIndirectCommand
+typedef struct GLTFDrawCommand {
+  uint32_t index_count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t vertex_offset;
+  uint32_t first_instance;
+} GLTFDrawCommand;
+
+#define GLTF_CULL_GROUP_SIZE 64
+#define GLTF_CLUSTER_CULL_GROUP_SIZE 64
+#define GLTF_FRUSTUM_PLANE_COUNT 6
+
+// Frustum culls everything with no occlusion test
+#define GLTF_CULL_PHASE_FRUSTUM 0
+// Emits what was visible last frame for the depth pre-pass
+#define GLTF_CULL_PHASE_EARLY 1
+// Tests everything against the Hi-Z pyramid and records visibility
+#define GLTF_CULL_PHASE_LATE 2
+
+// Draws for each permutation and bucket are written to their own
+// instance_count sized region of the draw buffer so every pair gets one
+// indirect draw
+typedef struct GLTFCullConstants {
+  float4 frustum_planes[GLTF_FRUSTUM_PLANE_COUNT];
+  uint32_t instance_count;
+  uint32_t cluster_count;
+  uint32_t phase;
+  uint32_t hiz_width;
+  uint32_t hiz_height;
+  uint32_t hiz_mip_count;
+} GLTFCullConstants;
+
+// Counters accumulated over every cull phase of a frame
+typedef struct GLTFCullStats {
+  uint32_t frustum_culled;
+  uint32_t occlusion_culled;
+  uint32_t prepass_draws;
+  uint32_t main_draws;
+  uint32_t clusters_frustum_culled;
+  uint32_t clusters_backface_culled;
+} GLTFCullStats;
@@ -0,0 +1,2 @@
+#define GLTF_BINDLESS
+#include "gltf.hlsl"
@@ -0,0 +1,103 @@
+#include "common.hlsli"
+#include "gltf.hlsli"
+
+StructuredBuffer<GLTFInstanceData> instances : register(t0, space0);
+RWStructuredBuffer<GLTFDrawCommand> draws : register(u1, space0);
+ConstantBuffer<CommonCameraData> camera_data : register(b3, space0);
+RWStructuredBuffer<GLTFCullStats> stats : register(u6, space0);
+RWStructuredBuffer<uint> instance_draws : register(u7, space0);
+StructuredBuffer<GLTFClusterData> clusters : register(t8, space0);
+ByteAddressBuffer pool_indices : register(t9, space0);
+RWStructuredBuffer<uint> cluster_indices : register(u10, space0);
+
+[[vk::push_constant]]
+ConstantBuffer<GLTFCullConstants> consts : register(b0);
+
+// Storage buffers are read a word at a time so 16-bit indices come in pairs
+uint load_index(uint index_type, uint index)
+{
+    if (index_type == GLTF_INDEX_TYPE_UINT32)
+    {
+        return pool_indices.Load(index * 4);
+    }
+    uint word = pool_indices.Load((index * 2) & ~3u);
+    return (index & 1) ? (word >> 16) : (word & 0xFFFF);
+}
+
+// Runs after the instance cull of the same phase. Every cluster of an
+// instance that drew is tested on its own and the indices of survivors are
+// appended to the instance's draw.
+[numthreads(GLTF_CLUSTER_CULL_GROUP_SIZE, 1, 1)]
+void comp(uint3 thread_id : SV_DispatchThreadID)
+{
+    uint idx = thread_id.x;
+    if (idx >= consts.cluster_count)
+    {
+        return;
+    }
+
+    GLTFClusterData cluster = clusters[idx];
+    uint draw = instance_draws[cluster.instance];
+    if (draw == GLTF_NO_DRAW)
+    {
+        return;
+    }
+
+    float4x4 m = instances[cluster.instance].m;
+
+    // Rows of the instance matrix are the object's basis vectors
+    float3 center = mul(float4(cluster.bounds.xyz, 1.0), m).xyz;
+    float3 scales =
+        float3(length(m[0].xyz), length(m[1].xyz), length(m[2].xyz));
+    float scale = max(max(scales.x, scales.y), scales.z);
+    float radius = cluster.bounds.w * scale;
+
+    bool visible = true;
+    [unroll]
+    for (uint i = 0; i < GLTF_FRUSTUM_PLANE_COUNT; ++i)
+    {
+        float4 plane = consts.frustum_planes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius)
+        {
+            visible = false;
+        }
+    }
+
+    // Only count culling once per frame
+    bool count = consts.phase != GLTF_CULL_PHASE_EARLY;
+    if (!visible)
+    {
+        if (count)
+        {
+            InterlockedAdd(stats[0].clusters_frustum_culled, 1);
+        }
+        return;
+    }
+
+    // Non-uniform scale skews normals so the cone no longer bounds them
+    bool uniform = max(abs(scales.x - scales.y), abs(scales.x - scales.z)) <=
+                   scale * 0.001;
+    if (uniform)
+    {
+        float3 axis = normalize(mul(float4(cluster.cone.xyz, 0.0), m).xyz);
+        float3 view = center - camera_data.view_pos;
+        // Every triangle faces away from anywhere in the bounding sphere
+        if (dot(view, axis) >= cluster.cone.w * length(view) + radius)
+        {
+            if (count)
+            {
+                InterlockedAdd(stats[0].clusters_backface_culled, 1);
+            }
+            return;
+        }
+    }
+
+    uint offset = 0;
+    InterlockedAdd(draws[draw].index_count, cluster.index_count, offset);
+    uint dst = draws[draw].first_index + offset;
+    for (uint i = 0; i < cluster.index_count; ++i)
+    {
+        cluster_indices[dst + i] =
+            load_index(cluster.index_type, cluster.first_index + i);
+    }
+}
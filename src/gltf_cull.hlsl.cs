@@ -0,0 +1,157 @@
+#include "common.hlsli"
+#include "gltf.hlsli"
+
+StructuredBuffer<GLTFInstanceData> instances : register(t0, space0);
+RWStructuredBuffer<GLTFDrawCommand> draws : register(u1, space0);
+RWStructuredBuffer<uint> draw_counts : register(u2, space0); // One per bucket
+ConstantBuffer<CommonCameraData> camera_data : register(b3, space0);
+RWStructuredBuffer<uint> visibility : register(u4, space0); // Last frame's result
+Texture2D<float> hiz : register(t5, space0);
+RWStructuredBuffer<GLTFCullStats> stats : register(u6, space0);
+// Where each clustered instance's draw landed for the cluster pass
+RWStructuredBuffer<uint> instance_draws : register(u7, space0);
+
+[[vk::push_constant]]
+ConstantBuffer<GLTFCullConstants> consts : register(b0);
+
+// Tests the screen rect of the sphere's bounding box against the pyramid
+bool occluded(float3 center, float radius)
+{
+    float2 rect_min = 1.0;
+    float2 rect_max = -1.0;
+    float nearest = 0.0;
+
+    [unroll]
+    for (uint i = 0; i < 8; ++i)
+    {
+        float3 corner = center + radius * float3((i & 1) ? 1.0 : -1.0,
+                                                 (i & 2) ? 1.0 : -1.0,
+                                                 (i & 4) ? 1.0 : -1.0);
+        float4 clip = mul(float4(corner, 1.0), camera_data.vp);
+
+        // Bounds that cross the near plane can't be projected safely
+        if (clip.w <= 0.0)
+        {
+            return false;
+        }
+
+        float3 ndc = clip.xyz / clip.w;
+        rect_min = min(rect_min, ndc.xy);
+        rect_max = max(rect_max, ndc.xy);
+        nearest = max(nearest, ndc.z); // Depth is reversed
+    }
+
+    // NDC to texture space; the viewport flips y
+    float2 uv_min = saturate(float2(rect_min.x, -rect_max.y) * 0.5 + 0.5);
+    float2 uv_max = saturate(float2(rect_max.x, -rect_min.y) * 0.5 + 0.5);
+
+    // Pick the level where the rect covers at most 2x2 texels
+    float2 hiz_size = float2(consts.hiz_width, consts.hiz_height);
+    float2 extent = (uv_max - uv_min) * hiz_size;
+    uint level = (uint)ceil(log2(max(max(extent.x, extent.y), 1.0)));
+    level = min(level, consts.hiz_mip_count - 1);
+
+    uint2 level_size = max(uint2(consts.hiz_width, consts.hiz_height) >> level,
+                           1);
+    int2 lo = (int2)min(uint2(uv_min * level_size), level_size - 1);
+    int2 hi = (int2)min(uint2(uv_max * level_size), level_size - 1);
+
+    float farthest = min(min(hiz.Load(int3(lo.x, lo.y, level)),
+                             hiz.Load(int3(hi.x, lo.y, level))),
+                         min(hiz.Load(int3(lo.x, hi.y, level)),
+                             hiz.Load(int3(hi.x, hi.y, level))));
+
+    return nearest < farthest;
+}
+
+[numthreads(GLTF_CULL_GROUP_SIZE, 1, 1)]
+void comp(uint3 thread_id : SV_DispatchThreadID)
+{
+    uint idx = thread_id.x;
+    if (idx >= consts.instance_count)
+    {
+        return;
+    }
+
+    instance_draws[idx] = GLTF_NO_DRAW;
+
+    // The early phase only redraws what the late phase saw last frame
+    if (consts.phase == GLTF_CULL_PHASE_EARLY && visibility[idx] == 0)
+    {
+        return;
+    }
+
+    GLTFInstanceData instance = instances[idx];
+
+    // Move the bounding sphere to world space
+    // Rows of the instance matrix are the object's basis vectors
+    float3 center = mul(float4(instance.bounds.xyz, 1.0), instance.m).xyz;
+    float scale = max(max(length(instance.m[0].xyz), length(instance.m[1].xyz)),
+                      length(instance.m[2].xyz));
+    float radius = instance.bounds.w * scale;
+
+    bool visible = true;
+    [unroll]
+    for (uint i = 0; i < GLTF_FRUSTUM_PLANE_COUNT; ++i)
+    {
+        float4 plane = consts.frustum_planes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius)
+        {
+            visible = false;
+        }
+    }
+
+    // Only count frustum culling once per frame
+    if (!visible && consts.phase != GLTF_CULL_PHASE_EARLY)
+    {
+        InterlockedAdd(stats[0].frustum_culled, 1);
+    }
+
+    if (visible && consts.phase == GLTF_CULL_PHASE_LATE &&
+        occluded(center, radius))
+    {
+        InterlockedAdd(stats[0].occlusion_culled, 1);
+        visible = false;
+    }
+
+    if (consts.phase == GLTF_CULL_PHASE_LATE)
+    {
+        visibility[idx] = visible ? 1 : 0;
+    }
+
+    if (!visible)
+    {
+        return;
+    }
+
+    if (consts.phase == GLTF_CULL_PHASE_EARLY)
+    {
+        InterlockedAdd(stats[0].prepass_draws, 1);
+    }
+    else
+    {
+        InterlockedAdd(stats[0].main_draws, 1);
+    }
+
+    bool clustered = instance.cluster_count > 0;
+    uint bucket = instance.perm * GLTF_DRAW_BUCKET_COUNT +
+                  (clustered ? GLTF_DRAW_BUCKET_CLUSTERS : instance.index_type);
+    uint slot = 0;
+    InterlockedAdd(draw_counts[bucket], 1, slot);
+    uint draw = bucket * consts.instance_count + slot;
+
+    // The cluster pass appends the indices of every cluster that survives
+    GLTFDrawCommand cmd;
+    cmd.index_count = clustered ? 0 : instance.index_count;
+    cmd.instance_count = 1;
+    cmd.first_index =
+        clustered ? instance.cluster_index_offset : instance.first_index;
+    cmd.vertex_offset = instance.vertex_offset;
+    cmd.first_instance = idx;
+    draws[draw] = cmd;
+
+    if (clustered)
+    {
+        instance_draws[idx] = draw;
+    }
+}
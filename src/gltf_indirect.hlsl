@@ -0,0 +1,3 @@
+#define GLTF_BINDLESS
+#define GLTF_INDIRECT
+#include "gltf.hlsl"
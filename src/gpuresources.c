@@ -2,9 +2,19 @@
 
 #include "allocator.h"
 #include "cpuresources.h"
+#include "hash.h"
+#include "imagedecode.h"
+#include "jobs.h"
+#include "meshimport.h"
+#include "meshpool.h"
+#include "pipelines.h"
 #include "profiling.h"
+#include "textureimport.h"
+#include "vfs.h"
 
-#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
 #include <cgltf.h>
 #include <ktx.h>
 #include <volk.h>
@@ -12,8 +22,10 @@
 #include <vk_mem_alloc.h>
 
 #include <assert.h>
+#include <math.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 int32_t create_gpubuffer(VmaAllocator allocator, uint64_t size,
                          int32_t mem_usage, int32_t buf_usage, GPUBuffer *out) {
@@ -140,98 +152,84 @@ int32_t create_gpumesh(VmaAllocator allocator, const CPUMesh *src_mesh,
   return err;
 }
 
-int32_t create_gpumesh_cgltf(VmaAllocator vma_alloc, Allocator tmp_alloc,
-                             const cgltf_mesh *src_mesh, GPUMesh *dst_mesh) {
-  TracyCZoneN(prof_e, "create_gpumesh_cgltf", true);
-  assert(src_mesh->primitives_count == 1);
-  cgltf_primitive *prim = &src_mesh->primitives[0];
+int32_t create_pooledmesh_cgltf(VmaAllocator vma_alloc, Allocator std_alloc,
+                                Allocator tmp_alloc, MeshPool *pool,
+                                const char *cache_dir,
+                                const cgltf_mesh *src_mesh,
+                                PooledMesh *dst_mesh) {
+  TracyCZoneN(prof_e, "create_pooledmesh_cgltf", true);
+
+  MeshImport import = {0};
+  if (import_mesh_cgltf_cached(tmp_alloc, cache_dir, src_mesh, &import) != 0) {
+    TracyCZoneEnd(prof_e);
+    return -1;
+  }
 
-  cgltf_accessor *indices = prim->indices;
+  int32_t err =
+      create_pooledmesh_import(vma_alloc, std_alloc, pool, &import, dst_mesh);
+  destroy_mesh_import(tmp_alloc, &import);
 
-  uint32_t index_count = indices->count;
-  uint32_t vertex_count = prim->attributes[0].data->count;
+  TracyCZoneEnd(prof_e);
+  return err;
+}
 
-  size_t index_size = indices->buffer_view->size;
-  size_t geom_size = 0;
-  for (uint32_t i = 0; i < prim->attributes_count; ++i) {
-    cgltf_accessor *attr = prim->attributes[i].data;
-    geom_size += attr->buffer_view->size;
+int32_t create_pooledmesh_import(VmaAllocator vma_alloc, Allocator std_alloc,
+                                 MeshPool *pool, const MeshImport *import,
+                                 PooledMesh *dst_mesh) {
+  TracyCZoneN(prof_e, "create_pooledmesh_import", true);
+
+  PooledMesh mesh = {
+      .bounds = import->bounds,
+      .dequant = import->dequant,
+      .lod_count = import->lod_count,
+      .submesh_count = import->submesh_count,
+      .submeshes = hb_alloc_nm_tp(std_alloc, import->submesh_count, Submesh),
+      .cluster_count = import->cluster_count,
+      .clusters =
+          hb_alloc_nm_tp(std_alloc, import->cluster_count, MeshCluster),
+      .idx_size = import->idx_size,
+  };
+  memcpy(mesh.lod_errors, import->lod_errors, sizeof(mesh.lod_errors));
+  memcpy(mesh.submeshes, import->submeshes,
+         import->submesh_count * sizeof(Submesh));
+  memcpy(mesh.clusters, import->clusters,
+         import->cluster_count * sizeof(MeshCluster));
+  if (meshpool_alloc(pool, import->index_type, import->index_count,
+                     import->vertex_count, &mesh) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Mesh pool is out of space");
+    assert(0);
+    hb_free(std_alloc, mesh.submeshes);
+    hb_free(std_alloc, mesh.clusters);
+    TracyCZoneEnd(prof_e);
+    return -2;
   }
 
-  size_t size = index_size + geom_size;
-
-  GPUBuffer host_buffer = {0};
   VkResult err =
-      create_gpubuffer(vma_alloc, size, VMA_MEMORY_USAGE_CPU_TO_GPU,
-                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &host_buffer);
+      create_gpubuffer(vma_alloc, import->size, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &mesh.host);
   assert(err == VK_SUCCESS);
 
-  GPUBuffer device_buffer = {0};
-  err = create_gpubuffer(vma_alloc, size, VMA_MEMORY_USAGE_GPU_ONLY,
-                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                             VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                         &device_buffer);
-  assert(err == VK_SUCCESS);
-
-  // Actually copy cube data to cpu local buffer
+  // The import is already in the pool's staging layout
   {
     uint8_t *data = NULL;
-    vmaMapMemory(vma_alloc, host_buffer.alloc, (void **)&data);
-
-    size_t offset = 0;
-    // Copy Index Data
-    {
-      cgltf_buffer_view *view = indices->buffer_view;
-      size_t index_offset = indices->offset + view->offset;
-      size_t index_size = view->size;
-
-      void *index_data = ((uint8_t *)view->buffer->data) + index_offset;
-      memcpy(data, index_data, index_size);
-      offset += index_size;
-    }
-
-    // Reorder attributes
-    uint32_t *attr_order =
-        hb_alloc(tmp_alloc, sizeof(uint32_t) * prim->attributes_count);
-    for (uint32_t i = 0; i < prim->attributes_count; ++i) {
-      cgltf_attribute_type attr_type = prim->attributes[i].type;
-      if (attr_type == cgltf_attribute_type_position) {
-        attr_order[0] = i;
-      } else if (attr_type == cgltf_attribute_type_normal) {
-        attr_order[1] = i;
-      } else if (attr_type == cgltf_attribute_type_tangent) {
-        attr_order[3] = i;
-      } else if (attr_type == cgltf_attribute_type_texcoord) {
-        attr_order[2] = i;
-      }
-    }
-
-    for (uint32_t i = 0; i < prim->attributes_count; ++i) {
-      uint32_t attr_idx = attr_order[i];
-      cgltf_attribute *attr = &prim->attributes[attr_idx];
-      cgltf_accessor *accessor = attr->data;
-      cgltf_buffer_view *view = accessor->buffer_view;
-
-      size_t attr_offset = view->offset + accessor->offset;
-      size_t attr_size = accessor->stride * accessor->count;
-
-      void *attr_data = ((uint8_t *)view->buffer->data) + attr_offset;
-      memcpy(data + offset, attr_data, attr_size);
-      offset += attr_size;
-    }
-    hb_free(tmp_alloc, attr_order);
-
-    vmaUnmapMemory(vma_alloc, host_buffer.alloc);
+    vmaMapMemory(vma_alloc, mesh.host.alloc, (void **)&data);
+    memcpy(data, import->data, import->size);
+    vmaUnmapMemory(vma_alloc, mesh.host.alloc);
   }
 
-  *dst_mesh =
-      (GPUMesh){index_count, vertex_count, VK_INDEX_TYPE_UINT16, size,
-                index_size,  geom_size,    host_buffer,          device_buffer};
+  *dst_mesh = mesh;
   TracyCZoneEnd(prof_e);
   return err;
 }
 
+void destroy_pooledmesh(VmaAllocator vma_alloc, Allocator std_alloc,
+                        MeshPool *pool, PooledMesh *mesh) {
+  meshpool_free(pool, mesh);
+  destroy_gpubuffer(vma_alloc, &mesh->host);
+  hb_free(std_alloc, mesh->submeshes);
+  hb_free(std_alloc, mesh->clusters);
+}
+
 void destroy_gpumesh(VmaAllocator allocator, const GPUMesh *mesh) {
   destroy_gpubuffer(allocator, &mesh->host);
   destroy_gpubuffer(allocator, &mesh->gpu);
@@ -261,38 +259,6 @@ void destroy_gpuimage(VmaAllocator allocator, const GPUImage *image) {
   vmaDestroyImage(allocator, image->image, image->alloc);
 }
 
-SDL_Surface *load_and_transform_image(const char *filename) {
-  TracyCZoneN(prof_e, "load_and_transform_image", true);
-  SDL_Surface *img = IMG_Load(filename);
-  assert(img);
-
-  SDL_PixelFormat *opt_fmt = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
-
-  SDL_Surface *opt_img = SDL_ConvertSurface(img, opt_fmt, 0);
-  SDL_FreeSurface(img);
-
-  TracyCZoneEnd(prof_e);
-  return opt_img;
-}
-
-SDL_Surface *parse_and_transform_image(const uint8_t *data, size_t size) {
-  SDL_RWops *ops = SDL_RWFromMem((void *)data, size);
-  SDL_Surface *img = IMG_Load_RW(ops, 0);
-  if (!img) {
-    const char *err = IMG_GetError();
-    (void)err;
-    assert(false);
-    return NULL;
-  }
-
-  SDL_PixelFormat *opt_fmt = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
-
-  SDL_Surface *opt_img = SDL_ConvertSurface(img, opt_fmt, 0);
-  SDL_FreeSurface(img);
-
-  return opt_img;
-}
-
 static VkImageType get_ktx2_image_type(const ktxTexture2 *t) {
   return (VkImageType)(t->numDimensions - 1);
 }
@@ -364,10 +330,76 @@ static ktx_error_code_e ktx2_optimal_tiling_callback(
   return KTX_SUCCESS;
 }
 
+// Every format of a family has to be filterable for it to count
+static bool formats_sampleable(VkPhysicalDevice gpu, const VkFormat *formats,
+                               uint32_t format_count) {
+  const VkFormatFeatureFlags needed =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  for (uint32_t i = 0; i < format_count; ++i) {
+    VkFormatProperties props = {0};
+    vkGetPhysicalDeviceFormatProperties(gpu, formats[i], &props);
+    if ((props.optimalTilingFeatures & needed) != needed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t query_texture_format_caps(
+    VkPhysicalDevice gpu, const VkPhysicalDeviceFeatures *enabled_features) {
+  // Transcoding picks sRGB or UNORM by the texture's transfer function so
+  // both variants are checked where there are two
+  static const struct {
+    uint32_t cap;
+    VkFormat formats[2];
+  } families[] = {
+      {TEXTURE_FORMAT_ASTC,
+       {VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK}},
+      {TEXTURE_FORMAT_BC1,
+       {VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK}},
+      {TEXTURE_FORMAT_BC4, {VK_FORMAT_BC4_UNORM_BLOCK}},
+      {TEXTURE_FORMAT_BC5, {VK_FORMAT_BC5_UNORM_BLOCK}},
+      {TEXTURE_FORMAT_BC7,
+       {VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK}},
+      {TEXTURE_FORMAT_ETC2_RGB,
+       {VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK}},
+      {TEXTURE_FORMAT_ETC2_RGBA,
+       {VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,
+        VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK}},
+      {TEXTURE_FORMAT_EAC_R11, {VK_FORMAT_EAC_R11_UNORM_BLOCK}},
+      {TEXTURE_FORMAT_EAC_RG11, {VK_FORMAT_EAC_R11G11_UNORM_BLOCK}},
+  };
+
+  uint32_t enabled = 0;
+  if (enabled_features->textureCompressionASTC_LDR) {
+    enabled |= TEXTURE_FORMAT_ASTC;
+  }
+  if (enabled_features->textureCompressionBC) {
+    enabled |= TEXTURE_FORMAT_BC1 | TEXTURE_FORMAT_BC4 | TEXTURE_FORMAT_BC5 |
+               TEXTURE_FORMAT_BC7;
+  }
+  if (enabled_features->textureCompressionETC2) {
+    enabled |= TEXTURE_FORMAT_ETC2_RGB | TEXTURE_FORMAT_ETC2_RGBA |
+               TEXTURE_FORMAT_EAC_R11 | TEXTURE_FORMAT_EAC_RG11;
+  }
+
+  uint32_t caps = 0;
+  for (uint32_t i = 0; i < SDL_arraysize(families); ++i) {
+    uint32_t format_count = families[i].formats[1] ? 2 : 1;
+    if ((enabled & families[i].cap) &&
+        formats_sampleable(gpu, families[i].formats, format_count)) {
+      caps |= families[i].cap;
+    }
+  }
+  return caps;
+}
+
 GPUTexture load_ktx2_texture(VkDevice device, VmaAllocator vma_alloc,
                              Allocator *tmp_alloc,
                              const VkAllocationCallbacks *vk_alloc,
-                             const char *file_path, VmaPool up_pool,
+                             const char *file_path, const char *cache_dir,
+                             uint32_t format_caps, VmaPool up_pool,
                              VmaPool tex_pool) {
   TracyCZoneN(prof_e, "load_ktx2_texture", true);
   GPUTexture t = {0};
@@ -396,6 +428,24 @@ GPUTexture load_ktx2_texture(VkDevice device, VmaAllocator vma_alloc,
     file->close(file);
   }
 
+  // Simple 2D textures go through an import so they can be cached
+  {
+    TextureImport import = {0};
+    int32_t err = import_texture_ktx2(*tmp_alloc, cache_dir, mem, size,
+                                      format_caps, &import);
+    if (err != -2) {
+      if (err == 0) {
+        err = create_gputexture_import(device, vma_alloc, vk_alloc, &import,
+                                       up_pool, tex_pool, &t);
+        destroy_texture_import(*tmp_alloc, &import);
+      }
+      assert(err == 0);
+      hb_free(*tmp_alloc, mem);
+      TracyCZoneEnd(prof_e);
+      return t;
+    }
+  }
+
   ktxTextureCreateFlags flags = KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT;
   ktxTexture2 *ktx = NULL;
   {
@@ -410,8 +460,9 @@ GPUTexture load_ktx2_texture(VkDevice device, VmaAllocator vma_alloc,
 
     bool needs_transcoding = ktxTexture2_NeedsTranscoding(ktx);
     if (needs_transcoding) {
-      // TODO: pre-calculate the best format for the platform
-      err = ktxTexture2_TranscodeBasis(ktx, KTX_TTF_BC7_RGBA, 0);
+      ktx_transcode_fmt_e transcode_fmt =
+          (ktx_transcode_fmt_e)select_ktx2_transcode(format_caps, ktx);
+      err = ktxTexture2_TranscodeBasis(ktx, transcode_fmt, 0);
       if (err != KTX_SUCCESS) {
         assert(0);
         TracyCZoneEnd(ktx_transcode_e);
@@ -559,26 +610,79 @@ GPUTexture load_ktx2_texture(VkDevice device, VmaAllocator vma_alloc,
 #endif
   }
 
+  ktxTexture_Destroy(ktxTexture(ktx));
+  hb_free(*tmp_alloc, mem);
+
   TracyCZoneEnd(prof_e);
   return t;
 }
 
-int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
-                     const VkAllocationCallbacks *vk_alloc,
-                     const char *filename, VmaPool up_pool, VmaPool tex_pool,
-                     GPUTexture *t) {
-  TracyCZoneN(prof_e, "load_texture", true);
-  assert(filename);
-  assert(t);
+int32_t load_ktx2_textures(VkDevice device, VmaAllocator vma_alloc,
+                           Allocator *tmp_alloc,
+                           const VkAllocationCallbacks *vk_alloc,
+                           JobSystem *jobs, uint32_t count,
+                           const char *const *file_paths,
+                           const char *cache_dir, uint32_t format_caps,
+                           VmaPool up_pool, VmaPool tex_pool,
+                           GPUTexture *out_textures) {
+  TracyCZoneN(prof_e, "load_ktx2_textures", true);
+  StandardAllocator *allocs =
+      hb_alloc_nm_tp(*tmp_alloc, count, StandardAllocator);
+  TextureImport *imports = hb_alloc_nm_tp(*tmp_alloc, count, TextureImport);
+  int32_t *errs = hb_alloc_nm_tp(*tmp_alloc, count, int32_t);
+  if (!allocs || !imports || !errs) {
+    hb_free(*tmp_alloc, allocs);
+    hb_free(*tmp_alloc, imports);
+    hb_free(*tmp_alloc, errs);
+    TracyCZoneEnd(prof_e);
+    return -1;
+  }
+  SDL_memset(imports, 0, count * sizeof(TextureImport));
+
+  import_textures_ktx2(jobs, cache_dir, format_caps, count, file_paths,
+                       allocs, imports, errs);
+
+  int32_t ret = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    int32_t err = errs[i];
+    if (err == 0) {
+      err = create_gputexture_import(device, vma_alloc, vk_alloc, &imports[i],
+                                     up_pool, tex_pool, &out_textures[i]);
+      destroy_texture_import(allocs[i].alloc, &imports[i]);
+    } else if (err == -2) {
+      // Cubemaps and arrays are rare enough to load the serial way
+      out_textures[i] = load_ktx2_texture(
+          device, vma_alloc, tmp_alloc, vk_alloc, file_paths[i], cache_dir,
+          format_caps, up_pool, tex_pool);
+      err = out_textures[i].view != VK_NULL_HANDLE ? 0 : -1;
+    }
+    if (err != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to load %s",
+                   file_paths[i]);
+      ret = -1;
+    }
+  }
 
-  SDL_Surface *img = load_and_transform_image(filename);
+  hb_free(*tmp_alloc, allocs);
+  hb_free(*tmp_alloc, imports);
+  hb_free(*tmp_alloc, errs);
+  TracyCZoneEnd(prof_e);
+  return ret;
+}
 
+// Creates an RGBA8 texture with mips generated on the GPU and leaves its host
+// buffer mapped so level 0 can be decoded straight into it. The caller unmaps
+// it once the pixels are in.
+static int32_t create_gputexture_mapped(VkDevice device,
+                                        VmaAllocator vma_alloc,
+                                        const VkAllocationCallbacks *vk_alloc,
+                                        uint32_t width, uint32_t height,
+                                        VmaPool up_pool, VmaPool tex_pool,
+                                        GPUTexture *t, uint8_t **out_pixels) {
+  TracyCZoneN(prof_e, "create_gputexture_mapped", true);
   VkResult err = VK_SUCCESS;
 
-  uint32_t img_width = img->w;
-  uint32_t img_height = img->h;
-
-  size_t host_buffer_size = img->pitch * img_height;
+  size_t host_buffer_size = (size_t)width * height * 4;
 
   GPUBuffer host_buffer = {0};
   {
@@ -595,7 +699,7 @@ int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
     assert(err == VK_SUCCESS);
   }
 
-  uint32_t mip_levels = floor(log2(SDL_max(img_width, img_height))) + 1;
+  uint32_t mip_levels = floor(log2(SDL_max(width, height))) + 1;
 
   GPUImage device_image = {0};
   {
@@ -610,9 +714,9 @@ int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
 
     VkImageCreateInfo img_info = {0};
     img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    img_info.imageType = VK_IMAGE_TYPE_2D; // Assuming for now
+    img_info.imageType = VK_IMAGE_TYPE_2D;
     img_info.format = VK_FORMAT_R8G8B8A8_SRGB;
-    img_info.extent = (VkExtent3D){img_width, img_height, 1};
+    img_info.extent = (VkExtent3D){width, height, 1};
     img_info.mipLevels = mip_levels;
     img_info.arrayLayers = 1;
     img_info.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -625,17 +729,6 @@ int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
     assert(err == VK_SUCCESS);
   }
 
-  // Copy data to host buffer
-  {
-    uint8_t *data = NULL;
-    vmaMapMemory(vma_alloc, host_buffer.alloc, (void **)&data);
-
-    memcpy(data, img->pixels, host_buffer_size);
-
-    vmaUnmapMemory(vma_alloc, host_buffer.alloc);
-  }
-
-  // Create Image View
   VkImageView view = VK_NULL_HANDLE;
   {
     VkImageViewCreateInfo create_info = {0};
@@ -647,23 +740,27 @@ int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
         VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1};
     err = vkCreateImageView(device, &create_info, vk_alloc, &view);
     assert(err == VK_SUCCESS);
-  };
+  }
+
+  err = vmaMapMemory(vma_alloc, host_buffer.alloc, (void **)out_pixels);
+  assert(err == VK_SUCCESS);
 
   t->host = host_buffer;
   t->device = device_image;
   t->format = VK_FORMAT_R8G8B8A8_SRGB;
-  t->width = img_width;
-  t->height = img_height;
+  t->width = width;
+  t->height = height;
   t->mip_levels = mip_levels;
   t->gen_mips = mip_levels > 1;
+  t->image_base_level = 0;
   t->layer_count = 1;
   t->view = view;
   t->region_count = 1;
   t->regions[0] = (VkBufferImageCopy){
       .imageExtent =
           {
-              .width = img_width,
-              .height = img_height,
+              .width = width,
+              .height = height,
               .depth = 1,
           },
       .imageSubresource =
@@ -673,50 +770,240 @@ int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
           },
   };
 
-  SDL_FreeSurface(img);
-
   TracyCZoneEnd(prof_e);
+  return err;
+}
+
+static int32_t create_gputexture_image(VkDevice device, VmaAllocator vma_alloc,
+                                       Allocator *tmp_alloc,
+                                       const VkAllocationCallbacks *vk_alloc,
+                                       const uint8_t *data, size_t size,
+                                       VmaPool up_pool, VmaPool tex_pool,
+                                       GPUTexture *t) {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  if (!image_dimensions(data, size, &width, &height)) {
+    return -1;
+  }
+  uint8_t *pixels = NULL;
+  int32_t err = create_gputexture_mapped(device, vma_alloc, vk_alloc, width,
+                                         height, up_pool, tex_pool, t, &pixels);
+  if (err != 0) {
+    return err;
+  }
+  err = decode_image_rgba8(*tmp_alloc, data, size, width, height,
+                           (size_t)width * 4, pixels);
+  vmaUnmapMemory(vma_alloc, t->host.alloc);
+  if (err != 0) {
+    destroy_texture(device, vma_alloc, vk_alloc, t);
+    *t = (GPUTexture){0};
+  }
+  return err;
+}
 
+int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
+                     Allocator *tmp_alloc,
+                     const VkAllocationCallbacks *vk_alloc,
+                     const char *filename, VmaPool up_pool, VmaPool tex_pool,
+                     GPUTexture *t) {
+  TracyCZoneN(prof_e, "load_texture", true);
+  assert(filename);
+  assert(t);
+
+  VfsFile file = {0};
+  if (!vfs_open(NULL, *tmp_alloc, filename, &file)) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to open %s", filename);
+    TracyCZoneEnd(prof_e);
+    return -1;
+  }
+  int32_t err = create_gputexture_image(device, vma_alloc, tmp_alloc, vk_alloc,
+                                        file.data, file.size, up_pool,
+                                        tex_pool, t);
+  vfs_close(&file);
+
+  TracyCZoneEnd(prof_e);
   return err;
 }
 
+typedef struct ImageDecodeJob {
+  const uint8_t *data;
+  size_t size;
+  uint32_t width;
+  uint32_t height;
+  uint8_t *pixels; // Mapped host buffer, NULL if there is nothing to decode
+  int32_t err;
+} ImageDecodeJob;
+
+static void decode_image_job(void *user_data, uint32_t index) {
+  ImageDecodeJob *job = &((ImageDecodeJob *)user_data)[index];
+  if (!job->pixels) {
+    return;
+  }
+  StandardAllocator alloc = {0};
+  create_standard_allocator(&alloc, "Image Decode Job");
+  job->err = decode_image_rgba8(alloc.alloc, job->data, job->size, job->width,
+                                job->height, (size_t)job->width * 4,
+                                job->pixels);
+  destroy_standard_allocator(alloc);
+}
+
+int32_t load_textures(VkDevice device, VmaAllocator vma_alloc,
+                      Allocator *tmp_alloc,
+                      const VkAllocationCallbacks *vk_alloc, JobSystem *jobs,
+                      uint32_t count, const char *const *file_paths,
+                      VmaPool up_pool, VmaPool tex_pool,
+                      GPUTexture *out_textures) {
+  TracyCZoneN(prof_e, "load_textures", true);
+  VfsFile *files = hb_alloc_nm_tp(*tmp_alloc, count, VfsFile);
+  ImageDecodeJob *decodes = hb_alloc_nm_tp(*tmp_alloc, count, ImageDecodeJob);
+  if (!files || !decodes) {
+    hb_free(*tmp_alloc, files);
+    hb_free(*tmp_alloc, decodes);
+    TracyCZoneEnd(prof_e);
+    return -1;
+  }
+  SDL_memset(files, 0, count * sizeof(VfsFile));
+  vfs_open_many(NULL, jobs, *tmp_alloc, count, file_paths, files);
+
+  // Headers are enough to size every texture, so they are all created here
+  // where vk_alloc may be used and the jobs only decode into mapped memory
+  for (uint32_t i = 0; i < count; ++i) {
+    ImageDecodeJob *decode = &decodes[i];
+    *decode = (ImageDecodeJob){
+        .data = files[i].data,
+        .size = files[i].size,
+        .err = -1,
+    };
+    if (!decode->data || !image_dimensions(decode->data, decode->size,
+                                           &decode->width, &decode->height)) {
+      continue;
+    }
+    if (create_gputexture_mapped(device, vma_alloc, vk_alloc, decode->width,
+                                 decode->height, up_pool, tex_pool,
+                                 &out_textures[i], &decode->pixels) != 0) {
+      decode->pixels = NULL;
+    }
+  }
+
+  job_parallel_for(jobs, count, decode_image_job, decodes);
+
+  int32_t ret = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (decodes[i].pixels) {
+      vmaUnmapMemory(vma_alloc, out_textures[i].host.alloc);
+      if (decodes[i].err != 0) {
+        destroy_texture(device, vma_alloc, vk_alloc, &out_textures[i]);
+        out_textures[i] = (GPUTexture){0};
+      }
+    }
+    if (decodes[i].err != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to load %s",
+                   file_paths[i]);
+      ret = -1;
+    }
+    vfs_close(&files[i]);
+  }
+
+  hb_free(*tmp_alloc, files);
+  hb_free(*tmp_alloc, decodes);
+  TracyCZoneEnd(prof_e);
+  return ret;
+}
+
+static const uint8_t ktx2_identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n',
+};
+
+static bool is_ktx2(const uint8_t *data, size_t size) {
+  return size >= sizeof(ktx2_identifier) &&
+         memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0;
+}
+
+// The encoded image a texture points at
+static const uint8_t *image_data_cgltf(const cgltf_texture *gltf,
+                                       const uint8_t *bin, size_t *size) {
+  cgltf_buffer_view *image_view = gltf->image->buffer_view;
+  cgltf_buffer *image_data = image_view->buffer;
+  const uint8_t *data = (uint8_t *)(image_view->buffer) + image_view->offset;
+
+  if (image_data->uri == NULL) {
+    data = bin + image_view->offset;
+  }
+
+  *size = image_view->size;
+  return data;
+}
+
 int32_t create_gputexture_cgltf(VkDevice device, VmaAllocator vma_alloc,
+                                Allocator *tmp_alloc,
                                 const VkAllocationCallbacks *vk_alloc,
                                 const cgltf_texture *gltf, const uint8_t *bin,
                                 VmaPool up_pool, VmaPool tex_pool,
                                 GPUTexture *t) {
   TracyCZoneN(prof_e, "create_gputexture_cgltf", true);
-  cgltf_buffer_view *image_view = gltf->image->buffer_view;
-  cgltf_buffer *image_data = image_view->buffer;
-  const uint8_t *data = (uint8_t *)(image_view->buffer) + image_view->offset;
+  size_t size = 0;
+  const uint8_t *data = image_data_cgltf(gltf, bin, &size);
+  int32_t err = create_gputexture_image(device, vma_alloc, tmp_alloc, vk_alloc,
+                                        data, size, up_pool, tex_pool, t);
+  TracyCZoneEnd(prof_e);
+  return err;
+}
 
-  if (image_data->uri == NULL) {
-    data = bin + image_view->offset;
+uint64_t image_key_cgltf(const cgltf_texture *gltf, const uint8_t *bin) {
+  size_t size = 0;
+  const uint8_t *data = image_data_cgltf(gltf, bin, &size);
+  return hash64(data, size, 0);
+}
+
+int32_t import_texture_cgltf_cached(Allocator alloc, const char *cache_dir,
+                                    const cgltf_texture *gltf,
+                                    const uint8_t *bin, uint64_t image_key,
+                                    uint32_t format_caps,
+                                    TextureImport *out_import) {
+  size_t size = 0;
+  const uint8_t *data = image_data_cgltf(gltf, bin, &size);
+  if (is_ktx2(data, size)) {
+    return import_texture_ktx2(alloc, cache_dir, data, size, format_caps,
+                               out_import);
   }
 
-  size_t size = image_view->size;
+  uint64_t key = texture_import_key(image_key, VK_FORMAT_R8G8B8A8_SRGB);
+  if (load_cached_texture_import(alloc, cache_dir, key, out_import)) {
+    return 0;
+  }
+  TracyCZoneN(prof_e, "decode_image_cgltf", true);
+  int32_t err = import_texture_image(alloc, data, size, out_import);
+  TracyCZoneEnd(prof_e);
+  if (err != 0) {
+    return err;
+  }
+  save_cached_texture_import(cache_dir, key, out_import);
+  return 0;
+}
 
-  SDL_Surface *image = parse_and_transform_image(data, size);
-  uint32_t image_width = image->w;
-  uint32_t image_height = image->h;
-  uint8_t *image_pixels = image->pixels;
-  size_t image_size = image->pitch * image_height;
+int32_t create_gputexture_rgba8(VkDevice device, VmaAllocator vma_alloc,
+                                const VkAllocationCallbacks *vk_alloc,
+                                uint32_t width, uint32_t height,
+                                const uint8_t *pixels, VmaPool up_pool,
+                                VmaPool tex_pool, GPUTexture *t) {
+  TracyCZoneN(prof_e, "create_gputexture_rgba8", true);
+  size_t image_size = (size_t)width * height * 4;
 
   TextureMip mip = {
-      image_width,
-      image_height,
+      width,
+      height,
       1,
-      image_pixels,
+      pixels,
   };
 
   TextureLayer layer = {
-      image_width,
-      image_height,
+      width,
+      height,
       1,
       &mip,
   };
   CPUTexture cpu_tex = {
-      1, 1, &layer, image_size, image_pixels,
+      1, 1, &layer, image_size, pixels,
   };
   int32_t err = create_texture(device, vma_alloc, vk_alloc, &cpu_tex, up_pool,
                                tex_pool, t, true);
@@ -724,6 +1011,109 @@ int32_t create_gputexture_cgltf(VkDevice device, VmaAllocator vma_alloc,
   return err;
 }
 
+int32_t create_gputexture_import(VkDevice device, VmaAllocator vma_alloc,
+                                 const VkAllocationCallbacks *vk_alloc,
+                                 const TextureImport *import, VmaPool up_pool,
+                                 VmaPool tex_pool, GPUTexture *t) {
+  TracyCZoneN(prof_e, "create_gputexture_import", true);
+  assert(import->level_count <= MAX_REGION_COUNT);
+  VkResult err = VK_SUCCESS;
+
+  VkFormat format = (VkFormat)import->format;
+  uint32_t img_width = import->width;
+  uint32_t img_height = import->height;
+  uint32_t mip_levels = import->level_count;
+
+  GPUBuffer host_buffer = {0};
+  {
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = import->size;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VmaAllocationCreateInfo alloc_create_info = {0};
+    alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    alloc_create_info.pool = up_pool;
+    VmaAllocationInfo alloc_info = {0};
+    err = vmaCreateBuffer(vma_alloc, &buffer_create_info, &alloc_create_info,
+                          &host_buffer.buffer, &host_buffer.alloc, &alloc_info);
+    assert(err == VK_SUCCESS);
+  }
+
+  GPUImage device_image = {0};
+  {
+    VkImageCreateInfo img_info = {0};
+    img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    img_info.imageType = VK_IMAGE_TYPE_2D;
+    img_info.format = format;
+    img_info.extent = (VkExtent3D){img_width, img_height, 1};
+    img_info.mipLevels = mip_levels;
+    img_info.arrayLayers = 1;
+    img_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    img_info.usage =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VmaAllocationCreateInfo alloc_info = {0};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.pool = tex_pool;
+    err = create_gpuimage(vma_alloc, &img_info, &alloc_info, &device_image);
+    assert(err == VK_SUCCESS);
+  }
+
+  VkImageView view = VK_NULL_HANDLE;
+  {
+    VkImageViewCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    create_info.image = device_image.image;
+    create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format = format;
+    create_info.subresourceRange = (VkImageSubresourceRange){
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1};
+    err = vkCreateImageView(device, &create_info, vk_alloc, &view);
+    assert(err == VK_SUCCESS);
+  }
+
+  // Copy data to host buffer
+  {
+    uint8_t *data = NULL;
+    vmaMapMemory(vma_alloc, host_buffer.alloc, (void **)&data);
+    memcpy(data, import->data, import->size);
+    vmaUnmapMemory(vma_alloc, host_buffer.alloc);
+  }
+
+  t->host = host_buffer;
+  t->device = device_image;
+  t->format = format;
+  t->width = img_width;
+  t->height = img_height;
+  t->mip_levels = mip_levels;
+  t->gen_mips = false;
+  t->image_base_level = 0;
+  t->layer_count = 1;
+  t->view = view;
+  t->region_count = mip_levels;
+  for (uint32_t i = 0; i < mip_levels; ++i) {
+    t->region_sizes[i] = import->level_sizes[i];
+    t->regions[i] = (VkBufferImageCopy){
+        .bufferOffset = import->level_offsets[i],
+        .imageExtent =
+            {
+                .width = SDL_max(img_width >> i, 1),
+                .height = SDL_max(img_height >> i, 1),
+                .depth = 1,
+            },
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = i,
+                .layerCount = 1,
+            },
+    };
+  }
+
+  TracyCZoneEnd(prof_e);
+  return err;
+}
+
 int32_t create_texture(VkDevice device, VmaAllocator vma_alloc,
                        const VkAllocationCallbacks *vk_alloc,
                        const CPUTexture *tex, VmaPool up_pool, VmaPool tex_pool,
@@ -816,6 +1206,7 @@ int32_t create_texture(VkDevice device, VmaAllocator vma_alloc,
   t->height = img_height;
   t->mip_levels = desired_mip_levels;
   t->gen_mips = gen_mips;
+  t->image_base_level = 0;
   t->layer_count = tex->layer_count;
   t->view = view;
   t->region_count = 1;
@@ -837,6 +1228,71 @@ int32_t create_texture(VkDevice device, VmaAllocator vma_alloc,
   return err;
 }
 
+int32_t resize_texture_image(VkDevice device, VmaAllocator vma_alloc,
+                             const VkAllocationCallbacks *vk_alloc,
+                             VmaPool tex_pool, uint32_t base_level,
+                             GPUTexture *t, GPUImage *out_old_image,
+                             VkImageView *out_old_view) {
+  TracyCZoneN(prof_e, "resize_texture_image", true);
+  assert(t->layer_count == 1 && !t->gen_mips);
+  assert(base_level < t->mip_levels);
+
+  VkFormat format = (VkFormat)t->format;
+  uint32_t level_count = t->mip_levels - base_level;
+
+  // Running out of device memory is expected here since this is how the
+  // texture budget is enforced. The texture just keeps its current image.
+  GPUImage device_image = {0};
+  {
+    VkImageCreateInfo img_info = {0};
+    img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    img_info.imageType = VK_IMAGE_TYPE_2D;
+    img_info.format = format;
+    img_info.extent = (VkExtent3D){SDL_max(t->width >> base_level, 1),
+                                   SDL_max(t->height >> base_level, 1), 1};
+    img_info.mipLevels = level_count;
+    img_info.arrayLayers = 1;
+    img_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    img_info.usage =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VmaAllocationCreateInfo alloc_info = {0};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.pool = tex_pool;
+    VmaAllocationInfo out_info = {0};
+    VkResult err =
+        vmaCreateImage(vma_alloc, &img_info, &alloc_info, &device_image.image,
+                       &device_image.alloc, &out_info);
+    if (err != VK_SUCCESS) {
+      TracyCZoneEnd(prof_e);
+      return (int32_t)err;
+    }
+  }
+
+  VkImageView view = VK_NULL_HANDLE;
+  {
+    VkImageViewCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    create_info.image = device_image.image;
+    create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format = format;
+    create_info.subresourceRange = (VkImageSubresourceRange){
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1};
+    VkResult err = vkCreateImageView(device, &create_info, vk_alloc, &view);
+    assert(err == VK_SUCCESS);
+    (void)err;
+  }
+
+  *out_old_image = t->device;
+  *out_old_view = t->view;
+  t->device = device_image;
+  t->view = view;
+  t->image_base_level = base_level;
+
+  TracyCZoneEnd(prof_e);
+  return 0;
+}
+
 void destroy_texture(VkDevice device, VmaAllocator vma_alloc,
                      const VkAllocationCallbacks *vk_alloc,
                      const GPUTexture *t) {
@@ -1005,26 +1461,62 @@ void destroy_gpupipeline(VkDevice device, Allocator alloc,
   hb_free(alloc, (void *)p);
 }
 
-int32_t create_gpumaterial_cgltf(VkDevice device, VmaAllocator vma_alloc,
-                                 const VkAllocationCallbacks *vk_alloc,
-                                 const cgltf_material *gltf, const uint8_t *bin,
-                                 GPUMaterial *m) {
-  VkResult err = VK_SUCCESS;
-
-  (void)device;
-  (void)vma_alloc;
-  (void)vk_alloc;
-  (void)gltf;
-  (void)bin;
-  (void)m;
+static uint32_t material_texture_idx(GPUMaterial *m,
+                                     const cgltf_texture_view *view,
+                                     const cgltf_texture *gltf_textures,
+                                     const uint32_t *texture_map) {
+  if (view->texture == NULL) {
+    return GLTF_TEXTURE_NONE;
+  }
 
-  return err;
+  uint32_t idx = texture_map[view->texture - gltf_textures];
+  assert(m->texture_count < MAX_MATERIAL_TEXTURES);
+  m->textures[m->texture_count++] = idx;
+  return idx;
 }
-void destroy_material(VkDevice device, VmaAllocator vma_alloc,
-                      const VkAllocationCallbacks *vk_alloc,
-                      const GPUMaterial *m) {
-  (void)device;
-  (void)vma_alloc;
-  (void)vk_alloc;
-  (void)m;
+
+int32_t create_gpumaterial_cgltf(const cgltf_material *gltf,
+                                 const cgltf_texture *gltf_textures,
+                                 const uint32_t *texture_map, GPUMaterial *m) {
+  TracyCZoneN(prof_e, "create_gpumaterial_cgltf", true);
+
+  *m = (GPUMaterial){
+      .data =
+          {
+              .base_color_factor = {1.0f, 1.0f, 1.0f, 1.0f},
+              .metallic_factor = 1.0f,
+              .roughness_factor = 1.0f,
+              .albedo_idx = GLTF_TEXTURE_NONE,
+              .normal_idx = GLTF_TEXTURE_NONE,
+              .roughness_idx = GLTF_TEXTURE_NONE,
+          },
+      .perm_flags = GLTF_PERM_NONE,
+  };
+
+  if (gltf->has_pbr_metallic_roughness) {
+    const cgltf_pbr_metallic_roughness *pbr = &gltf->pbr_metallic_roughness;
+    m->data.base_color_factor = (float4){
+        pbr->base_color_factor[0],
+        pbr->base_color_factor[1],
+        pbr->base_color_factor[2],
+        pbr->base_color_factor[3],
+    };
+    m->data.metallic_factor = pbr->metallic_factor;
+    m->data.roughness_factor = pbr->roughness_factor;
+    m->data.albedo_idx = material_texture_idx(m, &pbr->base_color_texture,
+                                              gltf_textures, texture_map);
+    m->data.roughness_idx =
+        material_texture_idx(m, &pbr->metallic_roughness_texture,
+                             gltf_textures, texture_map);
+    m->perm_flags |= GLTF_PERM_PBR_METALLIC_ROUGHNESS;
+  }
+
+  m->data.normal_idx = material_texture_idx(m, &gltf->normal_texture,
+                                            gltf_textures, texture_map);
+  if (m->data.normal_idx != GLTF_TEXTURE_NONE) {
+    m->perm_flags |= GLTF_PERM_NORMAL_MAP;
+  }
+
+  TracyCZoneEnd(prof_e);
+  return 0;
 }
@@ -8,6 +8,9 @@
 #include <vulkan/vulkan.h>
 
 #include "allocator.h"
+#include "simd.h"
+
+#include "gltf.hlsli"
 
 typedef struct VmaAllocator_T *VmaAllocator;
 typedef struct VmaAllocation_T *VmaAllocation;
@@ -18,9 +21,14 @@ typedef struct VmaAllocationCreateInfo VmaAllocationCreateInfo;
 typedef struct Allocator Allocator;
 typedef struct CPUMesh CPUMesh;
 typedef struct cgltf_mesh cgltf_mesh;
+typedef struct MeshPool MeshPool;
+typedef struct PooledMesh PooledMesh;
 typedef struct CPUTexture CPUTexture;
 typedef struct cgltf_texture cgltf_texture;
 typedef struct cgltf_material cgltf_material;
+typedef struct MeshImport MeshImport;
+typedef struct TextureImport TextureImport;
+typedef struct JobSystem JobSystem;
 
 typedef struct GPUBuffer {
   VkBuffer buffer;
@@ -59,11 +67,16 @@ typedef struct GPUTexture {
   uint32_t width;
   uint32_t height;
   uint32_t mip_levels;
+  // First level of the full chain that the device image holds. Every other
+  // field, regions included, describes the full chain in host.
+  uint32_t image_base_level;
   bool gen_mips;
   uint32_t layer_count;
   uint32_t format;
   uint32_t region_count;
   VkBufferImageCopy regions[MAX_REGION_COUNT];
+  // Bytes of host each region copies from, where the creator knows them
+  uint64_t region_sizes[MAX_REGION_COUNT];
 } GPUTexture;
 
 typedef struct GPUPipeline {
@@ -76,21 +89,18 @@ typedef struct GPUPipeline {
 #define MAX_MATERIAL_TEXTURES 8
 
 /*
-  TODO: Fiugre out how to best represent materials
-  For now I'm imagining that a material will be able to be implemented
-  mostly with 1 uniform buffer for parameters and up to 8 textures for
-  other resource bindings.
+  Materials don't own any GPU resources. Their parameters are gathered into
+  one material table per scene which shaders index by a per-draw material id.
+  Textures are referred to by their index in the scene's texture array so
+  that they can be looked up either in a bindless texture array or written
+  into a per-material descriptor set.
 */
 typedef struct GPUMaterial {
-  // All material parameters go into one uniform buffer
-  // The uniform buffer takes up location 0
-  size_t consts_size;
-  GPUBuffer host_consts;
-  GPUBuffer gpu_consts;
+  GLTFMaterialData data;
+  uint32_t perm_flags;
 
-  // textures take up locations 1-8 in the descriptor set
   uint32_t texture_count;
-  GPUTexture *textures[MAX_MATERIAL_TEXTURES];
+  uint32_t textures[MAX_MATERIAL_TEXTURES];
 } GPUMaterial;
 
 int32_t create_gpubuffer(VmaAllocator allocator, uint64_t size,
@@ -109,10 +119,24 @@ void destroy_gpuconstbuffer(VkDevice device, VmaAllocator allocator,
 
 int32_t create_gpumesh(VmaAllocator allocator, const CPUMesh *src_mesh,
                        GPUMesh *dst_mesh);
-int32_t create_gpumesh_cgltf(VmaAllocator vma_alloc, Allocator tmp_alloc,
-                             const cgltf_mesh *src_mesh, GPUMesh *dst_mesh);
 void destroy_gpumesh(VmaAllocator allocator, const GPUMesh *mesh);
 
+// Scene meshes are sub-allocated from a MeshPool rather than owning buffers.
+// Imports are cached in cache_dir; pass NULL to always import. The submesh
+// table is allocated from std_alloc.
+int32_t create_pooledmesh_cgltf(VmaAllocator vma_alloc, Allocator std_alloc,
+                                Allocator tmp_alloc, MeshPool *pool,
+                                const char *cache_dir,
+                                const cgltf_mesh *src_mesh,
+                                PooledMesh *dst_mesh);
+// The second half of create_pooledmesh_cgltf for imports that were already
+// made elsewhere, e.g. on a job. The import is left for the caller to free.
+int32_t create_pooledmesh_import(VmaAllocator vma_alloc, Allocator std_alloc,
+                                 MeshPool *pool, const MeshImport *import,
+                                 PooledMesh *dst_mesh);
+void destroy_pooledmesh(VmaAllocator vma_alloc, Allocator std_alloc,
+                        MeshPool *pool, PooledMesh *mesh);
+
 int32_t create_gpuimage(VmaAllocator vma_alloc,
                         const VkImageCreateInfo *img_create_info,
                         const VmaAllocationCreateInfo *alloc_create_info,
@@ -120,25 +144,97 @@ int32_t create_gpuimage(VmaAllocator vma_alloc,
                         GPUImage *i);
 void destroy_gpuimage(VmaAllocator allocator, const GPUImage *image);
 
+// Compressed formats the device can sample as TEXTURE_FORMAT_ bits. A family
+// only counts if its compression feature is in enabled_features, the
+// features the device was created with.
+uint32_t query_texture_format_caps(
+    VkPhysicalDevice gpu, const VkPhysicalDeviceFeatures *enabled_features);
+
+// Basis textures are transcoded to the best format in format_caps for their
+// channel count. Simple 2D textures are cached in cache_dir once transcoded;
+// a NULL cache_dir transcodes every time. The whole chain is staged for one
+// upload; only main scene textures stream their mips in tail first, which
+// includes KTX2 images embedded in a glb.
 GPUTexture load_ktx2_texture(VkDevice device, VmaAllocator vma_alloc,
                              Allocator *tmp_alloc,
                              const VkAllocationCallbacks *vk_alloc,
-                             const char *file_path, VmaPool up_pool,
+                             const char *file_path, const char *cache_dir,
+                             uint32_t format_caps, VmaPool up_pool,
                              VmaPool tex_pool);
+// load_ktx2_texture for many files at once. Files are read and transcoded
+// across jobs; the textures are created on the calling thread since that is
+// the only thread vk_alloc may be used from. Must not be called from inside
+// a job.
+int32_t load_ktx2_textures(VkDevice device, VmaAllocator vma_alloc,
+                           Allocator *tmp_alloc,
+                           const VkAllocationCallbacks *vk_alloc,
+                           JobSystem *jobs, uint32_t count,
+                           const char *const *file_paths,
+                           const char *cache_dir, uint32_t format_caps,
+                           VmaPool up_pool, VmaPool tex_pool,
+                           GPUTexture *out_textures);
 
+// PNG or JPEG decoded as RGBA8 straight into the mapped host buffer, with
+// mips generated on the GPU
 int32_t load_texture(VkDevice device, VmaAllocator vma_alloc,
+                     Allocator *tmp_alloc,
                      const VkAllocationCallbacks *vk_alloc,
                      const char *filename, VmaPool up_pool, VmaPool tex_pool,
                      GPUTexture *t);
+// load_texture for many files at once. Every texture is created and mapped
+// on the calling thread from the image headers, then the images are decoded
+// into them across jobs. Must not be called from inside a job.
+int32_t load_textures(VkDevice device, VmaAllocator vma_alloc,
+                      Allocator *tmp_alloc,
+                      const VkAllocationCallbacks *vk_alloc, JobSystem *jobs,
+                      uint32_t count, const char *const *file_paths,
+                      VmaPool up_pool, VmaPool tex_pool,
+                      GPUTexture *out_textures);
 int32_t create_texture(VkDevice device, VmaAllocator vma_alloc,
                        const VkAllocationCallbacks *vk_alloc,
                        const CPUTexture *tex, VmaPool up_pool, VmaPool tex_pool,
                        GPUTexture *t, bool gen_mips);
 int32_t create_gputexture_cgltf(VkDevice device, VmaAllocator vma_alloc,
+                                Allocator *tmp_alloc,
                                 const VkAllocationCallbacks *vk_alloc,
                                 const cgltf_texture *gltf, const uint8_t *bin,
                                 VmaPool up_pool, VmaPool tex_pool,
                                 GPUTexture *t);
+// Hash of the encoded image so textures shared between glbs can be found
+// without decoding them
+uint64_t image_key_cgltf(const cgltf_texture *gltf, const uint8_t *bin);
+// Decoding and mipping are expensive so the result is cached on disk by
+// image_key, the hash of the encoded image. KTX2 images keep their own levels
+// and go through import_texture_ktx2 with format_caps instead. Only touches
+// the CPU and the cache so it is safe to run on a job as long as alloc is.
+int32_t import_texture_cgltf_cached(Allocator alloc, const char *cache_dir,
+                                    const cgltf_texture *gltf,
+                                    const uint8_t *bin, uint64_t image_key,
+                                    uint32_t format_caps,
+                                    TextureImport *out_import);
+// Tightly packed RGBA8 pixels with mips generated on the GPU
+int32_t create_gputexture_rgba8(VkDevice device, VmaAllocator vma_alloc,
+                                const VkAllocationCallbacks *vk_alloc,
+                                uint32_t width, uint32_t height,
+                                const uint8_t *pixels, VmaPool up_pool,
+                                VmaPool tex_pool, GPUTexture *t);
+// Every level of the import is copied as is so nothing is generated on the
+// GPU
+int32_t create_gputexture_import(VkDevice device, VmaAllocator vma_alloc,
+                                 const VkAllocationCallbacks *vk_alloc,
+                                 const TextureImport *import, VmaPool up_pool,
+                                 VmaPool tex_pool, GPUTexture *t);
+// Moves a single layer texture with all of its levels in host to a new
+// device image holding the chain from base_level on. Nothing is uploaded; the
+// new image is undefined until its levels are copied from host again. The
+// old image and view are handed back for the caller to destroy once nothing
+// in flight samples them. Fails without changing anything when device memory
+// runs out.
+int32_t resize_texture_image(VkDevice device, VmaAllocator vma_alloc,
+                             const VkAllocationCallbacks *vk_alloc,
+                             VmaPool tex_pool, uint32_t base_level,
+                             GPUTexture *t, GPUImage *out_old_image,
+                             VkImageView *out_old_view);
 void destroy_texture(VkDevice device, VmaAllocator vma_alloc,
                      const VkAllocationCallbacks *vk_alloc,
                      const GPUTexture *t);
@@ -159,10 +255,9 @@ void destroy_gpupipeline(VkDevice device, Allocator alloc,
                          const VkAllocationCallbacks *vk_alloc,
                          const GPUPipeline *p);
 
-int32_t create_gpumaterial_cgltf(VkDevice device, VmaAllocator vma_alloc,
-                                 const VkAllocationCallbacks *vk_alloc,
-                                 const cgltf_material *gltf, const uint8_t *bin,
-                                 GPUMaterial *m);
-void destroy_material(VkDevice device, VmaAllocator vma_alloc,
-                      const VkAllocationCallbacks *vk_alloc,
-                      const GPUMaterial *m);
+// gltf_textures is the texture array of the gltf the material came from and
+// texture_map gives where each of those textures is in the scene's texture
+// array
+int32_t create_gpumaterial_cgltf(const cgltf_material *gltf,
+                                 const cgltf_texture *gltf_textures,
+                                 const uint32_t *texture_map, GPUMaterial *m);
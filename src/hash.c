@@ -0,0 +1,170 @@
+#include "hash.h"
+
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+static uint64_t rotl64(uint64_t x, uint32_t r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Unaligned reads; assumes a little endian host like every platform we ship
+static uint64_t read64(const uint8_t *p) {
+  uint64_t v = 0;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v = 0;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static uint64_t hash_merge_round(uint64_t acc, uint64_t val) {
+  acc ^= hash_round(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+  const uint8_t *p = (const uint8_t *)data;
+  const uint8_t *end = p + size;
+  uint64_t h = 0;
+
+  if (size >= 32) {
+    const uint8_t *limit = end - 32;
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    do {
+      v1 = hash_round(v1, read64(p));
+      v2 = hash_round(v2, read64(p + 8));
+      v3 = hash_round(v3, read64(p + 16));
+      v4 = hash_round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = hash_merge_round(h, v1);
+    h = hash_merge_round(h, v2);
+    h = hash_merge_round(h, v3);
+    h = hash_merge_round(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+
+  h += (uint64_t)size;
+
+  while (p + 8 <= end) {
+    h ^= hash_round(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= (*p) * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+void create_hash_index(Allocator alloc, HashIndex *out_index) {
+  *out_index = (HashIndex){.alloc = alloc};
+}
+
+static uint32_t hash_index_slot(const HashIndex *index, uint64_t key) {
+  uint32_t mask = index->capacity - 1;
+  uint32_t slot = (uint32_t)key & mask;
+  while (index->values[slot] != HASH_INDEX_NONE && index->keys[slot] != key) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+uint32_t hash_index_find(const HashIndex *index, uint64_t key) {
+  if (index->capacity == 0) {
+    return HASH_INDEX_NONE;
+  }
+  return index->values[hash_index_slot(index, key)];
+}
+
+// Keeps the load factor at or under a half so probes stay short
+static int32_t hash_index_grow(HashIndex *index) {
+  uint32_t capacity = index->capacity ? index->capacity * 2 : 64;
+  uint64_t *keys = hb_alloc_nm_tp(index->alloc, capacity, uint64_t);
+  uint32_t *values = hb_alloc_nm_tp(index->alloc, capacity, uint32_t);
+  if (!keys || !values) {
+    hb_free(index->alloc, keys);
+    hb_free(index->alloc, values);
+    return -1;
+  }
+  memset(values, 0xFF, capacity * sizeof(uint32_t));
+
+  HashIndex grown = {
+      .alloc = index->alloc,
+      .capacity = capacity,
+      .count = index->count,
+      .keys = keys,
+      .values = values,
+  };
+  for (uint32_t i = 0; i < index->capacity; ++i) {
+    if (index->values[i] == HASH_INDEX_NONE) {
+      continue;
+    }
+    uint32_t slot = hash_index_slot(&grown, index->keys[i]);
+    grown.keys[slot] = index->keys[i];
+    grown.values[slot] = index->values[i];
+  }
+
+  destroy_hash_index(index);
+  *index = grown;
+  return 0;
+}
+
+int32_t hash_index_insert(HashIndex *index, uint64_t key, uint32_t value) {
+  if ((index->count + 1) * 2 > index->capacity &&
+      hash_index_grow(index) != 0) {
+    return -1;
+  }
+
+  uint32_t slot = hash_index_slot(index, key);
+  if (index->values[slot] == HASH_INDEX_NONE) {
+    index->count++;
+  }
+  index->keys[slot] = key;
+  index->values[slot] = value;
+  return 0;
+}
+
+void destroy_hash_index(HashIndex *index) {
+  if (index->capacity > 0) {
+    hb_free(index->alloc, index->keys);
+    hb_free(index->alloc, index->values);
+  }
+  index->capacity = 0;
+  index->count = 0;
+  index->keys = NULL;
+  index->values = NULL;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+// 64-bit XXH64. Fast enough to key caches off of whole asset payloads.
+uint64_t hash64(const void *data, size_t size, uint64_t seed);
+
+#define HASH_INDEX_NONE 0xFFFFFFFF
+
+// Open addressed map from content hashes to array indices. Keys are already
+// well mixed so their low bits pick the slot directly.
+typedef struct HashIndex {
+  Allocator alloc;
+  uint32_t capacity; // Always a power of two, or zero before the first insert
+  uint32_t count;
+  uint64_t *keys;
+  uint32_t *values; // HASH_INDEX_NONE marks an empty slot
+} HashIndex;
+
+void create_hash_index(Allocator alloc, HashIndex *out_index);
+// Returns HASH_INDEX_NONE when the key isn't present
+uint32_t hash_index_find(const HashIndex *index, uint64_t key);
+// Replaces the value of a key that is already present
+int32_t hash_index_insert(HashIndex *index, uint64_t key, uint32_t value);
+void destroy_hash_index(HashIndex *index);
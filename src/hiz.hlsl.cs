@@ -0,0 +1,38 @@
+#include "hiz.hlsli"
+
+// Level 0 reads the depth buffer and every other level reads the one above it
+Texture2D<float> src : register(t0, space0);
+RWTexture2D<float> dst : register(u1, space0);
+
+[[vk::push_constant]]
+ConstantBuffer<HiZConstants> consts : register(b0);
+
+[numthreads(HIZ_GROUP_SIZE, HIZ_GROUP_SIZE, 1)]
+void comp(uint3 thread_id : SV_DispatchThreadID)
+{
+    uint2 src_size = uint2(consts.src_width, consts.src_height);
+    uint2 dst_size = uint2(consts.dst_width, consts.dst_height);
+    uint2 coord = thread_id.xy;
+    if (any(coord >= dst_size))
+    {
+        return;
+    }
+
+    // Every source texel the destination texel overlaps; at most 3x3 since
+    // each level is at least half the size of the one it is built from
+    uint2 lo = (coord * src_size) / dst_size;
+    uint2 hi = ((coord + 1) * src_size + dst_size - 1) / dst_size;
+    hi = min(hi, src_size);
+
+    // Depth is reversed so keep the farthest depth which is the smallest
+    float depth = 1.0;
+    for (uint y = lo.y; y < hi.y; ++y)
+    {
+        for (uint x = lo.x; x < hi.x; ++x)
+        {
+            depth = min(depth, src.Load(int3(x, y, 0)));
+        }
+    }
+
+    dst[coord] = depth;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#define HIZ_GROUP_SIZE 8
+#define HIZ_MAX_MIP_COUNT 16
+
+// Sizes of the level being read and the level being written
+typedef struct HiZConstants {
+  uint32_t src_width;
+  uint32_t src_height;
+  uint32_t dst_width;
+  uint32_t dst_height;
+} HiZConstants;
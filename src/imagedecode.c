@@ -0,0 +1,289 @@
+#include "imagedecode.h"
+
+#include <SDL2/SDL_log.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "profiling.h"
+
+static const uint8_t png_signature[8] = {0x89, 'P',  'N',  'G',
+                                         '\r', '\n', 0x1A, '\n'};
+
+static bool is_png(const uint8_t *data, size_t size) {
+  return size >= sizeof(png_signature) &&
+         memcmp(data, png_signature, sizeof(png_signature)) == 0;
+}
+
+static bool is_jpeg(const uint8_t *data, size_t size) {
+  return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+static uint32_t read_be16(const uint8_t *data) {
+  return ((uint32_t)data[0] << 8) | data[1];
+}
+
+static uint32_t read_be32(const uint8_t *data) {
+  return (read_be16(data) << 16) | read_be16(data + 2);
+}
+
+// IHDR has to be the first chunk so the size is always at the same place
+static bool png_dimensions(const uint8_t *data, size_t size,
+                           uint32_t *out_width, uint32_t *out_height) {
+  if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0) {
+    return false;
+  }
+  *out_width = read_be32(data + 16);
+  *out_height = read_be32(data + 20);
+  return true;
+}
+
+// Walks the markers up to the first start of frame, which holds the size
+static bool jpeg_dimensions(const uint8_t *data, size_t size,
+                            uint32_t *out_width, uint32_t *out_height) {
+  size_t offset = 2;
+  while (offset + 4 <= size) {
+    if (data[offset] != 0xFF) {
+      return false;
+    }
+    uint8_t marker = data[offset + 1];
+    if (marker == 0xFF) {
+      offset++; // Fill byte
+      continue;
+    }
+    offset += 2;
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      continue; // No length follows these
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      return false; // The image ended or started without a frame
+    }
+
+    uint32_t length = read_be16(data + offset);
+    if (length < 2) {
+      return false;
+    }
+    // C4, C8 and CC share the range but are tables, not frames
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+        marker != 0xC8 && marker != 0xCC) {
+      if (offset + 7 > size) {
+        return false;
+      }
+      *out_height = read_be16(data + offset + 3);
+      *out_width = read_be16(data + offset + 5);
+      return true;
+    }
+    offset += length;
+  }
+  return false;
+}
+
+bool image_dimensions(const uint8_t *data, size_t size, uint32_t *out_width,
+                      uint32_t *out_height) {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool ok = false;
+  if (is_png(data, size)) {
+    ok = png_dimensions(data, size, &width, &height);
+  } else if (is_jpeg(data, size)) {
+    ok = jpeg_dimensions(data, size, &width, &height);
+  }
+  if (!ok || width == 0 || height == 0) {
+    return false;
+  }
+  *out_width = width;
+  *out_height = height;
+  return true;
+}
+
+typedef uint8_t __attribute__((vector_size(16))) byte16;
+
+// Four texels per shuffle. Loads are 16 bytes wide so the last few texels,
+// which can't fill one without reading past the row, go the scalar way.
+static void expand_rgb8_rgba8(const uint8_t *src, uint8_t *dst,
+                              uint32_t count) {
+  const byte16 opaque = {
+      0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+      0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  };
+  uint32_t i = 0;
+  for (; i + 6 <= count; i += 4) {
+    byte16 rgb;
+    memcpy(&rgb, src + i * 3, sizeof(rgb));
+    byte16 rgba = __builtin_shufflevector(rgb, opaque, 0, 1, 2, 16, 3, 4, 5,
+                                          16, 6, 7, 8, 16, 9, 10, 11, 16);
+    memcpy(dst + i * 4, &rgba, sizeof(rgba));
+  }
+  for (; i < count; ++i) {
+    dst[i * 4 + 0] = src[i * 3 + 0];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = 0xFF;
+  }
+}
+
+typedef struct PngSource {
+  const uint8_t *data;
+  size_t size;
+  size_t offset;
+} PngSource;
+
+static void png_read_mem(png_structp png, png_bytep out, png_size_t count) {
+  PngSource *src = (PngSource *)png_get_io_ptr(png);
+  if (count > src->size - src->offset) {
+    png_error(png, "Image is truncated");
+  }
+  memcpy(out, src->data + src->offset, count);
+  src->offset += count;
+}
+
+static void png_fail(png_structp png, png_const_charp msg) {
+  SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to decode PNG: %s", msg);
+  png_longjmp(png, 1);
+}
+
+// Mostly complaints about color profiles that don't change the pixels
+static void png_warn(png_structp png, png_const_charp msg) {
+  (void)png;
+  (void)msg;
+}
+
+static int32_t decode_png(Allocator alloc, const uint8_t *data, size_t size,
+                          uint32_t width, uint32_t height, size_t pitch,
+                          uint8_t *dst) {
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL,
+                                           png_fail, png_warn);
+  if (!png) {
+    return -1;
+  }
+  png_infop info = png_create_info_struct(png);
+  if (!info) {
+    png_destroy_read_struct(&png, NULL, NULL);
+    return -1;
+  }
+
+  uint8_t *volatile row = NULL;
+  if (setjmp(png_jmpbuf(png))) {
+    hb_free(alloc, row);
+    png_destroy_read_struct(&png, &info, NULL);
+    return -1;
+  }
+
+  PngSource src = {data, size, 0};
+  png_set_read_fn(png, &src, png_read_mem);
+  png_read_info(png, info);
+  if (png_get_image_width(png, info) != width ||
+      png_get_image_height(png, info) != height) {
+    png_error(png, "Size doesn't match the header");
+  }
+
+  // Everything becomes 8 bit RGB with alpha wherever the image has any
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  uint32_t pass_count = (uint32_t)png_set_interlace_handling(png);
+
+  // Interlaced passes fill in the rows in place, so they have to be RGBA as
+  // they come out of libpng
+  bool has_alpha = (png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA) ||
+                   png_get_valid(png, info, PNG_INFO_tRNS);
+  if (pass_count > 1 && !has_alpha) {
+    png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+  }
+  png_read_update_info(png, info);
+
+  uint32_t channels = png_get_channels(png, info);
+  if (channels == 3) {
+    row = hb_alloc(alloc, (size_t)width * 3);
+    if (!row) {
+      png_error(png, "Out of memory");
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+      png_read_row(png, row, NULL);
+      expand_rgb8_rgba8(row, dst + y * pitch, width);
+    }
+  } else if (channels == 4) {
+    for (uint32_t pass = 0; pass < pass_count; ++pass) {
+      for (uint32_t y = 0; y < height; ++y) {
+        png_read_row(png, dst + y * pitch, NULL);
+      }
+    }
+  } else {
+    png_error(png, "Unsupported channel count");
+  }
+  png_read_end(png, NULL);
+
+  hb_free(alloc, row);
+  png_destroy_read_struct(&png, &info, NULL);
+  return 0;
+}
+
+typedef struct JpegError {
+  struct jpeg_error_mgr mgr;
+  jmp_buf jump;
+} JpegError;
+
+static void jpeg_fail(j_common_ptr cinfo) {
+  char msg[JMSG_LENGTH_MAX] = {0};
+  cinfo->err->format_message(cinfo, msg);
+  SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to decode JPEG: %s", msg);
+  longjmp(((JpegError *)cinfo->err)->jump, 1);
+}
+
+static void jpeg_message(j_common_ptr cinfo) {
+  (void)cinfo;
+}
+
+// libjpeg-turbo converts to RGBA itself with its own SIMD so scanlines go
+// straight to dst
+static int32_t decode_jpeg(const uint8_t *data, size_t size, uint32_t width,
+                           uint32_t height, size_t pitch, uint8_t *dst) {
+  struct jpeg_decompress_struct cinfo = {0};
+  JpegError err = {0};
+  cinfo.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = jpeg_fail;
+  err.mgr.output_message = jpeg_message;
+  if (setjmp(err.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return -1;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, (unsigned char *)data, (unsigned long)size);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_EXT_RGBA;
+  jpeg_start_decompress(&cinfo);
+  if (cinfo.output_width != width || cinfo.output_height != height ||
+      cinfo.output_components != 4) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                 "Failed to decode JPEG: Size doesn't match the header");
+    jpeg_destroy_decompress(&cinfo);
+    return -1;
+  }
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW out_row = dst + (size_t)cinfo.output_scanline * pitch;
+    jpeg_read_scanlines(&cinfo, &out_row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return 0;
+}
+
+int32_t decode_image_rgba8(Allocator alloc, const uint8_t *data, size_t size,
+                           uint32_t width, uint32_t height, size_t pitch,
+                           uint8_t *dst) {
+  TracyCZoneN(ctx, "decode_image_rgba8", true);
+  int32_t err = -1;
+  if (is_png(data, size)) {
+    err = decode_png(alloc, data, size, width, height, pitch, dst);
+  } else if (is_jpeg(data, size)) {
+    err = decode_jpeg(data, size, width, height, pitch, dst);
+  } else {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Image is neither PNG nor JPEG");
+  }
+  TracyCZoneEnd(ctx);
+  return err;
+}
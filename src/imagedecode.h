@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+// Reads the size of a PNG or JPEG out of its header without decoding it, so
+// the buffer it decodes into can be made first
+bool image_dimensions(const uint8_t *data, size_t size, uint32_t *out_width,
+                      uint32_t *out_height);
+
+/*
+  Decodes a PNG or JPEG as RGBA8 straight into dst, one row every pitch
+  bytes. width and height must be what image_dimensions returned. Rows are
+  only ever written front to back, except for interlaced PNGs, so dst may
+  be mapped write combined memory. alloc is only used for scratch. Safe to
+  call from any thread as long as alloc is.
+*/
+int32_t decode_image_rgba8(Allocator alloc, const uint8_t *data, size_t size,
+                           uint32_t width, uint32_t height, size_t pitch,
+                           uint8_t *dst);
@@ -0,0 +1,153 @@
+#include "jobs.h"
+
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <assert.h>
+
+#include "profiling.h"
+
+static void job_run_batch(JobSystem *jobs) {
+  uint32_t count = jobs->count;
+  for (;;) {
+    uint32_t index = (uint32_t)SDL_AtomicAdd(&jobs->next_index, 1);
+    if (index >= count) {
+      break;
+    }
+    jobs->fn(jobs->user_data, index);
+
+    if ((uint32_t)SDL_AtomicAdd(&jobs->done_count, 1) + 1 == count) {
+      SDL_LockMutex(jobs->mutex);
+      SDL_CondBroadcast(jobs->done_cond);
+      SDL_UnlockMutex(jobs->mutex);
+    }
+  }
+}
+
+static int job_worker(void *data) {
+  JobSystem *jobs = (JobSystem *)data;
+  uint32_t seen_generation = 0;
+
+  SDL_LockMutex(jobs->mutex);
+  for (;;) {
+    while (!jobs->quit && jobs->generation == seen_generation) {
+      SDL_CondWait(jobs->work_cond, jobs->mutex);
+    }
+    if (jobs->quit) {
+      break;
+    }
+    seen_generation = jobs->generation;
+    jobs->active_workers++;
+    SDL_UnlockMutex(jobs->mutex);
+
+    job_run_batch(jobs);
+
+    SDL_LockMutex(jobs->mutex);
+    jobs->active_workers--;
+    SDL_CondBroadcast(jobs->done_cond);
+  }
+  SDL_UnlockMutex(jobs->mutex);
+
+  return 0;
+}
+
+int32_t create_job_system(Allocator std_alloc, uint32_t worker_count,
+                          JobSystem *out_jobs) {
+  TracyCZoneN(ctx, "create_job_system", true);
+
+  if (worker_count == UINT32_MAX) {
+    int32_t cpu_count = SDL_GetCPUCount();
+    worker_count = cpu_count > 1 ? (uint32_t)cpu_count - 1 : 0;
+  }
+  if (worker_count > MAX_JOB_WORKERS) {
+    worker_count = MAX_JOB_WORKERS;
+  }
+
+  // Workers hold on to this pointer so the system is built in place
+  JobSystem *jobs = out_jobs;
+  *jobs = (JobSystem){.std_alloc = std_alloc};
+
+  jobs->mutex = SDL_CreateMutex();
+  jobs->work_cond = SDL_CreateCond();
+  jobs->done_cond = SDL_CreateCond();
+  if (!jobs->mutex || !jobs->work_cond || !jobs->done_cond) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+    assert(0);
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    SDL_Thread *thread = SDL_CreateThread(job_worker, "Job Worker", jobs);
+    if (!thread) {
+      // Run with however many workers we managed to start
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+      break;
+    }
+    jobs->workers[jobs->worker_count++] = thread;
+  }
+
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+void destroy_job_system(JobSystem *jobs) {
+  if (jobs->mutex) {
+    SDL_LockMutex(jobs->mutex);
+    jobs->quit = true;
+    SDL_CondBroadcast(jobs->work_cond);
+    SDL_UnlockMutex(jobs->mutex);
+  }
+
+  for (uint32_t i = 0; i < jobs->worker_count; ++i) {
+    SDL_WaitThread(jobs->workers[i], NULL);
+  }
+
+  SDL_DestroyCond(jobs->done_cond);
+  SDL_DestroyCond(jobs->work_cond);
+  SDL_DestroyMutex(jobs->mutex);
+  *jobs = (JobSystem){0};
+}
+
+void job_parallel_for(JobSystem *jobs, uint32_t count, job_fn *fn,
+                      void *user_data) {
+  if (count == 0) {
+    return;
+  }
+
+  // Waking workers costs more than a single index of work
+  if (jobs->worker_count == 0 || count == 1) {
+    for (uint32_t i = 0; i < count; ++i) {
+      fn(user_data, i);
+    }
+    return;
+  }
+
+  TracyCZoneN(ctx, "job_parallel_for", true);
+
+  SDL_LockMutex(jobs->mutex);
+  // A worker that woke late for the previous batch may still be on its way
+  // out and reading the batch state
+  while (jobs->active_workers > 0) {
+    SDL_CondWait(jobs->done_cond, jobs->mutex);
+  }
+  jobs->fn = fn;
+  jobs->user_data = user_data;
+  jobs->count = count;
+  SDL_AtomicSet(&jobs->next_index, 0);
+  SDL_AtomicSet(&jobs->done_count, 0);
+  jobs->generation++;
+  SDL_CondBroadcast(jobs->work_cond);
+  SDL_UnlockMutex(jobs->mutex);
+
+  job_run_batch(jobs);
+
+  SDL_LockMutex(jobs->mutex);
+  while ((uint32_t)SDL_AtomicGet(&jobs->done_count) < count) {
+    SDL_CondWait(jobs->done_cond, jobs->mutex);
+  }
+  SDL_UnlockMutex(jobs->mutex);
+
+  TracyCZoneEnd(ctx);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL_atomic.h>
+
+#include "allocator.h"
+
+#define MAX_JOB_WORKERS 16
+
+typedef struct SDL_Thread SDL_Thread;
+typedef struct SDL_mutex SDL_mutex;
+typedef struct SDL_cond SDL_cond;
+
+// Invoked once for every index of a parallel for
+typedef void job_fn(void *user_data, uint32_t index);
+
+/*
+  A fixed pool of worker threads that split up the indices of one parallel
+  for at a time. The submitting thread works on the batch too so a system
+  with zero workers just runs everything inline.
+*/
+typedef struct JobSystem {
+  Allocator std_alloc;
+  uint32_t worker_count;
+  SDL_Thread *workers[MAX_JOB_WORKERS];
+
+  SDL_mutex *mutex;
+  SDL_cond *work_cond;
+  SDL_cond *done_cond;
+
+  // The batch in flight; only written under mutex while no worker is active
+  job_fn *fn;
+  void *user_data;
+  uint32_t count;
+  uint32_t generation;
+  uint32_t active_workers;
+  bool quit;
+
+  SDL_atomic_t next_index;
+  SDL_atomic_t done_count;
+} JobSystem;
+
+// Pass UINT32_MAX as worker_count to use one worker per spare core
+int32_t create_job_system(Allocator std_alloc, uint32_t worker_count,
+                          JobSystem *out_jobs);
+void destroy_job_system(JobSystem *jobs);
+
+// Blocks until fn has run for every index in [0, count). Must not be called
+// from inside a job.
+void job_parallel_for(JobSystem *jobs, uint32_t count, job_fn *fn,
+                      void *user_data);
@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include "demo.h"
+#include "derivedcache.h"
 #include "profiling.h"
 #include "settings.h"
 #include "shadercommon.h"
@@ -504,6 +505,104 @@ int32_t SDL_main(int32_t argc, char *argv[]) {
 
         igLabelText("Frame Time (ms)", "%f", delta_time_ms);
         igLabelText("Framerate (fps)", "%f", (1000.0f / delta_time_ms));
+        if (d.scene_stream) {
+          float progress = (float)d.scene_stream_done /
+                           (float)SDL_max(d.scene_stream_total, 1);
+          igProgressBar(progress, (ImVec2){-1.0f, 0.0f}, "Streaming Scene");
+        }
+
+        // Streaming scenes are drawn from the CPU draw list until resident
+        bool gpu_culling = d.gpu_culling && !d.scene_stream;
+
+        if (igTreeNode_StrStr("Draw Stats", "%s", "Draw Stats")) {
+          const DrawStats *stats = &d.draw_stats;
+          igText("Packets: %d", stats->packet_count);
+          igText("Draws: %d", stats->draw_count);
+          igText("Pipeline Binds: %d", stats->pipeline_binds);
+          igText("Descriptor Set Binds: %d", stats->descriptor_binds);
+          igText("Index Buffer Binds: %d", stats->index_binds);
+          igText("Vertex Buffer Binds: %d", stats->vertex_binds);
+          if (!gpu_culling) {
+            igText("Triangles: %d", stats->triangle_count);
+            igSliderFloat("LOD Pixel Error", &d.lod_pixel_error, 0.0f, 16.0f,
+                          "%.2f", 0);
+          }
+          if (d.gpu_driven) {
+            igCheckbox("GPU Culling", &d.gpu_culling);
+            igCheckbox("Occlusion Culling", &d.occlusion_culling);
+          }
+          igTreePop();
+        }
+
+        // The CPU culler only runs when the GPU path isn't building draws
+        if (!gpu_culling &&
+            igTreeNode_StrStr("CPU Cull Stats", "%s", "CPU Cull Stats")) {
+          const DrawStats *stats = &d.draw_stats;
+          const OcclusionStats *occlusion = &d.occlusion.stats;
+          igCheckbox("CPU Occlusion Culling", &d.cpu_occlusion);
+          igText("Frustum Culled: %d", stats->frustum_culled);
+          igText("Occlusion Culled: %d", stats->occlusion_culled);
+          igText("Not Resident: %d", stats->non_resident);
+          if (d.cpu_occlusion) {
+            igText("Occluders: %d", occlusion->occluder_count);
+            igText("Occluder Triangles: %d", occlusion->triangle_count);
+          }
+          igText("Cull Time: %.3f ms", stats->cull_ms);
+          igTreePop();
+        }
+
+        if (d.gpu_driven && gpu_culling &&
+            igTreeNode_StrStr("Cull Stats", "%s", "Cull Stats")) {
+          const GLTFCullStats *stats = &d.cull_stats;
+          igText("Instances: %d", d.gltf_instance_count);
+          igText("Frustum Culled: %d", stats->frustum_culled);
+          igText("Occlusion Culled: %d", stats->occlusion_culled);
+          igText("Pre-Pass Draws: %d", stats->prepass_draws);
+          igText("Main Pass Draws: %d", stats->main_draws);
+          igText("Clusters: %d", d.gltf_cluster_count);
+          igText("Cluster Frustum Culled: %d",
+                 stats->clusters_frustum_culled);
+          igText("Cluster Backface Culled: %d",
+                 stats->clusters_backface_culled);
+          igTreePop();
+        }
+
+        if (igTreeNode_StrStr("Texture Streaming", "%s",
+                              "Texture Streaming")) {
+          igText("Streaming: %u", d.texture_stream_count);
+          float budget_mb =
+              (float)((double)d.texture_stream_budget / (1024.0 * 1024.0));
+          if (igSliderFloat("Budget (MB/frame)", &budget_mb, 0.0f, 64.0f,
+                            "%.1f", 0)) {
+            d.texture_stream_budget =
+                (uint64_t)((double)budget_mb * 1024.0 * 1024.0);
+          }
+
+          const double mb = 1024.0 * 1024.0;
+          igText("Resident: %.1f MB", (double)d.texture_resident_bytes / mb);
+          igText("Requested: %.1f MB",
+                 (double)d.texture_requested_bytes / mb);
+          igText("Limit: %.1f MB (%s)", (double)d.texture_memory_limit / mb,
+                 d.memory_budget ? "device budget" : "estimated");
+          igText("LOD Bias: %u", d.texture_lod_bias);
+          float memory_mb = (float)((double)d.texture_memory_budget / mb);
+          if (igSliderFloat("Memory Budget (MB)", &memory_mb, 64.0f, 8192.0f,
+                            "%.0f", 0)) {
+            d.texture_memory_budget = (uint64_t)((double)memory_mb * mb);
+          }
+          igTreePop();
+        }
+
+        if (igTreeNode_StrStr("Asset Cache", "%s", "Asset Cache")) {
+          DerivedCacheStats stats = derived_cache_stats();
+          igText("Mesh Hits: %u / %u", stats.hits[DERIVED_CACHE_MESH],
+                 stats.hits[DERIVED_CACHE_MESH] +
+                     stats.misses[DERIVED_CACHE_MESH]);
+          igText("Texture Hits: %u / %u", stats.hits[DERIVED_CACHE_TEXTURE],
+                 stats.hits[DERIVED_CACHE_TEXTURE] +
+                     stats.misses[DERIVED_CACHE_TEXTURE]);
+          igTreePop();
+        }
 
         // WindowMode Combo Box
         {
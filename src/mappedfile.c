@@ -0,0 +1,126 @@
+#include "mappedfile.h"
+
+#include <SDL2/SDL_log.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__ANDROID__) && !defined(__SWITCH__)
+#define HB_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "profiling.h"
+
+#if defined(_WIN32)
+
+bool map_file(const char *path, MappedFile *out_file) {
+  TracyCZoneN(ctx, "map_file", true);
+  *out_file = (MappedFile){0};
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  LARGE_INTEGER size = {0};
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  const void *data =
+      mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (!data) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to map %s: %lu", path,
+                GetLastError());
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  *out_file = (MappedFile){
+      .data = data,
+      .size = (size_t)size.QuadPart,
+      .file = file,
+      .mapping = mapping,
+  };
+  TracyCZoneEnd(ctx);
+  return true;
+}
+
+void unmap_file(MappedFile *file) {
+  if (file->data) {
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+    CloseHandle(file->file);
+  }
+  *file = (MappedFile){0};
+}
+
+#elif defined(HB_MMAP)
+
+bool map_file(const char *path, MappedFile *out_file) {
+  TracyCZoneN(ctx, "map_file", true);
+  *out_file = (MappedFile){0};
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  struct stat st = {0};
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  // The mapping keeps its own reference to the file
+  size_t size = (size_t)st.st_size;
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to map %s", path);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  // Every byte is about to be parsed, hashed or decoded so start reading
+  // ahead now rather than faulting in a page at a time
+  madvise(data, size, MADV_WILLNEED);
+
+  *out_file = (MappedFile){.data = data, .size = size};
+  TracyCZoneEnd(ctx);
+  return true;
+}
+
+void unmap_file(MappedFile *file) {
+  if (file->data) {
+    munmap((void *)file->data, file->size);
+  }
+  *file = (MappedFile){0};
+}
+
+#else
+
+bool map_file(const char *path, MappedFile *out_file) {
+  (void)path;
+  *out_file = (MappedFile){0};
+  return false;
+}
+
+void unmap_file(MappedFile *file) { *file = (MappedFile){0}; }
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  A read only view of a whole file straight out of the page cache. Nothing
+  is read until a page is touched and pages can be evicted again under
+  memory pressure, so large assets cost address space rather than heap.
+  Platforms without file mapping, or files that aren't plain files on disk
+  like Android assets, fail to map and callers fall back to reading.
+*/
+typedef struct MappedFile {
+  const uint8_t *data;
+  size_t size;
+#ifdef _WIN32
+  void *file;
+  void *mapping;
+#endif
+} MappedFile;
+
+bool map_file(const char *path, MappedFile *out_file);
+void unmap_file(MappedFile *file);
@@ -0,0 +1,664 @@
+#include "meshimport.h"
+
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
+#include <assert.h>
+#include <cgltf.h>
+#include <math.h>
+#include <meshoptimizer.h>
+#include <string.h>
+
+#include "derivedcache.h"
+#include "hash.h"
+#include "profiling.h"
+
+// Matches the post-transform cache the simulation in meshoptimizer models
+#define MESH_IMPORT_CACHE_SIZE 16
+// How much worse the vertex cache may get in exchange for less overdraw
+#define MESH_IMPORT_OVERDRAW_THRESHOLD 1.05f
+
+// Each level aims for half the triangles of the level before it
+#define MESH_LOD_REDUCTION 0.5f
+// A level that can't drop at least a fifth of the previous level's triangles
+// isn't worth the index memory
+#define MESH_LOD_MIN_REDUCTION 0.8f
+// Relative to the mesh's extent so simplification never eats the silhouette
+#define MESH_LOD_MAX_ERROR 0.05f
+
+// Trades a little vertex reuse for tighter normal cones
+#define MESH_CLUSTER_CONE_WEIGHT 0.25f
+
+#define MESH_CACHE_MAGIC 0x43424d48 // 'HMBC'
+
+// Attributes are unpacked to floats while the mesh is being processed and
+// only compressed into pool formats at the very end
+#define IMPORT_POSITION_STRIDE (sizeof(float) * 3)
+#define IMPORT_NORMAL_STRIDE (sizeof(float) * 3)
+#define IMPORT_UV_STRIDE (sizeof(float) * 2)
+
+// The submesh and cluster tables follow the header, then the import's data
+typedef struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t index_count;
+  uint32_t vertex_count;
+  uint32_t index_type;
+  uint32_t lod_count;
+  float lod_errors[MESH_MAX_LODS];
+  uint32_t submesh_count;
+  uint32_t cluster_count;
+  float4 bounds;
+  float4 dequant;
+  uint64_t idx_size;
+  uint64_t size;
+} MeshCacheHeader;
+
+static const cgltf_accessor *find_attribute(const cgltf_primitive *prim,
+                                            cgltf_attribute_type type) {
+  for (cgltf_size i = 0; i < prim->attributes_count; ++i) {
+    if (prim->attributes[i].type == type) {
+      return prim->attributes[i].data;
+    }
+  }
+  return NULL;
+}
+
+static uint64_t hash_accessor(const cgltf_accessor *accessor, uint64_t seed) {
+  if (!accessor) {
+    return hash64(NULL, 0, seed);
+  }
+
+  // The layout matters as much as the bytes it describes
+  uint32_t desc[] = {
+      (uint32_t)accessor->type,
+      (uint32_t)accessor->component_type,
+      (uint32_t)accessor->normalized,
+      (uint32_t)accessor->count,
+  };
+  seed = hash64(desc, sizeof(desc), seed);
+
+  const cgltf_buffer_view *view = accessor->buffer_view;
+  if (!view || accessor->count == 0) {
+    return seed;
+  }
+  const uint8_t *data =
+      (const uint8_t *)view->buffer->data + view->offset + accessor->offset;
+  size_t size = accessor->stride * (accessor->count - 1) +
+                cgltf_calc_size(accessor->type, accessor->component_type);
+  return hash64(data, size, seed);
+}
+
+uint64_t mesh_import_key(const cgltf_mesh *src_mesh) {
+  TracyCZoneN(ctx, "mesh_import_key", true);
+  uint64_t key = MESH_IMPORT_VERSION;
+  for (cgltf_size i = 0; i < src_mesh->primitives_count; ++i) {
+    const cgltf_primitive *prim = &src_mesh->primitives[i];
+    key = hash_accessor(prim->indices, key);
+    key = hash_accessor(find_attribute(prim, cgltf_attribute_type_position),
+                        key);
+    key =
+        hash_accessor(find_attribute(prim, cgltf_attribute_type_normal), key);
+    key = hash_accessor(find_attribute(prim, cgltf_attribute_type_texcoord),
+                        key);
+  }
+  TracyCZoneEnd(ctx);
+  return key;
+}
+
+static MeshImportStats analyze_mesh(const uint32_t *indices,
+                                    uint32_t index_count,
+                                    const float *positions,
+                                    uint32_t vertex_count) {
+  struct meshopt_VertexCacheStatistics cache = meshopt_analyzeVertexCache(
+      indices, index_count, vertex_count, MESH_IMPORT_CACHE_SIZE, 0, 0);
+  struct meshopt_OverdrawStatistics overdraw =
+      meshopt_analyzeOverdraw(indices, index_count, positions, vertex_count,
+                              IMPORT_POSITION_STRIDE);
+  return (MeshImportStats){cache.acmr, cache.atvr, overdraw.overdraw};
+}
+
+// Positions are stored as unorm xyz within the dequantization box; w pads the
+// stream to a format every device can fetch
+static void quantize_positions(const float *positions, uint32_t vertex_count,
+                               float4 dequant, uint16_t *out) {
+  float3 offset = f4tof3(dequant);
+  float inv_scale = 1.0f / dequant[3];
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    for (uint32_t ii = 0; ii < 3; ++ii) {
+      float v = (positions[i * 3 + ii] - offset[ii]) * inv_scale;
+      v = SDL_min(SDL_max(v, 0.0f), 1.0f);
+      out[i * 4 + ii] = (uint16_t)(v * 65535.0f + 0.5f);
+    }
+    out[i * 4 + 3] = 0;
+  }
+}
+
+// Octahedral encoding maps the unit sphere onto a square so a normal only
+// needs two components
+static void encode_normals(const float *normals, uint32_t vertex_count,
+                           int16_t *out) {
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    const float *n = &normals[i * 3];
+    float len = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = len > 0.0f ? n[0] / len : 0.0f;
+    float y = len > 0.0f ? n[1] / len : 0.0f;
+    if (n[2] < 0.0f) {
+      float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+      x = fx;
+      y = fy;
+    }
+    out[i * 2 + 0] = (int16_t)lrintf(x * 32767.0f);
+    out[i * 2 + 1] = (int16_t)lrintf(y * 32767.0f);
+  }
+}
+
+// Round to nearest float to half conversion. Denormals flush to zero which
+// is fine for texture coordinates.
+static uint16_t quantize_half(float v) {
+  uint32_t bits = 0;
+  memcpy(&bits, &v, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t em = bits & 0x7fffffff;
+
+  // Rebias the exponent from 127 to 15 and round the dropped mantissa bits
+  uint32_t h = (em - (112u << 23) + (1u << 12)) >> 13;
+  h = em < (113u << 23) ? 0 : h;       // Too small; flush to zero
+  h = em >= (143u << 23) ? 0x7c00 : h; // Too large; infinity
+  h = em > (255u << 23) ? 0x7e00 : h;  // NaN
+  return (uint16_t)(sign | h);
+}
+
+static void encode_uvs(const float *uvs, uint32_t vertex_count,
+                       uint16_t *out) {
+  for (uint32_t i = 0; i < vertex_count * 2; ++i) {
+    out[i] = quantize_half(uvs[i]);
+  }
+}
+
+// Splits each submesh's full detail triangles into clusters and rewrites
+// them in cluster order. Meshlets index a small local vertex table which is
+// flattened back to mesh indices so clusters can be drawn without mesh
+// shaders.
+static void build_mesh_clusters(Allocator alloc, uint32_t *indices,
+                                const float *positions, uint32_t vertex_count,
+                                MeshImport *import) {
+  TracyCZoneN(ctx, "build_mesh_clusters", true);
+
+  const size_t max_vertices = MESH_CLUSTER_MAX_VERTICES;
+  const size_t max_triangles = MESH_CLUSTER_MAX_TRIANGLES;
+
+  size_t max_clusters = 0;
+  for (uint32_t i = 0; i < import->submesh_count; ++i) {
+    max_clusters += meshopt_buildMeshletsBound(
+        import->submeshes[i].lods[0].index_count, max_vertices, max_triangles);
+  }
+  import->clusters = hb_alloc_nm_tp(alloc, max_clusters, MeshCluster);
+  import->cluster_count = 0;
+
+  for (uint32_t i = 0; i < import->submesh_count; ++i) {
+    Submesh *submesh = &import->submeshes[i];
+    const MeshLod *range = &submesh->lods[0];
+    uint32_t *submesh_indices = indices + range->first_index;
+
+    size_t max_meshlets = meshopt_buildMeshletsBound(
+        range->index_count, max_vertices, max_triangles);
+    meshopt_Meshlet *meshlets =
+        hb_alloc_nm_tp(alloc, max_meshlets, meshopt_Meshlet);
+    uint32_t *meshlet_vertices =
+        hb_alloc_nm_tp(alloc, max_meshlets * max_vertices, uint32_t);
+    uint8_t *meshlet_triangles =
+        hb_alloc_nm_tp(alloc, max_meshlets * max_triangles * 3, uint8_t);
+    size_t meshlet_count = meshopt_buildMeshlets(
+        meshlets, meshlet_vertices, meshlet_triangles, submesh_indices,
+        range->index_count, positions, vertex_count, IMPORT_POSITION_STRIDE,
+        max_vertices, max_triangles, MESH_CLUSTER_CONE_WEIGHT);
+
+    uint32_t *clustered = hb_alloc_nm_tp(alloc, range->index_count, uint32_t);
+    uint32_t index_count = 0;
+    submesh->first_cluster = import->cluster_count;
+    submesh->cluster_count = (uint32_t)meshlet_count;
+    for (size_t ii = 0; ii < meshlet_count; ++ii) {
+      const meshopt_Meshlet *meshlet = &meshlets[ii];
+      const uint32_t *vertices = meshlet_vertices + meshlet->vertex_offset;
+      const uint8_t *triangles = meshlet_triangles + meshlet->triangle_offset;
+
+      struct meshopt_Bounds bounds = meshopt_computeMeshletBounds(
+          vertices, triangles, meshlet->triangle_count, positions,
+          vertex_count, IMPORT_POSITION_STRIDE);
+      import->clusters[import->cluster_count++] = (MeshCluster){
+          .bounds = {bounds.center[0], bounds.center[1], bounds.center[2],
+                     bounds.radius},
+          .cone = {bounds.cone_axis[0], bounds.cone_axis[1],
+                   bounds.cone_axis[2], bounds.cone_cutoff},
+          .first_index = range->first_index + index_count,
+          .index_count = meshlet->triangle_count * 3,
+      };
+
+      for (uint32_t iii = 0; iii < meshlet->triangle_count * 3; ++iii) {
+        clustered[index_count++] = vertices[triangles[iii]];
+      }
+    }
+    // Every triangle lands in exactly one cluster
+    assert(index_count == range->index_count);
+    memcpy(submesh_indices, clustered, index_count * sizeof(uint32_t));
+
+    hb_free(alloc, clustered);
+    hb_free(alloc, meshlet_triangles);
+    hb_free(alloc, meshlet_vertices);
+    hb_free(alloc, meshlets);
+  }
+
+  TracyCZoneEnd(ctx);
+}
+
+// Writes the full detail indices followed by each simplified level into
+// lod_indices, which must have room for index_count * MESH_MAX_LODS indices.
+// Every submesh is simplified towards the same level; one that can't reduce
+// any further reuses its previous range. Returns the index count of the
+// whole chain.
+static uint32_t build_mesh_lods(Allocator alloc, const uint32_t *indices,
+                                uint32_t index_count, const float *positions,
+                                uint32_t vertex_count, uint32_t *lod_indices,
+                                MeshImport *import) {
+  TracyCZoneN(ctx, "build_mesh_lods", true);
+
+  const size_t stride = IMPORT_POSITION_STRIDE;
+
+  // Full detail submesh ranges already line up with the source indices
+  memcpy(lod_indices, indices, index_count * sizeof(uint32_t));
+  import->lod_errors[0] = 0.0f;
+  import->lod_count = 1;
+  uint32_t total_count = index_count;
+
+  // The simplifier reports error relative to the mesh's extent
+  float scale = meshopt_simplifyScale(positions, vertex_count, stride);
+
+  uint32_t submesh_count = import->submesh_count;
+  float *submesh_errors = hb_alloc_nm_tp(alloc, submesh_count, float);
+  memset(submesh_errors, 0, submesh_count * sizeof(float));
+  while (import->lod_count < MESH_MAX_LODS) {
+    uint32_t lod = import->lod_count;
+    float lod_error = 0.0f;
+    bool reduced = false;
+    for (uint32_t i = 0; i < submesh_count; ++i) {
+      Submesh *submesh = &import->submeshes[i];
+      const MeshLod *prev = &submesh->lods[lod - 1];
+      submesh->lods[lod] = *prev;
+
+      size_t target_count =
+          (size_t)(prev->index_count * MESH_LOD_REDUCTION) / 3 * 3;
+      uint32_t *dst = lod_indices + total_count;
+      float error = 0.0f;
+      size_t count = meshopt_simplify(
+          dst, lod_indices + prev->first_index, prev->index_count, positions,
+          vertex_count, stride, target_count, MESH_LOD_MAX_ERROR, &error);
+      if (count > 0 && count <= prev->index_count * MESH_LOD_MIN_REDUCTION) {
+        // Simplification scrambles the order the full mesh was optimized for
+        meshopt_optimizeVertexCache(dst, dst, count, vertex_count);
+
+        submesh->lods[lod] = (MeshLod){total_count, (uint32_t)count};
+        total_count += (uint32_t)count;
+        // Every level is simplified from the one before it so errors add up
+        submesh_errors[i] += error * scale;
+        reduced = true;
+      }
+      lod_error = SDL_max(lod_error, submesh_errors[i]);
+    }
+    if (!reduced) {
+      break;
+    }
+    import->lod_errors[import->lod_count++] = lod_error;
+  }
+  hb_free(alloc, submesh_errors);
+
+  TracyCZoneEnd(ctx);
+  return total_count;
+}
+
+// Every primitive must be indexed triangles with the attributes we shade
+static bool validate_primitive(const cgltf_primitive *prim, const char *name) {
+  if (prim->type != cgltf_primitive_type_triangles) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                 "Mesh %s has a primitive that isn't a triangle list", name);
+    return false;
+  }
+  if (!prim->indices ||
+      !find_attribute(prim, cgltf_attribute_type_position) ||
+      !find_attribute(prim, cgltf_attribute_type_normal) ||
+      !find_attribute(prim, cgltf_attribute_type_texcoord)) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                 "Mesh %s is missing indices, positions, normals or uvs",
+                 name);
+    return false;
+  }
+  return true;
+}
+
+int32_t import_mesh_cgltf(Allocator alloc, const cgltf_mesh *src_mesh,
+                          MeshImport *out_import) {
+  TracyCZoneN(ctx, "import_mesh_cgltf", true);
+  const char *name = src_mesh->name ? src_mesh->name : "unnamed";
+  uint32_t submesh_count = (uint32_t)src_mesh->primitives_count;
+
+  uint32_t index_count = 0;
+  uint32_t vertex_count = 0;
+  for (uint32_t i = 0; i < submesh_count; ++i) {
+    const cgltf_primitive *prim = &src_mesh->primitives[i];
+    if (!validate_primitive(prim, name)) {
+      TracyCZoneEnd(ctx);
+      return -1;
+    }
+    index_count += (uint32_t)prim->indices->count;
+    vertex_count +=
+        (uint32_t)find_attribute(prim, cgltf_attribute_type_position)->count;
+  }
+
+  MeshImport import = {
+      .submesh_count = submesh_count,
+      .submeshes = hb_alloc_nm_tp(alloc, submesh_count, Submesh),
+  };
+
+  // Primitives are appended one after another. Indices are rebased onto the
+  // merged vertices so every submesh can share one vertexOffset.
+  uint32_t *indices = hb_alloc_nm_tp(alloc, index_count, uint32_t);
+  float *positions = hb_alloc_nm_tp(alloc, vertex_count * 3, float);
+  float *normals = hb_alloc_nm_tp(alloc, vertex_count * 3, float);
+  float *uvs = hb_alloc_nm_tp(alloc, vertex_count * 2, float);
+  {
+    uint32_t first_index = 0;
+    uint32_t base_vertex = 0;
+    for (uint32_t i = 0; i < submesh_count; ++i) {
+      const cgltf_primitive *prim = &src_mesh->primitives[i];
+      const cgltf_accessor *position_accessor =
+          find_attribute(prim, cgltf_attribute_type_position);
+      uint32_t prim_index_count = (uint32_t)prim->indices->count;
+      uint32_t prim_vertex_count = (uint32_t)position_accessor->count;
+
+      for (uint32_t ii = 0; ii < prim_index_count; ++ii) {
+        indices[first_index + ii] =
+            base_vertex +
+            (uint32_t)cgltf_accessor_read_index(prim->indices, ii);
+      }
+
+      // Unpacking handles any stride or component type the asset uses
+      cgltf_accessor_unpack_floats(position_accessor,
+                                   positions + base_vertex * 3,
+                                   prim_vertex_count * 3);
+      cgltf_accessor_unpack_floats(
+          find_attribute(prim, cgltf_attribute_type_normal),
+          normals + base_vertex * 3, prim_vertex_count * 3);
+      cgltf_accessor_unpack_floats(
+          find_attribute(prim, cgltf_attribute_type_texcoord),
+          uvs + base_vertex * 2, prim_vertex_count * 2);
+
+      import.submeshes[i] = (Submesh){
+          .material = SUBMESH_NO_MATERIAL,
+          .lods[0] = {first_index, prim_index_count},
+      };
+      first_index += prim_index_count;
+      base_vertex += prim_vertex_count;
+    }
+  }
+
+  MeshImportStats before =
+      analyze_mesh(indices, index_count, positions, vertex_count);
+
+  // Order matters; overdraw optimization works on the clusters that the
+  // vertex cache pass leaves behind, meshlets are grown in triangle order
+  // and the fetch remap follows the final triangle order. Triangles never
+  // move between submeshes.
+  {
+    TracyCZoneN(opt_ctx, "Optimize Mesh", true);
+    for (uint32_t i = 0; i < submesh_count; ++i) {
+      const MeshLod *range = &import.submeshes[i].lods[0];
+      uint32_t *submesh_indices = indices + range->first_index;
+      meshopt_optimizeVertexCache(submesh_indices, submesh_indices,
+                                  range->index_count, vertex_count);
+      meshopt_optimizeOverdraw(submesh_indices, submesh_indices,
+                               range->index_count, positions, vertex_count,
+                               IMPORT_POSITION_STRIDE,
+                               MESH_IMPORT_OVERDRAW_THRESHOLD);
+    }
+    build_mesh_clusters(alloc, indices, positions, vertex_count, &import);
+
+    uint32_t *remap = hb_alloc_nm_tp(alloc, vertex_count, uint32_t);
+    uint32_t unique_count = (uint32_t)meshopt_optimizeVertexFetchRemap(
+        remap, indices, index_count, vertex_count);
+    meshopt_remapIndexBuffer(indices, indices, index_count, remap);
+    meshopt_remapVertexBuffer(positions, positions, vertex_count,
+                              IMPORT_POSITION_STRIDE, remap);
+    meshopt_remapVertexBuffer(normals, normals, vertex_count,
+                              IMPORT_NORMAL_STRIDE, remap);
+    meshopt_remapVertexBuffer(uvs, uvs, vertex_count, IMPORT_UV_STRIDE,
+                              remap);
+    hb_free(alloc, remap);
+
+    // Vertices that no triangle referenced are gone now
+    vertex_count = unique_count;
+    TracyCZoneEnd(opt_ctx);
+  }
+
+  MeshImportStats after =
+      analyze_mesh(indices, index_count, positions, vertex_count);
+  SDL_Log("Mesh %s (%u submeshes): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, "
+          "Overdraw %.3f -> %.3f",
+          name, submesh_count, (double)before.acmr, (double)after.acmr,
+          (double)before.atvr, (double)after.atvr, (double)before.overdraw,
+          (double)after.overdraw);
+
+  import.vertex_count = vertex_count;
+  // Half the index bandwidth and memory whenever the vertices allow it
+  import.index_type = vertex_count > UINT16_MAX + 1 ? VK_INDEX_TYPE_UINT32
+                                                    : VK_INDEX_TYPE_UINT16;
+
+  float3 bounds_min = {0};
+  float3 bounds_max = {0};
+  if (vertex_count > 0) {
+    bounds_min = (float3){positions[0], positions[1], positions[2]};
+    bounds_max = bounds_min;
+    for (uint32_t i = 1; i < vertex_count; ++i) {
+      const float *p = &positions[i * 3];
+      for (uint32_t ii = 0; ii < 3; ++ii) {
+        bounds_min[ii] = SDL_min(bounds_min[ii], p[ii]);
+        bounds_max[ii] = SDL_max(bounds_max[ii], p[ii]);
+      }
+    }
+  }
+  float3 center = (bounds_min + bounds_max) * 0.5f;
+  import.bounds = f3tof4(center, magf3(bounds_max - center));
+
+  // One scale for every axis keeps the dequantization uniform so normals
+  // don't need a separate transform
+  {
+    float3 extent = bounds_max - bounds_min;
+    float scale = SDL_max(extent[0], SDL_max(extent[1], extent[2]));
+    import.dequant = f3tof4(bounds_min, scale > 0.0f ? scale : 1.0f);
+  }
+
+  uint32_t *lod_indices =
+      hb_alloc_nm_tp(alloc, index_count * MESH_MAX_LODS, uint32_t);
+  import.index_count =
+      build_mesh_lods(alloc, indices, index_count, positions, vertex_count,
+                      lod_indices, &import);
+
+  // Lay everything out the way the pool's staging copy expects
+  size_t position_size = vertex_count * MESH_POOL_POSITION_STRIDE;
+  size_t normal_size = vertex_count * MESH_POOL_NORMAL_STRIDE;
+  size_t uv_size = vertex_count * MESH_POOL_UV_STRIDE;
+  bool wide = import.index_type == VK_INDEX_TYPE_UINT32;
+  size_t index_size = wide ? sizeof(uint32_t) : sizeof(uint16_t);
+  // The pool hands out index ranges in whole units
+  size_t index_bytes = import.index_count * index_size;
+  import.idx_size = (index_bytes + MESH_POOL_INDEX_UNIT - 1) /
+                    MESH_POOL_INDEX_UNIT * MESH_POOL_INDEX_UNIT;
+  import.size = import.idx_size + position_size + normal_size + uv_size;
+  import.data = hb_alloc(alloc, import.size);
+  {
+    if (wide) {
+      memcpy(import.data, lod_indices, index_bytes);
+    } else {
+      uint16_t *index_data = (uint16_t *)import.data;
+      for (uint32_t i = 0; i < import.index_count; ++i) {
+        index_data[i] = (uint16_t)lod_indices[i];
+      }
+    }
+    memset(import.data + index_bytes, 0, import.idx_size - index_bytes);
+    uint8_t *dst = import.data + import.idx_size;
+    quantize_positions(positions, vertex_count, import.dequant,
+                       (uint16_t *)dst);
+    dst += position_size;
+    encode_normals(normals, vertex_count, (int16_t *)dst);
+    dst += normal_size;
+    encode_uvs(uvs, vertex_count, (uint16_t *)dst);
+  }
+
+  hb_free(alloc, lod_indices);
+  hb_free(alloc, uvs);
+  hb_free(alloc, normals);
+  hb_free(alloc, positions);
+  hb_free(alloc, indices);
+
+  *out_import = import;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+void destroy_mesh_import(Allocator alloc, MeshImport *import) {
+  hb_free(alloc, import->data);
+  hb_free(alloc, import->submeshes);
+  hb_free(alloc, import->clusters);
+  *import = (MeshImport){0};
+}
+
+static void mesh_cache_path(const char *cache_dir, uint64_t key, char *path,
+                            size_t path_size) {
+  SDL_snprintf(path, path_size, "%smesh_%016llx.cache", cache_dir,
+               (unsigned long long)key);
+}
+
+bool load_cached_mesh_import(Allocator alloc, const char *cache_dir,
+                             uint64_t key, MeshImport *out_import) {
+  if (!cache_dir) {
+    return false;
+  }
+  TracyCZoneN(ctx, "load_cached_mesh_import", true);
+
+  char path[1024] = {0};
+  mesh_cache_path(cache_dir, key, path, sizeof(path));
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file) {
+    derived_cache_count(DERIVED_CACHE_MESH, false);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  // Anything that doesn't line up exactly is treated as a miss and rebuilt
+  MeshCacheHeader header = {0};
+  bool valid = SDL_RWread(file, &header, sizeof(header), 1) == 1 &&
+               header.magic == MESH_CACHE_MAGIC &&
+               header.version == MESH_IMPORT_VERSION && header.key == key &&
+               header.lod_count <= MESH_MAX_LODS &&
+               (uint64_t)SDL_RWsize(file) ==
+                   sizeof(header) + header.submesh_count * sizeof(Submesh) +
+                       header.cluster_count * sizeof(MeshCluster) +
+                       header.size;
+
+  MeshImport import = {0};
+  if (valid) {
+    import = (MeshImport){
+        .index_count = header.index_count,
+        .vertex_count = header.vertex_count,
+        .index_type = (VkIndexType)header.index_type,
+        .lod_count = header.lod_count,
+        .submesh_count = header.submesh_count,
+        .cluster_count = header.cluster_count,
+        .bounds = header.bounds,
+        .dequant = header.dequant,
+        .idx_size = (size_t)header.idx_size,
+        .size = (size_t)header.size,
+    };
+    memcpy(import.lod_errors, header.lod_errors, sizeof(import.lod_errors));
+    import.submeshes = hb_alloc_nm_tp(alloc, import.submesh_count, Submesh);
+    import.clusters =
+        hb_alloc_nm_tp(alloc, import.cluster_count, MeshCluster);
+    import.data = hb_alloc(alloc, import.size);
+    valid = SDL_RWread(file, import.submeshes, sizeof(Submesh),
+                       import.submesh_count) == import.submesh_count &&
+            SDL_RWread(file, import.clusters, sizeof(MeshCluster),
+                       import.cluster_count) == import.cluster_count &&
+            SDL_RWread(file, import.data, import.size, 1) == 1;
+    if (!valid) {
+      destroy_mesh_import(alloc, &import);
+    }
+  }
+  SDL_RWclose(file);
+
+  if (valid) {
+    derived_cache_touch(path);
+    *out_import = import;
+  }
+  derived_cache_count(DERIVED_CACHE_MESH, valid);
+  TracyCZoneEnd(ctx);
+  return valid;
+}
+
+void save_cached_mesh_import(const char *cache_dir, uint64_t key,
+                             const MeshImport *import) {
+  if (!cache_dir) {
+    return;
+  }
+  TracyCZoneN(ctx, "save_cached_mesh_import", true);
+
+  char path[1024] = {0};
+  mesh_cache_path(cache_dir, key, path, sizeof(path));
+  SDL_RWops *file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    // Not fatal; the mesh just gets imported again next launch
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to write %s", path);
+    TracyCZoneEnd(ctx);
+    return;
+  }
+
+  MeshCacheHeader header = {
+      .magic = MESH_CACHE_MAGIC,
+      .version = MESH_IMPORT_VERSION,
+      .key = key,
+      .index_count = import->index_count,
+      .vertex_count = import->vertex_count,
+      .index_type = (uint32_t)import->index_type,
+      .lod_count = import->lod_count,
+      .submesh_count = import->submesh_count,
+      .cluster_count = import->cluster_count,
+      .bounds = import->bounds,
+      .dequant = import->dequant,
+      .idx_size = import->idx_size,
+      .size = import->size,
+  };
+  memcpy(header.lod_errors, import->lod_errors, sizeof(header.lod_errors));
+  SDL_RWwrite(file, &header, sizeof(header), 1);
+  SDL_RWwrite(file, import->submeshes, sizeof(Submesh),
+              import->submesh_count);
+  SDL_RWwrite(file, import->clusters, sizeof(MeshCluster),
+              import->cluster_count);
+  SDL_RWwrite(file, import->data, import->size, 1);
+  SDL_RWclose(file);
+
+  TracyCZoneEnd(ctx);
+}
+
+int32_t import_mesh_cgltf_cached(Allocator alloc, const char *cache_dir,
+                                 const cgltf_mesh *src_mesh,
+                                 MeshImport *out_import) {
+  uint64_t key = mesh_import_key(src_mesh);
+  if (load_cached_mesh_import(alloc, cache_dir, key, out_import)) {
+    return 0;
+  }
+  if (import_mesh_cgltf(alloc, src_mesh, out_import) != 0) {
+    return -1;
+  }
+  save_cached_mesh_import(cache_dir, key, out_import);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "meshpool.h"
+#include "simd.h"
+
+typedef struct cgltf_mesh cgltf_mesh;
+
+// Bump whenever import output changes so stale cache entries are rebuilt
+#define MESH_IMPORT_VERSION 4
+
+// Post-transform cache simulation results; lower is better for all three
+typedef struct MeshImportStats {
+  float acmr;     // Vertices shaded per triangle
+  float atvr;     // Vertices shaded per unique vertex
+  float overdraw; // Pixels shaded per covered pixel
+} MeshImportStats;
+
+/*
+  The CPU side result of importing a mesh, ready to be copied into a pool
+  staging buffer as is. data holds every submesh's levels of detail
+  (idx_size bytes, padded to the pool's index unit) followed by each vertex
+  stream in pool stream order. Submesh materials are left for the scene to
+  resolve.
+*/
+typedef struct MeshImport {
+  uint32_t index_count; // Every submesh and level of detail combined
+  uint32_t vertex_count;
+  VkIndexType index_type;
+  uint32_t lod_count;
+  float lod_errors[MESH_MAX_LODS];
+  uint32_t submesh_count;
+  Submesh *submeshes;
+  uint32_t cluster_count;
+  MeshCluster *clusters;
+  float4 bounds;
+  float4 dequant; // Maps unorm positions back to object space
+  size_t idx_size;
+  size_t size;
+  uint8_t *data;
+} MeshImport;
+
+// Hash of every source byte the import reads
+uint64_t mesh_import_key(const cgltf_mesh *src_mesh);
+
+// Every primitive becomes a submesh and all of their vertices are merged
+// into one range. Each submesh's triangles are reordered for the
+// post-transform vertex cache and for overdraw, then grouped into clusters,
+// and vertices are remapped into first use order for fetch locality. Levels
+// of detail are generated from the optimized mesh. Any accessor format is
+// accepted, including KHR_mesh_quantization, and vertices are compressed into
+// the pool's formats last. Indices are 16-bit unless there are too many
+// vertices.
+int32_t import_mesh_cgltf(Allocator alloc, const cgltf_mesh *src_mesh,
+                          MeshImport *out_import);
+void destroy_mesh_import(Allocator alloc, MeshImport *import);
+
+// A NULL cache_dir disables the cache
+bool load_cached_mesh_import(Allocator alloc, const char *cache_dir,
+                             uint64_t key, MeshImport *out_import);
+void save_cached_mesh_import(const char *cache_dir, uint64_t key,
+                             const MeshImport *import);
+
+// Importing is expensive so the result is cached on disk by source hash.
+// Only touches the CPU and the cache so it is safe to run on a job as long
+// as alloc is.
+int32_t import_mesh_cgltf_cached(Allocator alloc, const char *cache_dir,
+                                 const cgltf_mesh *src_mesh,
+                                 MeshImport *out_import);
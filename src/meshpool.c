@@ -0,0 +1,151 @@
+#include "meshpool.h"
+
+#include <assert.h>
+#include <volk.h>
+
+#include <vk_mem_alloc.h>
+
+#include "profiling.h"
+
+static const VkDeviceSize stream_strides[MESH_POOL_STREAM_COUNT] = {
+    MESH_POOL_POSITION_STRIDE,
+    MESH_POOL_NORMAL_STRIDE,
+    MESH_POOL_UV_STRIDE,
+};
+
+static uint32_t index_type_size(VkIndexType index_type) {
+  return index_type == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t)
+                                            : sizeof(uint16_t);
+}
+
+static int32_t create_meshpool_buffer(VmaAllocator vma_alloc, VkDeviceSize size,
+                                      GPUBuffer *out) {
+  // Cluster culling reads indices back as a storage buffer
+  return create_gpubuffer(vma_alloc, size, VMA_MEMORY_USAGE_GPU_ONLY,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          out);
+}
+
+int32_t create_meshpool(VmaAllocator vma_alloc, Allocator std_alloc,
+                        uint32_t max_indices, uint32_t max_vertices,
+                        MeshPool *out_pool) {
+  TracyCZoneN(ctx, "create_meshpool", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  MeshPool pool = {.vma_alloc = vma_alloc};
+
+  // Lay out every region back to back
+  VkDeviceSize offset = max_indices * MESH_POOL_INDEX_UNIT;
+  for (uint32_t i = 0; i < MESH_POOL_STREAM_COUNT; ++i) {
+    pool.stream_offsets[i] = offset;
+    offset += max_vertices * stream_strides[i];
+  }
+  pool.size = offset;
+
+  if (create_meshpool_buffer(vma_alloc, pool.size, &pool.gpu) != VK_SUCCESS) {
+    assert(0);
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+
+  if (create_offset_allocator(std_alloc, max_indices, &pool.indices) != 0 ||
+      create_offset_allocator(std_alloc, max_vertices, &pool.vertices) != 0) {
+    assert(0);
+    TracyCZoneEnd(ctx);
+    return -2;
+  }
+
+  *out_pool = pool;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+void destroy_meshpool(MeshPool *p) {
+  destroy_offset_allocator(&p->indices);
+  destroy_offset_allocator(&p->vertices);
+  destroy_gpubuffer(p->vma_alloc, &p->gpu);
+}
+
+int32_t meshpool_alloc(MeshPool *p, VkIndexType index_type,
+                       uint32_t index_count, uint32_t vertex_count,
+                       PooledMesh *mesh) {
+  uint32_t index_size = index_type_size(index_type);
+  uint32_t unit_count =
+      (index_count * index_size + MESH_POOL_INDEX_UNIT - 1) /
+      MESH_POOL_INDEX_UNIT;
+
+  OffsetAllocation indices = {0};
+  if (!offset_alloc(&p->indices, unit_count, &indices)) {
+    return -1;
+  }
+
+  OffsetAllocation vertices = {0};
+  if (!offset_alloc(&p->vertices, vertex_count, &vertices)) {
+    offset_free(&p->indices, &indices);
+    return -2;
+  }
+
+  mesh->indices = indices;
+  mesh->vertices = vertices;
+  mesh->index_type = index_type;
+  return 0;
+}
+
+void meshpool_free(MeshPool *p, PooledMesh *mesh) {
+  offset_free(&p->indices, &mesh->indices);
+  offset_free(&p->vertices, &mesh->vertices);
+  mesh->indices = (OffsetAllocation){0};
+  mesh->vertices = (OffsetAllocation){0};
+}
+
+void meshpool_bind(const MeshPool *p, VkCommandBuffer cmd,
+                   VkIndexType index_type) {
+  VkBuffer buffer = p->gpu.buffer;
+  vkCmdBindIndexBuffer(cmd, buffer, p->index_offset, index_type);
+
+  VkBuffer buffers[MESH_POOL_STREAM_COUNT] = {0};
+  for (uint32_t i = 0; i < MESH_POOL_STREAM_COUNT; ++i) {
+    buffers[i] = buffer;
+  }
+  vkCmdBindVertexBuffers(cmd, 0, MESH_POOL_STREAM_COUNT, buffers,
+                         p->stream_offsets);
+}
+
+void meshpool_bind_indices(const MeshPool *p, VkCommandBuffer cmd,
+                           VkIndexType index_type) {
+  vkCmdBindIndexBuffer(cmd, p->gpu.buffer, p->index_offset, index_type);
+}
+
+uint32_t meshpool_first_index(const PooledMesh *mesh) {
+  return mesh->indices.offset *
+         (MESH_POOL_INDEX_UNIT / index_type_size(mesh->index_type));
+}
+
+void meshpool_record_upload(const MeshPool *p, VkCommandBuffer cmd,
+                            const PooledMesh *mesh) {
+  VkBufferCopy regions[MESH_POOL_STREAM_COUNT + 1] = {0};
+  regions[0] = (VkBufferCopy){
+      0,
+      p->index_offset + mesh->indices.offset * MESH_POOL_INDEX_UNIT,
+      mesh->indices.size * MESH_POOL_INDEX_UNIT,
+  };
+
+  VkDeviceSize src_offset = mesh->idx_size;
+  for (uint32_t i = 0; i < MESH_POOL_STREAM_COUNT; ++i) {
+    VkDeviceSize stride = stream_strides[i];
+    VkDeviceSize size = mesh->vertices.size * stride;
+    regions[i + 1] = (VkBufferCopy){
+        src_offset,
+        p->stream_offsets[i] + mesh->vertices.offset * stride,
+        size,
+    };
+    src_offset += size;
+  }
+
+  vkCmdCopyBuffer(cmd, mesh->host.buffer, p->gpu.buffer,
+                  MESH_POOL_STREAM_COUNT + 1, regions);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+#include "gpuresources.h"
+#include "offsetalloc.h"
+
+#define MESH_POOL_MAX_INDICES (1 << 22) // Counted as 32-bit indices
+#define MESH_POOL_MAX_VERTICES (1 << 20)
+
+// Index ranges are allocated in 4 byte units so 16 and 32-bit meshes can
+// share one region. A 16-bit range just holds two indices per unit.
+#define MESH_POOL_INDEX_UNIT sizeof(uint32_t)
+
+// Vertex streams in the order they are bound. Positions are 16-bit unorm
+// within the mesh's quantization box (see PooledMesh::dequant), normals are
+// octahedral encoded 16-bit snorm and uvs are half floats. 16 bytes a vertex.
+#define MESH_POOL_STREAM_COUNT 3
+#define MESH_POOL_POSITION_STRIDE (sizeof(uint16_t) * 4)
+#define MESH_POOL_NORMAL_STRIDE (sizeof(int16_t) * 2)
+#define MESH_POOL_UV_STRIDE (sizeof(uint16_t) * 2)
+
+#define MESH_POOL_POSITION_FORMAT VK_FORMAT_R16G16B16A16_UNORM
+#define MESH_POOL_NORMAL_FORMAT VK_FORMAT_R16G16_SNORM
+#define MESH_POOL_UV_FORMAT VK_FORMAT_R16G16_SFLOAT
+
+#define MESH_MAX_LODS 4
+
+#define SUBMESH_NO_MATERIAL UINT32_MAX
+
+// Clusters are small enough to cull finely but big enough that the per
+// cluster work stays cheap next to the triangles it saves
+#define MESH_CLUSTER_MAX_VERTICES 64
+#define MESH_CLUSTER_MAX_TRIANGLES 124
+
+/*
+  All scene geometry lives in one device buffer laid out as
+  [indices | positions | normals | uvs]. Meshes are sub-allocated index and
+  vertex ranges of that buffer so every mesh can be drawn with the same
+  vertex bindings using firstIndex and vertexOffset. Only the index type
+  has to be rebound when it changes between meshes.
+*/
+typedef struct MeshPool {
+  VmaAllocator vma_alloc;
+  GPUBuffer gpu;
+  VkDeviceSize size;
+  VkDeviceSize index_offset;
+  VkDeviceSize stream_offsets[MESH_POOL_STREAM_COUNT];
+
+  OffsetAllocator indices;  // In MESH_POOL_INDEX_UNITs
+  OffsetAllocator vertices; // In units of vertices
+} MeshPool;
+
+// One submesh's indices for a level of detail
+typedef struct MeshLod {
+  uint32_t first_index; // Relative to the start of the mesh's index range
+  uint32_t index_count;
+} MeshLod;
+
+// A spatially coherent group of a submesh's full detail triangles
+typedef struct MeshCluster {
+  float4 bounds; // Object space bounding sphere; xyz center and w radius
+  float4 cone;   // Normal cone; xyz axis and w cutoff
+  uint32_t first_index; // Relative to the start of the mesh's index range
+  uint32_t index_count;
+} MeshCluster;
+
+// A glTF primitive. Every submesh of a mesh indexes the same vertex range.
+// Its full detail triangles are stored in cluster order so every cluster is
+// one contiguous index range.
+typedef struct Submesh {
+  uint32_t material; // Scene material index or SUBMESH_NO_MATERIAL
+  MeshLod lods[MESH_MAX_LODS];
+  uint32_t first_cluster; // Into the mesh's clusters
+  uint32_t cluster_count;
+} Submesh;
+
+/*
+  A mesh's range of the pool. The host buffer is a staging copy laid out as
+  the index data (idx_size bytes) followed by each vertex stream tightly
+  packed in pool stream order. The index range holds every submesh's levels
+  of detail back to back, starting with the full detail meshes. Levels are
+  shared by every submesh so one selection covers the whole mesh.
+*/
+typedef struct PooledMesh {
+  OffsetAllocation indices;
+  OffsetAllocation vertices;
+  VkIndexType index_type; // 32-bit only when there are too many vertices
+  float4 bounds; // Object space bounding sphere; xyz center and w radius
+  float4 dequant; // Object space position is xyz + unorm position * w
+  uint32_t lod_count;
+  // Object space distance from the full detail surface
+  float lod_errors[MESH_MAX_LODS];
+  uint32_t submesh_count;
+  Submesh *submeshes;
+  uint32_t cluster_count;
+  MeshCluster *clusters;
+  size_t idx_size;
+  GPUBuffer host;
+} PooledMesh;
+
+int32_t create_meshpool(VmaAllocator vma_alloc, Allocator std_alloc,
+                        uint32_t max_indices, uint32_t max_vertices,
+                        MeshPool *out_pool);
+void destroy_meshpool(MeshPool *p);
+
+// Only reserves ranges; the caller provides the mesh's staging buffer
+int32_t meshpool_alloc(MeshPool *p, VkIndexType index_type,
+                       uint32_t index_count, uint32_t vertex_count,
+                       PooledMesh *mesh);
+// Ranges are reused immediately so the caller must ensure no in-flight work
+// still reads from them
+void meshpool_free(MeshPool *p, PooledMesh *mesh);
+
+void meshpool_bind(const MeshPool *p, VkCommandBuffer cmd,
+                   VkIndexType index_type);
+// Vertex bindings are left alone
+void meshpool_bind_indices(const MeshPool *p, VkCommandBuffer cmd,
+                           VkIndexType index_type);
+// firstIndex of the start of the mesh's range for its index type
+uint32_t meshpool_first_index(const PooledMesh *mesh);
+void meshpool_record_upload(const MeshPool *p, VkCommandBuffer cmd,
+                            const PooledMesh *mesh);
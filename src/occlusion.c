@@ -0,0 +1,474 @@
+#include "occlusion.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "jobs.h"
+#include "profiling.h"
+
+#define INITIAL_OCCLUDER_COUNT 64
+#define INITIAL_TRI_COUNT 4096
+
+#define OCCLUSION_ROW_SIZE (OCCLUSION_WIDTH / 4)
+
+// Triangles this close to the eye are dropped rather than clipped
+#define OCCLUSION_NEAR_W 1e-4f
+
+static float4 select4(int4 mask, float4 a, float4 b) {
+  // Vector ?: isn't available in C so blend the bits by hand
+  return (float4)(((int4)a & mask) | ((int4)b & ~mask));
+}
+
+int32_t create_occlusion_buffer(Allocator std_alloc, JobSystem *jobs,
+                                OcclusionBuffer *out_buffer) {
+  OcclusionBuffer ob = {
+      .std_alloc = std_alloc,
+      .jobs = jobs,
+      .max_occluder_count = INITIAL_OCCLUDER_COUNT,
+      .max_tri_count = INITIAL_TRI_COUNT,
+      .max_bin_count = INITIAL_TRI_COUNT,
+  };
+
+  ob.depth = hb_alloc_nm_tp(std_alloc, OCCLUSION_ROW_SIZE * OCCLUSION_HEIGHT,
+                            float4);
+  ob.occluders = hb_alloc_nm_tp(std_alloc, ob.max_occluder_count, Occluder);
+  ob.tris = hb_alloc_nm_tp(std_alloc, ob.max_tri_count, OcclusionTriangle);
+  ob.bins = hb_alloc_nm_tp(std_alloc, ob.max_bin_count, uint32_t);
+  if (!ob.depth || !ob.occluders || !ob.tris || !ob.bins) {
+    assert(0);
+    destroy_occlusion_buffer(&ob);
+    return -1;
+  }
+
+  *out_buffer = ob;
+  return 0;
+}
+
+void destroy_occlusion_buffer(OcclusionBuffer *ob) {
+  Allocator std_alloc = ob->std_alloc;
+  hb_free(std_alloc, ob->bins);
+  hb_free(std_alloc, ob->tris);
+  hb_free(std_alloc, ob->occluders);
+  hb_free(std_alloc, ob->depth);
+  *ob = (OcclusionBuffer){0};
+}
+
+void occlusion_begin(OcclusionBuffer *ob, const float4x4 *vp) {
+  ob->vp = *vp;
+  ob->occluder_count = 0;
+  ob->stats = (OcclusionStats){0};
+}
+
+void occlusion_add_occluder(OcclusionBuffer *ob, const float4x4 *m,
+                            const OccluderMesh *mesh) {
+  if (mesh->index_count < 3) {
+    return;
+  }
+
+  if (ob->occluder_count == ob->max_occluder_count) {
+    uint32_t new_max = ob->max_occluder_count * 2;
+    Occluder *occluders =
+        hb_realloc_nm_tp(ob->std_alloc, ob->occluders, new_max, Occluder);
+    if (!occluders) {
+      // Missing an occluder only means culling less
+      assert(0);
+      return;
+    }
+    ob->occluders = occluders;
+    ob->max_occluder_count = new_max;
+  }
+
+  Occluder *occluder = &ob->occluders[ob->occluder_count++];
+  *occluder = (Occluder){.mesh = mesh};
+  mulmf44(&ob->vp, m, &occluder->mvp);
+}
+
+// Transforms, culls and builds edge functions four triangles at a time
+static void setup_occluder(void *user_data, uint32_t index) {
+  OcclusionBuffer *ob = (OcclusionBuffer *)user_data;
+  Occluder *occluder = &ob->occluders[index];
+  const OccluderMesh *mesh = occluder->mesh;
+  const float4x4 *mvp = &occluder->mvp;
+  OcclusionTriangle *out_tris = &ob->tris[occluder->tri_offset];
+
+  const float4 zero = {0};
+  const float4 near_w = {OCCLUSION_NEAR_W, OCCLUSION_NEAR_W, OCCLUSION_NEAR_W,
+                         OCCLUSION_NEAR_W};
+  const float4 half = {0.5f, 0.5f, 0.5f, 0.5f};
+  const float4 width = {OCCLUSION_WIDTH, OCCLUSION_WIDTH, OCCLUSION_WIDTH,
+                        OCCLUSION_WIDTH};
+  const float4 height = {OCCLUSION_HEIGHT, OCCLUSION_HEIGHT, OCCLUSION_HEIGHT,
+                         OCCLUSION_HEIGHT};
+
+  uint32_t tri_count = mesh->index_count / 3;
+  uint32_t out_count = 0;
+  for (uint32_t first = 0; first < tri_count; first += 4) {
+    uint32_t lane_count = tri_count - first < 4 ? tri_count - first : 4;
+
+    // Gather into one vector per vertex component with a triangle per lane
+    float4 px[3] = {{0}};
+    float4 py[3] = {{0}};
+    float4 pz[3] = {{0}};
+    for (uint32_t lane = 0; lane < lane_count; ++lane) {
+      for (uint32_t v = 0; v < 3; ++v) {
+        uint32_t idx = mesh->indices[(first + lane) * 3 + v];
+        const float *p = &mesh->positions[idx * 3];
+        px[v][lane] = p[0];
+        py[v][lane] = p[1];
+        pz[v][lane] = p[2];
+      }
+    }
+
+    float4 sx[3] = {{0}};
+    float4 sy[3] = {{0}};
+    float4 sz[3] = {{0}};
+    int4 valid = {0};
+    for (uint32_t lane = 0; lane < lane_count; ++lane) {
+      valid[lane] = -1;
+    }
+    for (uint32_t v = 0; v < 3; ++v) {
+      float4 cx = mvp->row0[0] * px[v] + mvp->row0[1] * py[v] +
+                  mvp->row0[2] * pz[v] + mvp->row0[3];
+      float4 cy = mvp->row1[0] * px[v] + mvp->row1[1] * py[v] +
+                  mvp->row1[2] * pz[v] + mvp->row1[3];
+      float4 cz = mvp->row2[0] * px[v] + mvp->row2[1] * py[v] +
+                  mvp->row2[2] * pz[v] + mvp->row2[3];
+      float4 cw = mvp->row3[0] * px[v] + mvp->row3[1] * py[v] +
+                  mvp->row3[2] * pz[v] + mvp->row3[3];
+
+      // Anything crossing the near plane would need clipping
+      valid &= cw > near_w;
+      cw = select4(valid, cw, near_w);
+
+      // Same mapping as the flipped viewport so winding matches the GPU
+      float4 inv_w = 1.0f / cw;
+      sx[v] = (cx * inv_w * half + half) * width;
+      sy[v] = (half - cy * inv_w * half) * height;
+      sz[v] = cz * inv_w;
+    }
+
+    // Counter clockwise front faces have negative area in screen space
+    float4 area = (sx[1] - sx[0]) * (sy[2] - sy[0]) -
+                  (sx[2] - sx[0]) * (sy[1] - sy[0]);
+    valid &= area < zero;
+
+    float4 min_x = sx[0];
+    float4 max_x = sx[0];
+    float4 min_y = sy[0];
+    float4 max_y = sy[0];
+    float4 depth = sz[0];
+    for (uint32_t v = 1; v < 3; ++v) {
+      min_x = select4(sx[v] < min_x, sx[v], min_x);
+      max_x = select4(sx[v] > max_x, sx[v], max_x);
+      min_y = select4(sy[v] < min_y, sy[v], min_y);
+      max_y = select4(sy[v] > max_y, sy[v], max_y);
+      depth = select4(sz[v] < depth, sz[v], depth);
+    }
+
+    // Edge i runs from vertex i to vertex i + 1. Tests count every pixel a
+    // box touches as covered, so each edge is pulled in by half a pixel's
+    // extent along its normal and only pixels the triangle covers entirely
+    // pass at their centers.
+    float4 edge_a[3] = {{0}};
+    float4 edge_b[3] = {{0}};
+    float4 edge_c[3] = {{0}};
+    for (uint32_t e = 0; e < 3; ++e) {
+      uint32_t n = (e + 1) % 3;
+      edge_a[e] = sy[n] - sy[e];
+      edge_b[e] = sx[e] - sx[n];
+      float4 abs_a = select4(edge_a[e] < zero, -edge_a[e], edge_a[e]);
+      float4 abs_b = select4(edge_b[e] < zero, -edge_b[e], edge_b[e]);
+      edge_c[e] = sx[n] * sy[e] - sx[e] * sy[n] - (abs_a + abs_b) * half;
+    }
+
+    for (uint32_t lane = 0; lane < lane_count; ++lane) {
+      if (!valid[lane]) {
+        continue;
+      }
+
+      // Pixels are sampled at their centers. The box still bounds the
+      // unshrunk triangle, which the edge functions trim.
+      int32_t x0 = (int32_t)ceilf(min_x[lane] - 0.5f);
+      int32_t x1 = (int32_t)floorf(max_x[lane] - 0.5f);
+      int32_t y0 = (int32_t)ceilf(min_y[lane] - 0.5f);
+      int32_t y1 = (int32_t)floorf(max_y[lane] - 0.5f);
+      x0 = x0 < 0 ? 0 : x0;
+      y0 = y0 < 0 ? 0 : y0;
+      x1 = x1 >= OCCLUSION_WIDTH ? OCCLUSION_WIDTH - 1 : x1;
+      y1 = y1 >= OCCLUSION_HEIGHT ? OCCLUSION_HEIGHT - 1 : y1;
+      if (x0 > x1 || y0 > y1) {
+        continue;
+      }
+
+      out_tris[out_count++] = (OcclusionTriangle){
+          .edge_a = {edge_a[0][lane], edge_a[1][lane], edge_a[2][lane], 0},
+          .edge_b = {edge_b[0][lane], edge_b[1][lane], edge_b[2][lane], 0},
+          .edge_c = {edge_c[0][lane], edge_c[1][lane], edge_c[2][lane], 0},
+          .depth = depth[lane],
+          .min_x = x0,
+          .min_y = y0,
+          .max_x = x1,
+          .max_y = y1,
+      };
+    }
+  }
+
+  occluder->tri_count = out_count;
+}
+
+static void tile_range(const OcclusionTriangle *tri, uint32_t *tx0,
+                       uint32_t *ty0, uint32_t *tx1, uint32_t *ty1) {
+  *tx0 = (uint32_t)tri->min_x / OCCLUSION_TILE_WIDTH;
+  *ty0 = (uint32_t)tri->min_y / OCCLUSION_TILE_HEIGHT;
+  *tx1 = (uint32_t)tri->max_x / OCCLUSION_TILE_WIDTH;
+  *ty1 = (uint32_t)tri->max_y / OCCLUSION_TILE_HEIGHT;
+}
+
+static bool bin_triangles(OcclusionBuffer *ob) {
+  TracyCZoneN(ctx, "bin_triangles", true);
+
+  memset(ob->bin_counts, 0, sizeof(ob->bin_counts));
+  for (uint32_t i = 0; i < ob->occluder_count; ++i) {
+    const Occluder *occluder = &ob->occluders[i];
+    for (uint32_t ii = 0; ii < occluder->tri_count; ++ii) {
+      uint32_t tx0, ty0, tx1, ty1;
+      tile_range(&ob->tris[occluder->tri_offset + ii], &tx0, &ty0, &tx1, &ty1);
+      for (uint32_t ty = ty0; ty <= ty1; ++ty) {
+        for (uint32_t tx = tx0; tx <= tx1; ++tx) {
+          ob->bin_counts[ty * OCCLUSION_TILES_X + tx]++;
+        }
+      }
+    }
+  }
+
+  uint32_t bin_total = 0;
+  for (uint32_t i = 0; i < OCCLUSION_TILE_COUNT; ++i) {
+    ob->bin_offsets[i] = bin_total;
+    bin_total += ob->bin_counts[i];
+    ob->bin_counts[i] = 0;
+  }
+
+  if (bin_total > ob->max_bin_count) {
+    uint32_t *bins =
+        hb_realloc_nm_tp(ob->std_alloc, ob->bins, bin_total, uint32_t);
+    if (!bins) {
+      assert(0);
+      TracyCZoneEnd(ctx);
+      return false;
+    }
+    ob->bins = bins;
+    ob->max_bin_count = bin_total;
+  }
+
+  // Walking occluders in submission order keeps each bin in that order too
+  for (uint32_t i = 0; i < ob->occluder_count; ++i) {
+    const Occluder *occluder = &ob->occluders[i];
+    for (uint32_t ii = 0; ii < occluder->tri_count; ++ii) {
+      uint32_t tri_idx = occluder->tri_offset + ii;
+      uint32_t tx0, ty0, tx1, ty1;
+      tile_range(&ob->tris[tri_idx], &tx0, &ty0, &tx1, &ty1);
+      for (uint32_t ty = ty0; ty <= ty1; ++ty) {
+        for (uint32_t tx = tx0; tx <= tx1; ++tx) {
+          uint32_t tile = ty * OCCLUSION_TILES_X + tx;
+          ob->bins[ob->bin_offsets[tile] + ob->bin_counts[tile]++] = tri_idx;
+        }
+      }
+    }
+  }
+
+  TracyCZoneEnd(ctx);
+  return true;
+}
+
+static void rasterize_tile(void *user_data, uint32_t index) {
+  OcclusionBuffer *ob = (OcclusionBuffer *)user_data;
+
+  int32_t tile_x0 = (int32_t)(index % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+  int32_t tile_y0 =
+      (int32_t)(index / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+  int32_t tile_x1 = tile_x0 + OCCLUSION_TILE_WIDTH - 1;
+  int32_t tile_y1 = tile_y0 + OCCLUSION_TILE_HEIGHT - 1;
+
+  const float4 zero = {0};
+  const float4 lane_offsets = {0.5f, 1.5f, 2.5f, 3.5f};
+
+  for (int32_t y = tile_y0; y <= tile_y1; ++y) {
+    float4 *row = &ob->depth[y * OCCLUSION_ROW_SIZE];
+    for (int32_t x = tile_x0; x <= tile_x1; x += 4) {
+      row[x / 4] = zero;
+    }
+  }
+
+  const uint32_t *bin = &ob->bins[ob->bin_offsets[index]];
+  for (uint32_t i = 0; i < ob->bin_counts[index]; ++i) {
+    const OcclusionTriangle *tri = &ob->tris[bin[i]];
+
+    int32_t x0 = tri->min_x > tile_x0 ? tri->min_x : tile_x0;
+    int32_t x1 = tri->max_x < tile_x1 ? tri->max_x : tile_x1;
+    int32_t y0 = tri->min_y > tile_y0 ? tri->min_y : tile_y0;
+    int32_t y1 = tri->max_y < tile_y1 ? tri->max_y : tile_y1;
+    // Edge functions reject the extra pixels of a rounded down block start
+    x0 &= ~3;
+
+    float4 depth = {tri->depth, tri->depth, tri->depth, tri->depth};
+
+    for (int32_t y = y0; y <= y1; ++y) {
+      float4 *row = &ob->depth[y * OCCLUSION_ROW_SIZE];
+      // Each lane of the row constants holds a different edge
+      float4 row_c = tri->edge_b * ((float)y + 0.5f) + tri->edge_c;
+
+      for (int32_t x = x0; x <= x1; x += 4) {
+        float4 px = lane_offsets + (float)x;
+        float4 e0 = tri->edge_a[0] * px + row_c[0];
+        float4 e1 = tri->edge_a[1] * px + row_c[1];
+        float4 e2 = tri->edge_a[2] * px + row_c[2];
+
+        int4 inside = (e0 >= zero) & (e1 >= zero) & (e2 >= zero);
+        float4 old = row[x / 4];
+        row[x / 4] = select4(inside & (depth > old), depth, old);
+      }
+    }
+  }
+
+  // The farthest depth in the tile lets tests skip whole tiles at once
+  float4 tile_min = {1.0f, 1.0f, 1.0f, 1.0f};
+  for (int32_t y = tile_y0; y <= tile_y1; ++y) {
+    const float4 *row = &ob->depth[y * OCCLUSION_ROW_SIZE];
+    for (int32_t x = tile_x0; x <= tile_x1; x += 4) {
+      float4 v = row[x / 4];
+      tile_min = select4(v < tile_min, v, tile_min);
+    }
+  }
+  float m = tile_min[0];
+  for (uint32_t i = 1; i < 4; ++i) {
+    m = tile_min[i] < m ? tile_min[i] : m;
+  }
+  ob->tile_min_depth[index] = m;
+}
+
+void occlusion_rasterize(OcclusionBuffer *ob) {
+  TracyCZoneN(ctx, "occlusion_rasterize", true);
+  TracyCZoneColor(ctx, TracyCategoryColorRendering);
+
+  // Give every occluder its own range so setup needs no synchronization
+  uint32_t tri_total = 0;
+  for (uint32_t i = 0; i < ob->occluder_count; ++i) {
+    ob->occluders[i].tri_offset = tri_total;
+    tri_total += ob->occluders[i].mesh->index_count / 3;
+  }
+  if (tri_total > ob->max_tri_count) {
+    OcclusionTriangle *tris = hb_realloc_nm_tp(ob->std_alloc, ob->tris,
+                                               tri_total, OcclusionTriangle);
+    if (!tris) {
+      assert(0);
+      ob->occluder_count = 0;
+      tri_total = 0;
+    } else {
+      ob->tris = tris;
+      ob->max_tri_count = tri_total;
+    }
+  }
+
+  {
+    TracyCZoneN(setup_ctx, "Setup Occluders", true);
+    job_parallel_for(ob->jobs, ob->occluder_count, setup_occluder, ob);
+    TracyCZoneEnd(setup_ctx);
+  }
+
+  if (!bin_triangles(ob)) {
+    memset(ob->bin_counts, 0, sizeof(ob->bin_counts));
+  }
+
+  {
+    TracyCZoneN(raster_ctx, "Rasterize Tiles", true);
+    job_parallel_for(ob->jobs, OCCLUSION_TILE_COUNT, rasterize_tile, ob);
+    TracyCZoneEnd(raster_ctx);
+  }
+
+  ob->stats.occluder_count = ob->occluder_count;
+  for (uint32_t i = 0; i < ob->occluder_count; ++i) {
+    ob->stats.triangle_count += ob->occluders[i].tri_count;
+  }
+
+  TracyCZoneEnd(ctx);
+}
+
+bool occlusion_test_aabb(OcclusionBuffer *ob, float3 min, float3 max) {
+  ob->stats.tested_count++;
+
+  const float4x4 *vp = &ob->vp;
+  float min_x = INFINITY;
+  float min_y = INFINITY;
+  float max_x = -INFINITY;
+  float max_y = -INFINITY;
+  float nearest = -INFINITY;
+  for (uint32_t i = 0; i < 8; ++i) {
+    float4 p = {
+        (i & 1) ? max[0] : min[0],
+        (i & 2) ? max[1] : min[1],
+        (i & 4) ? max[2] : min[2],
+        1.0f,
+    };
+    float w = dotf4(vp->row3, p);
+    if (w <= OCCLUSION_NEAR_W) {
+      // Straddling the eye; assume it covers the view
+      return true;
+    }
+    float inv_w = 1.0f / w;
+    float x = (dotf4(vp->row0, p) * inv_w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+    float y = (0.5f - dotf4(vp->row1, p) * inv_w * 0.5f) * OCCLUSION_HEIGHT;
+    float z = dotf4(vp->row2, p) * inv_w;
+    min_x = x < min_x ? x : min_x;
+    max_x = x > max_x ? x : max_x;
+    min_y = y < min_y ? y : min_y;
+    max_y = y > max_y ? y : max_y;
+    nearest = z > nearest ? z : nearest;
+  }
+
+  // Any pixel the box touches counts, not just covered centers
+  int32_t x0 = (int32_t)floorf(min_x);
+  int32_t x1 = (int32_t)floorf(max_x);
+  int32_t y0 = (int32_t)floorf(min_y);
+  int32_t y1 = (int32_t)floorf(max_y);
+  x0 = x0 < 0 ? 0 : x0;
+  y0 = y0 < 0 ? 0 : y0;
+  x1 = x1 >= OCCLUSION_WIDTH ? OCCLUSION_WIDTH - 1 : x1;
+  y1 = y1 >= OCCLUSION_HEIGHT ? OCCLUSION_HEIGHT - 1 : y1;
+  if (x0 > x1 || y0 > y1) {
+    // Off screen is for the frustum test to decide
+    return true;
+  }
+
+  for (int32_t ty = y0 / OCCLUSION_TILE_HEIGHT;
+       ty <= y1 / OCCLUSION_TILE_HEIGHT; ++ty) {
+    for (int32_t tx = x0 / OCCLUSION_TILE_WIDTH;
+         tx <= x1 / OCCLUSION_TILE_WIDTH; ++tx) {
+      // Every pixel of this tile is nearer than the whole box
+      if (ob->tile_min_depth[ty * OCCLUSION_TILES_X + tx] > nearest) {
+        continue;
+      }
+
+      int32_t px0 = tx * OCCLUSION_TILE_WIDTH;
+      int32_t py0 = ty * OCCLUSION_TILE_HEIGHT;
+      int32_t px1 = px0 + OCCLUSION_TILE_WIDTH - 1;
+      int32_t py1 = py0 + OCCLUSION_TILE_HEIGHT - 1;
+      px0 = px0 > x0 ? px0 : x0;
+      py0 = py0 > y0 ? py0 : y0;
+      px1 = px1 < x1 ? px1 : x1;
+      py1 = py1 < y1 ? py1 : y1;
+
+      for (int32_t y = py0; y <= py1; ++y) {
+        const float4 *row = &ob->depth[y * OCCLUSION_ROW_SIZE];
+        for (int32_t x = px0; x <= px1; ++x) {
+          if (row[x / 4][x & 3] <= nearest) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  ob->stats.culled_count++;
+  return false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "simd.h"
+
+typedef struct JobSystem JobSystem;
+
+// Low resolution is fine; occluders only need to cover whole objects
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_TILE_WIDTH 32
+#define OCCLUSION_TILE_HEIGHT 16
+#define OCCLUSION_TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT)
+#define OCCLUSION_TILE_COUNT (OCCLUSION_TILES_X * OCCLUSION_TILES_Y)
+
+_Static_assert(OCCLUSION_TILE_WIDTH % 4 == 0,
+               "Tiles are rasterized four pixels at a time");
+_Static_assert(OCCLUSION_WIDTH % OCCLUSION_TILE_WIDTH == 0 &&
+                   OCCLUSION_HEIGHT % OCCLUSION_TILE_HEIGHT == 0,
+               "Occlusion buffer must be a whole number of tiles");
+
+// CPU copy of the geometry an occluder is rasterized with
+typedef struct OccluderMesh {
+  uint32_t vertex_count;
+  uint32_t index_count;
+  float *positions; // Tightly packed xyz
+  uint32_t *indices;
+} OccluderMesh;
+
+// Edge functions are stored so that pixels inside have every edge >= 0
+typedef struct OcclusionTriangle {
+  float4 edge_a; // x coefficient of each edge; w unused
+  float4 edge_b; // y coefficient of each edge; w unused
+  float4 edge_c; // Constant of each edge; w unused
+  float depth;   // Farthest vertex so the triangle never occludes too much
+  int32_t min_x;
+  int32_t min_y;
+  int32_t max_x;
+  int32_t max_y;
+} OcclusionTriangle;
+
+typedef struct Occluder {
+  float4x4 mvp;
+  const OccluderMesh *mesh;
+  uint32_t tri_offset;
+  uint32_t tri_count; // Triangles that survived setup
+} Occluder;
+
+typedef struct OcclusionStats {
+  uint32_t occluder_count;
+  uint32_t triangle_count;
+  uint32_t tested_count;
+  uint32_t culled_count;
+} OcclusionStats;
+
+/*
+  A software rasterized depth buffer for culling on the CPU. Occluder
+  triangles are set up and binned into screen tiles, then each tile is
+  rasterized independently across the job system. Depth is reversed like the
+  main view so larger values are nearer.
+*/
+typedef struct OcclusionBuffer {
+  Allocator std_alloc;
+  JobSystem *jobs;
+  float4x4 vp;
+
+  float4 *depth; // Row major; four pixels per element
+  float tile_min_depth[OCCLUSION_TILE_COUNT];
+
+  uint32_t occluder_count;
+  uint32_t max_occluder_count;
+  Occluder *occluders;
+
+  uint32_t max_tri_count;
+  OcclusionTriangle *tris;
+
+  uint32_t bin_offsets[OCCLUSION_TILE_COUNT];
+  uint32_t bin_counts[OCCLUSION_TILE_COUNT];
+  uint32_t max_bin_count;
+  uint32_t *bins;
+
+  OcclusionStats stats;
+} OcclusionBuffer;
+
+int32_t create_occlusion_buffer(Allocator std_alloc, JobSystem *jobs,
+                                OcclusionBuffer *out_buffer);
+void destroy_occlusion_buffer(OcclusionBuffer *ob);
+
+// Clears the buffer and the occluder list for a new view
+void occlusion_begin(OcclusionBuffer *ob, const float4x4 *vp);
+// The mesh must stay alive until occlusion_rasterize returns
+void occlusion_add_occluder(OcclusionBuffer *ob, const float4x4 *m,
+                            const OccluderMesh *mesh);
+void occlusion_rasterize(OcclusionBuffer *ob);
+
+// Takes a world space box and returns false only when every pixel it could
+// touch is behind an occluder
+bool occlusion_test_aabb(OcclusionBuffer *ob, float3 min, float3 max);
@@ -0,0 +1,169 @@
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_timer.h>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "jobs.h"
+#include "occlusion.h"
+#include "simd.h"
+
+/*
+  Headless benchmark for the CPU occlusion culler. The camera walks down a
+  street of procedural walls that hide a grid of small boxes. Every frame the
+  walls are rasterized and each box that survives frustum culling is tested
+  against them. Pass a worker count to compare against the default of one
+  worker per spare core.
+*/
+
+#define BENCH_FRAME_COUNT 200
+#define BENCH_WALL_COUNT 64
+#define BENCH_GRID_SIZE 64
+#define BENCH_OBJECT_COUNT (BENCH_GRID_SIZE * BENCH_GRID_SIZE)
+
+static float cube_positions[] = {
+    -1, -1, -1, 1, -1, -1, 1, 1, -1, -1, 1, -1,
+    -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1,
+};
+
+static uint32_t cube_indices[] = {
+    0, 1, 2, 2, 3, 0, // -z
+    4, 7, 6, 6, 5, 4, // +z
+    0, 3, 7, 7, 4, 0, // -x
+    1, 5, 6, 6, 2, 1, // +x
+    0, 4, 5, 5, 1, 0, // -y
+    3, 2, 6, 6, 7, 3, // +y
+};
+
+static uint32_t bench_seed = 0x12345678;
+static float bench_rand(float lo, float hi) {
+  // Deterministic so runs are comparable
+  bench_seed = bench_seed * 1664525u + 1013904223u;
+  return lo + (hi - lo) * (float)(bench_seed >> 8) / (float)(1 << 24);
+}
+
+static float ms_since(uint64_t start) {
+  uint64_t ticks = SDL_GetPerformanceCounter() - start;
+  return (float)((double)ticks * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+int main(int argc, char **argv) {
+  uint32_t worker_count = UINT32_MAX;
+  if (argc > 1) {
+    worker_count = (uint32_t)atoi(argv[1]);
+  }
+
+  StandardAllocator std_alloc = {0};
+  create_standard_allocator(&std_alloc, "Occlusion Bench");
+
+  JobSystem jobs = {0};
+  if (create_job_system(std_alloc.alloc, worker_count, &jobs) != 0) {
+    return 1;
+  }
+
+  OcclusionBuffer occlusion = {0};
+  if (create_occlusion_buffer(std_alloc.alloc, &jobs, &occlusion) != 0) {
+    return 1;
+  }
+
+  OccluderMesh cube = {
+      .vertex_count = sizeof(cube_positions) / (sizeof(float) * 3),
+      .index_count = sizeof(cube_indices) / sizeof(uint32_t),
+      .positions = cube_positions,
+      .indices = cube_indices,
+  };
+
+  // Thin walls scattered down both sides of the street and across it. The
+  // unit cube is scaled to each wall's half extents.
+  float4x4 walls[BENCH_WALL_COUNT] = {{.row0 = {0}}};
+  for (uint32_t i = 0; i < BENCH_WALL_COUNT; ++i) {
+    float3 center = {bench_rand(-40, 40), 3, bench_rand(8, 160)};
+    float3 extent = {bench_rand(2, 8), 3, 0.25f};
+    walls[i] = (float4x4){
+        .row0 = {extent[0], 0, 0, center[0]},
+        .row1 = {0, extent[1], 0, center[1]},
+        .row2 = {0, 0, extent[2], center[2]},
+        .row3 = {0, 0, 0, 1},
+    };
+  }
+
+  float3 object_extent = {0.5f, 0.5f, 0.5f};
+  float3 object_centers[BENCH_OBJECT_COUNT] = {{0}};
+  for (uint32_t i = 0; i < BENCH_OBJECT_COUNT; ++i) {
+    float x = (float)(i % BENCH_GRID_SIZE) / (BENCH_GRID_SIZE - 1);
+    float z = (float)(i / BENCH_GRID_SIZE) / (BENCH_GRID_SIZE - 1);
+    object_centers[i] = (float3){x * 120 - 60, 0.5f, z * 180 + 10};
+  }
+
+  float4x4 proj = {.row0 = {0}};
+  perspective(&proj, (float)M_PI / 3.0f,
+              (float)OCCLUSION_WIDTH / OCCLUSION_HEIGHT, 0.1f, 500.0f);
+
+  uint64_t frustum_visible = 0;
+  uint64_t occlusion_culled = 0;
+  uint64_t triangle_count = 0;
+  float raster_ms = 0.0f;
+  float test_ms = 0.0f;
+
+  for (uint32_t frame = 0; frame < BENCH_FRAME_COUNT; ++frame) {
+    float t = (float)frame / BENCH_FRAME_COUNT;
+    float3 eye = {sinf(t * 6.28f) * 4.0f, 1.7f, t * 60.0f};
+    float3 target = eye + (float3){sinf(t * 3.14f) * 0.5f, 0, 1};
+
+    float4x4 view = {.row0 = {0}};
+    look_at(&view, eye, target, (float3){0, 1, 0});
+    float4x4 vp = {.row0 = {0}};
+    mulmf44(&proj, &view, &vp);
+
+    float4 planes[6] = {{0}};
+    frustum_planes(&vp, planes);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    occlusion_begin(&occlusion, &vp);
+    for (uint32_t i = 0; i < BENCH_WALL_COUNT; ++i) {
+      const float4x4 *wall = &walls[i];
+      float3 center = {wall->row0[3], wall->row1[3], wall->row2[3]};
+      float3 extent = {wall->row0[0], wall->row1[1], wall->row2[2]};
+      if (!frustum_test_sphere(planes, center, magf3(extent))) {
+        continue;
+      }
+      occlusion_add_occluder(&occlusion, wall, &cube);
+    }
+    occlusion_rasterize(&occlusion);
+    raster_ms += ms_since(start);
+
+    start = SDL_GetPerformanceCounter();
+    for (uint32_t i = 0; i < BENCH_OBJECT_COUNT; ++i) {
+      float3 center = object_centers[i];
+      if (!frustum_test_sphere(planes, center, magf3(object_extent))) {
+        continue;
+      }
+      frustum_visible++;
+      if (!occlusion_test_aabb(&occlusion, center - object_extent,
+                               center + object_extent)) {
+        occlusion_culled++;
+      }
+    }
+    test_ms += ms_since(start);
+    triangle_count += occlusion.stats.triangle_count;
+  }
+
+  SDL_Log("Workers: %u", jobs.worker_count);
+  SDL_Log("Objects: %u, Occluders: %u", BENCH_OBJECT_COUNT,
+          BENCH_WALL_COUNT);
+  SDL_Log("Occluder Triangles: %.1f per frame",
+          (double)triangle_count / BENCH_FRAME_COUNT);
+  SDL_Log("Frustum Visible: %.1f per frame",
+          (double)frustum_visible / BENCH_FRAME_COUNT);
+  SDL_Log("Occlusion Culled: %.1f%% of frustum visible",
+          frustum_visible ? 100.0 * occlusion_culled / frustum_visible : 0.0);
+  SDL_Log("Rasterize: %.3f ms, Test: %.3f ms per frame",
+          raster_ms / BENCH_FRAME_COUNT, test_ms / BENCH_FRAME_COUNT);
+
+  destroy_occlusion_buffer(&occlusion);
+  destroy_job_system(&jobs);
+  destroy_standard_allocator(std_alloc);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "offsetalloc.h"
+
+#include <SDL2/SDL_stdinc.h>
+#include <assert.h>
+
+#include "profiling.h"
+
+#define INITIAL_FREE_RANGE_COUNT 16
+
+int32_t create_offset_allocator(Allocator std_alloc, uint32_t capacity,
+                                OffsetAllocator *out_alloc) {
+  OffsetAllocation *free_ranges =
+      hb_alloc_nm_tp(std_alloc, INITIAL_FREE_RANGE_COUNT, OffsetAllocation);
+  if (!free_ranges) {
+    assert(0);
+    return -1;
+  }
+  free_ranges[0] = (OffsetAllocation){0, capacity};
+
+  *out_alloc = (OffsetAllocator){
+      .std_alloc = std_alloc,
+      .capacity = capacity,
+      .free_count = capacity > 0 ? 1 : 0,
+      .max_free_count = INITIAL_FREE_RANGE_COUNT,
+      .free_ranges = free_ranges,
+  };
+  return 0;
+}
+
+void destroy_offset_allocator(OffsetAllocator *a) {
+  hb_free(a->std_alloc, a->free_ranges);
+  *a = (OffsetAllocator){0};
+}
+
+bool offset_alloc(OffsetAllocator *a, uint32_t size, OffsetAllocation *out) {
+  if (size == 0) {
+    *out = (OffsetAllocation){0};
+    return true;
+  }
+
+  // Best fit keeps large ranges intact for large requests
+  uint32_t best = UINT32_MAX;
+  uint32_t best_size = UINT32_MAX;
+  for (uint32_t i = 0; i < a->free_count; ++i) {
+    uint32_t range_size = a->free_ranges[i].size;
+    if (range_size >= size && range_size < best_size) {
+      best = i;
+      best_size = range_size;
+      if (range_size == size) {
+        break;
+      }
+    }
+  }
+  if (best == UINT32_MAX) {
+    return false;
+  }
+
+  OffsetAllocation *range = &a->free_ranges[best];
+  *out = (OffsetAllocation){range->offset, size};
+
+  range->offset += size;
+  range->size -= size;
+  if (range->size == 0) {
+    SDL_memmove(range, range + 1,
+                (a->free_count - best - 1) * sizeof(OffsetAllocation));
+    a->free_count--;
+  }
+
+  a->used += size;
+  return true;
+}
+
+void offset_free(OffsetAllocator *a, const OffsetAllocation *allocation) {
+  uint32_t offset = allocation->offset;
+  uint32_t size = allocation->size;
+  if (size == 0) {
+    return;
+  }
+  assert(offset + size <= a->capacity);
+  assert(a->used >= size);
+
+  // Find the first free range after the one being released
+  uint32_t idx = 0;
+  while (idx < a->free_count && a->free_ranges[idx].offset < offset) {
+    idx++;
+  }
+
+  bool merge_prev = false;
+  if (idx > 0) {
+    const OffsetAllocation *prev = &a->free_ranges[idx - 1];
+    merge_prev = prev->offset + prev->size == offset;
+  }
+  bool merge_next =
+      idx < a->free_count && offset + size == a->free_ranges[idx].offset;
+
+  if (merge_prev && merge_next) {
+    a->free_ranges[idx - 1].size += size + a->free_ranges[idx].size;
+    SDL_memmove(&a->free_ranges[idx], &a->free_ranges[idx + 1],
+                (a->free_count - idx - 1) * sizeof(OffsetAllocation));
+    a->free_count--;
+  } else if (merge_prev) {
+    a->free_ranges[idx - 1].size += size;
+  } else if (merge_next) {
+    a->free_ranges[idx].offset = offset;
+    a->free_ranges[idx].size += size;
+  } else {
+    if (a->free_count == a->max_free_count) {
+      uint32_t new_max = a->max_free_count * 2;
+      OffsetAllocation *ranges = hb_realloc_nm_tp(
+          a->std_alloc, a->free_ranges, new_max, OffsetAllocation);
+      if (!ranges) {
+        // Leaking the range is better than corrupting the list
+        assert(0);
+        return;
+      }
+      a->free_ranges = ranges;
+      a->max_free_count = new_max;
+    }
+    SDL_memmove(&a->free_ranges[idx + 1], &a->free_ranges[idx],
+                (a->free_count - idx) * sizeof(OffsetAllocation));
+    a->free_ranges[idx] = (OffsetAllocation){offset, size};
+    a->free_count++;
+  }
+
+  a->used -= size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+/*
+  Hands out ranges of some linear resource (elements of a buffer, rows of a
+  table, etc.) without touching the resource itself. Free space is tracked as
+  a list of ranges sorted by offset; neighbouring ranges are merged on free so
+  the list stays as short as the fragmentation allows.
+*/
+typedef struct OffsetAllocation {
+  uint32_t offset;
+  uint32_t size;
+} OffsetAllocation;
+
+typedef struct OffsetAllocator {
+  Allocator std_alloc;
+  uint32_t capacity;
+  uint32_t used;
+
+  uint32_t free_count;
+  uint32_t max_free_count;
+  OffsetAllocation *free_ranges;
+} OffsetAllocator;
+
+int32_t create_offset_allocator(Allocator std_alloc, uint32_t capacity,
+                                OffsetAllocator *out_alloc);
+void destroy_offset_allocator(OffsetAllocator *a);
+
+// Best-fit allocation; returns false when no free range is large enough
+bool offset_alloc(OffsetAllocator *a, uint32_t size, OffsetAllocation *out);
+void offset_free(OffsetAllocator *a, const OffsetAllocation *allocation);
+
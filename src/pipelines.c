@@ -4,11 +4,16 @@
 #include "color_mesh_vert.h"
 #include "fractal_frag.h"
 #include "fractal_vert.h"
+#include "gltf_bindless_frag.h"
+#include "gltf_bindless_vert.h"
 #include "gltf_frag.h"
+#include "gltf_indirect_vert.h"
 #include "gltf_vert.h"
 #include "gpuresources.h"
+#include "hiz_comp.h"
 #include "imgui_frag.h"
 #include "imgui_vert.h"
+#include "meshpool.h"
 #include "shadercommon.h"
 #include "sky_frag.h"
 #include "sky_vert.h"
@@ -16,6 +21,8 @@
 #include "uv_mesh_vert.h"
 
 #include "gltf_closehit.h"
+#include "gltf_cluster_cull_comp.h"
+#include "gltf_cull_comp.h"
 #include "gltf_miss.h"
 #include "gltf_raygen.h"
 
@@ -716,27 +723,29 @@ uint32_t create_gltf_pipeline(VkDevice device,
                               Allocator tmp_alloc, Allocator std_alloc,
                               VkPipelineCache cache, VkRenderPass pass,
                               uint32_t w, uint32_t h, VkPipelineLayout layout,
+                              bool bindless, bool indirect,
                               GPUPipeline **pipe) {
   VkResult err = VK_SUCCESS;
+  assert(bindless || !indirect);
 
-  VkVertexInputBindingDescription vert_bindings[3] = {
-      {0, sizeof(float) * 3, VK_VERTEX_INPUT_RATE_VERTEX},
-      {1, sizeof(float) * 3, VK_VERTEX_INPUT_RATE_VERTEX},
-      {2, sizeof(float) * 2, VK_VERTEX_INPUT_RATE_VERTEX},
+  VkVertexInputBindingDescription vert_bindings[MESH_POOL_STREAM_COUNT] = {
+      {0, MESH_POOL_POSITION_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
+      {1, MESH_POOL_NORMAL_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
+      {2, MESH_POOL_UV_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
   };
 
-  VkVertexInputAttributeDescription vert_attrs[3] = {
-      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
-      {1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0},
-      {2, 2, VK_FORMAT_R32G32_SFLOAT, 0},
+  VkVertexInputAttributeDescription vert_attrs[MESH_POOL_STREAM_COUNT] = {
+      {0, 0, MESH_POOL_POSITION_FORMAT, 0},
+      {1, 1, MESH_POOL_NORMAL_FORMAT, 0},
+      {2, 2, MESH_POOL_UV_FORMAT, 0},
   };
 
   VkPipelineVertexInputStateCreateInfo vert_input_state = {0};
   vert_input_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vert_input_state.vertexBindingDescriptionCount = 3;
+  vert_input_state.vertexBindingDescriptionCount = MESH_POOL_STREAM_COUNT;
   vert_input_state.pVertexBindingDescriptions = vert_bindings;
-  vert_input_state.vertexAttributeDescriptionCount = 3;
+  vert_input_state.vertexAttributeDescriptionCount = MESH_POOL_STREAM_COUNT;
   vert_input_state.pVertexAttributeDescriptions = vert_attrs;
 
   VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {0};
@@ -769,7 +778,9 @@ uint32_t create_gltf_pipeline(VkDevice device,
       VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   depth_state.depthTestEnable = VK_TRUE;
   depth_state.depthWriteEnable = VK_TRUE;
-  depth_state.depthCompareOp = VK_COMPARE_OP_GREATER;
+  // Equal depth passes so surfaces already laid down by the depth pre-pass
+  // are shaded
+  depth_state.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
   depth_state.maxDepthBounds = 1.0f;
 
   VkPipelineColorBlendAttachmentState attachment_state = {0};
@@ -795,14 +806,27 @@ uint32_t create_gltf_pipeline(VkDevice device,
 
   VkShaderModuleCreateInfo shader_mod_create_info = {0};
   shader_mod_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  shader_mod_create_info.codeSize = sizeof(gltf_vert);
-  shader_mod_create_info.pCode = (const uint32_t *)gltf_vert;
+  if (indirect) {
+    shader_mod_create_info.codeSize = sizeof(gltf_indirect_vert);
+    shader_mod_create_info.pCode = (const uint32_t *)gltf_indirect_vert;
+  } else if (bindless) {
+    shader_mod_create_info.codeSize = sizeof(gltf_bindless_vert);
+    shader_mod_create_info.pCode = (const uint32_t *)gltf_bindless_vert;
+  } else {
+    shader_mod_create_info.codeSize = sizeof(gltf_vert);
+    shader_mod_create_info.pCode = (const uint32_t *)gltf_vert;
+  }
   err = vkCreateShaderModule(device, &shader_mod_create_info, vk_alloc,
                              &vert_mod);
   assert(err == VK_SUCCESS);
 
-  shader_mod_create_info.codeSize = sizeof(gltf_frag);
-  shader_mod_create_info.pCode = (const uint32_t *)gltf_frag;
+  if (bindless) {
+    shader_mod_create_info.codeSize = sizeof(gltf_bindless_frag);
+    shader_mod_create_info.pCode = (const uint32_t *)gltf_bindless_frag;
+  } else {
+    shader_mod_create_info.codeSize = sizeof(gltf_frag);
+    shader_mod_create_info.pCode = (const uint32_t *)gltf_frag;
+  }
   err = vkCreateShaderModule(device, &shader_mod_create_info, vk_alloc,
                              &frag_mod);
   assert(err == VK_SUCCESS);
@@ -854,6 +878,200 @@ uint32_t create_gltf_pipeline(VkDevice device,
   return err;
 }
 
+uint32_t create_gltf_depth_pipeline(VkDevice device,
+                                    const VkAllocationCallbacks *vk_alloc,
+                                    Allocator tmp_alloc, Allocator std_alloc,
+                                    VkPipelineCache cache, VkRenderPass pass,
+                                    uint32_t w, uint32_t h,
+                                    VkPipelineLayout layout,
+                                    GPUPipeline **pipe) {
+  VkResult err = VK_SUCCESS;
+
+  // Must match the vertex layout of the indirect color pipeline
+  VkVertexInputBindingDescription vert_bindings[MESH_POOL_STREAM_COUNT] = {
+      {0, MESH_POOL_POSITION_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
+      {1, MESH_POOL_NORMAL_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
+      {2, MESH_POOL_UV_STRIDE, VK_VERTEX_INPUT_RATE_VERTEX},
+  };
+
+  VkVertexInputAttributeDescription vert_attrs[MESH_POOL_STREAM_COUNT] = {
+      {0, 0, MESH_POOL_POSITION_FORMAT, 0},
+      {1, 1, MESH_POOL_NORMAL_FORMAT, 0},
+      {2, 2, MESH_POOL_UV_FORMAT, 0},
+  };
+
+  VkPipelineVertexInputStateCreateInfo vert_input_state = {0};
+  vert_input_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vert_input_state.vertexBindingDescriptionCount = MESH_POOL_STREAM_COUNT;
+  vert_input_state.pVertexBindingDescriptions = vert_bindings;
+  vert_input_state.vertexAttributeDescriptionCount = MESH_POOL_STREAM_COUNT;
+  vert_input_state.pVertexAttributeDescriptions = vert_attrs;
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {0};
+  input_assembly_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkViewport viewport = {0, h, w, -(float)h, 0, 1};
+  VkRect2D scissor = {{0, 0}, {w, h}};
+
+  VkPipelineViewportStateCreateInfo viewport_state = {0};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.pViewports = &viewport;
+  viewport_state.scissorCount = 1;
+  viewport_state.pScissors = &scissor;
+  VkPipelineRasterizationStateCreateInfo raster_state = {0};
+  raster_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  raster_state.polygonMode = VK_POLYGON_MODE_FILL;
+  raster_state.cullMode = VK_CULL_MODE_BACK_BIT;
+  raster_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  raster_state.lineWidth = 1.0f;
+  VkPipelineMultisampleStateCreateInfo multisample_state = {0};
+  multisample_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample_state.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  VkPipelineDepthStencilStateCreateInfo depth_state = {0};
+  depth_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_state.depthTestEnable = VK_TRUE;
+  depth_state.depthWriteEnable = VK_TRUE;
+  depth_state.depthCompareOp = VK_COMPARE_OP_GREATER;
+  depth_state.maxDepthBounds = 1.0f;
+
+  VkPipelineColorBlendStateCreateInfo color_blend_state = {0};
+  color_blend_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+  VkDynamicState dyn_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                 VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamic_state = {0};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = sizeof(dyn_states) / sizeof(VkDynamicState);
+  dynamic_state.pDynamicStates = dyn_states;
+
+  // Same vertex shader as the color pass so both produce identical depth
+  VkShaderModule vert_mod = VK_NULL_HANDLE;
+  {
+    VkShaderModuleCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = sizeof(gltf_indirect_vert);
+    create_info.pCode = (const uint32_t *)gltf_indirect_vert;
+    err = vkCreateShaderModule(device, &create_info, vk_alloc, &vert_mod);
+    assert(err == VK_SUCCESS);
+  }
+
+  VkPipelineShaderStageCreateInfo vert_stage = {0};
+  vert_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vert_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vert_stage.module = vert_mod;
+  vert_stage.pName = "vert";
+
+  VkGraphicsPipelineCreateInfo create_info_base = {0};
+  create_info_base.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  create_info_base.stageCount = 1;
+  create_info_base.pStages = &vert_stage;
+  create_info_base.pVertexInputState = &vert_input_state;
+  create_info_base.pInputAssemblyState = &input_assembly_state;
+  create_info_base.pViewportState = &viewport_state;
+  create_info_base.pRasterizationState = &raster_state;
+  create_info_base.pMultisampleState = &multisample_state;
+  create_info_base.pDepthStencilState = &depth_state;
+  create_info_base.pColorBlendState = &color_blend_state;
+  create_info_base.pDynamicState = &dynamic_state;
+  create_info_base.layout = layout;
+  create_info_base.renderPass = pass;
+
+  // Material permutations don't affect depth so there is only one pipeline
+  GPUPipeline *p = NULL;
+  err = (VkResult)create_gfx_pipeline(device, vk_alloc, tmp_alloc, std_alloc,
+                                      cache, 1, &create_info_base, &p);
+  assert(err == VK_SUCCESS);
+
+  set_vk_name(device, (uint64_t)p->pipelines[0], VK_OBJECT_TYPE_PIPELINE,
+              "gltf depth pipeline");
+
+  // Can destroy shader module
+  vkDestroyShaderModule(device, vert_mod, vk_alloc);
+
+  *pipe = p;
+
+  return err;
+}
+
+static uint32_t create_compute_pipeline(VkDevice device,
+                                        const VkAllocationCallbacks *vk_alloc,
+                                        VkPipelineCache cache,
+                                        VkPipelineLayout layout,
+                                        const void *code, size_t code_size,
+                                        const char *name, VkPipeline *pipe) {
+  VkResult err = VK_SUCCESS;
+
+  VkShaderModule comp_mod = VK_NULL_HANDLE;
+  {
+    VkShaderModuleCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = code_size,
+        .pCode = (const uint32_t *)code,
+    };
+    err = vkCreateShaderModule(device, &create_info, vk_alloc, &comp_mod);
+    assert(err == VK_SUCCESS);
+  }
+
+  VkComputePipelineCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage =
+          {
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+              .module = comp_mod,
+              .pName = "comp",
+          },
+      .layout = layout,
+  };
+
+  VkPipeline comp_pipeline = VK_NULL_HANDLE;
+  err = vkCreateComputePipelines(device, cache, 1, &create_info, vk_alloc,
+                                 &comp_pipeline);
+  assert(err == VK_SUCCESS);
+
+  set_vk_name(device, (uint64_t)comp_pipeline, VK_OBJECT_TYPE_PIPELINE, name);
+
+  // Can destroy shader module
+  vkDestroyShaderModule(device, comp_mod, vk_alloc);
+
+  *pipe = comp_pipeline;
+
+  return err;
+}
+
+uint32_t create_gltf_cull_pipeline(VkDevice device,
+                                   const VkAllocationCallbacks *vk_alloc,
+                                   VkPipelineCache cache,
+                                   VkPipelineLayout layout, VkPipeline *pipe) {
+  return create_compute_pipeline(device, vk_alloc, cache, layout,
+                                 gltf_cull_comp, sizeof(gltf_cull_comp),
+                                 "gltf cull pipeline", pipe);
+}
+
+uint32_t create_gltf_cluster_cull_pipeline(
+    VkDevice device, const VkAllocationCallbacks *vk_alloc,
+    VkPipelineCache cache, VkPipelineLayout layout, VkPipeline *pipe) {
+  return create_compute_pipeline(
+      device, vk_alloc, cache, layout, gltf_cluster_cull_comp,
+      sizeof(gltf_cluster_cull_comp), "gltf cluster cull pipeline", pipe);
+}
+
+uint32_t create_hiz_pipeline(VkDevice device,
+                             const VkAllocationCallbacks *vk_alloc,
+                             VkPipelineCache cache, VkPipelineLayout layout,
+                             VkPipeline *pipe) {
+  return create_compute_pipeline(device, vk_alloc, cache, layout, hiz_comp,
+                                 sizeof(hiz_comp), "hiz pipeline", pipe);
+}
+
 uint32_t create_gltf_rt_pipeline(
     VkDevice device, const VkAllocationCallbacks *vk_alloc, Allocator tmp_alloc,
     Allocator std_alloc, VkPipelineCache cache,
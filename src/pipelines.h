@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define VK_NO_PROTOTYPES
@@ -53,13 +54,41 @@ enum GLTF_PERMUTATIONS {
   // GLTF_PERM_FLAG_COUNT = 8,
 };
 
+// The bindless variant indexes one texture array with the per-draw material
+// and requires descriptor indexing support. The indirect variant is also
+// bindless and reads per-object data from the instance buffer instead of
+// push constants.
 uint32_t create_gltf_pipeline(VkDevice device,
                               const VkAllocationCallbacks *vk_alloc,
                               Allocator tmp_alloc, Allocator std_alloc,
                               VkPipelineCache cache, VkRenderPass pass,
                               uint32_t w, uint32_t h, VkPipelineLayout layout,
+                              bool bindless, bool indirect,
                               GPUPipeline **pipe);
 
+// Depth only variant of the indirect pipeline for the depth pre-pass
+uint32_t create_gltf_depth_pipeline(VkDevice device,
+                                    const VkAllocationCallbacks *vk_alloc,
+                                    Allocator tmp_alloc, Allocator std_alloc,
+                                    VkPipelineCache cache, VkRenderPass pass,
+                                    uint32_t w, uint32_t h,
+                                    VkPipelineLayout layout,
+                                    GPUPipeline **pipe);
+
+uint32_t create_gltf_cull_pipeline(VkDevice device,
+                                   const VkAllocationCallbacks *vk_alloc,
+                                   VkPipelineCache cache,
+                                   VkPipelineLayout layout, VkPipeline *pipe);
+
+uint32_t create_gltf_cluster_cull_pipeline(
+    VkDevice device, const VkAllocationCallbacks *vk_alloc,
+    VkPipelineCache cache, VkPipelineLayout layout, VkPipeline *pipe);
+
+uint32_t create_hiz_pipeline(VkDevice device,
+                             const VkAllocationCallbacks *vk_alloc,
+                             VkPipelineCache cache, VkPipelineLayout layout,
+                             VkPipeline *pipe);
+
 uint32_t create_gltf_rt_pipeline(
     VkDevice device, const VkAllocationCallbacks *vk_alloc, Allocator tmp_alloc,
     Allocator std_alloc, VkPipelineCache cache,
@@ -1,98 +1,267 @@
 #include "scene.h"
 #include "cpuresources.h"
 #include "gpuresources.h"
+#include "jobs.h"
+#include "meshimport.h"
+#include "meshpool.h"
+#include "occlusion.h"
+#include "profiling.h"
+#include "textureimport.h"
+#include "vfs.h"
 
 #include <SDL2/SDL_assert.h>
+#include <SDL2/SDL_cpuinfo.h>
 #include <SDL2/SDL_log.h>
 #include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
 
 #include <assert.h>
 #include <malloc.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <cgltf.h>
 
-cgltf_result sdl_read_gltf(const struct cgltf_memory_options *memory_options,
-                           const struct cgltf_file_options *file_options,
-                           const char *path, cgltf_size *size, void **data) {
-  SDL_RWops *file = (SDL_RWops *)file_options->user_data;
-  cgltf_size file_size = SDL_RWsize(file);
+// cgltf points the glb's binary chunk straight into the file's data so
+// buffers are never copied again; the file stays open until cgltf_free
+static cgltf_result
+vfs_read_gltf(const struct cgltf_memory_options *memory_options,
+              const struct cgltf_file_options *file_options, const char *path,
+              cgltf_size *size, void **data) {
+  const VfsFile *file = (const VfsFile *)file_options->user_data;
+  (void)memory_options;
   (void)path;
 
-  void *mem = memory_options->alloc(memory_options->user_data, file_size);
-  if (mem == NULL) {
-    assert(0);
-    return cgltf_result_out_of_memory;
+  *size = file->size;
+  *data = (void *)file->data;
+  return cgltf_result_success;
+}
+
+static void
+vfs_release_gltf(const struct cgltf_memory_options *memory_options,
+                 const struct cgltf_file_options *file_options, void *data) {
+  VfsFile *file = (VfsFile *)file_options->user_data;
+  (void)data;
+
+  vfs_close(file);
+  memory_options->free(memory_options->user_data, file);
+}
+
+static const cgltf_accessor *find_positions(const cgltf_primitive *prim) {
+  for (uint32_t i = 0; i < prim->attributes_count; ++i) {
+    if (prim->attributes[i].type == cgltf_attribute_type_position) {
+      return prim->attributes[i].data;
+    }
   }
+  return NULL;
+}
 
-  if (SDL_RWread(file, mem, file_size, 1) == 0) {
-    return cgltf_result_io_error;
+// Every primitive is merged into one occluder
+static int32_t create_occluder_mesh(Allocator std_alloc,
+                                    const cgltf_mesh *src_mesh,
+                                    OccluderMesh *dst_mesh) {
+  uint32_t vertex_count = 0;
+  uint32_t index_count = 0;
+  for (uint32_t i = 0; i < src_mesh->primitives_count; ++i) {
+    const cgltf_primitive *prim = &src_mesh->primitives[i];
+    const cgltf_accessor *positions = find_positions(prim);
+    if (!positions || !prim->indices) {
+      return -1;
+    }
+    vertex_count += (uint32_t)positions->count;
+    index_count += (uint32_t)prim->indices->count;
   }
 
-  *size = file_size;
-  *data = mem;
+  OccluderMesh mesh = {
+      .vertex_count = vertex_count,
+      .index_count = index_count,
+      .positions = hb_alloc_nm_tp(std_alloc, vertex_count * 3, float),
+      .indices = hb_alloc_nm_tp(std_alloc, index_count, uint32_t),
+  };
+  if (!mesh.positions || !mesh.indices) {
+    hb_free(std_alloc, mesh.positions);
+    hb_free(std_alloc, mesh.indices);
+    return -2;
+  }
 
-  return cgltf_result_success;
+  uint32_t base_vertex = 0;
+  uint32_t first_index = 0;
+  for (uint32_t i = 0; i < src_mesh->primitives_count; ++i) {
+    const cgltf_primitive *prim = &src_mesh->primitives[i];
+    const cgltf_accessor *positions = find_positions(prim);
+
+    // Unpacking handles any stride the source buffer view uses
+    uint32_t prim_vertex_count = (uint32_t)positions->count;
+    cgltf_accessor_unpack_floats(positions, mesh.positions + base_vertex * 3,
+                                 prim_vertex_count * 3);
+    for (uint32_t ii = 0; ii < prim->indices->count; ++ii) {
+      mesh.indices[first_index++] =
+          base_vertex + (uint32_t)cgltf_accessor_read_index(prim->indices, ii);
+    }
+    base_vertex += prim_vertex_count;
+  }
+
+  *dst_mesh = mesh;
+  return 0;
+}
+
+// Streamed meshes know their submeshes up front but have no triangles until
+// their import is committed
+static int32_t create_placeholder_mesh(Allocator std_alloc,
+                                       const cgltf_mesh *src_mesh,
+                                       PooledMesh *dst_mesh) {
+  uint32_t submesh_count = (uint32_t)src_mesh->primitives_count;
+  PooledMesh mesh = {
+      .submesh_count = submesh_count,
+      .submeshes = hb_alloc_nm_tp(std_alloc, submesh_count, Submesh),
+  };
+  if (!mesh.submeshes) {
+    return -1;
+  }
+  memset(mesh.submeshes, 0, submesh_count * sizeof(Submesh));
+
+  *dst_mesh = mesh;
+  return 0;
+}
+
+// Where each of a file's textures, materials and meshes ended up in the
+// scene. Duplicates map to the copy that was appended first.
+typedef struct SceneRemap {
+  uint32_t *textures;
+  uint32_t *materials;
+  uint32_t *meshes;
+} SceneRemap;
+
+static int32_t create_scene_remap(Allocator std_alloc, uint32_t texture_count,
+                                  uint32_t material_count, uint32_t mesh_count,
+                                  SceneRemap *out_remap) {
+  uint32_t count = texture_count + material_count + mesh_count;
+  uint32_t *indices = hb_alloc_nm_tp(std_alloc, SDL_max(count, 1), uint32_t);
+  if (!indices) {
+    return -1;
+  }
+  *out_remap = (SceneRemap){
+      .textures = indices,
+      .materials = indices + texture_count,
+      .meshes = indices + texture_count + material_count,
+  };
+  return 0;
+}
+
+static int32_t create_gltf_remap(Allocator std_alloc, const cgltf_data *data,
+                                 SceneRemap *out_remap) {
+  return create_scene_remap(std_alloc, (uint32_t)data->textures_count,
+                            (uint32_t)data->materials_count,
+                            (uint32_t)data->meshes_count, out_remap);
+}
+
+static void destroy_scene_remap(Allocator std_alloc, SceneRemap *remap) {
+  hb_free(std_alloc, remap->textures);
+  *remap = (SceneRemap){0};
+}
+
+// Content hashes of a glb's textures followed by its meshes. Images are
+// keyed by their encoded bytes and meshes by their source geometry. Only
+// touches the CPU so it is safe to run on a job as long as alloc is.
+static uint64_t *hash_gltf_resources(Allocator alloc, const cgltf_data *data) {
+  TracyCZoneN(ctx, "hash_gltf_resources", true);
+  uint32_t texture_count = (uint32_t)data->textures_count;
+  uint32_t key_count = texture_count + (uint32_t)data->meshes_count;
+  uint64_t *keys = hb_alloc_nm_tp(alloc, SDL_max(key_count, 1), uint64_t);
+  if (keys) {
+    for (uint32_t i = 0; i < texture_count; ++i) {
+      keys[i] = image_key_cgltf(&data->textures[i], data->bin);
+    }
+    for (uint32_t i = 0; i < data->meshes_count; ++i) {
+      keys[texture_count + i] = mesh_import_key(&data->meshes[i]);
+    }
+  }
+  TracyCZoneEnd(ctx);
+  return keys;
 }
 
-void sdl_release_gltf(const struct cgltf_memory_options *memory_options,
-                      const struct cgltf_file_options *file_options,
-                      void *data) {
-  SDL_RWops *file = (SDL_RWops *)file_options->user_data;
+// Each primitive brings its own material
+static uint32_t submesh_material(const cgltf_data *data,
+                                 const cgltf_mesh *src_mesh,
+                                 const uint32_t *material_map, uint32_t idx) {
+  const cgltf_material *material = src_mesh->primitives[idx].material;
+  return material ? material_map[material - data->materials]
+                  : SUBMESH_NO_MATERIAL;
+}
 
-  memory_options->free(memory_options->user_data, data);
+static void resolve_submesh_materials(const cgltf_data *data,
+                                      const cgltf_mesh *src_mesh,
+                                      const uint32_t *material_map,
+                                      PooledMesh *mesh) {
+  for (uint32_t i = 0; i < mesh->submesh_count; ++i) {
+    mesh->submeshes[i].material =
+        submesh_material(data, src_mesh, material_map, i);
+  }
+}
 
-  if (SDL_RWclose(file) != 0) {
-    assert(0);
+// Identical geometry only makes for the same mesh if its submeshes resolve
+// to the same materials too
+static uint64_t mesh_key(const cgltf_data *data, const cgltf_mesh *src_mesh,
+                         const uint32_t *material_map, uint64_t geometry_key) {
+  uint64_t key = geometry_key;
+  for (uint32_t i = 0; i < src_mesh->primitives_count; ++i) {
+    uint32_t material = submesh_material(data, src_mesh, material_map, i);
+    key = hash64(&material, sizeof(material), key);
   }
+  return key;
 }
 
 int32_t create_scene(DemoAllocContext alloc_ctx, Scene *out_scene) {
   (*out_scene) = (Scene){.alloc_ctx = alloc_ctx};
+  create_hash_index(alloc_ctx.std_alloc, &out_scene->texture_index);
+  create_hash_index(alloc_ctx.std_alloc, &out_scene->material_index);
+  create_hash_index(alloc_ctx.std_alloc, &out_scene->mesh_index);
   return 0;
 }
 
-int32_t scene_append_gltf(Scene *s, const char *filename) {
-  const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
-  VkDevice device = alloc_ctx->device;
-  Allocator std_alloc = alloc_ctx->std_alloc;
-  Allocator tmp_alloc = alloc_ctx->tmp_alloc;
-  VmaAllocator vma_alloc = alloc_ctx->vma_alloc;
-  const VkAllocationCallbacks *vk_alloc = alloc_ctx->vk_alloc;
-  VmaPool up_pool = alloc_ctx->up_pool;
-  VmaPool tex_pool = alloc_ctx->tex_pool;
+// Parses a glb and loads its buffers. Only touches the CPU so it is safe to
+// run on a job as long as alloc is.
+static int32_t load_gltf(Allocator alloc, const Vfs *vfs,
+                         const char *filename, cgltf_data **out_data) {
+  TracyCZoneN(ctx, "load_gltf", true);
 
   // Load a GLTF/GLB file off disk
   cgltf_data *data = NULL;
   {
-    // We really only want to handle glbs; gltfs should be pre-packed
-    SDL_RWops *gltf_file = SDL_RWFromFile(filename, "rb");
-
-    if (gltf_file == NULL) {
-      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+    // We really only want to handle glbs; gltfs should be pre-packed.
+    // The vfs hands out pack entries and mapped loose files in place so
+    // usually nothing is copied onto the heap.
+    VfsFile *file = hb_alloc_tp(alloc, VfsFile);
+    if (!file || !vfs_open(vfs, alloc, filename, file)) {
+      hb_free(alloc, file);
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to open %s", filename);
       assert(0);
+      TracyCZoneEnd(ctx);
       return -1;
     }
+    cgltf_file_options file_options = {
+        .read = vfs_read_gltf,
+        .release = vfs_release_gltf,
+        .user_data = file,
+    };
 
     cgltf_options options = {.type = cgltf_file_type_glb,
                              .memory =
                                  {
-                                     .user_data = std_alloc.user_data,
-                                     .alloc = std_alloc.alloc,
-                                     .free = std_alloc.free,
+                                     .user_data = alloc.user_data,
+                                     .alloc = alloc.alloc,
+                                     .free = alloc.free,
                                  },
-                             .file = {
-                                 .read = sdl_read_gltf,
-                                 .release = sdl_release_gltf,
-                                 .user_data = gltf_file,
-                             }};
+                             .file = file_options};
 
     // Parse file loaded via SDL
     cgltf_result res = cgltf_parse_file(&options, filename, &data);
     if (res != cgltf_result_success) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Failed to parse gltf");
       SDL_TriggerBreakpoint();
+      TracyCZoneEnd(ctx);
       return -1;
     }
 
@@ -100,6 +269,8 @@ int32_t scene_append_gltf(Scene *s, const char *filename) {
     if (res != cgltf_result_success) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Failed to load gltf buffers");
       SDL_TriggerBreakpoint();
+      cgltf_free(data);
+      TracyCZoneEnd(ctx);
       return -2;
     }
 
@@ -109,104 +280,255 @@ int32_t scene_append_gltf(Scene *s, const char *filename) {
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
                    "Failed to load validate gltf");
       SDL_TriggerBreakpoint();
+      cgltf_free(data);
+      TracyCZoneEnd(ctx);
       return -3;
     }
   }
 
+  *out_data = data;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+// Each reserve grows the scene's parallel arrays so count more entries fit
+static int32_t scene_reserve_textures(Scene *s, uint32_t count) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  uint32_t max_count = s->texture_count + count;
+
+  s->textures = hb_realloc_nm_tp(std_alloc, s->textures, max_count, GPUTexture);
+  s->resident_textures =
+      hb_realloc_nm_tp(std_alloc, s->resident_textures, max_count, bool);
+  s->texture_base_levels =
+      hb_realloc_nm_tp(std_alloc, s->texture_base_levels, max_count, uint32_t);
+  if (s->textures == NULL || s->resident_textures == NULL ||
+      s->texture_base_levels == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                 "Failed to allocate textures for scene");
+    SDL_TriggerBreakpoint();
+    return -4;
+  }
+  s->max_texture_count = max_count;
+  return 0;
+}
+
+static int32_t scene_reserve_materials(Scene *s, uint32_t count) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  uint32_t max_count = s->material_count + count;
+
+  s->materials =
+      hb_realloc_nm_tp(std_alloc, s->materials, max_count, GPUMaterial);
+  if (s->materials == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                 "Failed to allocate materials for scene");
+    SDL_TriggerBreakpoint();
+    return -4;
+  }
+  s->max_material_count = max_count;
+  return 0;
+}
+
+static int32_t scene_reserve_meshes(Scene *s, uint32_t count) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  uint32_t max_count = s->mesh_count + count;
+
+  s->meshes = hb_realloc_nm_tp(std_alloc, s->meshes, max_count, PooledMesh);
+  s->occluder_meshes =
+      hb_realloc_nm_tp(std_alloc, s->occluder_meshes, max_count, OccluderMesh);
+  s->resident_meshes =
+      hb_realloc_nm_tp(std_alloc, s->resident_meshes, max_count, bool);
+  if (s->meshes == NULL || s->occluder_meshes == NULL ||
+      s->resident_meshes == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                 "Failed to allocate meshes for scene");
+    SDL_TriggerBreakpoint();
+    return -4;
+  }
+  s->max_mesh_count = max_count;
+  return 0;
+}
+
+static int32_t scene_reserve_entities(Scene *s, uint32_t count) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  uint32_t max_count = s->entity_count + count;
+
+  // Alloc entity component rows
+  s->components =
+      hb_realloc_nm_tp(std_alloc, s->components, max_count, uint64_t);
+  s->static_meshes =
+      hb_realloc_nm_tp(std_alloc, s->static_meshes, max_count, uint32_t);
+  s->transforms =
+      hb_realloc_nm_tp(std_alloc, s->transforms, max_count, SceneTransform);
+  if (s->components == NULL || s->static_meshes == NULL ||
+      s->transforms == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                 "Failed to allocate entities for scene");
+    SDL_TriggerBreakpoint();
+    return -4;
+  }
+  s->max_entity_count = max_count;
+  return 0;
+}
+
+// Texture ids are already remapped by the time materials are keyed, so
+// materials that only differed by which file their textures came from hash
+// the same
+static uint64_t material_key(const GPUMaterial *material) {
+  return hash64(&material->data, sizeof(material->data),
+                material->perm_flags);
+}
+
+// Appends a loaded glb to the scene. keys come from hash_gltf_resources and
+// anything whose hash is already in the scene is referenced rather than
+// created again; remap receives where everything ended up. A streamed glb
+// only gets placeholders, which its stream makes resident later.
+static int32_t scene_commit_gltf(Scene *s, const cgltf_data *data,
+                                 const uint64_t *keys, bool stream,
+                                 SceneRemap *remap) {
+  const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
+  VkDevice device = alloc_ctx->device;
+  Allocator std_alloc = alloc_ctx->std_alloc;
+  Allocator tmp_alloc = alloc_ctx->tmp_alloc;
+  VmaAllocator vma_alloc = alloc_ctx->vma_alloc;
+  const VkAllocationCallbacks *vk_alloc = alloc_ctx->vk_alloc;
+  VmaPool up_pool = alloc_ctx->up_pool;
+  VmaPool tex_pool = alloc_ctx->tex_pool;
+
   // Collect some pre-append counts so that we can do math later
-  uint32_t old_tex_count = s->texture_count;
-  uint32_t old_mat_count = s->material_count;
-  uint32_t old_mesh_count = s->mesh_count;
   uint32_t old_node_count = s->entity_count;
 
   // Append textures to scene
   {
-    uint32_t new_tex_count = old_tex_count + (uint32_t)data->textures_count;
-
-    s->textures =
-        hb_realloc_nm_tp(std_alloc, s->textures, new_tex_count, GPUTexture);
-    if (s->textures == NULL) {
-      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
-                   "Failed to allocate textures for scene");
-      SDL_TriggerBreakpoint();
+    if (scene_reserve_textures(s, (uint32_t)data->textures_count) != 0) {
       return -4;
     }
 
-    // TODO: Determine a good way to do texture de-duplication
-    for (uint32_t i = old_tex_count; i < new_tex_count; ++i) {
-      cgltf_texture *tex = &data->textures[i - old_tex_count];
-      if (create_gputexture_cgltf(device, vma_alloc, vk_alloc, tex, data->bin,
-                                  up_pool, tex_pool, &s->textures[i]) != 0) {
+    for (uint32_t i = 0; i < data->textures_count; ++i) {
+      uint32_t idx = hash_index_find(&s->texture_index, keys[i]);
+      if (idx != HASH_INDEX_NONE) {
+        remap->textures[i] = idx;
+        continue;
+      }
+
+      idx = s->texture_count;
+      s->resident_textures[idx] = !stream;
+      int32_t err = 0;
+      if (stream) {
+        s->textures[idx] = (GPUTexture){0};
+      } else {
+        TextureImport import = {0};
+        err = import_texture_cgltf_cached(
+            std_alloc, alloc_ctx->cache_dir, &data->textures[i], data->bin,
+            keys[i], alloc_ctx->texture_format_caps, &import);
+        if (err == 0) {
+          err = create_gputexture_import(device, vma_alloc, vk_alloc, &import,
+                                         up_pool, tex_pool, &s->textures[idx]);
+        }
+        destroy_texture_import(std_alloc, &import);
+      }
+      if (err != 0) {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
                      "Failed to to create gputexture");
         SDL_TriggerBreakpoint();
         return -5;
       }
-    }
 
-    s->texture_count = new_tex_count;
+      s->texture_base_levels[idx] = s->textures[idx].mip_levels;
+      s->texture_count++;
+      remap->textures[i] = idx;
+      if (hash_index_insert(&s->texture_index, keys[i], idx) != 0) {
+        return -4;
+      }
+    }
   }
 
   // Append materials to scene
   {
-    uint32_t new_material_count =
-        old_mat_count + (uint32_t)data->textures_count;
-
-    s->materials = hb_realloc_nm_tp(std_alloc, s->materials, new_material_count,
-                                    GPUMaterial);
-    if (s->materials == NULL) {
-      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
-                   "Failed to allocate textures for scene");
-      SDL_TriggerBreakpoint();
+    if (scene_reserve_materials(s, (uint32_t)data->materials_count) != 0) {
       return -4;
     }
 
-    // TODO: Actually load materials
+    for (uint32_t i = 0; i < data->materials_count; ++i) {
+      GPUMaterial material = {0};
+      if (create_gpumaterial_cgltf(&data->materials[i], data->textures,
+                                   remap->textures, &material) != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                     "Failed to to create gpumaterial");
+        SDL_TriggerBreakpoint();
+        return -5;
+      }
+
+      uint64_t key = material_key(&material);
+      uint32_t idx = hash_index_find(&s->material_index, key);
+      if (idx != HASH_INDEX_NONE) {
+        remap->materials[i] = idx;
+        continue;
+      }
 
-    // s->material_count = new_material_count;
+      idx = s->material_count++;
+      s->materials[idx] = material;
+      remap->materials[i] = idx;
+      if (hash_index_insert(&s->material_index, key, idx) != 0) {
+        return -4;
+      }
+    }
   }
 
   // Append meshes to scene
   {
-    uint32_t new_mesh_count = old_mesh_count + (uint32_t)data->meshes_count;
-
-    s->meshes = hb_realloc_nm_tp(std_alloc, s->meshes, new_mesh_count, GPUMesh);
-    if (s->meshes == NULL) {
-      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
-                   "Failed to allocate meshes for scene");
-      SDL_TriggerBreakpoint();
+    if (scene_reserve_meshes(s, (uint32_t)data->meshes_count) != 0) {
       return -4;
     }
 
-    // TODO: Determine a good way to do texture de-duplication
-    for (uint32_t i = old_mesh_count; i < new_mesh_count; ++i) {
-      cgltf_mesh *mesh = &data->meshes[i - old_mesh_count];
-      if (create_gpumesh_cgltf(vma_alloc, tmp_alloc, mesh, &s->meshes[i]) !=
-          0) {
+    const uint64_t *mesh_keys = keys + data->textures_count;
+    for (uint32_t i = 0; i < data->meshes_count; ++i) {
+      cgltf_mesh *mesh = &data->meshes[i];
+      uint64_t key = mesh_key(data, mesh, remap->materials, mesh_keys[i]);
+      uint32_t idx = hash_index_find(&s->mesh_index, key);
+      if (idx != HASH_INDEX_NONE) {
+        remap->meshes[i] = idx;
+        continue;
+      }
+
+      idx = s->mesh_count;
+      s->occluder_meshes[idx] = (OccluderMesh){0};
+      s->resident_meshes[idx] = !stream;
+      int32_t err = 0;
+      if (stream) {
+        err = create_placeholder_mesh(std_alloc, mesh, &s->meshes[idx]);
+      } else {
+        err = create_pooledmesh_cgltf(vma_alloc, std_alloc, tmp_alloc,
+                                      alloc_ctx->mesh_pool,
+                                      alloc_ctx->cache_dir, mesh,
+                                      &s->meshes[idx]);
+      }
+      if (err != 0) {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
                      "Failed to to create gpumesh");
         SDL_TriggerBreakpoint();
         return -5;
       }
-    }
 
-    s->mesh_count = new_mesh_count;
+      resolve_submesh_materials(data, mesh, remap->materials,
+                                &s->meshes[idx]);
+      s->mesh_count++;
+      remap->meshes[i] = idx;
+      if (hash_index_insert(&s->mesh_index, key, idx) != 0) {
+        return -4;
+      }
+    }
   }
 
   // Append nodes to scene
   {
     uint32_t new_node_count = old_node_count + (uint32_t)data->nodes_count;
-
-    // Alloc entity component rows
-    s->components =
-        hb_realloc_nm_tp(std_alloc, s->components, new_node_count, uint64_t);
-    s->static_meshes =
-        hb_realloc_nm_tp(std_alloc, s->static_meshes, new_node_count, uint32_t);
-    s->transforms = hb_realloc_nm_tp(std_alloc, s->transforms, new_node_count,
-                                     SceneTransform);
+    if (scene_reserve_entities(s, (uint32_t)data->nodes_count) != 0) {
+      return -4;
+    }
 
     for (uint32_t i = old_node_count; i < new_node_count; ++i) {
       cgltf_node *node = &data->nodes[i - old_node_count];
+      s->components[i] = COMPONENT_TYPE_NONE;
 
       // For now, all nodes have transforms
       {
@@ -262,12 +584,20 @@ int32_t scene_append_gltf(Scene *s, const char *filename) {
         // Assign a static mesh component
         s->components[i] |= COMPONENT_TYPE_STATIC_MESH;
 
-        // Find the index of the mesh that matches what this node wants
-        for (uint32_t ii = 0; ii < data->meshes_count; ++ii) {
-          if (node->mesh == &data->meshes[ii]) {
-            s->static_meshes[i] = old_mesh_count + ii;
-            break;
+        // Duplicate meshes all share the first copy
+        s->static_meshes[i] = remap->meshes[node->mesh - data->meshes];
+
+        // Occluders share one CPU copy per mesh
+        if (node->name && strstr(node->name, "occluder")) {
+          OccluderMesh *occluder = &s->occluder_meshes[s->static_meshes[i]];
+          if (!occluder->positions &&
+              create_occluder_mesh(std_alloc, node->mesh, occluder) != 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                         "Failed to create occluder mesh");
+            SDL_TriggerBreakpoint();
+            return -7;
           }
+          s->components[i] |= COMPONENT_TYPE_OCCLUDER;
         }
       }
 
@@ -277,10 +607,1235 @@ int32_t scene_append_gltf(Scene *s, const char *filename) {
     s->entity_count = new_node_count;
   }
 
+  return 0;
+}
+
+int32_t scene_append_gltf(Scene *s, const char *filename) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  cgltf_data *data = NULL;
+  int32_t err = load_gltf(std_alloc, s->alloc_ctx.vfs, filename, &data);
+  if (err != 0) {
+    return err;
+  }
+
+  uint64_t *keys = hash_gltf_resources(std_alloc, data);
+  SceneRemap remap = {0};
+  if (keys && create_gltf_remap(std_alloc, data, &remap) == 0) {
+    err = scene_commit_gltf(s, data, keys, false, &remap);
+  } else {
+    err = -4;
+  }
+
+  destroy_scene_remap(std_alloc, &remap);
+  hb_free(std_alloc, keys);
   cgltf_free(data);
+  return err;
+}
+
+/*
+  A cooked scene is a glb baked offline into exactly what appending it would
+  produce: texture imports with every mip level, mesh imports in the pool's
+  staging layout and flat entity tables. Every table and payload is found by
+  its offset from the start of the file, so a mapped file is used in place
+  and each payload is copied once, straight into staging. Indices between
+  tables are local to the file and remapped as it is appended.
+*/
+#define COOKED_SCENE_MAGIC 0x53434248 // 'HBCS'
+#define COOKED_SCENE_VERSION 2
+// Tables and payloads all start on this boundary so they can be read in place
+#define COOKED_SCENE_ALIGNMENT 16
+
+typedef struct CookedSceneHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t mesh_import_version;
+  uint32_t texture_count;
+  uint32_t material_count;
+  uint32_t mesh_count;
+  uint32_t entity_count;
+  uint32_t child_count;
+  uint64_t textures;
+  uint64_t materials;
+  uint64_t meshes;
+  uint64_t entities;
+  uint64_t children;
+  uint64_t size;
+} CookedSceneHeader;
+
+typedef struct CookedTexture {
+  uint64_t key; // Same as the glb image's so both share one texture
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint64_t level_offsets[TEXTURE_MAX_LEVELS]; // From the start of pixels
+  uint64_t level_sizes[TEXTURE_MAX_LEVELS];
+  uint64_t pixels;
+  uint64_t size;
+} CookedTexture;
+
+typedef struct CookedMaterial {
+  GLTFMaterialData data; // Texture ids index the cooked textures
+  uint32_t perm_flags;
+  uint32_t texture_count;
+  uint32_t textures[MAX_MATERIAL_TEXTURES];
+  uint32_t padding[2];
+} CookedMaterial;
+
+typedef struct CookedMesh {
+  uint64_t key; // Source geometry only, like the keys of hash_gltf_resources
+  uint32_t index_count;
+  uint32_t vertex_count;
+  uint32_t index_type;
+  uint32_t lod_count;
+  float lod_errors[MESH_MAX_LODS];
+  uint32_t submesh_count; // Submesh materials index the cooked materials
+  uint32_t cluster_count;
+  float4 bounds;
+  float4 dequant;
+  uint64_t idx_size;
+  uint64_t size;
+  uint64_t submeshes;
+  uint64_t clusters;
+  uint64_t data;
+  uint32_t occluder_vertex_count; // Zero unless an occluder uses the mesh
+  uint32_t occluder_index_count;
+  uint64_t occluder_positions;
+  uint64_t occluder_indices;
+} CookedMesh;
+
+typedef struct CookedEntity {
+  uint64_t components;
+  float position[3];
+  float scale[3];
+  float rotation[3];
+  uint32_t mesh;        // Into the cooked meshes if it has a static mesh
+  uint32_t first_child; // Into the child table, which holds entity indices
+  uint32_t child_count;
+} CookedEntity;
+
+// Everything a cooked scene holds, gathered in memory before it is laid out
+typedef struct SceneCook {
+  CookedSceneHeader header;
+  CookedTexture *textures;
+  TextureImport *images;
+  CookedMaterial *materials;
+  CookedMesh *meshes;
+  MeshImport *imports;
+  OccluderMesh *occluders;
+  CookedEntity *entities;
+  uint32_t *children;
+} SceneCook;
+
+static uint64_t cook_reserve(uint64_t *offset, uint64_t size) {
+  uint64_t start = (*offset + COOKED_SCENE_ALIGNMENT - 1) &
+                   ~(uint64_t)(COOKED_SCENE_ALIGNMENT - 1);
+  *offset = start + size;
+  return start;
+}
+
+// Pads the file out to offset before writing so payloads land where the
+// layout put them
+static bool cook_write(SDL_RWops *file, uint64_t *written, uint64_t offset,
+                       const void *data, uint64_t size) {
+  static const uint8_t zeros[COOKED_SCENE_ALIGNMENT] = {0};
+  while (*written < offset) {
+    uint64_t pad = SDL_min(offset - *written, sizeof(zeros));
+    if (SDL_RWwrite(file, zeros, (size_t)pad, 1) != 1) {
+      return false;
+    }
+    *written += pad;
+  }
+  if (size > 0 && SDL_RWwrite(file, data, (size_t)size, 1) != 1) {
+    return false;
+  }
+  *written += size;
+  return true;
+}
+
+static int32_t cook_gltf(Allocator std_alloc, const cgltf_data *data,
+                         const uint64_t *keys, SceneCook *cook) {
+  uint32_t texture_count = (uint32_t)data->textures_count;
+  uint32_t material_count = (uint32_t)data->materials_count;
+  uint32_t mesh_count = (uint32_t)data->meshes_count;
+  uint32_t entity_count = (uint32_t)data->nodes_count;
+
+  uint32_t child_count = 0;
+  for (uint32_t i = 0; i < entity_count; ++i) {
+    child_count += (uint32_t)data->nodes[i].children_count;
+  }
+
+  cook->header = (CookedSceneHeader){
+      .magic = COOKED_SCENE_MAGIC,
+      .version = COOKED_SCENE_VERSION,
+      .mesh_import_version = MESH_IMPORT_VERSION,
+      .texture_count = texture_count,
+      .material_count = material_count,
+      .mesh_count = mesh_count,
+      .entity_count = entity_count,
+      .child_count = child_count,
+  };
+  cook->textures =
+      hb_alloc_nm_tp(std_alloc, SDL_max(texture_count, 1), CookedTexture);
+  cook->images =
+      hb_alloc_nm_tp(std_alloc, SDL_max(texture_count, 1), TextureImport);
+  cook->materials =
+      hb_alloc_nm_tp(std_alloc, SDL_max(material_count, 1), CookedMaterial);
+  cook->meshes = hb_alloc_nm_tp(std_alloc, SDL_max(mesh_count, 1), CookedMesh);
+  cook->imports = hb_alloc_nm_tp(std_alloc, SDL_max(mesh_count, 1), MeshImport);
+  cook->occluders =
+      hb_alloc_nm_tp(std_alloc, SDL_max(mesh_count, 1), OccluderMesh);
+  cook->entities =
+      hb_alloc_nm_tp(std_alloc, SDL_max(entity_count, 1), CookedEntity);
+  cook->children = hb_alloc_nm_tp(std_alloc, SDL_max(child_count, 1), uint32_t);
+  if (!cook->textures || !cook->images || !cook->materials || !cook->meshes ||
+      !cook->imports || !cook->occluders || !cook->entities ||
+      !cook->children) {
+    return -1;
+  }
+  memset(cook->images, 0, SDL_max(texture_count, 1) * sizeof(TextureImport));
+  memset(cook->imports, 0, SDL_max(mesh_count, 1) * sizeof(MeshImport));
+  memset(cook->occluders, 0, SDL_max(mesh_count, 1) * sizeof(OccluderMesh));
+
+  // Indices stay local to the file so every map is the identity
+  uint32_t identity_count = SDL_max(texture_count, material_count);
+  uint32_t *identity =
+      hb_alloc_nm_tp(std_alloc, SDL_max(identity_count, 1), uint32_t);
+  if (!identity) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < identity_count; ++i) {
+    identity[i] = i;
+  }
+
+  int32_t err = 0;
+  for (uint32_t i = 0; i < texture_count && err == 0; ++i) {
+    // Cooking is the cache, so the derived one is skipped. Cooked scenes
+    // aren't tied to a device so KTX2 images are transcoded to RGBA.
+    TextureImport *import = &cook->images[i];
+    if (import_texture_cgltf_cached(std_alloc, NULL, &data->textures[i],
+                                    data->bin, keys[i], 0, import) != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to decode texture %u", i);
+      err = -2;
+      break;
+    }
+    cook->textures[i] = (CookedTexture){
+        .key = keys[i],
+        .format = import->format,
+        .width = import->width,
+        .height = import->height,
+        .level_count = import->level_count,
+        .size = import->size,
+    };
+    memcpy(cook->textures[i].level_offsets, import->level_offsets,
+           sizeof(import->level_offsets));
+    memcpy(cook->textures[i].level_sizes, import->level_sizes,
+           sizeof(import->level_sizes));
+  }
+
+  for (uint32_t i = 0; i < material_count && err == 0; ++i) {
+    GPUMaterial material = {0};
+    err = create_gpumaterial_cgltf(&data->materials[i], data->textures,
+                                   identity, &material);
+    cook->materials[i] = (CookedMaterial){
+        .data = material.data,
+        .perm_flags = material.perm_flags,
+        .texture_count = material.texture_count,
+    };
+    memcpy(cook->materials[i].textures, material.textures,
+           sizeof(material.textures));
+  }
+
+  for (uint32_t i = 0; i < mesh_count && err == 0; ++i) {
+    const cgltf_mesh *src_mesh = &data->meshes[i];
+    MeshImport *import = &cook->imports[i];
+    err = import_mesh_cgltf(std_alloc, src_mesh, import);
+    if (err != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to import mesh %u", i);
+      break;
+    }
+    for (uint32_t ii = 0; ii < import->submesh_count; ++ii) {
+      import->submeshes[ii].material =
+          submesh_material(data, src_mesh, identity, ii);
+    }
+    cook->meshes[i] = (CookedMesh){
+        .key = keys[texture_count + i],
+        .index_count = import->index_count,
+        .vertex_count = import->vertex_count,
+        .index_type = (uint32_t)import->index_type,
+        .lod_count = import->lod_count,
+        .submesh_count = import->submesh_count,
+        .cluster_count = import->cluster_count,
+        .bounds = import->bounds,
+        .dequant = import->dequant,
+        .idx_size = import->idx_size,
+        .size = import->size,
+    };
+    memcpy(cook->meshes[i].lod_errors, import->lod_errors,
+           sizeof(import->lod_errors));
+  }
+
+  uint32_t first_child = 0;
+  for (uint32_t i = 0; i < entity_count && err == 0; ++i) {
+    const cgltf_node *node = &data->nodes[i];
+    if (node->children_count >= MAX_CHILD_COUNT) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                   "Node has number of children that exceeds max child count "
+                   "of: %d",
+                   MAX_CHILD_COUNT);
+      err = -6;
+      break;
+    }
+
+    CookedEntity entity = {
+        .components = COMPONENT_TYPE_TRANSFORM,
+        .position = {node->translation[0], node->translation[1],
+                     node->translation[2]},
+        .scale = {node->scale[0], node->scale[1], node->scale[2]},
+        .rotation = {node->rotation[0], node->rotation[1], node->rotation[2]},
+        .mesh = UINT32_MAX,
+        .first_child = first_child,
+        .child_count = (uint32_t)node->children_count,
+    };
+    for (uint32_t ii = 0; ii < node->children_count; ++ii) {
+      cook->children[first_child++] =
+          (uint32_t)(node->children[ii] - data->nodes);
+    }
+
+    if (node->mesh) {
+      entity.components |= COMPONENT_TYPE_STATIC_MESH;
+      entity.mesh = (uint32_t)(node->mesh - data->meshes);
+
+      // Occluders share one CPU copy per mesh
+      if (node->name && strstr(node->name, "occluder")) {
+        OccluderMesh *occluder = &cook->occluders[entity.mesh];
+        if (!occluder->positions &&
+            create_occluder_mesh(std_alloc, node->mesh, occluder) != 0) {
+          SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                       "Failed to create occluder mesh");
+          err = -7;
+          break;
+        }
+        entity.components |= COMPONENT_TYPE_OCCLUDER;
+      }
+    }
+    cook->entities[i] = entity;
+  }
+
+  hb_free(std_alloc, identity);
+  return err;
+}
+
+static int32_t write_cooked_scene(const char *filename, SceneCook *cook) {
+  CookedSceneHeader *header = &cook->header;
+
+  // Lay out the tables first, then every payload in table order
+  uint64_t offset = sizeof(CookedSceneHeader);
+  header->textures = cook_reserve(
+      &offset, header->texture_count * sizeof(CookedTexture));
+  header->materials = cook_reserve(
+      &offset, header->material_count * sizeof(CookedMaterial));
+  header->meshes =
+      cook_reserve(&offset, header->mesh_count * sizeof(CookedMesh));
+  header->entities =
+      cook_reserve(&offset, header->entity_count * sizeof(CookedEntity));
+  header->children =
+      cook_reserve(&offset, header->child_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < header->texture_count; ++i) {
+    CookedTexture *texture = &cook->textures[i];
+    texture->pixels = cook_reserve(&offset, texture->size);
+  }
+  for (uint32_t i = 0; i < header->mesh_count; ++i) {
+    CookedMesh *mesh = &cook->meshes[i];
+    const OccluderMesh *occluder = &cook->occluders[i];
+    mesh->submeshes =
+        cook_reserve(&offset, mesh->submesh_count * sizeof(Submesh));
+    mesh->clusters =
+        cook_reserve(&offset, mesh->cluster_count * sizeof(MeshCluster));
+    mesh->data = cook_reserve(&offset, mesh->size);
+    if (occluder->positions) {
+      mesh->occluder_vertex_count = occluder->vertex_count;
+      mesh->occluder_index_count = occluder->index_count;
+      mesh->occluder_positions = cook_reserve(
+          &offset, occluder->vertex_count * 3 * sizeof(float));
+      mesh->occluder_indices =
+          cook_reserve(&offset, occluder->index_count * sizeof(uint32_t));
+    }
+  }
+  header->size = offset;
+
+  SDL_RWops *file = SDL_RWFromFile(filename, "wb");
+  if (!file) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+    return -1;
+  }
+
+  uint64_t written = 0;
+  bool ok =
+      cook_write(file, &written, 0, header, sizeof(CookedSceneHeader)) &&
+      cook_write(file, &written, header->textures, cook->textures,
+                 header->texture_count * sizeof(CookedTexture)) &&
+      cook_write(file, &written, header->materials, cook->materials,
+                 header->material_count * sizeof(CookedMaterial)) &&
+      cook_write(file, &written, header->meshes, cook->meshes,
+                 header->mesh_count * sizeof(CookedMesh)) &&
+      cook_write(file, &written, header->entities, cook->entities,
+                 header->entity_count * sizeof(CookedEntity)) &&
+      cook_write(file, &written, header->children, cook->children,
+                 header->child_count * sizeof(uint32_t));
+
+  for (uint32_t i = 0; i < header->texture_count && ok; ++i) {
+    const CookedTexture *texture = &cook->textures[i];
+    ok = cook_write(file, &written, texture->pixels, cook->images[i].data,
+                    texture->size);
+  }
+  for (uint32_t i = 0; i < header->mesh_count && ok; ++i) {
+    const CookedMesh *mesh = &cook->meshes[i];
+    const MeshImport *import = &cook->imports[i];
+    const OccluderMesh *occluder = &cook->occluders[i];
+    ok = cook_write(file, &written, mesh->submeshes, import->submeshes,
+                    mesh->submesh_count * sizeof(Submesh)) &&
+         cook_write(file, &written, mesh->clusters, import->clusters,
+                    mesh->cluster_count * sizeof(MeshCluster)) &&
+         cook_write(file, &written, mesh->data, import->data, mesh->size);
+    if (ok && occluder->positions) {
+      ok = cook_write(file, &written, mesh->occluder_positions,
+                      occluder->positions,
+                      occluder->vertex_count * 3 * sizeof(float)) &&
+           cook_write(file, &written, mesh->occluder_indices,
+                      occluder->indices,
+                      occluder->index_count * sizeof(uint32_t));
+    }
+  }
+  ok = cook_write(file, &written, header->size, NULL, 0) && ok;
+
+  if (SDL_RWclose(file) != 0 || !ok) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to write %s", filename);
+    return -2;
+  }
   return 0;
 }
 
+static void destroy_scene_cook(Allocator std_alloc, SceneCook *cook) {
+  const CookedSceneHeader *header = &cook->header;
+  for (uint32_t i = 0; cook->images && i < header->texture_count; ++i) {
+    destroy_texture_import(std_alloc, &cook->images[i]);
+  }
+  for (uint32_t i = 0; cook->imports && i < header->mesh_count; ++i) {
+    destroy_mesh_import(std_alloc, &cook->imports[i]);
+    hb_free(std_alloc, cook->occluders[i].positions);
+    hb_free(std_alloc, cook->occluders[i].indices);
+  }
+  hb_free(std_alloc, cook->textures);
+  hb_free(std_alloc, cook->images);
+  hb_free(std_alloc, cook->materials);
+  hb_free(std_alloc, cook->meshes);
+  hb_free(std_alloc, cook->imports);
+  hb_free(std_alloc, cook->occluders);
+  hb_free(std_alloc, cook->entities);
+  hb_free(std_alloc, cook->children);
+  *cook = (SceneCook){0};
+}
+
+int32_t scene_cook_gltf(Allocator std_alloc, const char *src_filename,
+                        const char *dst_filename) {
+  TracyCZoneN(ctx, "scene_cook_gltf", true);
+  cgltf_data *data = NULL;
+  // Cooking runs on loose source files
+  int32_t err = load_gltf(std_alloc, NULL, src_filename, &data);
+  if (err != 0) {
+    TracyCZoneEnd(ctx);
+    return err;
+  }
+
+  SceneCook cook = {.textures = NULL};
+  uint64_t *keys = hash_gltf_resources(std_alloc, data);
+  err = keys ? cook_gltf(std_alloc, data, keys, &cook) : -1;
+  if (err == 0) {
+    err = write_cooked_scene(dst_filename, &cook);
+  }
+  if (err == 0) {
+    SDL_Log("Cooked %s (%u textures, %u materials, %u meshes, %u entities, "
+            "%llu bytes)",
+            src_filename, cook.header.texture_count,
+            cook.header.material_count, cook.header.mesh_count,
+            cook.header.entity_count,
+            (unsigned long long)cook.header.size);
+  }
+
+  destroy_scene_cook(std_alloc, &cook);
+  hb_free(std_alloc, keys);
+  cgltf_free(data);
+  TracyCZoneEnd(ctx);
+  return err;
+}
+
+static bool cooked_range(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset % COOKED_SCENE_ALIGNMENT == 0 && offset <= file_size &&
+         size <= file_size - offset;
+}
+
+// A view of the texture's levels where they sit in the file
+static TextureImport cooked_texture_import(const uint8_t *data,
+                                           const CookedTexture *texture) {
+  TextureImport import = {
+      .format = texture->format,
+      .width = texture->width,
+      .height = texture->height,
+      .level_count = texture->level_count,
+      .size = (size_t)texture->size,
+      .data = (uint8_t *)(data + texture->pixels),
+  };
+  memcpy(import.level_offsets, texture->level_offsets,
+         sizeof(import.level_offsets));
+  memcpy(import.level_sizes, texture->level_sizes,
+         sizeof(import.level_sizes));
+  return import;
+}
+
+static bool cooked_texture_idx(uint32_t idx, uint32_t texture_count) {
+  return idx == GLTF_TEXTURE_NONE || idx < texture_count;
+}
+
+// Cooked scenes come from disk so every offset and index is checked before
+// anything is appended; a stale or damaged file is rejected as a whole
+static bool validate_cooked_scene(const uint8_t *data, size_t size) {
+  if (size < sizeof(CookedSceneHeader)) {
+    return false;
+  }
+  const CookedSceneHeader *header = (const CookedSceneHeader *)data;
+  if (header->magic != COOKED_SCENE_MAGIC ||
+      header->version != COOKED_SCENE_VERSION ||
+      header->mesh_import_version != MESH_IMPORT_VERSION ||
+      header->size != size ||
+      !cooked_range(header->textures,
+                    header->texture_count * sizeof(CookedTexture), size) ||
+      !cooked_range(header->materials,
+                    header->material_count * sizeof(CookedMaterial), size) ||
+      !cooked_range(header->meshes, header->mesh_count * sizeof(CookedMesh),
+                    size) ||
+      !cooked_range(header->entities,
+                    header->entity_count * sizeof(CookedEntity), size) ||
+      !cooked_range(header->children, header->child_count * sizeof(uint32_t),
+                    size)) {
+    return false;
+  }
+
+  const CookedTexture *textures =
+      (const CookedTexture *)(data + header->textures);
+  for (uint32_t i = 0; i < header->texture_count; ++i) {
+    const CookedTexture *texture = &textures[i];
+    if (!cooked_range(texture->pixels, texture->size, size)) {
+      return false;
+    }
+    TextureImport import = cooked_texture_import(data, texture);
+    if (!validate_texture_import(&import)) {
+      return false;
+    }
+  }
+
+  const CookedMaterial *materials =
+      (const CookedMaterial *)(data + header->materials);
+  for (uint32_t i = 0; i < header->material_count; ++i) {
+    const CookedMaterial *material = &materials[i];
+    if (material->texture_count > MAX_MATERIAL_TEXTURES ||
+        !cooked_texture_idx(material->data.albedo_idx, header->texture_count) ||
+        !cooked_texture_idx(material->data.normal_idx, header->texture_count) ||
+        !cooked_texture_idx(material->data.roughness_idx,
+                            header->texture_count)) {
+      return false;
+    }
+    for (uint32_t ii = 0; ii < material->texture_count; ++ii) {
+      if (material->textures[ii] >= header->texture_count) {
+        return false;
+      }
+    }
+  }
+
+  const CookedMesh *meshes = (const CookedMesh *)(data + header->meshes);
+  for (uint32_t i = 0; i < header->mesh_count; ++i) {
+    const CookedMesh *mesh = &meshes[i];
+    if (mesh->lod_count > MESH_MAX_LODS ||
+        !cooked_range(mesh->submeshes, mesh->submesh_count * sizeof(Submesh),
+                      size) ||
+        !cooked_range(mesh->clusters,
+                      mesh->cluster_count * sizeof(MeshCluster), size) ||
+        !cooked_range(mesh->data, mesh->size, size) ||
+        mesh->idx_size > mesh->size) {
+      return false;
+    }
+    const Submesh *submeshes = (const Submesh *)(data + mesh->submeshes);
+    for (uint32_t ii = 0; ii < mesh->submesh_count; ++ii) {
+      uint32_t material = submeshes[ii].material;
+      if (material != SUBMESH_NO_MATERIAL &&
+          material >= header->material_count) {
+        return false;
+      }
+    }
+    if (mesh->occluder_vertex_count > 0 &&
+        (!cooked_range(mesh->occluder_positions,
+                       mesh->occluder_vertex_count * 3 * sizeof(float),
+                       size) ||
+         !cooked_range(mesh->occluder_indices,
+                       mesh->occluder_index_count * sizeof(uint32_t), size))) {
+      return false;
+    }
+  }
+
+  const CookedEntity *entities =
+      (const CookedEntity *)(data + header->entities);
+  const uint32_t *children = (const uint32_t *)(data + header->children);
+  for (uint32_t i = 0; i < header->entity_count; ++i) {
+    const CookedEntity *entity = &entities[i];
+    if (((entity->components & COMPONENT_TYPE_STATIC_MESH) &&
+         entity->mesh >= header->mesh_count) ||
+        entity->child_count >= MAX_CHILD_COUNT ||
+        entity->first_child > header->child_count ||
+        entity->child_count > header->child_count - entity->first_child) {
+      return false;
+    }
+    for (uint32_t ii = 0; ii < entity->child_count; ++ii) {
+      if (children[entity->first_child + ii] >= header->entity_count) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Builds the import over the file itself so mesh data is copied once,
+// straight into the pool's staging
+static int32_t scene_commit_cooked_mesh(Scene *s, const uint8_t *data,
+                                        const CookedMesh *mesh,
+                                        const SceneRemap *remap,
+                                        uint64_t key) {
+  const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
+  MeshImport import = {
+      .index_count = mesh->index_count,
+      .vertex_count = mesh->vertex_count,
+      .index_type = (VkIndexType)mesh->index_type,
+      .lod_count = mesh->lod_count,
+      .submesh_count = mesh->submesh_count,
+      .submeshes = (Submesh *)(data + mesh->submeshes),
+      .cluster_count = mesh->cluster_count,
+      .clusters = (MeshCluster *)(data + mesh->clusters),
+      .bounds = mesh->bounds,
+      .dequant = mesh->dequant,
+      .idx_size = (size_t)mesh->idx_size,
+      .size = (size_t)mesh->size,
+      .data = (uint8_t *)(data + mesh->data),
+  };
+  memcpy(import.lod_errors, mesh->lod_errors, sizeof(import.lod_errors));
+
+  uint32_t idx = s->mesh_count;
+  s->occluder_meshes[idx] = (OccluderMesh){0};
+  if (create_pooledmesh_import(alloc_ctx->vma_alloc, alloc_ctx->std_alloc,
+                               alloc_ctx->mesh_pool, &import,
+                               &s->meshes[idx]) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", "Failed to to create gpumesh");
+    SDL_TriggerBreakpoint();
+    return -5;
+  }
+  for (uint32_t i = 0; i < mesh->submesh_count; ++i) {
+    uint32_t *material = &s->meshes[idx].submeshes[i].material;
+    if (*material != SUBMESH_NO_MATERIAL) {
+      *material = remap->materials[*material];
+    }
+  }
+  s->resident_meshes[idx] = true;
+  s->mesh_count++;
+  return hash_index_insert(&s->mesh_index, key, idx);
+}
+
+static int32_t scene_commit_cooked(Scene *s, const uint8_t *data,
+                                   SceneRemap *remap) {
+  const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
+  Allocator std_alloc = alloc_ctx->std_alloc;
+  const CookedSceneHeader *header = (const CookedSceneHeader *)data;
+
+  if (scene_reserve_textures(s, header->texture_count) != 0 ||
+      scene_reserve_materials(s, header->material_count) != 0 ||
+      scene_reserve_meshes(s, header->mesh_count) != 0 ||
+      scene_reserve_entities(s, header->entity_count) != 0) {
+    return -4;
+  }
+
+  // Every level goes straight from the file into staging
+  const CookedTexture *textures =
+      (const CookedTexture *)(data + header->textures);
+  for (uint32_t i = 0; i < header->texture_count; ++i) {
+    const CookedTexture *texture = &textures[i];
+    uint32_t idx = hash_index_find(&s->texture_index, texture->key);
+    if (idx != HASH_INDEX_NONE) {
+      remap->textures[i] = idx;
+      continue;
+    }
+
+    idx = s->texture_count;
+    TextureImport import = cooked_texture_import(data, texture);
+    if (create_gputexture_import(alloc_ctx->device, alloc_ctx->vma_alloc,
+                                 alloc_ctx->vk_alloc, &import,
+                                 alloc_ctx->up_pool, alloc_ctx->tex_pool,
+                                 &s->textures[idx]) != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                   "Failed to to create gputexture");
+      SDL_TriggerBreakpoint();
+      return -5;
+    }
+    s->resident_textures[idx] = true;
+    s->texture_base_levels[idx] = s->textures[idx].mip_levels;
+    s->texture_count++;
+    remap->textures[i] = idx;
+    if (hash_index_insert(&s->texture_index, texture->key, idx) != 0) {
+      return -4;
+    }
+  }
+
+  const CookedMaterial *materials =
+      (const CookedMaterial *)(data + header->materials);
+  for (uint32_t i = 0; i < header->material_count; ++i) {
+    const CookedMaterial *cooked = &materials[i];
+    GPUMaterial material = {
+        .data = cooked->data,
+        .perm_flags = cooked->perm_flags,
+        .texture_count = cooked->texture_count,
+    };
+    uint32_t *ids[] = {
+        &material.data.albedo_idx,
+        &material.data.normal_idx,
+        &material.data.roughness_idx,
+    };
+    for (uint32_t ii = 0; ii < sizeof(ids) / sizeof(ids[0]); ++ii) {
+      if (*ids[ii] != GLTF_TEXTURE_NONE) {
+        *ids[ii] = remap->textures[*ids[ii]];
+      }
+    }
+    for (uint32_t ii = 0; ii < cooked->texture_count; ++ii) {
+      material.textures[ii] = remap->textures[cooked->textures[ii]];
+    }
+
+    uint64_t key = material_key(&material);
+    uint32_t idx = hash_index_find(&s->material_index, key);
+    if (idx != HASH_INDEX_NONE) {
+      remap->materials[i] = idx;
+      continue;
+    }
+
+    idx = s->material_count++;
+    s->materials[idx] = material;
+    remap->materials[i] = idx;
+    if (hash_index_insert(&s->material_index, key, idx) != 0) {
+      return -4;
+    }
+  }
+
+  // Mesh data goes straight from the file into staging too
+  const CookedMesh *meshes = (const CookedMesh *)(data + header->meshes);
+  for (uint32_t i = 0; i < header->mesh_count; ++i) {
+    const CookedMesh *mesh = &meshes[i];
+    const Submesh *submeshes = (const Submesh *)(data + mesh->submeshes);
+
+    // Keyed the same as mesh_key so glb and cooked copies are shared
+    uint64_t key = mesh->key;
+    for (uint32_t ii = 0; ii < mesh->submesh_count; ++ii) {
+      uint32_t material = submeshes[ii].material;
+      if (material != SUBMESH_NO_MATERIAL) {
+        material = remap->materials[material];
+      }
+      key = hash64(&material, sizeof(material), key);
+    }
+    uint32_t idx = hash_index_find(&s->mesh_index, key);
+    if (idx == HASH_INDEX_NONE) {
+      idx = s->mesh_count;
+      int32_t err = scene_commit_cooked_mesh(s, data, mesh, remap, key);
+      if (err != 0) {
+        return err;
+      }
+    }
+    remap->meshes[i] = idx;
+
+    // Occluders share one CPU copy per mesh
+    OccluderMesh *occluder = &s->occluder_meshes[idx];
+    if (mesh->occluder_vertex_count > 0 && !occluder->positions) {
+      size_t positions_size = mesh->occluder_vertex_count * 3 * sizeof(float);
+      size_t indices_size = mesh->occluder_index_count * sizeof(uint32_t);
+      *occluder = (OccluderMesh){
+          .vertex_count = mesh->occluder_vertex_count,
+          .index_count = mesh->occluder_index_count,
+          .positions = hb_alloc(std_alloc, positions_size),
+          .indices = hb_alloc(std_alloc, indices_size),
+      };
+      if (!occluder->positions || !occluder->indices) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s",
+                     "Failed to create occluder mesh");
+        SDL_TriggerBreakpoint();
+        return -7;
+      }
+      memcpy(occluder->positions, data + mesh->occluder_positions,
+             positions_size);
+      memcpy(occluder->indices, data + mesh->occluder_indices, indices_size);
+    }
+  }
+
+  const CookedEntity *entities =
+      (const CookedEntity *)(data + header->entities);
+  const uint32_t *children = (const uint32_t *)(data + header->children);
+  uint32_t old_entity_count = s->entity_count;
+  for (uint32_t i = 0; i < header->entity_count; ++i) {
+    const CookedEntity *entity = &entities[i];
+    uint32_t idx = old_entity_count + i;
+    SceneTransform *transform = &s->transforms[idx];
+
+    s->components[idx] = entity->components;
+    transform->t = (Transform){
+        .position = {entity->position[0], entity->position[1],
+                     entity->position[2]},
+        .scale = {entity->scale[0], entity->scale[1], entity->scale[2]},
+        .rotation = {entity->rotation[0], entity->rotation[1],
+                     entity->rotation[2]},
+    };
+    transform->child_count = entity->child_count;
+    for (uint32_t ii = 0; ii < entity->child_count; ++ii) {
+      transform->children[ii] =
+          old_entity_count + children[entity->first_child + ii];
+    }
+    if (entity->components & COMPONENT_TYPE_STATIC_MESH) {
+      s->static_meshes[idx] = remap->meshes[entity->mesh];
+    }
+  }
+  s->entity_count += header->entity_count;
+
+  return 0;
+}
+
+static int32_t scene_append_cooked_data(Scene *s, const char *filename,
+                                        const VfsFile *file) {
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  if (!validate_cooked_scene(file->data, file->size)) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "%s is not a valid cooked scene; it may need cooking again",
+                filename);
+    return -2;
+  }
+
+  const CookedSceneHeader *header = (const CookedSceneHeader *)file->data;
+  SceneRemap remap = {0};
+  int32_t err = create_scene_remap(std_alloc, header->texture_count,
+                                   header->material_count, header->mesh_count,
+                                   &remap);
+  if (err == 0) {
+    err = scene_commit_cooked(s, file->data, &remap);
+  }
+  destroy_scene_remap(std_alloc, &remap);
+  return err;
+}
+
+int32_t scene_append_cooked(Scene *s, const char *filename) {
+  TracyCZoneN(ctx, "scene_append_cooked", true);
+  VfsFile file = {0};
+  if (!vfs_open(s->alloc_ctx.vfs, s->alloc_ctx.std_alloc, filename, &file)) {
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  int32_t err = scene_append_cooked_data(s, filename, &file);
+  vfs_close(&file);
+  TracyCZoneEnd(ctx);
+  return err;
+}
+
+int32_t scene_append_cooked_files(Scene *s, JobSystem *jobs,
+                                  uint32_t file_count,
+                                  const char *const *filenames,
+                                  int32_t *out_errs) {
+  TracyCZoneN(ctx, "scene_append_cooked_files", true);
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+  VfsFile *files = hb_alloc_nm_tp(std_alloc, file_count, VfsFile);
+  if (!files) {
+    TracyCZoneEnd(ctx);
+    return -4;
+  }
+
+  // Every file decompresses at once; appending is still in the order given
+  vfs_open_many(s->alloc_ctx.vfs, jobs, std_alloc, file_count, filenames,
+                files);
+  for (uint32_t i = 0; i < file_count; ++i) {
+    out_errs[i] = files[i].data
+                      ? scene_append_cooked_data(s, filenames[i], &files[i])
+                      : -1;
+    vfs_close(&files[i]);
+  }
+
+  hb_free(std_alloc, files);
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+// One glb of a stream. The parsed glb is kept until the stream is destroyed
+// since decoding reads from it and committing resolves materials with it.
+typedef struct SceneStreamFile {
+  const char *filename;
+  StandardAllocator alloc;
+  cgltf_data *data;
+  uint64_t *keys;
+  int32_t err;
+  SceneRemap remap;
+  // Scene counts before the file was committed. Only meshes and textures
+  // remapped past these are new, so only those are streamed by this file.
+  uint32_t first_mesh;
+  uint32_t first_texture;
+} SceneStreamFile;
+
+typedef struct SceneStreamItem {
+  uint32_t file;
+  uint32_t index;       // Mesh or texture within the file
+  uint32_t scene_index; // Mesh or texture within the scene
+  bool mesh;
+  bool committed; // Only touched by the thread updating the stream
+  int32_t err;
+  SDL_atomic_t done; // Set by the job once the results below are written
+  StandardAllocator alloc;
+  TextureImport texture;
+  MeshImport import;
+} SceneStreamItem;
+
+struct SceneStream {
+  Allocator std_alloc;
+  const Vfs *vfs;
+  const char *cache_dir;
+  uint32_t format_caps;
+  uint64_t start;
+
+  uint32_t file_count;
+  SceneStreamFile *files;
+
+  // Meshes first, then textures, since a mesh with flat materials is a
+  // better stand in than nothing at all
+  uint32_t item_count;
+  SceneStreamItem *items;
+  uint32_t first_pending; // Every item before this one is committed
+  uint32_t done_count;
+
+  scene_stream_progress_fn *progress;
+  void *user_data;
+
+  // Decoding gets its own workers so it never holds up the caller's jobs
+  SDL_atomic_t cancel;
+  JobSystem jobs;
+  SDL_Thread *thread;
+};
+
+static void scene_stream_load_job(void *user_data, uint32_t index) {
+  SceneStream *stream = (SceneStream *)user_data;
+  SceneStreamFile *file = &stream->files[index];
+
+  create_standard_allocator(&file->alloc, "Scene Stream");
+  file->err =
+      load_gltf(file->alloc.alloc, stream->vfs, file->filename, &file->data);
+  if (file->err == 0) {
+    file->keys = hash_gltf_resources(file->alloc.alloc, file->data);
+    file->err = file->keys ? 0 : -4;
+  }
+  destroy_standard_allocator(file->alloc);
+}
+
+static void scene_stream_decode_job(void *user_data, uint32_t index) {
+  SceneStream *stream = (SceneStream *)user_data;
+  SceneStreamItem *item = &stream->items[index];
+  const cgltf_data *data = stream->files[item->file].data;
+
+  if (SDL_AtomicGet(&stream->cancel)) {
+    item->err = -1;
+  } else if (item->mesh) {
+    TracyCZoneN(ctx, "Stream Mesh", true);
+    create_standard_allocator(&item->alloc, "Scene Stream");
+    item->err = import_mesh_cgltf_cached(item->alloc.alloc, stream->cache_dir,
+                                         &data->meshes[item->index],
+                                         &item->import);
+    destroy_standard_allocator(item->alloc);
+    TracyCZoneEnd(ctx);
+  } else {
+    TracyCZoneN(ctx, "Stream Texture", true);
+    const SceneStreamFile *file = &stream->files[item->file];
+    create_standard_allocator(&item->alloc, "Scene Stream");
+    item->err = import_texture_cgltf_cached(
+        item->alloc.alloc, stream->cache_dir, &data->textures[item->index],
+        data->bin, file->keys[item->index], stream->format_caps,
+        &item->texture);
+    destroy_standard_allocator(item->alloc);
+    TracyCZoneEnd(ctx);
+  }
+
+  // Publishes the results to the thread updating the stream
+  SDL_AtomicSet(&item->done, 1);
+}
+
+static int scene_stream_thread(void *data) {
+  SceneStream *stream = (SceneStream *)data;
+  job_parallel_for(&stream->jobs, stream->item_count, scene_stream_decode_job,
+                   stream);
+  return 0;
+}
+
+int32_t scene_stream_gltfs(Scene *s, JobSystem *jobs, uint32_t file_count,
+                           const char *const *filenames,
+                           scene_stream_progress_fn *progress, void *user_data,
+                           uint32_t *first_entities, SceneStream **out_stream) {
+  TracyCZoneN(ctx, "scene_stream_gltfs", true);
+  Allocator std_alloc = s->alloc_ctx.std_alloc;
+
+  SceneStream *stream = hb_alloc_tp(std_alloc, SceneStream);
+  if (!stream) {
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  *stream = (SceneStream){
+      .std_alloc = std_alloc,
+      .vfs = s->alloc_ctx.vfs,
+      .cache_dir = s->alloc_ctx.cache_dir,
+      .format_caps = s->alloc_ctx.texture_format_caps,
+      .start = SDL_GetPerformanceCounter(),
+      .file_count = file_count,
+      .files = hb_alloc_nm_tp(std_alloc, file_count, SceneStreamFile),
+      .progress = progress,
+      .user_data = user_data,
+  };
+  for (uint32_t i = 0; i < file_count; ++i) {
+    stream->files[i] = (SceneStreamFile){.filename = filenames[i]};
+  }
+
+  // Entities can't be handed out before their nodes are known so parsing
+  // is the one part that has to finish up front
+  job_parallel_for(jobs, file_count, scene_stream_load_job, stream);
+
+  int32_t err = 0;
+  uint32_t old_mesh_count = s->mesh_count;
+  uint32_t old_texture_count = s->texture_count;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    SceneStreamFile *file = &stream->files[i];
+    if (file->err != 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to load %s",
+                   file->filename);
+      err = file->err;
+      continue;
+    }
+
+    file->first_mesh = s->mesh_count;
+    file->first_texture = s->texture_count;
+    if (first_entities) {
+      first_entities[i] = s->entity_count;
+    }
+    err = create_gltf_remap(std_alloc, file->data, &file->remap);
+    if (err == 0) {
+      err = scene_commit_gltf(s, file->data, file->keys, true, &file->remap);
+    }
+  }
+  if (err != 0) {
+    // Whatever was appended stays in the scene as placeholders
+    destroy_scene_stream(stream);
+    TracyCZoneEnd(ctx);
+    return err;
+  }
+
+  // Duplicates were folded into resources appended earlier so only what is
+  // new to the scene gets decoded. New entries were appended in the order
+  // they first appear in their file.
+  uint32_t mesh_count = s->mesh_count - old_mesh_count;
+  uint32_t texture_count = s->texture_count - old_texture_count;
+  stream->item_count = mesh_count + texture_count;
+  stream->items = hb_alloc_nm_tp(std_alloc, SDL_max(stream->item_count, 1),
+                                 SceneStreamItem);
+  uint32_t mesh_idx = 0;
+  uint32_t texture_idx = mesh_count;
+  for (uint32_t i = 0; i < file_count; ++i) {
+    const SceneStreamFile *file = &stream->files[i];
+    uint32_t next_mesh = file->first_mesh;
+    for (uint32_t ii = 0; ii < file->data->meshes_count; ++ii) {
+      if (file->remap.meshes[ii] != next_mesh) {
+        continue;
+      }
+      stream->items[mesh_idx++] = (SceneStreamItem){
+          .file = i,
+          .index = ii,
+          .scene_index = next_mesh++,
+          .mesh = true,
+      };
+    }
+    uint32_t next_texture = file->first_texture;
+    for (uint32_t ii = 0; ii < file->data->textures_count; ++ii) {
+      if (file->remap.textures[ii] != next_texture) {
+        continue;
+      }
+      stream->items[texture_idx++] = (SceneStreamItem){
+          .file = i,
+          .index = ii,
+          .scene_index = next_texture++,
+      };
+    }
+  }
+
+  // The stream thread works on its own batch too so leave a core for the
+  // thread rendering the placeholders
+  int32_t cpu_count = SDL_GetCPUCount();
+  uint32_t worker_count = cpu_count > 2 ? (uint32_t)cpu_count - 2 : 0;
+  err = create_job_system(std_alloc, worker_count, &stream->jobs);
+  if (err == 0) {
+    stream->thread =
+        SDL_CreateThread(scene_stream_thread, "Scene Stream", stream);
+    if (!stream->thread) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+      err = -2;
+    }
+  }
+  if (err != 0) {
+    destroy_scene_stream(stream);
+    TracyCZoneEnd(ctx);
+    return err;
+  }
+
+  if (progress) {
+    progress(user_data, 0, stream->item_count);
+  }
+
+  *out_stream = stream;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+static int32_t scene_stream_commit(Scene *s, SceneStream *stream,
+                                   SceneStreamItem *item) {
+  const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
+  const SceneStreamFile *file = &stream->files[item->file];
+
+  if (!item->mesh) {
+    int32_t err = create_gputexture_import(
+        alloc_ctx->device, alloc_ctx->vma_alloc, alloc_ctx->vk_alloc,
+        &item->texture, alloc_ctx->up_pool, alloc_ctx->tex_pool,
+        &s->textures[item->scene_index]);
+    destroy_texture_import(item->alloc.alloc, &item->texture);
+    if (err != 0) {
+      s->textures[item->scene_index] = (GPUTexture){0};
+      return err;
+    }
+    s->resident_textures[item->scene_index] = true;
+    s->texture_base_levels[item->scene_index] =
+        s->textures[item->scene_index].mip_levels;
+    return 0;
+  }
+
+  PooledMesh mesh = {0};
+  int32_t err =
+      create_pooledmesh_import(alloc_ctx->vma_alloc, alloc_ctx->std_alloc,
+                               alloc_ctx->mesh_pool, &item->import, &mesh);
+  destroy_mesh_import(item->alloc.alloc, &item->import);
+  if (err != 0) {
+    return err;
+  }
+
+  // The placeholder's submeshes are replaced by the imported ones
+  PooledMesh *placeholder = &s->meshes[item->scene_index];
+  hb_free(alloc_ctx->std_alloc, placeholder->submeshes);
+  *placeholder = mesh;
+  resolve_submesh_materials(file->data, &file->data->meshes[item->index],
+                            file->remap.materials, placeholder);
+  s->resident_meshes[item->scene_index] = true;
+  return 0;
+}
+
+bool scene_stream_update(Scene *s, SceneStream *stream,
+                         SceneStreamUpdate *out_update) {
+  TracyCZoneN(ctx, "scene_stream_update", true);
+  *out_update = (SceneStreamUpdate){0};
+
+  // Items finish in any order so everything past the first pending one is
+  // checked, but only so much is committed per update
+  uint32_t old_done_count = stream->done_count;
+  for (uint32_t i = stream->first_pending; i < stream->item_count; ++i) {
+    SceneStreamItem *item = &stream->items[i];
+    if (item->committed || !SDL_AtomicGet(&item->done)) {
+      continue;
+    }
+
+    uint32_t *count =
+        item->mesh ? &out_update->mesh_count : &out_update->texture_count;
+    if (*count == SCENE_STREAM_MAX_COMMITS) {
+      continue;
+    }
+
+    int32_t err = item->err;
+    if (err == 0) {
+      err = scene_stream_commit(s, stream, item);
+    }
+    if (err == 0) {
+      uint32_t *indices =
+          item->mesh ? out_update->meshes : out_update->textures;
+      indices[(*count)++] = item->scene_index;
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to stream %s %u of %s",
+                   item->mesh ? "mesh" : "texture", item->index,
+                   stream->files[item->file].filename);
+    }
+    item->committed = true;
+    stream->done_count++;
+  }
+  while (stream->first_pending < stream->item_count &&
+         stream->items[stream->first_pending].committed) {
+    stream->first_pending++;
+  }
+
+  bool done = stream->done_count == stream->item_count;
+  if (stream->done_count != old_done_count) {
+    if (stream->progress) {
+      stream->progress(stream->user_data, stream->done_count,
+                       stream->item_count);
+    }
+    if (done) {
+      double ms = (double)(SDL_GetPerformanceCounter() - stream->start) *
+                  1000.0 / (double)SDL_GetPerformanceFrequency();
+      SDL_Log("Streamed %u glbs (%u items) in %.2f ms on %u workers",
+              stream->file_count, stream->item_count, ms,
+              stream->jobs.worker_count);
+    }
+  }
+
+  TracyCZoneEnd(ctx);
+  return done;
+}
+
+void destroy_scene_stream(SceneStream *stream) {
+  Allocator std_alloc = stream->std_alloc;
+
+  // Jobs that haven't started skip their work once cancelled so this only
+  // waits on what is already decoding
+  SDL_AtomicSet(&stream->cancel, 1);
+  if (stream->thread) {
+    SDL_WaitThread(stream->thread, NULL);
+  }
+  destroy_job_system(&stream->jobs);
+
+  for (uint32_t i = 0; i < stream->item_count; ++i) {
+    SceneStreamItem *item = &stream->items[i];
+    if (!SDL_AtomicGet(&item->done) || item->committed || item->err != 0) {
+      continue;
+    }
+    if (item->mesh) {
+      destroy_mesh_import(item->alloc.alloc, &item->import);
+    } else {
+      destroy_texture_import(item->alloc.alloc, &item->texture);
+    }
+  }
+  for (uint32_t i = 0; i < stream->file_count; ++i) {
+    SceneStreamFile *file = &stream->files[i];
+    destroy_scene_remap(std_alloc, &file->remap);
+    hb_free(file->alloc.alloc, file->keys);
+    if (file->data) {
+      cgltf_free(file->data);
+    }
+  }
+  hb_free(std_alloc, stream->items);
+  hb_free(std_alloc, stream->files);
+  hb_free(std_alloc, stream);
+}
+
 void destroy_scene(Scene *s) {
   const DemoAllocContext *alloc_ctx = &s->alloc_ctx;
   VkDevice device = alloc_ctx->device;
@@ -290,17 +1845,33 @@ void destroy_scene(Scene *s) {
 
   // Clean up GPU memory
   for (uint32_t i = 0; i < s->mesh_count; i++) {
-    destroy_gpumesh(vma_alloc, &s->meshes[i]);
+    if (s->resident_meshes[i]) {
+      destroy_pooledmesh(vma_alloc, std_alloc, alloc_ctx->mesh_pool,
+                         &s->meshes[i]);
+    } else {
+      hb_free(std_alloc, s->meshes[i].submeshes);
+    }
+    hb_free(std_alloc, s->occluder_meshes[i].positions);
+    hb_free(std_alloc, s->occluder_meshes[i].indices);
   }
 
   for (uint32_t i = 0; i < s->texture_count; i++) {
-    destroy_texture(device, vma_alloc, vk_alloc, &s->textures[i]);
+    if (s->resident_textures[i]) {
+      destroy_texture(device, vma_alloc, vk_alloc, &s->textures[i]);
+    }
   }
 
   // Clean up CPU-side arrays
+  destroy_hash_index(&s->texture_index);
+  destroy_hash_index(&s->material_index);
+  destroy_hash_index(&s->mesh_index);
   hb_free(std_alloc, s->materials);
   hb_free(std_alloc, s->meshes);
+  hb_free(std_alloc, s->occluder_meshes);
+  hb_free(std_alloc, s->resident_meshes);
   hb_free(std_alloc, s->textures);
+  hb_free(std_alloc, s->resident_textures);
+  hb_free(std_alloc, s->texture_base_levels);
   hb_free(std_alloc, s->components);
   hb_free(std_alloc, s->static_meshes);
   hb_free(std_alloc, s->transforms);
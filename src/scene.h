@@ -1,23 +1,30 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "allocator.h"
+#include "hash.h"
 #include "simd.h"
 
 typedef struct VkDevice_T *VkDevice;
 typedef struct VmaAllocator_T *VmaAllocator;
 typedef struct VmaPool_T *VmaPool;
-typedef struct GPUMesh GPUMesh;
+typedef struct MeshPool MeshPool;
+typedef struct PooledMesh PooledMesh;
 typedef struct GPUTexture GPUTexture;
 typedef struct GPUMaterial GPUMaterial;
+typedef struct OccluderMesh OccluderMesh;
+typedef struct JobSystem JobSystem;
+typedef struct Vfs Vfs;
+typedef struct SceneStream SceneStream;
 typedef struct VkAllocationCallbacks VkAllocationCallbacks;
 
 enum ComponentType {
   COMPONENT_TYPE_NONE = 0x00000000,
   COMPONENT_TYPE_TRANSFORM = 0x00000001,
   COMPONENT_TYPE_STATIC_MESH = 0x00000002,
-  COMPONENT_TYPE_MATERIAL = 0x00000004,
+  COMPONENT_TYPE_OCCLUDER = 0x00000008,
 };
 
 #define MAX_CHILD_COUNT 256
@@ -35,6 +42,11 @@ typedef struct DemoAllocContext {
   VmaAllocator vma_alloc;
   VmaPool up_pool;
   VmaPool tex_pool;
+  MeshPool *mesh_pool;
+  const char *cache_dir; // Where derived asset data is cached; may be NULL
+  const Vfs *vfs;        // Resolves asset paths; NULL reads loose files only
+  // TEXTURE_FORMAT_ bits that KTX2 images are transcoded for
+  uint32_t texture_format_caps;
 } DemoAllocContext;
 
 typedef struct Scene {
@@ -49,17 +61,93 @@ typedef struct Scene {
 
   uint32_t max_mesh_count;
   uint32_t mesh_count;
-  GPUMesh *meshes;
+  PooledMesh *meshes;
+  // Parallel to meshes; only filled in for meshes used by an occluder
+  OccluderMesh *occluder_meshes;
+  // Parallel to meshes. A streamed mesh starts out as a placeholder with its
+  // submeshes and materials but no triangles and must not be drawn.
+  bool *resident_meshes;
 
   uint32_t max_texture_count;
   uint32_t texture_count;
   GPUTexture *textures;
+  // Parallel to textures. A streamed texture has no image until resident so
+  // materials should fall back to their factors.
+  bool *resident_textures;
+  // Parallel to textures; the finest mip level uploaded so far, which
+  // sampling is clamped to. Equal to the texture's mip_levels until whoever
+  // uploads it records otherwise.
+  uint32_t *texture_base_levels;
 
   uint32_t max_material_count;
   uint32_t material_count;
   GPUMaterial *materials;
+
+  // Content hashes of every texture, material and mesh above. Glbs that
+  // repeat each other's images or geometry share one copy of each, which
+  // lives as long as the scene does.
+  HashIndex texture_index;
+  HashIndex material_index;
+  HashIndex mesh_index;
 } Scene;
 
 int32_t create_scene(DemoAllocContext alloc_ctx, Scene *out_scene);
+// Nodes with "occluder" in their name are also marked as occluders and keep
+// a CPU copy of their mesh for the software occlusion culler. Textures,
+// materials and meshes already in the scene are referenced rather than
+// loaded again.
 int32_t scene_append_gltf(Scene *s, const char *filename);
+
+// Bakes a glb into a cooked scene: decoded textures, imported meshes and
+// flat entity tables that can be appended without parsing or importing
+// anything. Run offline by the scenecook tool.
+int32_t scene_cook_gltf(Allocator std_alloc, const char *src_filename,
+                        const char *dst_filename);
+// Appends a cooked scene the same as scene_append_gltf would append its
+// source glb, sharing anything already in the scene. Returns -1 when the
+// file doesn't exist and -2 when it is stale or damaged, so callers can fall
+// back to the glb.
+int32_t scene_append_cooked(Scene *s, const char *filename);
+// Appends many cooked scenes in the order given, decompressing all of them
+// across jobs first. Each file's result goes to out_errs. Must not be called
+// from inside a job.
+int32_t scene_append_cooked_files(Scene *s, JobSystem *jobs,
+                                  uint32_t file_count,
+                                  const char *const *filenames,
+                                  int32_t *out_errs);
+
+// Most meshes and textures a single stream update will make resident, which
+// bounds the staging work handed to a frame
+#define SCENE_STREAM_MAX_COMMITS 8
+
+// Invoked by scene_stream_update whenever more of the stream is done, failed
+// items included
+typedef void scene_stream_progress_fn(void *user_data, uint32_t done_count,
+                                      uint32_t total_count);
+
+// What one stream update made resident, so the caller can queue uploads
+typedef struct SceneStreamUpdate {
+  uint32_t mesh_count;
+  uint32_t meshes[SCENE_STREAM_MAX_COMMITS];
+  uint32_t texture_count;
+  uint32_t textures[SCENE_STREAM_MAX_COMMITS];
+} SceneStreamUpdate;
+
+// Parses the glbs on jobs and appends their entities and materials right
+// away, along with placeholders for every mesh and texture. The first entity
+// of each file is written to first_entities if it isn't NULL. Image decoding
+// and mesh imports then run on a background thread with its own workers so
+// jobs is free again once this returns. filenames must outlive the stream.
+int32_t scene_stream_gltfs(Scene *s, JobSystem *jobs, uint32_t file_count,
+                           const char *const *filenames,
+                           scene_stream_progress_fn *progress, void *user_data,
+                           uint32_t *first_entities, SceneStream **out_stream);
+// Commits whatever finished decoding since the last update, up to
+// SCENE_STREAM_MAX_COMMITS of each kind. Returns true once every item is done.
+bool scene_stream_update(Scene *s, SceneStream *stream,
+                         SceneStreamUpdate *out_update);
+// Cancels any outstanding work and waits for it to stop. Anything not yet
+// resident stays a placeholder.
+void destroy_scene_stream(SceneStream *stream);
+
 void destroy_scene(Scene *s);
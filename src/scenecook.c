@@ -0,0 +1,33 @@
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_timer.h>
+
+#include "allocator.h"
+#include "scene.h"
+
+/*
+  Offline cooker for scenes. Bakes a glb into the cooked format that
+  scene_append_cooked reads so the demo skips parsing, image decoding and
+  mesh imports at load time. Needs no GPU; the build runs it on every glb
+  under assets/scenes.
+*/
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    SDL_Log("Usage: %s <in.glb> <out.hbscene>", argv[0]);
+    return 1;
+  }
+
+  StandardAllocator std_alloc = {0};
+  create_standard_allocator(&std_alloc, "Scene Cook");
+
+  uint64_t start = SDL_GetPerformanceCounter();
+  int32_t err = scene_cook_gltf(std_alloc.alloc, argv[1], argv[2]);
+  uint64_t ticks = SDL_GetPerformanceCounter() - start;
+  if (err == 0) {
+    SDL_Log("Cooked in %.3f ms",
+            (double)ticks * 1000.0 / SDL_GetPerformanceFrequency());
+  }
+
+  destroy_standard_allocator(std_alloc);
+  return err == 0 ? 0 : 1;
+}
@@ -3,6 +3,8 @@
 #include "simd.h"
 
 #include "common.hlsli"
+#include "gltf.hlsli"
+#include "hiz.hlsli"
 #include "imgui.hlsli"
 
 #define PUSH_CONSTANT_BYTES 128
@@ -13,6 +15,18 @@ _Static_assert(sizeof(SkyPushConstants) <= PUSH_CONSTANT_BYTES,
                "Too Many Push Constants");
 _Static_assert(sizeof(ImGuiPushConstants) <= PUSH_CONSTANT_BYTES,
                "Too Many Push Constants");
+_Static_assert(sizeof(GLTFCullConstants) <= PUSH_CONSTANT_BYTES,
+               "Too Many Push Constants");
+_Static_assert(sizeof(HiZConstants) <= PUSH_CONSTANT_BYTES,
+               "Too Many Push Constants");
+_Static_assert(sizeof(GLTFMaterialData) % 16 == 0,
+               "Material records must match structured buffer stride");
+_Static_assert(sizeof(GLTFObjectData) % 16 == 0,
+               "Object records must match structured buffer stride");
+_Static_assert(sizeof(GLTFInstanceData) % 16 == 0,
+               "Instance records must match structured buffer stride");
+_Static_assert(sizeof(GLTFDrawCommand) == 20,
+               "Draw commands must match VkDrawIndexedIndirectCommand");
 
 typedef struct SkyData {
   float time;
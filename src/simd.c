@@ -284,6 +284,38 @@ void perspective(float4x4 *m, float fovy, float aspect, float zn, float zf) {
   };
 }
 
+void frustum_planes(const float4x4 *vp, float4 *planes) {
+  assert(vp);
+  assert(planes);
+
+  // Depth is reversed so the near plane is z <= w and the far plane is z >= 0
+  planes[0] = vp->row3 + vp->row0; // Left
+  planes[1] = vp->row3 - vp->row0; // Right
+  planes[2] = vp->row3 + vp->row1; // Bottom
+  planes[3] = vp->row3 - vp->row1; // Top
+  planes[4] = vp->row3 - vp->row2; // Near
+  planes[5] = vp->row2;            // Far
+
+  for (uint32_t i = 0; i < 6; ++i) {
+    float4 p = planes[i];
+    float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    planes[i] = p / len;
+  }
+}
+
+bool frustum_test_sphere(const float4 *planes, float3 center, float radius) {
+  assert(planes);
+
+  for (uint32_t i = 0; i < 6; ++i) {
+    float4 p = planes[i];
+    if (p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3] <
+        -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef float __attribute__((vector_size(16))) float4;
@@ -90,3 +91,9 @@ void transform_to_matrix(float4x4 *m, const Transform *t);
 void look_forward(float4x4 *m, float3 pos, float3 forward, float3 up);
 void look_at(float4x4 *m, float3 pos, float3 target, float3 up);
 void perspective(float4x4 *m, float fovy, float aspect, float zn, float zf);
+
+// Extracts the 6 normalized clip planes of a view projection matrix as
+// xyz normal and w distance; points inside have dot(n, p) + d >= 0
+void frustum_planes(const float4x4 *vp, float4 *planes);
+// False only when the sphere is entirely outside one of the planes
+bool frustum_test_sphere(const float4 *planes, float3 center, float radius);
@@ -0,0 +1,167 @@
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_timer.h>
+
+#include <string.h>
+
+#include "allocator.h"
+#include "jobs.h"
+#include "textureimport.h"
+
+/*
+  Headless benchmark for KTX2 transcoding on the job system. The shipped
+  shfsaida set is read into memory once and then transcoded with 1, 2, 4, 8
+  and 16 threads, counting the submitting thread. The set is repeated so
+  there are enough textures to keep every thread busy, the way a scene with
+  many materials would. Only the CPU is touched and the cache is skipped.
+  Pass bc, astc or etc2 to pick the device to transcode for and the
+  directory the .ktx2 files were built to.
+*/
+
+#define BENCH_RUN_COUNT 3
+#define BENCH_SET_COPIES 4
+
+static const char *bench_textures[] = {
+    "shfsaida_Albedo.ktx2",
+    "shfsaida_Displacement.ktx2",
+    "shfsaida_Normal.ktx2",
+    "shfsaida_Roughness.ktx2",
+};
+#define BENCH_TEXTURE_COUNT                                                    \
+  (sizeof(bench_textures) / sizeof(bench_textures[0]))
+#define BENCH_BATCH_SIZE (BENCH_TEXTURE_COUNT * BENCH_SET_COPIES)
+
+static const uint32_t bench_thread_counts[] = {1, 2, 4, 8, 16};
+
+typedef struct BenchFile {
+  uint8_t *data;
+  size_t size;
+} BenchFile;
+
+typedef struct BenchBatch {
+  const BenchFile *files;
+  uint32_t format_caps;
+  uint64_t sizes[BENCH_BATCH_SIZE];
+  int32_t errs[BENCH_BATCH_SIZE];
+} BenchBatch;
+
+static float ms_since(uint64_t start) {
+  uint64_t ticks = SDL_GetPerformanceCounter() - start;
+  return (float)((double)ticks * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static bool read_bench_file(Allocator alloc, const char *path,
+                            BenchFile *out_file) {
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  size_t size = (size_t)SDL_RWsize(file);
+  uint8_t *data = hb_alloc(alloc, size);
+  bool ok = data && SDL_RWread(file, data, size, 1) == 1;
+  SDL_RWclose(file);
+  if (!ok) {
+    hb_free(alloc, data);
+    return false;
+  }
+  *out_file = (BenchFile){data, size};
+  return true;
+}
+
+static void transcode_job(void *user_data, uint32_t index) {
+  BenchBatch *batch = (BenchBatch *)user_data;
+  const BenchFile *file = &batch->files[index % BENCH_TEXTURE_COUNT];
+
+  StandardAllocator alloc = {0};
+  create_standard_allocator(&alloc, "Texture Bench Job");
+  TextureImport import = {0};
+  batch->errs[index] = import_texture_ktx2(alloc.alloc, NULL, file->data,
+                                           file->size, batch->format_caps,
+                                           &import);
+  batch->sizes[index] = import.size;
+  destroy_texture_import(alloc.alloc, &import);
+  destroy_standard_allocator(alloc);
+}
+
+int main(int argc, char **argv) {
+  uint32_t format_caps = TEXTURE_FORMAT_BC1 | TEXTURE_FORMAT_BC4 |
+                         TEXTURE_FORMAT_BC5 | TEXTURE_FORMAT_BC7;
+  if (argc > 1) {
+    if (strcmp(argv[1], "astc") == 0) {
+      format_caps = TEXTURE_FORMAT_ASTC;
+    } else if (strcmp(argv[1], "etc2") == 0) {
+      format_caps = TEXTURE_FORMAT_ETC2_RGB | TEXTURE_FORMAT_ETC2_RGBA |
+                    TEXTURE_FORMAT_EAC_R11 | TEXTURE_FORMAT_EAC_RG11;
+    }
+  }
+  const char *texture_dir = argc > 2 ? argv[2] : "./assets/textures";
+
+  StandardAllocator std_alloc = {0};
+  create_standard_allocator(&std_alloc, "Texture Bench");
+
+  BenchFile files[BENCH_TEXTURE_COUNT] = {{0}};
+  uint64_t file_size = 0;
+  for (uint32_t i = 0; i < BENCH_TEXTURE_COUNT; ++i) {
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s/%s", texture_dir, bench_textures[i]);
+    if (!read_bench_file(std_alloc.alloc, path, &files[i])) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to read %s", path);
+      return 1;
+    }
+    file_size += files[i].size;
+  }
+
+  SDL_Log("Textures: %u (%u copies of %u), %.1f MB of KTX2",
+          (uint32_t)BENCH_BATCH_SIZE, BENCH_SET_COPIES,
+          (uint32_t)BENCH_TEXTURE_COUNT,
+          (double)(file_size * BENCH_SET_COPIES) / (1024.0 * 1024.0));
+
+  float base_ms = 0.0f;
+  const uint32_t config_count =
+      sizeof(bench_thread_counts) / sizeof(bench_thread_counts[0]);
+  for (uint32_t t = 0; t < config_count; ++t) {
+    uint32_t threads = bench_thread_counts[t];
+
+    // The submitting thread works on the batch too
+    JobSystem jobs = {0};
+    if (create_job_system(std_alloc.alloc, threads - 1, &jobs) != 0) {
+      return 1;
+    }
+
+    BenchBatch batch = {
+        .files = files,
+        .format_caps = format_caps,
+    };
+    float best_ms = 0.0f;
+    for (uint32_t run = 0; run < BENCH_RUN_COUNT; ++run) {
+      uint64_t start = SDL_GetPerformanceCounter();
+      job_parallel_for(&jobs, BENCH_BATCH_SIZE, transcode_job, &batch);
+      float ms = ms_since(start);
+      best_ms = run == 0 ? ms : SDL_min(best_ms, ms);
+    }
+    destroy_job_system(&jobs);
+
+    uint64_t out_size = 0;
+    for (uint32_t i = 0; i < BENCH_BATCH_SIZE; ++i) {
+      if (batch.errs[i] != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to transcode %s",
+                     bench_textures[i % BENCH_TEXTURE_COUNT]);
+        return 1;
+      }
+      out_size += batch.sizes[i];
+    }
+
+    if (t == 0) {
+      base_ms = best_ms;
+    }
+    SDL_Log("Threads: %2u, %8.2f ms, %5.2fx, %.1f MB transcoded", threads,
+            best_ms, base_ms / best_ms,
+            (double)out_size / (1024.0 * 1024.0));
+  }
+
+  for (uint32_t i = 0; i < BENCH_TEXTURE_COUNT; ++i) {
+    hb_free(std_alloc.alloc, files[i].data);
+  }
+  destroy_standard_allocator(std_alloc);
+  return 0;
+}
@@ -0,0 +1,509 @@
+#include "textureimport.h"
+
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
+#include <ktx.h>
+#include <math.h>
+#include <string.h>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "derivedcache.h"
+#include "hash.h"
+#include "imagedecode.h"
+#include "jobs.h"
+#include "profiling.h"
+
+#define TEXTURE_CACHE_MAGIC 0x43585448 // 'HTXC'
+
+// The import's data follows the header
+typedef struct TextureCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint64_t level_offsets[TEXTURE_MAX_LEVELS];
+  uint64_t level_sizes[TEXTURE_MAX_LEVELS];
+  uint64_t size;
+} TextureCacheHeader;
+
+uint64_t texture_import_key(uint64_t source_key, uint32_t target) {
+  return hash64(&target, sizeof(target), source_key);
+}
+
+bool validate_texture_import(const TextureImport *import) {
+  if (import->width == 0 || import->height == 0 || import->level_count == 0 ||
+      import->level_count > TEXTURE_MAX_LEVELS) {
+    return false;
+  }
+  for (uint32_t i = 0; i < import->level_count; ++i) {
+    uint64_t offset = import->level_offsets[i];
+    uint64_t size = import->level_sizes[i];
+    if (size == 0 || offset > import->size || size > import->size - offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decoding is a table lookup. Encoding searches the midpoints between
+// neighbouring decoded values so every linear value rounds to the nearest
+// sRGB byte.
+typedef struct SRGBTables {
+  float to_linear[256];
+  float bounds[255];
+} SRGBTables;
+
+static void build_srgb_tables(SRGBTables *tables) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    float c = (float)i / 255.0f;
+    tables->to_linear[i] =
+        c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+  }
+  for (uint32_t i = 0; i < 255; ++i) {
+    tables->bounds[i] =
+        (tables->to_linear[i] + tables->to_linear[i + 1]) * 0.5f;
+  }
+}
+
+static uint8_t encode_srgb(const SRGBTables *tables, float linear) {
+  uint32_t lo = 0;
+  uint32_t hi = 255;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (linear > tables->bounds[mid]) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return (uint8_t)lo;
+}
+
+// Halves a level with a 2x2 box. Odd edges drop their last row or column
+// like the blit used to, so level sizes match what the GPU would make.
+static void downsample_rgba8(const SRGBTables *tables, const uint8_t *src,
+                             uint32_t src_width, uint32_t src_height,
+                             uint8_t *dst, uint32_t dst_width,
+                             uint32_t dst_height) {
+  for (uint32_t y = 0; y < dst_height; ++y) {
+    uint32_t y0 = SDL_min(y * 2, src_height - 1);
+    uint32_t y1 = SDL_min(y * 2 + 1, src_height - 1);
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      uint32_t x0 = SDL_min(x * 2, src_width - 1);
+      uint32_t x1 = SDL_min(x * 2 + 1, src_width - 1);
+      const uint8_t *texels[4] = {
+          &src[(y0 * src_width + x0) * 4],
+          &src[(y0 * src_width + x1) * 4],
+          &src[(y1 * src_width + x0) * 4],
+          &src[(y1 * src_width + x1) * 4],
+      };
+      uint8_t *out = &dst[(y * dst_width + x) * 4];
+      for (uint32_t c = 0; c < 3; ++c) {
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < 4; ++i) {
+          sum += tables->to_linear[texels[i][c]];
+        }
+        out[c] = encode_srgb(tables, sum * 0.25f);
+      }
+      uint32_t alpha = 0;
+      for (uint32_t i = 0; i < 4; ++i) {
+        alpha += texels[i][3];
+      }
+      out[3] = (uint8_t)((alpha + 2) / 4);
+    }
+  }
+}
+
+// Lays out the full chain with level 0 first and allocates room for it
+static bool alloc_rgba8_import(Allocator alloc, uint32_t width,
+                               uint32_t height, TextureImport *out_import) {
+  TextureImport import = {
+      .format = VK_FORMAT_R8G8B8A8_SRGB,
+      .width = width,
+      .height = height,
+  };
+  uint32_t extent = SDL_max(width, height);
+  while (import.level_count < TEXTURE_MAX_LEVELS &&
+         (extent >> import.level_count) > 0) {
+    import.level_count++;
+  }
+  for (uint32_t i = 0; i < import.level_count; ++i) {
+    uint32_t level_width = SDL_max(width >> i, 1);
+    uint32_t level_height = SDL_max(height >> i, 1);
+    import.level_offsets[i] = import.size;
+    import.level_sizes[i] = (uint64_t)level_width * level_height * 4;
+    import.size += (size_t)import.level_sizes[i];
+  }
+
+  import.data = hb_alloc(alloc, import.size);
+  if (!import.data) {
+    return false;
+  }
+  *out_import = import;
+  return true;
+}
+
+// Fills in every level after the first from the one before it
+static void build_rgba8_mips(TextureImport *import) {
+  uint32_t width = import->width;
+  uint32_t height = import->height;
+  SRGBTables tables = {0};
+  build_srgb_tables(&tables);
+  for (uint32_t i = 1; i < import->level_count; ++i) {
+    downsample_rgba8(&tables, import->data + import->level_offsets[i - 1],
+                     SDL_max(width >> (i - 1), 1),
+                     SDL_max(height >> (i - 1), 1),
+                     import->data + import->level_offsets[i],
+                     SDL_max(width >> i, 1), SDL_max(height >> i, 1));
+  }
+}
+
+int32_t import_texture_rgba8(Allocator alloc, uint32_t width, uint32_t height,
+                             size_t pitch, const uint8_t *pixels,
+                             TextureImport *out_import) {
+  TracyCZoneN(ctx, "import_texture_rgba8", true);
+  TextureImport import = {0};
+  if (width == 0 || height == 0 ||
+      !alloc_rgba8_import(alloc, width, height, &import)) {
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+
+  size_t row_size = (size_t)width * 4;
+  for (uint32_t y = 0; y < height; ++y) {
+    memcpy(import.data + y * row_size, pixels + y * pitch, row_size);
+  }
+  build_rgba8_mips(&import);
+
+  *out_import = import;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+int32_t import_texture_image(Allocator alloc, const uint8_t *data,
+                             size_t size, TextureImport *out_import) {
+  TracyCZoneN(ctx, "import_texture_image", true);
+  uint32_t width = 0;
+  uint32_t height = 0;
+  TextureImport import = {0};
+  if (!image_dimensions(data, size, &width, &height) ||
+      !alloc_rgba8_import(alloc, width, height, &import)) {
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+
+  // Level 0 comes first in the chain so it decodes right into place
+  if (decode_image_rgba8(alloc, data, size, width, height, (size_t)width * 4,
+                         import.data) != 0) {
+    destroy_texture_import(alloc, &import);
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  build_rgba8_mips(&import);
+
+  *out_import = import;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+void destroy_texture_import(Allocator alloc, TextureImport *import) {
+  hb_free(alloc, import->data);
+  *import = (TextureImport){0};
+}
+
+static void texture_cache_path(const char *cache_dir, uint64_t key,
+                               char *path, size_t path_size) {
+  SDL_snprintf(path, path_size, "%stexture_%016llx.cache", cache_dir,
+               (unsigned long long)key);
+}
+
+bool load_cached_texture_import(Allocator alloc, const char *cache_dir,
+                                uint64_t key, TextureImport *out_import) {
+  if (!cache_dir) {
+    return false;
+  }
+  TracyCZoneN(ctx, "load_cached_texture_import", true);
+
+  char path[1024] = {0};
+  texture_cache_path(cache_dir, key, path, sizeof(path));
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file) {
+    derived_cache_count(DERIVED_CACHE_TEXTURE, false);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  // Anything that doesn't line up exactly is treated as a miss and rebuilt
+  TextureCacheHeader header = {0};
+  bool valid = SDL_RWread(file, &header, sizeof(header), 1) == 1 &&
+               header.magic == TEXTURE_CACHE_MAGIC &&
+               header.version == TEXTURE_IMPORT_VERSION &&
+               header.key == key &&
+               (uint64_t)SDL_RWsize(file) == sizeof(header) + header.size;
+
+  TextureImport import = {0};
+  if (valid) {
+    import = (TextureImport){
+        .format = header.format,
+        .width = header.width,
+        .height = header.height,
+        .level_count = header.level_count,
+        .size = (size_t)header.size,
+    };
+    memcpy(import.level_offsets, header.level_offsets,
+           sizeof(import.level_offsets));
+    memcpy(import.level_sizes, header.level_sizes, sizeof(import.level_sizes));
+    valid = validate_texture_import(&import);
+  }
+  if (valid) {
+    import.data = hb_alloc(alloc, import.size);
+    valid = import.data && SDL_RWread(file, import.data, import.size, 1) == 1;
+    if (!valid) {
+      destroy_texture_import(alloc, &import);
+    }
+  }
+  SDL_RWclose(file);
+
+  if (valid) {
+    derived_cache_touch(path);
+    *out_import = import;
+  }
+  derived_cache_count(DERIVED_CACHE_TEXTURE, valid);
+  TracyCZoneEnd(ctx);
+  return valid;
+}
+
+void save_cached_texture_import(const char *cache_dir, uint64_t key,
+                                const TextureImport *import) {
+  if (!cache_dir) {
+    return;
+  }
+  TracyCZoneN(ctx, "save_cached_texture_import", true);
+
+  char path[1024] = {0};
+  texture_cache_path(cache_dir, key, path, sizeof(path));
+  SDL_RWops *file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    // Not fatal; the texture just gets imported again next launch
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to write %s", path);
+    TracyCZoneEnd(ctx);
+    return;
+  }
+
+  TextureCacheHeader header = {
+      .magic = TEXTURE_CACHE_MAGIC,
+      .version = TEXTURE_IMPORT_VERSION,
+      .key = key,
+      .format = import->format,
+      .width = import->width,
+      .height = import->height,
+      .level_count = import->level_count,
+      .size = import->size,
+  };
+  memcpy(header.level_offsets, import->level_offsets,
+         sizeof(header.level_offsets));
+  memcpy(header.level_sizes, import->level_sizes, sizeof(header.level_sizes));
+  SDL_RWwrite(file, &header, sizeof(header), 1);
+  SDL_RWwrite(file, import->data, import->size, 1);
+  SDL_RWclose(file);
+
+  TracyCZoneEnd(ctx);
+}
+
+/*
+  Textures with fewer channels go to the smaller formats made for them,
+  which is what normal maps and roughness are authored as. ETC1S sources
+  carry no more detail than a 4 bit per pixel format holds so color goes to
+  those where it can. Everything else gets the best quality format the device
+  has: ASTC, then BC7, then ETC2, and uncompressed when there is nothing else.
+*/
+uint32_t select_ktx2_transcode(uint32_t format_caps, ktxTexture2 *ktx) {
+  uint32_t components = ktxTexture2_GetNumComponents(ktx);
+  bool etc1s = ktx->supercompressionScheme == KTX_SS_BASIS_LZ;
+
+  if (components == 1) {
+    if (format_caps & TEXTURE_FORMAT_BC4) {
+      return KTX_TTF_BC4_R;
+    }
+    if (format_caps & TEXTURE_FORMAT_EAC_R11) {
+      return KTX_TTF_ETC2_EAC_R11;
+    }
+  } else if (components == 2) {
+    if (format_caps & TEXTURE_FORMAT_BC5) {
+      return KTX_TTF_BC5_RG;
+    }
+    if (format_caps & TEXTURE_FORMAT_EAC_RG11) {
+      return KTX_TTF_ETC2_EAC_RG11;
+    }
+  } else if (components == 3 && etc1s) {
+    if (format_caps & TEXTURE_FORMAT_BC1) {
+      return KTX_TTF_BC1_RGB;
+    }
+    if (format_caps & TEXTURE_FORMAT_ETC2_RGB) {
+      return KTX_TTF_ETC1_RGB;
+    }
+  }
+
+  if (format_caps & TEXTURE_FORMAT_ASTC) {
+    return KTX_TTF_ASTC_4x4_RGBA;
+  }
+  if (format_caps & TEXTURE_FORMAT_BC7) {
+    return KTX_TTF_BC7_RGBA;
+  }
+  if (format_caps & TEXTURE_FORMAT_ETC2_RGBA) {
+    return KTX_TTF_ETC2_RGBA;
+  }
+  return KTX_TTF_RGBA32;
+}
+
+static bool ktx2_importable(const ktxTexture2 *ktx) {
+  return ktx->numDimensions == 2 && ktx->numLayers == 1 &&
+         ktx->numFaces == 1 && !ktx->generateMipmaps &&
+         ktx->numLevels <= TEXTURE_MAX_LEVELS;
+}
+
+int32_t import_texture_ktx2(Allocator alloc, const char *cache_dir,
+                            const uint8_t *data, size_t size,
+                            uint32_t format_caps, TextureImport *out_import) {
+  TracyCZoneN(ctx, "import_texture_ktx2", true);
+
+  // The transcode target only depends on the file and the device's formats
+  uint64_t key = texture_import_key(hash64(data, size, 0), format_caps);
+  if (load_cached_texture_import(alloc, cache_dir, key, out_import)) {
+    TracyCZoneEnd(ctx);
+    return 0;
+  }
+
+  ktxTexture2 *ktx = NULL;
+  if (ktxTexture2_CreateFromMemory(data, size,
+                                   KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
+                                   &ktx) != KTX_SUCCESS) {
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  if (!ktx2_importable(ktx)) {
+    ktxTexture_Destroy(ktxTexture(ktx));
+    TracyCZoneEnd(ctx);
+    return -2;
+  }
+
+  bool transcoded = ktxTexture2_NeedsTranscoding(ktx);
+  if (transcoded) {
+    TracyCZoneN(transcode_ctx, "import_texture_ktx2 transcode", true);
+    ktx_transcode_fmt_e target =
+        (ktx_transcode_fmt_e)select_ktx2_transcode(format_caps, ktx);
+    ktx_error_code_e err = ktxTexture2_TranscodeBasis(ktx, target, 0);
+    TracyCZoneEnd(transcode_ctx);
+    if (err != KTX_SUCCESS) {
+      ktxTexture_Destroy(ktxTexture(ktx));
+      TracyCZoneEnd(ctx);
+      return -1;
+    }
+  }
+
+  TextureImport import = {
+      .format = (uint32_t)ktx->vkFormat,
+      .width = ktx->baseWidth,
+      .height = ktx->baseHeight,
+      .level_count = ktx->numLevels,
+      .size = ktx->dataSize,
+  };
+  for (uint32_t i = 0; i < import.level_count; ++i) {
+    ktx_size_t offset = 0;
+    ktxTexture_GetImageOffset(ktxTexture(ktx), i, 0, 0, &offset);
+    import.level_offsets[i] = offset;
+    import.level_sizes[i] = ktxTexture_GetImageSize(ktxTexture(ktx), i);
+  }
+  import.data = hb_alloc(alloc, import.size);
+  if (!import.data) {
+    ktxTexture_Destroy(ktxTexture(ktx));
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  memcpy(import.data, ktx->pData, import.size);
+  ktxTexture_Destroy(ktxTexture(ktx));
+
+  // Files already in a GPU format load just as fast without the cache
+  if (transcoded) {
+    save_cached_texture_import(cache_dir, key, &import);
+  }
+
+  *out_import = import;
+  TracyCZoneEnd(ctx);
+  return 0;
+}
+
+typedef struct KTX2ImportBatch {
+  const char *cache_dir;
+  uint32_t format_caps;
+  const char *const *file_paths;
+  StandardAllocator *allocs;
+  TextureImport *imports;
+  int32_t *errs;
+} KTX2ImportBatch;
+
+static int32_t read_file(Allocator alloc, const char *path, uint8_t **out_data,
+                         size_t *out_size) {
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file) {
+    return -1;
+  }
+  size_t size = (size_t)SDL_RWsize(file);
+  uint8_t *data = hb_alloc(alloc, size);
+  if (!data || SDL_RWread(file, data, size, 1) != 1) {
+    hb_free(alloc, data);
+    SDL_RWclose(file);
+    return -1;
+  }
+  SDL_RWclose(file);
+  *out_data = data;
+  *out_size = size;
+  return 0;
+}
+
+static void import_ktx2_job(void *user_data, uint32_t index) {
+  TracyCZoneN(ctx, "import_ktx2_job", true);
+  KTX2ImportBatch *batch = (KTX2ImportBatch *)user_data;
+
+  // A heap per job; blocks stay valid after the heap is destroyed
+  StandardAllocator *alloc = &batch->allocs[index];
+  create_standard_allocator(alloc, "KTX2 Import");
+
+  uint8_t *data = NULL;
+  size_t size = 0;
+  int32_t err = read_file(alloc->alloc, batch->file_paths[index], &data, &size);
+  if (err == 0) {
+    err = import_texture_ktx2(alloc->alloc, batch->cache_dir,
+                              data, size, batch->format_caps,
+                              &batch->imports[index]);
+    hb_free(alloc->alloc, data);
+  }
+  batch->errs[index] = err;
+
+  destroy_standard_allocator(*alloc);
+  TracyCZoneEnd(ctx);
+}
+
+void import_textures_ktx2(JobSystem *jobs, const char *cache_dir,
+                          uint32_t format_caps, uint32_t count,
+                          const char *const *file_paths,
+                          StandardAllocator *out_allocs,
+                          TextureImport *out_imports, int32_t *out_errs) {
+  TracyCZoneN(ctx, "import_textures_ktx2", true);
+  KTX2ImportBatch batch = {
+      .cache_dir = cache_dir,
+      .format_caps = format_caps,
+      .file_paths = file_paths,
+      .allocs = out_allocs,
+      .imports = out_imports,
+      .errs = out_errs,
+  };
+  job_parallel_for(jobs, count, import_ktx2_job, &batch);
+  TracyCZoneEnd(ctx);
+}
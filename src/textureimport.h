@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+typedef struct JobSystem JobSystem;
+typedef struct ktxTexture2 ktxTexture2;
+
+// Bump whenever import output changes so stale cache entries are rebuilt
+#define TEXTURE_IMPORT_VERSION 1
+
+#define TEXTURE_MAX_LEVELS 16
+
+// Compressed formats the device can sample, as a mask of these bits
+#define TEXTURE_FORMAT_ASTC (1 << 0)
+#define TEXTURE_FORMAT_BC1 (1 << 1)
+#define TEXTURE_FORMAT_BC4 (1 << 2)
+#define TEXTURE_FORMAT_BC5 (1 << 3)
+#define TEXTURE_FORMAT_BC7 (1 << 4)
+#define TEXTURE_FORMAT_ETC2_RGB (1 << 5)
+#define TEXTURE_FORMAT_ETC2_RGBA (1 << 6)
+#define TEXTURE_FORMAT_EAC_R11 (1 << 7)
+#define TEXTURE_FORMAT_EAC_RG11 (1 << 8)
+
+/*
+  The CPU side result of importing a texture: every mip level already in the
+  format the GPU samples, ready to be copied into a staging buffer as is and
+  uploaded without generating anything on the GPU. Level offsets are into
+  data and need not be in level order.
+*/
+typedef struct TextureImport {
+  uint32_t format; // VkFormat of every level
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint64_t level_offsets[TEXTURE_MAX_LEVELS];
+  uint64_t level_sizes[TEXTURE_MAX_LEVELS];
+  size_t size;
+  uint8_t *data;
+} TextureImport;
+
+// A texture's import depends on its source and on the format it was
+// converted to for the device, so both make up the cache key. target is
+// that format or, where the format is picked per texture, whatever it is
+// picked from.
+uint64_t texture_import_key(uint64_t source_key, uint32_t target);
+
+// Checks the level layout fits in the data, for imports read off of disk
+bool validate_texture_import(const TextureImport *import);
+
+// Builds the full mip chain of an sRGB RGBA8 image on the CPU. Texels are
+// averaged in linear space, the same as a blit of the sRGB image would.
+int32_t import_texture_rgba8(Allocator alloc, uint32_t width, uint32_t height,
+                             size_t pitch, const uint8_t *pixels,
+                             TextureImport *out_import);
+// import_texture_rgba8 for an encoded PNG or JPEG, decoded straight into the
+// import's first level
+int32_t import_texture_image(Allocator alloc, const uint8_t *data,
+                             size_t size, TextureImport *out_import);
+void destroy_texture_import(Allocator alloc, TextureImport *import);
+
+// A NULL cache_dir disables the cache
+bool load_cached_texture_import(Allocator alloc, const char *cache_dir,
+                                uint64_t key, TextureImport *out_import);
+void save_cached_texture_import(const char *cache_dir, uint64_t key,
+                                const TextureImport *import);
+
+// The best format in format_caps for a Basis texture's channel count, as a
+// ktx_transcode_fmt_e
+uint32_t select_ktx2_transcode(uint32_t format_caps, ktxTexture2 *ktx);
+
+// Basis payloads are transcoded for format_caps and cached in cache_dir;
+// anything else is copied out as is. Returns -2 for layouts an import can't
+// describe (cubemaps, arrays, 3D or mips left to the GPU), which only
+// load_ktx2_texture handles. Only touches the CPU and the cache.
+int32_t import_texture_ktx2(Allocator alloc, const char *cache_dir,
+                            const uint8_t *data, size_t size,
+                            uint32_t format_caps, TextureImport *out_import);
+
+// Reads and imports every file with one job per file, which is where all of
+// the transcoding happens. Each import is made by its own allocator in
+// out_allocs so it can be freed from any thread. Must not be called from
+// inside a job.
+void import_textures_ktx2(JobSystem *jobs, const char *cache_dir,
+                          uint32_t format_caps, uint32_t count,
+                          const char *const *file_paths,
+                          StandardAllocator *out_allocs,
+                          TextureImport *out_imports, int32_t *out_errs);
@@ -0,0 +1,809 @@
+#include "vfs.h"
+
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zdict.h>
+#include <zstd.h>
+
+#include "hash.h"
+#include "jobs.h"
+#include "profiling.h"
+
+#define PACK_MAGIC 0x4B504248 // 'HBPK'
+#define PACK_VERSION 1
+// Stored entries start on this boundary so they can be used in place
+#define PACK_ALIGNMENT 16
+// Chunks decompress independently so large entries spread over jobs
+#define PACK_CHUNK_SIZE (256 * 1024)
+// Packs are built offline and zstd decompresses about as fast at any level
+#define PACK_COMPRESSION_LEVEL 19
+// Entries that compress by less than 1 / PACK_MIN_SAVING are stored instead
+#define PACK_MIN_SAVING 8
+// Entries too small to compress well alone share a trained dictionary
+#define PACK_DICTIONARY_MAX_ENTRY_SIZE (64 * 1024)
+#define PACK_DICTIONARY_MIN_SAMPLES 8
+#define PACK_DICTIONARY_CAPACITY (32 * 1024)
+
+#define PACK_ENTRY_DICTIONARY 0x1 // Chunks need the pack's dictionary
+
+typedef struct PackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t chunk_count;
+  uint64_t entries;
+  uint64_t chunks;
+  uint64_t names;
+  uint64_t names_size;
+  uint64_t dictionary;
+  uint64_t dictionary_size;
+  uint64_t size;
+} PackHeader;
+
+typedef struct PackEntry {
+  uint64_t path_hash; // The table is sorted by this
+  uint64_t content_hash;
+  uint64_t offset; // Of the contents when stored
+  uint64_t size;   // Uncompressed
+  uint32_t name;   // Into the name table, which isn't null terminated
+  uint32_t name_size;
+  uint32_t first_chunk;
+  uint32_t chunk_count; // Zero when stored
+  uint32_t flags;
+  uint32_t padding[3];
+} PackEntry;
+
+// Every chunk but an entry's last expands to PACK_CHUNK_SIZE
+typedef struct PackChunk {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t padding;
+} PackChunk;
+
+static uint64_t pack_path_hash(const char *name, size_t name_size) {
+  return hash64(name, name_size, 0);
+}
+
+static uint32_t pack_chunk_count(uint64_t size) {
+  return (uint32_t)((size + PACK_CHUNK_SIZE - 1) / PACK_CHUNK_SIZE);
+}
+
+static size_t pack_chunk_size(const PackEntry *entry, uint32_t chunk) {
+  uint64_t offset = (uint64_t)chunk * PACK_CHUNK_SIZE;
+  return (size_t)SDL_min(entry->size - offset, PACK_CHUNK_SIZE);
+}
+
+static bool pack_range(uint64_t offset, uint64_t size, uint64_t pack_size) {
+  return offset <= pack_size && size <= pack_size - offset;
+}
+
+// Packs come from disk so every range is checked once at mount and lookups
+// can trust the tables afterwards
+static bool validate_pack(const uint8_t *data, size_t size) {
+  if (size < sizeof(PackHeader)) {
+    return false;
+  }
+  const PackHeader *header = (const PackHeader *)data;
+  if (header->magic != PACK_MAGIC || header->version != PACK_VERSION ||
+      header->size != size || header->entries % PACK_ALIGNMENT != 0 ||
+      header->chunks % PACK_ALIGNMENT != 0 ||
+      !pack_range(header->entries,
+                  header->entry_count * sizeof(PackEntry), size) ||
+      !pack_range(header->chunks, header->chunk_count * sizeof(PackChunk),
+                  size) ||
+      !pack_range(header->names, header->names_size, size) ||
+      !pack_range(header->dictionary, header->dictionary_size, size)) {
+    return false;
+  }
+
+  const PackEntry *entries = (const PackEntry *)(data + header->entries);
+  const PackChunk *chunks = (const PackChunk *)(data + header->chunks);
+  for (uint32_t i = 0; i < header->entry_count; ++i) {
+    const PackEntry *entry = &entries[i];
+    if (!pack_range(entry->name, entry->name_size, header->names_size) ||
+        (i > 0 && entry->path_hash < entries[i - 1].path_hash) ||
+        ((entry->flags & PACK_ENTRY_DICTIONARY) &&
+         header->dictionary_size == 0)) {
+      return false;
+    }
+    if (entry->chunk_count == 0) {
+      if (entry->offset % PACK_ALIGNMENT != 0 ||
+          !pack_range(entry->offset, entry->size, size)) {
+        return false;
+      }
+      continue;
+    }
+    if (entry->chunk_count != pack_chunk_count(entry->size) ||
+        entry->first_chunk > header->chunk_count ||
+        entry->chunk_count > header->chunk_count - entry->first_chunk) {
+      return false;
+    }
+    for (uint32_t ii = 0; ii < entry->chunk_count; ++ii) {
+      const PackChunk *chunk = &chunks[entry->first_chunk + ii];
+      if (!pack_range(chunk->offset, chunk->size, size)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void create_vfs(Allocator std_alloc, Vfs *out_vfs) {
+  *out_vfs = (Vfs){.std_alloc = std_alloc};
+}
+
+static void release_pack(Allocator std_alloc, VfsPack *pack) {
+  ZSTD_freeDDict(pack->dictionary);
+  if (pack->heap_data) {
+    hb_free(std_alloc, pack->heap_data);
+  }
+  unmap_file(&pack->file);
+  *pack = (VfsPack){0};
+}
+
+// Where a file can't be mapped it is read onto the heap instead
+static uint8_t *read_file(Allocator alloc, const char *path, size_t *size) {
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+  int64_t file_size = SDL_RWsize(file);
+  uint8_t *data = file_size > 0 ? hb_alloc(alloc, (size_t)file_size) : NULL;
+  if (data && SDL_RWread(file, data, (size_t)file_size, 1) != 1) {
+    hb_free(alloc, data);
+    data = NULL;
+  }
+  SDL_RWclose(file);
+  *size = data ? (size_t)file_size : 0;
+  return data;
+}
+
+bool vfs_mount_pack(Vfs *vfs, const char *mount, const char *pack_path) {
+  TracyCZoneN(ctx, "vfs_mount_pack", true);
+  if (vfs->pack_count >= VFS_MAX_PACKS) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to mount %s; %d packs max",
+                 pack_path, VFS_MAX_PACKS);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  VfsPack pack = {.mount = mount, .mount_len = strlen(mount)};
+  if (map_file(pack_path, &pack.file)) {
+    pack.data = pack.file.data;
+    pack.size = pack.file.size;
+  } else {
+    pack.heap_data = read_file(vfs->std_alloc, pack_path, &pack.size);
+    pack.data = pack.heap_data;
+  }
+  if (!pack.data) {
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  if (!validate_pack(pack.data, pack.size)) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "%s is not a valid pack; using loose files", pack_path);
+    release_pack(vfs->std_alloc, &pack);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  const PackHeader *header = (const PackHeader *)pack.data;
+  if (header->dictionary_size > 0) {
+    pack.dictionary = ZSTD_createDDict(pack.data + header->dictionary,
+                                       (size_t)header->dictionary_size);
+    if (!pack.dictionary) {
+      release_pack(vfs->std_alloc, &pack);
+      TracyCZoneEnd(ctx);
+      return false;
+    }
+  }
+
+  SDL_Log("Mounted %s at \"%s\" (%u entries)", pack_path, mount,
+          header->entry_count);
+  vfs->packs[vfs->pack_count++] = pack;
+  TracyCZoneEnd(ctx);
+  return true;
+}
+
+void destroy_vfs(Vfs *vfs) {
+  for (uint32_t i = 0; i < vfs->pack_count; ++i) {
+    release_pack(vfs->std_alloc, &vfs->packs[i]);
+  }
+  vfs->pack_count = 0;
+}
+
+static const PackEntry *pack_find(const VfsPack *pack, const char *name) {
+  const PackHeader *header = (const PackHeader *)pack->data;
+  const PackEntry *entries = (const PackEntry *)(pack->data + header->entries);
+  const char *names = (const char *)(pack->data + header->names);
+  size_t name_size = strlen(name);
+  uint64_t hash = pack_path_hash(name, name_size);
+
+  // Lower bound, then step over any entries that only share the hash
+  uint32_t lo = 0;
+  uint32_t hi = header->entry_count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].path_hash < hash) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  for (; lo < header->entry_count && entries[lo].path_hash == hash; ++lo) {
+    const PackEntry *entry = &entries[lo];
+    if (entry->name_size == name_size &&
+        memcmp(names + entry->name, name, name_size) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static const PackEntry *vfs_find(const Vfs *vfs, const char *path,
+                                 const VfsPack **out_pack) {
+  for (uint32_t i = 0; vfs && i < vfs->pack_count; ++i) {
+    const VfsPack *pack = &vfs->packs[i];
+    if (strncmp(path, pack->mount, pack->mount_len) != 0) {
+      continue;
+    }
+    const PackEntry *entry = pack_find(pack, path + pack->mount_len);
+    if (entry) {
+      *out_pack = pack;
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static bool pack_decompress_chunk(const VfsPack *pack, const PackEntry *entry,
+                                  uint32_t chunk, uint8_t *dst) {
+  const PackHeader *header = (const PackHeader *)pack->data;
+  const PackChunk *chunks = (const PackChunk *)(pack->data + header->chunks);
+  const PackChunk *src = &chunks[entry->first_chunk + chunk];
+  size_t size = pack_chunk_size(entry, chunk);
+  dst += (size_t)chunk * PACK_CHUNK_SIZE;
+
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  if (!dctx) {
+    return false;
+  }
+  size_t res = 0;
+  if (entry->flags & PACK_ENTRY_DICTIONARY) {
+    res = ZSTD_decompress_usingDDict(dctx, dst, size, pack->data + src->offset,
+                                     src->size, pack->dictionary);
+  } else {
+    res = ZSTD_decompressDCtx(dctx, dst, size, pack->data + src->offset,
+                              src->size);
+  }
+  ZSTD_freeDCtx(dctx);
+  return !ZSTD_isError(res) && res == size;
+}
+
+// Stored entries are handed out in place; compressed ones only get their
+// buffer here and are filled in by the caller
+static bool vfs_open_entry(const VfsPack *pack, const PackEntry *entry,
+                           Allocator alloc, VfsFile *out_file) {
+  *out_file = (VfsFile){
+      .size = (size_t)entry->size,
+      .content_hash = entry->content_hash,
+      .alloc = alloc,
+  };
+  if (entry->chunk_count == 0) {
+    out_file->data = pack->data + entry->offset;
+    return true;
+  }
+  out_file->heap_data = hb_alloc(alloc, (size_t)entry->size);
+  out_file->data = out_file->heap_data;
+  return out_file->heap_data != NULL;
+}
+
+static bool vfs_open_loose(Allocator alloc, const char *path,
+                           VfsFile *out_file) {
+  *out_file = (VfsFile){.alloc = alloc};
+  if (map_file(path, &out_file->mapped)) {
+    out_file->data = out_file->mapped.data;
+    out_file->size = out_file->mapped.size;
+    return true;
+  }
+  out_file->heap_data = read_file(alloc, path, &out_file->size);
+  out_file->data = out_file->heap_data;
+  return out_file->data != NULL;
+}
+
+bool vfs_open(const Vfs *vfs, Allocator alloc, const char *path,
+              VfsFile *out_file) {
+  TracyCZoneN(ctx, "vfs_open", true);
+  const VfsPack *pack = NULL;
+  const PackEntry *entry = vfs_find(vfs, path, &pack);
+  if (!entry) {
+    bool ok = vfs_open_loose(alloc, path, out_file);
+    TracyCZoneEnd(ctx);
+    return ok;
+  }
+
+  if (!vfs_open_entry(pack, entry, alloc, out_file)) {
+    vfs_close(out_file);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+  for (uint32_t i = 0; i < entry->chunk_count; ++i) {
+    if (!pack_decompress_chunk(pack, entry, i, out_file->heap_data)) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to decompress %s", path);
+      vfs_close(out_file);
+      TracyCZoneEnd(ctx);
+      return false;
+    }
+  }
+  TracyCZoneEnd(ctx);
+  return true;
+}
+
+typedef struct VfsChunkJob {
+  const VfsPack *pack;
+  const PackEntry *entry;
+  uint32_t chunk;
+  uint32_t file;
+  uint8_t *dst;
+  bool ok;
+} VfsChunkJob;
+
+static void vfs_decompress_job(void *user_data, uint32_t index) {
+  VfsChunkJob *job = &((VfsChunkJob *)user_data)[index];
+  TracyCZoneN(ctx, "vfs_decompress_job", true);
+  job->ok = pack_decompress_chunk(job->pack, job->entry, job->chunk, job->dst);
+  TracyCZoneEnd(ctx);
+}
+
+bool vfs_open_many(const Vfs *vfs, JobSystem *jobs, Allocator alloc,
+                   uint32_t file_count, const char *const *paths,
+                   VfsFile *out_files) {
+  TracyCZoneN(ctx, "vfs_open_many", true);
+
+  // Everything is opened and allocated up front so the jobs only decompress
+  const PackEntry **entries =
+      hb_alloc_nm_tp(alloc, SDL_max(file_count, 1), const PackEntry *);
+  const VfsPack **packs =
+      hb_alloc_nm_tp(alloc, SDL_max(file_count, 1), const VfsPack *);
+  if (!entries || !packs) {
+    hb_free(alloc, entries);
+    hb_free(alloc, packs);
+    TracyCZoneEnd(ctx);
+    return false;
+  }
+
+  uint32_t chunk_count = 0;
+  for (uint32_t i = 0; i < file_count; ++i) {
+    entries[i] = vfs_find(vfs, paths[i], &packs[i]);
+    bool ok = entries[i]
+                  ? vfs_open_entry(packs[i], entries[i], alloc, &out_files[i])
+                  : vfs_open_loose(alloc, paths[i], &out_files[i]);
+    if (!ok) {
+      vfs_close(&out_files[i]);
+      entries[i] = NULL;
+      continue;
+    }
+    if (entries[i]) {
+      chunk_count += entries[i]->chunk_count;
+    }
+  }
+
+  VfsChunkJob *chunk_jobs =
+      hb_alloc_nm_tp(alloc, SDL_max(chunk_count, 1), VfsChunkJob);
+  if (!chunk_jobs) {
+    chunk_count = 0;
+    for (uint32_t i = 0; i < file_count; ++i) {
+      if (entries[i] && entries[i]->chunk_count > 0) {
+        vfs_close(&out_files[i]);
+      }
+    }
+  }
+
+  uint32_t job_idx = 0;
+  for (uint32_t i = 0; i < file_count && chunk_jobs; ++i) {
+    for (uint32_t ii = 0; entries[i] && ii < entries[i]->chunk_count; ++ii) {
+      chunk_jobs[job_idx++] = (VfsChunkJob){
+          .pack = packs[i],
+          .entry = entries[i],
+          .chunk = ii,
+          .file = i,
+          .dst = out_files[i].heap_data,
+      };
+    }
+  }
+  if (chunk_count > 0) {
+    job_parallel_for(jobs, chunk_count, vfs_decompress_job, chunk_jobs);
+  }
+
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    VfsFile *file = &out_files[chunk_jobs[i].file];
+    if (!chunk_jobs[i].ok && file->data) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to decompress %s",
+                   paths[chunk_jobs[i].file]);
+      vfs_close(file);
+    }
+  }
+
+  bool any_open = false;
+  for (uint32_t i = 0; i < file_count; ++i) {
+    any_open |= out_files[i].data != NULL;
+  }
+
+  hb_free(alloc, chunk_jobs);
+  hb_free(alloc, entries);
+  hb_free(alloc, packs);
+  TracyCZoneEnd(ctx);
+  return any_open;
+}
+
+void vfs_close(VfsFile *file) {
+  if (file->heap_data) {
+    hb_free(file->alloc, file->heap_data);
+  }
+  unmap_file(&file->mapped);
+  *file = (VfsFile){.alloc = file->alloc};
+}
+
+typedef struct PackSource {
+  const char *name;
+  size_t name_size;
+  uint64_t path_hash;
+  uint8_t *data;
+  size_t size;
+} PackSource;
+
+typedef struct PackChunkJob {
+  const uint8_t *src;
+  size_t src_size;
+  const ZSTD_CDict *dictionary; // NULL for entries compressed alone
+  uint8_t *dst;
+  size_t dst_capacity;
+  size_t dst_size;
+} PackChunkJob;
+
+static void pack_compress_job(void *user_data, uint32_t index) {
+  PackChunkJob *job = &((PackChunkJob *)user_data)[index];
+  TracyCZoneN(ctx, "pack_compress_job", true);
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+  size_t res = 0;
+  if (!cctx) {
+    res = (size_t)-1;
+  } else if (job->dictionary) {
+    res = ZSTD_compress_usingCDict(cctx, job->dst, job->dst_capacity,
+                                   job->src, job->src_size, job->dictionary);
+  } else {
+    res = ZSTD_compressCCtx(cctx, job->dst, job->dst_capacity, job->src,
+                            job->src_size, PACK_COMPRESSION_LEVEL);
+  }
+  ZSTD_freeCCtx(cctx);
+  job->dst_size = ZSTD_isError(res) ? 0 : res;
+  TracyCZoneEnd(ctx);
+}
+
+static int pack_source_cmp(const void *a, const void *b) {
+  uint64_t ha = ((const PackSource *)a)->path_hash;
+  uint64_t hb = ((const PackSource *)b)->path_hash;
+  return (ha > hb) - (ha < hb);
+}
+
+static uint64_t pack_reserve(uint64_t *offset, uint64_t size,
+                             uint64_t alignment) {
+  uint64_t start = (*offset + alignment - 1) & ~(alignment - 1);
+  *offset = start + size;
+  return start;
+}
+
+// Pads the file out to offset before writing so payloads land where the
+// layout put them
+static bool pack_write(SDL_RWops *file, uint64_t *written, uint64_t offset,
+                       const void *data, uint64_t size) {
+  static const uint8_t zeros[PACK_ALIGNMENT] = {0};
+  while (*written < offset) {
+    uint64_t pad = SDL_min(offset - *written, sizeof(zeros));
+    if (SDL_RWwrite(file, zeros, (size_t)pad, 1) != 1) {
+      return false;
+    }
+    *written += pad;
+  }
+  if (size > 0 && SDL_RWwrite(file, data, (size_t)size, 1) != 1) {
+    return false;
+  }
+  *written += size;
+  return true;
+}
+
+// Trains on every small entry; returns NULL when there are too few samples
+// to be worth it
+static uint8_t *train_pack_dictionary(Allocator std_alloc,
+                                      const PackSource *sources,
+                                      uint32_t source_count,
+                                      size_t *out_size) {
+  *out_size = 0;
+  uint32_t sample_count = 0;
+  size_t samples_size = 0;
+  for (uint32_t i = 0; i < source_count; ++i) {
+    if (sources[i].size > 0 &&
+        sources[i].size <= PACK_DICTIONARY_MAX_ENTRY_SIZE) {
+      sample_count++;
+      samples_size += sources[i].size;
+    }
+  }
+  if (sample_count < PACK_DICTIONARY_MIN_SAMPLES) {
+    return NULL;
+  }
+
+  uint8_t *samples = hb_alloc(std_alloc, samples_size);
+  size_t *sample_sizes = hb_alloc_nm_tp(std_alloc, sample_count, size_t);
+  uint8_t *dictionary = hb_alloc(std_alloc, PACK_DICTIONARY_CAPACITY);
+  if (!samples || !sample_sizes || !dictionary) {
+    hb_free(std_alloc, samples);
+    hb_free(std_alloc, sample_sizes);
+    hb_free(std_alloc, dictionary);
+    return NULL;
+  }
+
+  size_t offset = 0;
+  uint32_t sample_idx = 0;
+  for (uint32_t i = 0; i < source_count; ++i) {
+    const PackSource *source = &sources[i];
+    if (source->size > 0 && source->size <= PACK_DICTIONARY_MAX_ENTRY_SIZE) {
+      memcpy(samples + offset, source->data, source->size);
+      offset += source->size;
+      sample_sizes[sample_idx++] = source->size;
+    }
+  }
+
+  size_t size = ZDICT_trainFromBuffer(dictionary, PACK_DICTIONARY_CAPACITY,
+                                      samples, sample_sizes, sample_count);
+  hb_free(std_alloc, samples);
+  hb_free(std_alloc, sample_sizes);
+  if (ZDICT_isError(size)) {
+    SDL_Log("Skipping pack dictionary: %s", ZDICT_getErrorName(size));
+    hb_free(std_alloc, dictionary);
+    return NULL;
+  }
+  *out_size = size;
+  return dictionary;
+}
+
+int32_t vfs_write_pack(Allocator std_alloc, JobSystem *jobs,
+                       const char *pack_path, uint32_t file_count,
+                       const char *const *names, const char *const *src_paths) {
+  TracyCZoneN(ctx, "vfs_write_pack", true);
+  int32_t err = 0;
+
+  PackSource *sources =
+      hb_alloc_nm_tp(std_alloc, SDL_max(file_count, 1), PackSource);
+  PackEntry *entries =
+      hb_alloc_nm_tp(std_alloc, SDL_max(file_count, 1), PackEntry);
+  if (!sources || !entries) {
+    hb_free(std_alloc, sources);
+    hb_free(std_alloc, entries);
+    TracyCZoneEnd(ctx);
+    return -1;
+  }
+  memset(sources, 0, SDL_max(file_count, 1) * sizeof(PackSource));
+
+  // Sources are read whole; packing is offline and assets fit in memory
+  size_t names_size = 0;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    PackSource *source = &sources[i];
+    source->name = names[i];
+    source->name_size = strlen(names[i]);
+    source->path_hash = pack_path_hash(names[i], source->name_size);
+    source->data = read_file(std_alloc, src_paths[i], &source->size);
+    names_size += source->name_size;
+    if (!source->data) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to read %s", src_paths[i]);
+      err = -2;
+    }
+  }
+  if (err == 0) {
+    qsort(sources, file_count, sizeof(PackSource), pack_source_cmp);
+  }
+  for (uint32_t i = 1; i < file_count && err == 0; ++i) {
+    const PackSource *prev = &sources[i - 1];
+    if (prev->name_size == sources[i].name_size &&
+        memcmp(prev->name, sources[i].name, prev->name_size) == 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s is packed twice", prev->name);
+      err = -3;
+    }
+  }
+
+  size_t dictionary_size = 0;
+  uint8_t *dictionary = NULL;
+  ZSTD_CDict *cdict = NULL;
+  if (err == 0) {
+    dictionary =
+        train_pack_dictionary(std_alloc, sources, file_count, &dictionary_size);
+  }
+  if (dictionary) {
+    cdict = ZSTD_createCDict(dictionary, dictionary_size,
+                             PACK_COMPRESSION_LEVEL);
+    if (!cdict) {
+      err = -1;
+    }
+  }
+
+  // Split every entry into chunks and compress them all at once
+  uint32_t chunk_count = 0;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    chunk_count += pack_chunk_count(sources[i].size);
+  }
+  PackChunkJob *chunk_jobs =
+      hb_alloc_nm_tp(std_alloc, SDL_max(chunk_count, 1), PackChunkJob);
+  PackChunk *chunks = hb_alloc_nm_tp(std_alloc, SDL_max(chunk_count, 1),
+                                     PackChunk);
+  if (!chunk_jobs || !chunks) {
+    err = -1;
+  }
+  if (chunk_jobs) {
+    memset(chunk_jobs, 0, SDL_max(chunk_count, 1) * sizeof(PackChunkJob));
+  }
+
+  uint32_t job_idx = 0;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    const PackSource *source = &sources[i];
+    bool use_dictionary = cdict && source->size > 0 &&
+                          source->size <= PACK_DICTIONARY_MAX_ENTRY_SIZE;
+    for (size_t offset = 0; offset < source->size; offset += PACK_CHUNK_SIZE) {
+      PackChunkJob *job = &chunk_jobs[job_idx++];
+      job->src = source->data + offset;
+      job->src_size = SDL_min(source->size - offset, PACK_CHUNK_SIZE);
+      job->dictionary = use_dictionary ? cdict : NULL;
+      job->dst_capacity = ZSTD_compressBound(job->src_size);
+      job->dst = hb_alloc(std_alloc, job->dst_capacity);
+      if (!job->dst) {
+        err = -1;
+        break;
+      }
+    }
+  }
+  if (err == 0 && chunk_count > 0) {
+    job_parallel_for(jobs, chunk_count, pack_compress_job, chunk_jobs);
+  }
+
+  // Only entries that compress worthwhile keep their chunks; the layout
+  // puts the tables first, then stored entries, then chunks
+  uint64_t offset = sizeof(PackHeader);
+  uint64_t entries_offset =
+      pack_reserve(&offset, file_count * sizeof(PackEntry), PACK_ALIGNMENT);
+  uint32_t packed_chunk_count = 0;
+  job_idx = 0;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    const PackSource *source = &sources[i];
+    uint32_t source_chunks = pack_chunk_count(source->size);
+    size_t compressed_size = 0;
+    for (uint32_t ii = 0; ii < source_chunks; ++ii) {
+      const PackChunkJob *job = &chunk_jobs[job_idx + ii];
+      if (job->dst_size == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to compress %s",
+                     source->name);
+        err = -4;
+      }
+      compressed_size += job->dst_size;
+    }
+
+    bool compress = err == 0 && source_chunks > 0 &&
+                    compressed_size <
+                        source->size - source->size / PACK_MIN_SAVING;
+    entries[i] = (PackEntry){
+        .path_hash = source->path_hash,
+        .content_hash = hash64(source->data, source->size, 0),
+        .size = source->size,
+        .first_chunk = compress ? packed_chunk_count : 0,
+        .chunk_count = compress ? source_chunks : 0,
+        .flags = compress && chunk_jobs[job_idx].dictionary
+                     ? PACK_ENTRY_DICTIONARY
+                     : 0,
+    };
+    packed_chunk_count += entries[i].chunk_count;
+    job_idx += source_chunks;
+  }
+  uint64_t chunks_offset = pack_reserve(
+      &offset, packed_chunk_count * sizeof(PackChunk), PACK_ALIGNMENT);
+  uint64_t names_offset = pack_reserve(&offset, names_size, 1);
+  uint64_t dictionary_offset = pack_reserve(&offset, dictionary_size, 1);
+
+  uint32_t name_offset = 0;
+  job_idx = 0;
+  for (uint32_t i = 0; i < file_count && err == 0; ++i) {
+    PackEntry *entry = &entries[i];
+    entry->name = name_offset;
+    entry->name_size = (uint32_t)sources[i].name_size;
+    name_offset += entry->name_size;
+    if (entry->chunk_count == 0) {
+      entry->offset = pack_reserve(&offset, entry->size, PACK_ALIGNMENT);
+    }
+    for (uint32_t ii = 0; ii < entry->chunk_count; ++ii) {
+      const PackChunkJob *job = &chunk_jobs[job_idx + ii];
+      chunks[entry->first_chunk + ii] = (PackChunk){
+          .offset = pack_reserve(&offset, job->dst_size, 1),
+          .size = (uint32_t)job->dst_size,
+      };
+    }
+    job_idx += pack_chunk_count(sources[i].size);
+  }
+
+  PackHeader header = {
+      .magic = PACK_MAGIC,
+      .version = PACK_VERSION,
+      .entry_count = file_count,
+      .chunk_count = packed_chunk_count,
+      .entries = entries_offset,
+      .chunks = chunks_offset,
+      .names = names_offset,
+      .names_size = names_size,
+      .dictionary = dictionary_offset,
+      .dictionary_size = dictionary_size,
+      .size = offset,
+  };
+
+  SDL_RWops *file = err == 0 ? SDL_RWFromFile(pack_path, "wb") : NULL;
+  if (err == 0 && !file) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", SDL_GetError());
+    err = -5;
+  }
+  if (file) {
+    uint64_t written = 0;
+    bool ok = pack_write(file, &written, 0, &header, sizeof(header)) &&
+              pack_write(file, &written, entries_offset, entries,
+                         file_count * sizeof(PackEntry)) &&
+              pack_write(file, &written, chunks_offset, chunks,
+                         packed_chunk_count * sizeof(PackChunk));
+    for (uint32_t i = 0; i < file_count && ok; ++i) {
+      ok = pack_write(file, &written, names_offset + entries[i].name,
+                      sources[i].name, sources[i].name_size);
+    }
+    ok = ok && pack_write(file, &written, dictionary_offset, dictionary,
+                          dictionary_size);
+    job_idx = 0;
+    for (uint32_t i = 0; i < file_count && ok; ++i) {
+      const PackEntry *entry = &entries[i];
+      if (entry->chunk_count == 0) {
+        ok = pack_write(file, &written, entry->offset, sources[i].data,
+                        entry->size);
+      }
+      for (uint32_t ii = 0; ii < entry->chunk_count && ok; ++ii) {
+        const PackChunk *chunk = &chunks[entry->first_chunk + ii];
+        ok = pack_write(file, &written, chunk->offset,
+                        chunk_jobs[job_idx + ii].dst, chunk->size);
+      }
+      job_idx += pack_chunk_count(sources[i].size);
+    }
+    ok = pack_write(file, &written, header.size, NULL, 0) && ok;
+    if (SDL_RWclose(file) != 0 || !ok) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to write %s", pack_path);
+      err = -5;
+    }
+  }
+
+  if (err == 0) {
+    size_t raw_size = 0;
+    for (uint32_t i = 0; i < file_count; ++i) {
+      raw_size += sources[i].size;
+    }
+    SDL_Log("Packed %u files (%u compressed chunks) from %zu to %llu bytes",
+            file_count, packed_chunk_count, raw_size,
+            (unsigned long long)header.size);
+  }
+
+  for (uint32_t i = 0; chunk_jobs && i < chunk_count; ++i) {
+    hb_free(std_alloc, chunk_jobs[i].dst);
+  }
+  for (uint32_t i = 0; i < file_count; ++i) {
+    hb_free(std_alloc, sources[i].data);
+  }
+  ZSTD_freeCDict(cdict);
+  hb_free(std_alloc, dictionary);
+  hb_free(std_alloc, chunk_jobs);
+  hb_free(std_alloc, chunks);
+  hb_free(std_alloc, entries);
+  hb_free(std_alloc, sources);
+  TracyCZoneEnd(ctx);
+  return err;
+}
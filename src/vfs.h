@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "mappedfile.h"
+
+typedef struct JobSystem JobSystem;
+typedef struct ZSTD_DDict_s ZSTD_DDict;
+
+#define VFS_MAX_PACKS 4
+
+/*
+  A pack is many assets in one file: a table of contents sorted by path
+  hash, then every entry either stored as is or split into independently
+  zstd compressed chunks so one large entry can decompress on many threads.
+  Small entries share a trained dictionary. Stored entries are aligned so a
+  mapped pack hands them out in place without a copy.
+*/
+typedef struct VfsPack {
+  const char *mount; // Prefix of the paths this pack serves
+  size_t mount_len;
+  const uint8_t *data;
+  size_t size;
+  MappedFile file;
+  uint8_t *heap_data; // Only set where the pack couldn't be mapped
+  ZSTD_DDict *dictionary;
+} VfsPack;
+
+// Resolves asset paths to pack entries first and loose files second
+typedef struct Vfs {
+  Allocator std_alloc;
+  uint32_t pack_count;
+  VfsPack packs[VFS_MAX_PACKS];
+} Vfs;
+
+/*
+  The contents of one opened asset. data points into a mapped pack or
+  loose file where possible and into a heap copy otherwise; either way it
+  is valid until vfs_close.
+*/
+typedef struct VfsFile {
+  const uint8_t *data;
+  size_t size;
+  uint64_t content_hash; // Hash of the contents; 0 for loose files
+
+  Allocator alloc;
+  uint8_t *heap_data;
+  MappedFile mapped;
+} VfsFile;
+
+void create_vfs(Allocator std_alloc, Vfs *out_vfs);
+// Paths starting with mount are looked up in the pack before loose files.
+// mount must outlive the vfs. Returns false if the pack is missing or
+// invalid, which just leaves loose files to serve everything.
+bool vfs_mount_pack(Vfs *vfs, const char *mount, const char *pack_path);
+void destroy_vfs(Vfs *vfs);
+
+// A NULL vfs reads loose files only. Safe to call from any thread as long as
+// alloc is.
+bool vfs_open(const Vfs *vfs, Allocator alloc, const char *path,
+              VfsFile *out_file);
+// Opens many files at once, decompressing every chunk of every file across
+// jobs. Fails only if every file does; check each file's data. Must not be
+// called from inside a job.
+bool vfs_open_many(const Vfs *vfs, JobSystem *jobs, Allocator alloc,
+                   uint32_t file_count, const char *const *paths,
+                   VfsFile *out_files);
+void vfs_close(VfsFile *file);
+
+// Builds a pack out of loose files; names are the paths relative to the
+// pack's mount. Chunks are compressed across jobs.
+int32_t vfs_write_pack(Allocator std_alloc, JobSystem *jobs,
+                       const char *pack_path, uint32_t file_count,
+                       const char *const *names, const char *const *src_paths);